@@ -0,0 +1,75 @@
+#ifndef MBOT_CLOCK_SYNC_HPP
+#define MBOT_CLOCK_SYNC_HPP
+
+#include <lcm/lcm-cpp.hpp>
+#include <mbot_lcm_msgs/timesync_t.hpp>
+#include <utils/clock_estimator.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+* ClockSync keeps a program on the MBot's clock, which is the clock of the computer running lcm_serial_server. Odometry
+* and lidar scans are stamped with the same clock.
+*
+* Round trip requests are sent on MBOT_TIMESYNC_REQUEST_CHANNEL, and lcm_serial_server replies with the times it
+* received and answered each one. A clock_estimator keeps the shortest round trips and fits the offset and drift between
+* the clocks. The LCM delay is removed from the offset, and a single late message doesn't move it.
+*
+* Replies are handled on the LCM thread. The other methods can be called from any thread.
+*/
+class ClockSync
+{
+public:
+
+    /**
+    * Constructor for ClockSync.
+    *
+    * \param    lcmInstance         LCM instance to send requests and handle replies on
+    * \param    requestPeriodUs     Time between requests
+    */
+    explicit ClockSync(lcm::LCM* lcmInstance, int64_t requestPeriodUs = 100000);
+    ~ClockSync(void);
+
+    ClockSync(const ClockSync&) = delete;
+    ClockSync& operator=(const ClockSync&) = delete;
+
+    /**
+    * sendRequestIfDue sends a new request if requestPeriodUs has passed since the last one. Call it regularly, like
+    * once per control cycle.
+    */
+    void sendRequestIfDue(void);
+
+    /**
+    * isSynced checks if any replies have arrived yet. Until then, now() is the local time.
+    */
+    bool isSynced(void) const { return isSynced_; }
+
+    /**
+    * now finds the current time on the MBot's clock.
+    *
+    * \return   Microseconds since the Unix epoch on the MBot's clock.
+    */
+    int64_t now(void) const;
+
+    /**
+    * error is the estimated bound on the error of now(), in microseconds.
+    */
+    double error(void) const { return error_; }
+
+private:
+
+    lcm::LCM* lcmInstance_;
+    int64_t requestPeriodUs_;
+    clock_estimator_t* estimator_;      // Only used by the LCM thread
+
+    std::atomic<int64_t> lastRequestUtime_;
+    std::atomic<int64_t> offset_;       // MBot time minus local time as of the last reply
+    std::atomic<double> error_;
+    std::atomic<bool> isSynced_;
+
+    void handleResponse(const lcm::ReceiveBuffer* buf, const std::string& channel,
+                        const mbot_lcm_msgs::timesync_t* response);
+};
+
+#endif // MBOT_CLOCK_SYNC_HPP
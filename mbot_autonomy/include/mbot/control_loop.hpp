@@ -0,0 +1,76 @@
+#ifndef MBOT_CONTROL_LOOP_HPP
+#define MBOT_CONTROL_LOOP_HPP
+
+#include <lcm/lcm-cpp.hpp>
+#include <mbot_lcm_msgs/control_loop_stats_t.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+/**
+* ControlLoopParams defines the timing of a ControlLoop.
+*/
+struct ControlLoopParams
+{
+    double rateHz;                  ///< Rate at which the control cycle runs
+    int realtimePriority;           ///< SCHED_FIFO priority of the control thread, 1-99. 0 uses normal scheduling
+    int64_t statsPeriodUs;          ///< How often the timing statistics are published
+
+    ControlLoopParams(void)
+    : rateHz(50.0)
+    , realtimePriority(0)
+    , statsPeriodUs(1000000)
+    {
+    }
+};
+
+/**
+* ControlLoop runs a control cycle at a fixed rate, independent of when LCM messages arrive.
+*
+* Two threads are used:
+*
+*   - The LCM thread handles all incoming messages. Handlers should store what the control cycle needs, usually in a
+*       LatestValue, rather than computing commands.
+*   - The control thread waits on a timerfd and runs the control cycle once per period. If a realtimePriority is set,
+*       the thread runs with SCHED_FIFO scheduling and its memory is locked, so it isn't delayed by other processes.
+*
+* The control thread measures how late each cycle starts (jitter), how long it takes, and how many deadlines are
+* missed. The statistics are published on CONTROL_LOOP_STATS_CHANNEL as a control_loop_stats_t.
+*/
+class ControlLoop
+{
+public:
+
+    /**
+    * Constructor for ControlLoop.
+    *
+    * \param    lcmInstance         LCM instance whose messages are handled and on which the statistics are published
+    * \param    params              Timing of the loop
+    */
+    ControlLoop(lcm::LCM* lcmInstance, const ControlLoopParams& params);
+
+    /**
+    * run handles LCM messages and runs the control cycle until shouldStop is set. run blocks until both threads exit.
+    *
+    * \param    cycle               Function run once per control period
+    * \param    shouldStop          Flag that stops the loop when set, usually from a signal handler
+    * \return   False if the control timer couldn't be created. Otherwise, true once stopped.
+    */
+    bool run(const std::function<void(void)>& cycle, const std::atomic<bool>& shouldStop);
+
+private:
+
+    lcm::LCM* lcmInstance_;
+    ControlLoopParams params_;
+
+    mbot_lcm_msgs::control_loop_stats_t stats_;     // Statistics for the current reporting period
+    double jitterSumUs_;
+    double computeSumUs_;
+
+    bool setRealtimePriority(void);
+    void recordCycle(int64_t jitterUs, int64_t computeUs, bool missedDeadline, int64_t numSkipped);
+    void publishStats(int64_t utime);   // Also starts a new reporting period
+    void resetStats(void);
+};
+
+#endif // MBOT_CONTROL_LOOP_HPP
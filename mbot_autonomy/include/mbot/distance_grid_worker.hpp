@@ -0,0 +1,61 @@
+#ifndef MBOT_DISTANCE_GRID_WORKER_HPP
+#define MBOT_DISTANCE_GRID_WORKER_HPP
+
+#include <planning/obstacle_distance_grid.hpp>
+#include <slam/occupancy_grid.hpp>
+#include <utils/latest_value.hpp>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+/**
+* DistanceGridWorker computes the ObstacleDistanceGrid for each new map on its own low-priority thread.
+*
+* Computing the distances takes much longer than handling a message, so doing it in an LCM handler would hold up the
+* odometry, pose, and path messages behind it. Instead, the LCM thread only passes the map to setMap, and the control
+* thread picks up the finished grid with read. If maps arrive faster than the distances can be computed, the ones in
+* between are skipped.
+*
+* Only one thread may call setMap and only one thread may call read.
+*/
+class DistanceGridWorker
+{
+public:
+
+    /**
+    * Constructor for DistanceGridWorker. Starts the worker thread.
+    */
+    DistanceGridWorker(void);
+
+    /**
+    * Destructor for DistanceGridWorker. Stops the worker thread, after it finishes any grid it is computing.
+    */
+    ~DistanceGridWorker(void);
+
+    DistanceGridWorker(const DistanceGridWorker&) = delete;
+    DistanceGridWorker& operator=(const DistanceGridWorker&) = delete;
+
+    /**
+    * setMap queues a new map. Any map queued earlier that the worker hasn't started on yet is dropped.
+    */
+    void setMap(const std::shared_ptr<const OccupancyGrid>& map);
+
+    /**
+    * read gets the distances for the newest map if they have been computed since the last read.
+    *
+    * \param    distances           Set to the new grid if there is one. Otherwise, it isn't changed
+    * \return   True if a new grid was read.
+    */
+    bool read(std::shared_ptr<const ObstacleDistanceGrid>& distances);
+
+private:
+
+    LatestValue<std::shared_ptr<const OccupancyGrid>> incomingMap_;
+    LatestValue<std::shared_ptr<const ObstacleDistanceGrid>> newDistances_;
+    std::atomic<bool> isRunning_;       // Cleared by the destructor to stop the worker thread
+    std::thread thread_;                // Declared last, so the slots exist before it starts
+
+    void run(void);
+};
+
+#endif // MBOT_DISTANCE_GRID_WORKER_HPP
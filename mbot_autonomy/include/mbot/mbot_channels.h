@@ -7,6 +7,7 @@
 #define MBOT_IMU_CHANNEL "MBOT_IMU"
 #define MBOT_ENCODERS_CHANNEL "MBOT_ENCODERS"
 #define LIDAR_CHANNEL "LIDAR"
+#define LIDAR_COMPACT_CHANNEL "LIDAR_COMPACT"
 #define WIFI_READINGS_CHANNEL "WIFI"
 #define PATH_REQUEST_CHANNEL "PATH_REQUEST"
 
@@ -14,6 +15,7 @@
 #define ODOMETRY_CHANNEL "MBOT_ODOMETRY"
 #define ODOMETRY_RESET_CHANNEL "MBOT_ODOMETRY_RESET"
 #define CONTROLLER_PATH_CHANNEL "CONTROLLER_PATH"
+#define CONTROL_LOOP_STATS_CHANNEL "MBOT_CONTROL_LOOP_STATS"
 
 #define BOTGUI_GOAL_CHANNEL "BOTGUI_GOAL" //separate channel for lcm-server excluding the motion controller
 
@@ -23,6 +25,9 @@
 #define MBOT_MAX_VEL_CHANNEL "MBOT_MAX_VEL"
 
 #define MBOT_TIMESYNC_CHANNEL "MBOT_TIMESYNC"
+#define MBOT_TIMESYNC_REQUEST_CHANNEL "MBOT_TIMESYNC_REQUEST"
+#define MBOT_TIMESYNC_RESPONSE_CHANNEL "MBOT_TIMESYNC_RESPONSE"
+#define MBOT_CLOCK_OFFSET_CHANNEL "MBOT_CLOCK_OFFSET"
 #define MESSAGE_CONFIRMATION_CHANNEL "MSG_CONFIRM"
 
 #define MBOT_SYSTEM_RESET_CHANNEL "MBOT_SYSTEM_RESET"
@@ -0,0 +1,89 @@
+#ifndef MBOT_TRAJECTORY_HPP
+#define MBOT_TRAJECTORY_HPP
+
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <vector>
+
+/**
+* TrajectoryLimits defines the motion limits used to time-parameterize a path.
+*/
+struct TrajectoryLimits
+{
+    double maxVel;                  ///< Maximum forward speed (m/s)
+    double maxAccel;                ///< Maximum forward acceleration and deceleration (m/s^2)
+    double maxAngularVel;           ///< Maximum turn rate (rad/s)
+    double maxCentripetalAccel;     ///< Maximum v^2 * curvature, which sets how fast corners are taken (m/s^2)
+    double sampleSpacing;           ///< Distance between points in the trajectory (m)
+    double cornerSmoothing;         ///< Distance over which corners are rounded. Corners are cut by about a third of it (m)
+
+    TrajectoryLimits(void)
+    : maxVel(0.5)
+    , maxAccel(0.5)
+    , maxAngularVel(2.5)
+    , maxCentripetalAccel(0.5)
+    , sampleSpacing(0.01)
+    , cornerSmoothing(0.2)
+    {
+    }
+};
+
+/**
+* TrajectoryPoint is the reference state of the robot at time t along a Trajectory.
+*/
+struct TrajectoryPoint
+{
+    double t;           ///< Time since the start of the trajectory (s)
+    double x;
+    double y;
+    double theta;
+    double v;           ///< Forward speed (m/s)
+    double w;           ///< Turn rate (rad/s)
+};
+
+/**
+* Trajectory is a path2D_t with a speed assigned to every point, so it can be tracked in time rather than followed
+* one waypoint at a time.
+*
+* The path is resampled at limits.sampleSpacing and its corners are rounded so that its heading changes smoothly.
+* The speed at each point is the fastest allowed by the speed, turn rate, and centripetal acceleration limits, and then
+* forward and backward passes limit the acceleration. The trajectory starts and ends at rest. It's planned a little
+* inside the limits, so the commands that track it can go faster or turn harder to correct errors.
+*/
+class Trajectory
+{
+public:
+
+    /**
+    * Default constructor for Trajectory. The trajectory is empty.
+    */
+    Trajectory(void);
+
+    /**
+    * Constructor for Trajectory.
+    *
+    * \param    path            Waypoints to pass through. Their headings are ignored
+    * \param    limits          Limits on the motion along the path
+    */
+    Trajectory(const std::vector<mbot_lcm_msgs::pose2D_t>& path, const TrajectoryLimits& limits);
+
+    bool empty(void) const { return points_.empty(); }
+    std::size_t size(void) const { return points_.size(); }
+    double duration(void) const { return points_.empty() ? 0.0 : points_.back().t; }
+
+    /**
+    * sample finds the reference state at time t. Times outside the trajectory are clamped to its start or end.
+    *
+    * \param    t               Time since the start of the trajectory (s)
+    * \return   Reference state interpolated between the nearest points.
+    */
+    TrajectoryPoint sample(double t) const;
+
+    const TrajectoryPoint& front(void) const { return points_.front(); }
+    const TrajectoryPoint& back(void) const { return points_.back(); }
+
+private:
+
+    std::vector<TrajectoryPoint> points_;
+};
+
+#endif // MBOT_TRAJECTORY_HPP
@@ -0,0 +1,125 @@
+#ifndef MBOT_TRAJECTORY_TRACKER_HPP
+#define MBOT_TRAJECTORY_TRACKER_HPP
+
+#include <mbot/trajectory.hpp>
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <mbot_lcm_msgs/twist2D_t.hpp>
+#include <cstdint>
+
+/**
+* TrackerParams defines the horizon and weights of the TrajectoryTracker.
+*/
+struct TrackerParams
+{
+    int horizonSteps;               ///< Number of steps the tracker looks ahead
+    double stepSec;                 ///< Length of each step in the horizon (s)
+    double alongWeight;             ///< Cost of position error along the reference heading
+    double crossWeight;             ///< Cost of position error across the reference heading
+    double headingWeight;           ///< Cost of heading error
+    double velWeight;               ///< Cost of changing the forward speed from the reference speed
+    double angularVelWeight;        ///< Cost of changing the turn rate from the reference turn rate
+    double maxLag;                  ///< The reference stops moving when the robot is this far behind it (m)
+    double goalTolerance;           ///< Distance from the end of the trajectory at which the goal is reached (m)
+    double headingTolerance;        ///< Heading error at which the initial and final turns are done (rad)
+
+    TrackerParams(void)
+    : horizonSteps(20)
+    , stepSec(0.05)
+    , alongWeight(20.0)
+    , crossWeight(40.0)
+    , headingWeight(2.0)
+    , velWeight(1.0)
+    , angularVelWeight(0.1)
+    , maxLag(0.2)
+    , goalTolerance(0.02)
+    , headingTolerance(0.05)
+    {
+    }
+};
+
+/**
+* TrajectoryTracker drives a differential-drive robot along a Trajectory with a receding-horizon controller.
+*
+* Each call to getCommand linearizes the robot's error dynamics about the reference over the next horizonSteps
+* steps and solves the finite-horizon LQ problem with a backward Riccati recursion. Only the first command is used,
+* and the problem is solved again on the next cycle. The cost is about horizonSteps small matrix products, a few
+* microseconds on a Raspberry Pi core.
+*
+* The command is the reference speed and turn rate plus the correction from the solution, then clamped to the
+* TrajectoryLimits. If the robot falls behind, the reference slows down and waits for it rather than running away.
+*
+* Before tracking, the robot turns in place to face the start of the trajectory. Once the end is reached, it turns in
+* place to the heading of the final pose in the path.
+*/
+class TrajectoryTracker
+{
+public:
+
+    /**
+    * Constructor for TrajectoryTracker.
+    *
+    * \param    limits          Limits on the commands
+    * \param    params          Horizon and weights
+    */
+    TrajectoryTracker(const TrajectoryLimits& limits = TrajectoryLimits(), const TrackerParams& params = TrackerParams());
+
+    /**
+    * setTrajectory starts tracking a new trajectory.
+    *
+    * \param    trajectory      Trajectory to track
+    * \param    goalHeading     Heading to turn to once the end of the trajectory is reached
+    */
+    void setTrajectory(const Trajectory& trajectory, double goalHeading);
+
+    /**
+    * setLimits changes the command limits. The current trajectory isn't changed.
+    */
+    void setLimits(const TrajectoryLimits& limits) { limits_ = limits; }
+    const TrajectoryLimits& limits(void) const { return limits_; }
+
+    /**
+    * getCommand computes the command for the current cycle.
+    *
+    * \param    pose            Current pose of the robot
+    * \param    utime           Current time, used to advance the reference
+    * \return   Command to send to the robot. It is zero once the trajectory is done.
+    */
+    mbot_lcm_msgs::twist2D_t getCommand(const mbot_lcm_msgs::pose2D_t& pose, int64_t utime);
+
+    /**
+    * isDone checks if the goal has been reached, or if there's no trajectory.
+    */
+    bool isDone(void) const { return phase_ == DONE; }
+
+    /**
+    * stop abandons the current trajectory.
+    */
+    void stop(void);
+
+private:
+
+    enum Phase
+    {
+        INITIAL_TURN,
+        TRACK,
+        FINAL_TURN,
+        DONE
+    };
+
+    TrajectoryLimits limits_;
+    TrackerParams params_;
+
+    Trajectory trajectory_;
+    double goalHeading_;
+    Phase phase_;
+    double refTime_;                    // Time along the trajectory that the robot should be at
+    int64_t lastUtime_;
+    double lastVel_;
+
+    mbot_lcm_msgs::twist2D_t turnTo(const mbot_lcm_msgs::pose2D_t& pose, double heading, double dt);
+    mbot_lcm_msgs::twist2D_t approachGoal(const mbot_lcm_msgs::pose2D_t& pose, double dt);
+    void solveHorizon(const double error[3], double& velCorrection, double& angularVelCorrection) const;
+    mbot_lcm_msgs::twist2D_t limitCommand(double vel, double angularVel, double dt);
+};
+
+#endif // MBOT_TRAJECTORY_TRACKER_HPP
@@ -109,8 +109,31 @@ struct SearchParams
     double distanceCostExponent;    ///< The exponent to apply to the distance cost, whose function is:
                                     ///<   pow(maxDistanceWithCost / cellDistance, distanceCostExponent)
                                     ///< for cellDistance > minDistanceToObstacle && cellDistance < maxDistanceWithCost
+
+    bool useJumpPoints = false;     ///< Use Jump Point Search through cells at least maxDistanceWithCost from obstacles.
+                                    ///< These cells all have the same cost, so the search jumps straight across them
+                                    ///< and only expands cells where the path could turn. Closer to obstacles the
+                                    ///< search falls back to the normal weighted expansion.
 };
 
+/**
+* SearchStats records the work done by a single call to search_for_path. It is used to compare the different search
+* modes against each other.
+*/
+struct SearchStats
+{
+    int64_t expandedNodes = 0;      ///< Number of nodes removed from the open list and expanded
+    int64_t searchTimeUs = 0;       ///< Time spent searching, in microseconds
+    double pathCost = 0.0;          ///< Cost of the path found, or 0 if there is none
+};
+
+// A cell can be driven through if the robot fits there without touching an obstacle
+bool is_traversable(int x, int y, const ObstacleDistanceGrid& distances, const SearchParams& params);
+// Cells at least maxDistanceWithCost from obstacles all have the same cost per step
+bool is_uniform(int x, int y, const ObstacleDistanceGrid& distances, const SearchParams& params);
+// Cost of stepping into cell (x, y) from one of its neighbors
+double step_cost(int x, int y, bool diagonal, const ObstacleDistanceGrid& distances, const SearchParams& params);
+
 double h_cost(Node* from, Node* goal, const ObstacleDistanceGrid& distances);
 double g_cost(Node* from, Node* goal, const ObstacleDistanceGrid& distances, const SearchParams& params);
 std::vector<Node*> expand_node(Node* node, const ObstacleDistanceGrid& distances, const SearchParams& params);
@@ -129,12 +152,14 @@ Node* get_from_list(Node* node, std::vector<Node*> list);
 * \param    goal            Desired goal pose of the robot
 * \param    distances       Distance to the nearest obstacle for each cell in the grid
 * \param    params          Parameters specifying the behavior of the A* search
+* \param    stats           If not null, filled with the number of expanded nodes, the search time, and the path cost (optional)
 * \return   The path found to the goal, if one exists. If the goal is unreachable, then a path with just the initial
 *   pose is returned, per the path2D_t specification.
 */
 mbot_lcm_msgs::path2D_t search_for_path(mbot_lcm_msgs::pose2D_t start,
                                              mbot_lcm_msgs::pose2D_t goal,
                                              const ObstacleDistanceGrid& distances,
-                                             const SearchParams& params);
+                                             const SearchParams& params,
+                                             SearchStats* stats = nullptr);
 
 #endif // PLANNING_ASTAR_HPP
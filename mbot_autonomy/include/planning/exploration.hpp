@@ -5,17 +5,40 @@
 #include <planning/planning_channels.h>
 #include <planning/motion_planner.hpp>
 #include <planning/frontiers.hpp>
+#include <planning/path_safety_monitor.hpp>
 #include <slam/occupancy_grid.hpp>
 #include <mbot_lcm_msgs/exploration_status_t.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <mbot_lcm_msgs/path2D_t.hpp>
 #include <mbot_lcm_msgs/mbot_message_received_t.hpp>
+#include <utils/latest_value.hpp>
 #include <lcm/lcm-cpp.hpp>
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include <set>
 #include <iostream>
 
 
+/**
+* ExplorationMap is the configuration space built from one map. Once built, it's shared by the exploration stages
+* and never changed.
+*/
+struct ExplorationMap
+{
+    std::shared_ptr<const OccupancyGrid> map;
+    std::shared_ptr<const MotionPlanner> planner;   // Planner with its obstacle distances set for map
+};
+
+/**
+* ExplorationFrontiers holds the frontiers found in one ExplorationMap.
+*/
+struct ExplorationFrontiers
+{
+    std::shared_ptr<const ExplorationMap> cspace;   // Map the frontiers were found in
+    std::vector<frontier_t> frontiers;
+};
+
+
 /**
 * Exploration runs a simple state machine to explore -- and possibly escape from -- an environment. The state machine
 * for Exploration goes through the following steps:
@@ -36,6 +59,16 @@
 *   - FAILED_EXPLORATION:
 *       stop the robot, exit with FAILURE
 *
+* The work is split into stages that run on their own threads, so a slow stage never holds up the others:
+*
+*   - map stage: builds the configuration space, an ExplorationMap, for each new map
+*   - frontier stage: finds the frontiers in each new ExplorationMap
+*   - explore stage: the thread calling exploreEnvironment. It checks the path and runs the state machine for each new
+*       set of frontiers, selecting goals and planning paths
+*
+* Each stage hands its results to the next through a LatestValue slot. If a stage falls behind, it skips straight to
+* the newest data rather than working through a backlog. Results are shared as immutable snapshots, so no stage ever
+* waits on a lock held by another, and the LCM handlers only copy the incoming message into a slot.
 */
 class Exploration
 {
@@ -63,7 +96,8 @@ public:
     * exploreEnvironment explores the robot's environment. The exploration routine assumes that the environment
     * is enclosed.
     *
-    * exploreEnvironment doesn't return until the exploration is completed.
+    * exploreEnvironment doesn't return until the exploration is completed. The map and frontier stages run on their
+    * own threads until then.
     *
     * \return   True if the exploration was successful. False if the exploration failed.
     */
@@ -79,24 +113,35 @@ private:
     int8_t state_;                      // Current state of the high-level exploration state machine, as defined in exploration_status_t
     bool  shouldAttemptEscape_;         // Flag indicating if the escaping_map state should be entered after returning_home completes
     mbot_lcm_msgs::pose2D_t currentPose_;  // Robot pose to use for computing new paths
-    OccupancyGrid currentMap_;          // Map to use for finding frontiers and planning paths to them
-    MotionPlanner planner_;             // Planner to use for finding collision-free paths to select frontiers
+    std::shared_ptr<const OccupancyGrid> currentMap_;   // Map to use for finding frontiers and planning paths to them
+    std::shared_ptr<const MotionPlanner> planner_;      // Planner for finding collision-free paths to frontiers
 
     mbot_lcm_msgs::pose2D_t homePose_;  // Pose of the robot when it is home, i.e. the initial pose before exploration begins
 
     mbot_lcm_msgs::path2D_t currentPath_;  // Current path being followed to a frontier or other target, like the home or key poses
     std::vector<frontier_t> frontiers_; // Current frontiers in the map
+    PathSafetyMonitor pathMonitor_;     // Checks currentPath_ against each new map
+    bool pathInvalidated_;              // Flag indicating a new map blocked currentPath_, so a new path is needed now
+    bool havePose_;                     // Flag indicating if a pose has been received by the explore stage
+    bool haveHomePose_;                 // Flag indicating if the home pose has been set
 
-    // Data coming in from other modules -- used by LCM thread
-    mbot_lcm_msgs::pose2D_t incomingPose_;  // Temporary storage for the most recently received pose until needed by explore thread
-    OccupancyGrid incomingMap_;         // Temporary storage for the most recently received map until needed by explore thread
+    // Used only by the map stage
+    MotionPlannerParams plannerParams_;
+    std::vector<std::shared_ptr<MotionPlanner>> plannerPool_;   // Planners that can be reused once no stage holds them
 
-    bool haveNewPose_;                  // Flag indicating if a new pose has been received since the last call to copyDataForUpdate
-    bool haveNewMap_;                   // Flag indicating if a new map has been received since the last call to copyDataForUpdate
-    bool haveHomePose_;                 // Flag indicating if the home pose has been set
+    // Used only by the frontier stage
+    FrontierDetector frontierDetector_; // Finds the frontiers incrementally as the map is updated
+
+    // Data passed between the LCM thread and the stages. Each slot has one writer and one reader.
+    LatestValue<std::shared_ptr<const OccupancyGrid>> incomingMap_;         // LCM thread -> map stage
+    LatestValue<mbot_lcm_msgs::pose2D_t> incomingFrontierPose_;             // LCM thread -> frontier stage
+    LatestValue<mbot_lcm_msgs::pose2D_t> incomingPose_;                     // LCM thread -> explore stage
+    LatestValue<std::shared_ptr<const ExplorationMap>> newCSpace_;          // map stage -> frontier stage
+    LatestValue<std::shared_ptr<const ExplorationFrontiers>> newFrontiers_; // frontier stage -> explore stage
+
+    std::atomic<bool> isExploring_;     // Cleared when exploreEnvironment finishes, to stop the other stages
 
     lcm::LCM* lcmInstance_;             // Instance of LCM to use for sending out information
-    std::mutex dataLock_;               // Lock to keep the LCM and explore threads properly synchronized
 
     /////////// TODO: Add any state variables you might need here //////////////
 
@@ -104,8 +149,8 @@ private:
     OccupancyGrid exploredMap_;     // Map found after completing the RETURNING_HOME state
 
     size_t prev_frontier_size;
-    bool pathReceived_;
-    int64_t most_recent_path_time;
+    std::atomic<bool> pathReceived_;                // Also set by the LCM thread
+    std::atomic<int64_t> most_recent_path_time;
 //    int8_t path_redundancy_count;
 
     // Whether or not it has received at least one frontier to explore
@@ -114,9 +159,11 @@ private:
     /////////////////////////// End student code ///////////////////////////////
 
 
-    bool isReadyToUpdate(void);
-    void runExploration(void);
-    void copyDataForUpdate(void);
+    void runMapStage(void);
+    void runFrontierStage(void);
+
+    bool copyDataForUpdate(void);
+    void checkPathSafety(void);
 
     void   executeStateMachine(void);
     int8_t executeInitializing(void);
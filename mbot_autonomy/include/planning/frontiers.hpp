@@ -4,6 +4,7 @@
 #include <utils/geometric/point.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <mbot_lcm_msgs/path2D_t.hpp>
+#include <unordered_map>
 #include <vector>
 
 class MotionPlanner;
@@ -30,6 +31,82 @@ struct frontier_processing_t
 };
 
 
+/**
+* FrontierDetector finds the frontiers in a map that is updated over time, as during exploration. Rather than searching
+* the whole map on every update, it keeps the frontier cells, the free space reachable from the robot, and the frontier
+* clusters from the previous map, and only re-examines the neighborhood of cells whose state (free, unknown, or
+* occupied) changed.
+*
+* Frontier cells are grouped into clusters using union-find, so clusters persist and merge as the map grows. When a
+* cluster loses a cell, only that cluster is relabeled, since removing the cell might have split it.
+*
+* The frontiers found are exactly those found by find_map_frontiers.
+*/
+class FrontierDetector
+{
+public:
+
+    /**
+    * Constructor for FrontierDetector.
+    *
+    * \param    minFrontierLength       Minimum length of a valid frontier (meters) (optional, default = 0.35m)
+    */
+    explicit FrontierDetector(double minFrontierLength = 0.35);
+
+    /**
+    * update finds the frontiers in a new version of the map. If the size, resolution, or origin of the map changed
+    * since the last update, all state is rebuilt from scratch.
+    *
+    * \param    map                     Latest map
+    * \param    robotPose               Pose of the robot in the map
+    * \return   All frontiers reachable through free space from the robot pose, as described for find_map_frontiers.
+    */
+    std::vector<frontier_t> update(const OccupancyGrid& map, const mbot_lcm_msgs::pose2D_t& robotPose);
+
+    /**
+    * reset clears all state, so the next update rebuilds everything.
+    */
+    void reset(void);
+
+    // Number of cells whose state changed in the last update, or -1 if the last update rebuilt everything
+    int numChangedCells(void) const { return numChangedCells_; }
+
+private:
+
+    double minFrontierLength_;
+
+    int width_;
+    int height_;
+    float metersPerCell_;
+    Point<float> origin_;
+    int robotIndex_;                    // Cell the robot was in on the last update
+
+    std::vector<bool> isFree_;          // log-odds < 0
+    std::vector<bool> isUnknown_;       // log-odds == 0
+    std::vector<bool> isFrontier_;
+    std::vector<bool> isReachable_;     // Free space connected to the robot cell, plus the robot cell itself
+
+    // Union-find forest over frontier cells. Each cluster's cells are kept with its root.
+    std::vector<int> parent_;
+    std::unordered_map<int, std::vector<int>> clusters_;
+
+    int numChangedCells_;
+
+    void rebuild(const OccupancyGrid& map, int robotIndex);
+    void rebuildReachable(int robotIndex);
+    void growReachable(int seedIndex);
+    bool isStillConnected(int lostIndex) const;
+
+    void updateFrontiers(const OccupancyGrid& map, const std::vector<int>& changedCells);
+    void linkCluster(int index);
+
+    int findRoot(int index);
+    void unionClusters(int indexA, int indexB);
+
+    bool isTouchingReachable(int index) const;
+};
+
+
 /**
 * find_map_frontiers locates all frontiers in the provided map. A frontier cell is an unknown cell (log-odds == 0) that
 * borders a free space cell (log-odds < 0). A frontier is a contiguous region of frontier cells.
@@ -41,9 +118,12 @@ struct frontier_processing_t
 *
 * \param    map                     Map in which to find the frontiers
 * \param    robotPose               Pose of the robot at the start
-* \param    minFrontierLength       Minimum length of a valid frontier (meters) (optional, default = 0.1m)
+* \param    minFrontierLength       Minimum length of a valid frontier (meters) (optional, default = 0.35m)
 * \return   All frontiers found in the map. A fully-explored map will have no frontiers, so the returned vector will be
 *   empty in that case.
+*
+* find_map_frontiers searches the whole map on every call. To find frontiers repeatedly in an evolving map, use a
+* FrontierDetector instead.
 */
 std::vector<frontier_t> find_map_frontiers(const OccupancyGrid& map,
                                            const mbot_lcm_msgs::pose2D_t& robotPose,
@@ -55,6 +135,10 @@ std::vector<frontier_t> find_map_frontiers(const OccupancyGrid& map,
 * frontier is returned. If no frontiers exist or there are no valid paths to any of the frontiers, then a path of length
 * 1, with the only pose being the robot pose should be returned indicating an error.
 *
+* All frontiers are evaluated with a single Dijkstra search from the robot through the planner's configuration space.
+* The chosen frontier has the lowest path cost to a nearby goal cell, less a bonus for the expected information gain at
+* that goal cell. The gains of the goal cells are computed in parallel.
+*
 * \param    frontiers           Frontiers in the environment
 * \param    robotPose           Pose of the robot from which to plan
 * \param    map                 Map being explored
@@ -67,6 +151,29 @@ frontier_processing_t plan_path_to_frontier(const std::vector<frontier_t>& front
                                    const MotionPlanner& planner);
 
 
+/**
+* expected_information_gain estimates how much unknown space the lidar would see from a position. Rays are cast out to
+* maxRange in every direction and stop at the first occupied cell. Unknown cells don't block the rays, since whatever
+* is in them hasn't been seen yet.
+*
+* Each sample along a ray stands for the area of the ray's wedge around it, so the result is the unknown area in view,
+* without having to keep track of which cells were already counted by another ray.
+*
+* \param    position            Position of the lidar in global coordinates
+* \param    map                 Map being explored
+* \param    maxRange            Range of the lidar (meters) (optional, default = 5m, the range used by the mapping)
+* \param    numRays             Number of rays cast (optional, default = 180)
+* \return   Area of unknown space in view (square meters).
+*/
+double expected_information_gain(const Point<double>& position,
+                                 const OccupancyGrid& map,
+                                 double maxRange = 5.0,
+                                 int numRays = 180);
+
+/**
+* find_frontier_centroid finds the frontier cell closest to the average position of the frontier's cells. A curved
+* frontier's average position can be off the frontier, so the closest cell on it is used instead.
+*/
 Point<double> find_frontier_centroid(const frontier_t& frontier);
 
 bool is_centroid_reachable(const Point<double>& centroid,
@@ -0,0 +1,121 @@
+#ifndef PLANNING_HIERARCHICAL_PLANNER_HPP
+#define PLANNING_HIERARCHICAL_PLANNER_HPP
+
+#include <mbot_lcm_msgs/path2D_t.hpp>
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <planning/astar.hpp>
+#include <planning/obstacle_distance_grid.hpp>
+#include <unordered_map>
+#include <vector>
+
+/**
+* HierarchicalPlanner implements HPA* (hierarchical path-finding A*) over an ObstacleDistanceGrid.
+*
+* The grid is divided into square clusters. Wherever the border between two neighboring clusters can be crossed,
+* entrance cells are placed on each side of the border. Within a cluster, the cost and cell path between every pair of
+* its entrances is found once and cached as an edge of the abstract graph. A query connects the start and goal to the
+* entrances of their clusters, runs A* over the abstract graph, and then stitches together the cached cell paths of
+* the edges it used. Finally, the path is refined by searching again, confined to the clusters the stitched path
+* crosses, so it doesn't have to detour through the entrance cells. The work done by a query grows with the number of
+* clusters the path crosses rather than the size of the map.
+*
+* When the distances change, only the clusters containing changed cells, plus the neighbors sharing a border with
+* them, have their entrances and edges rebuilt.
+*
+* To use the planner:
+*
+*   - Call setDistances whenever the ObstacleDistanceGrid changes.
+*   - Find paths using planPath.
+*/
+class HierarchicalPlanner
+{
+public:
+
+    /**
+    * Constructor for HierarchicalPlanner.
+    *
+    * \param    clusterSize         Side length of a cluster in cells (optional, default = 40)
+    */
+    explicit HierarchicalPlanner(int clusterSize = 40);
+
+    /**
+    * setDistances updates the abstract graph for a new set of obstacle distances. Only the clusters whose cells
+    * changed since the last call are rebuilt. Changing the size of the grid or the search parameters rebuilds the
+    * whole graph.
+    *
+    * \param    distances       New obstacle distances
+    * \param    params          Parameters that define the cost of moving through a cell
+    * \return   Number of clusters whose edges were rebuilt.
+    */
+    int setDistances(const ObstacleDistanceGrid& distances, const SearchParams& params);
+
+    /**
+    * planPath finds a path from the start to the goal pose using the abstract graph.
+    *
+    * \param    start           Starting pose for the path
+    * \param    goal            Goal pose for the path
+    * \param    stats           If not null, filled with the number of expanded abstract nodes and refined cells, the
+    *   search time, and the cost of the path
+    * \return   Path found from start to end. If no path is found, then the path length is 1 and contains only the start
+    *   pose, the same as search_for_path.
+    */
+    mbot_lcm_msgs::path2D_t planPath(const mbot_lcm_msgs::pose2D_t& start,
+                                     const mbot_lcm_msgs::pose2D_t& goal,
+                                     SearchStats* stats = nullptr) const;
+
+    // Accessors for the size of the abstract graph
+    int clusterSize(void) const { return clusterSize_; }
+    int numClusters(void) const { return clustersWide_ * clustersHigh_; }
+    int numAbstractNodes(void) const { return static_cast<int>(nodes_.size()); }
+
+private:
+
+    // An edge of the abstract graph. The cells are the path taken from the source node to the target, excluding the
+    // source and including the target.
+    struct AbstractEdge
+    {
+        int target;                     // Cell index of the node at the end of the edge
+        double cost;
+        std::vector<cell_t> cells;
+    };
+
+    // An entrance cell. Inter-cluster edges cross a border, while intra-cluster edges are cached paths within the
+    // node's cluster.
+    struct AbstractNode
+    {
+        cell_t cell;
+        std::vector<AbstractEdge> interEdges;
+        std::vector<AbstractEdge> intraEdges;
+    };
+
+    int clusterSize_;
+    int clustersWide_;
+    int clustersHigh_;
+
+    ObstacleDistanceGrid distances_;    // Distances the graph was built from
+    SearchParams params_;
+    bool haveGraph_;
+
+    std::unordered_map<int, AbstractNode> nodes_;     // Entrance nodes, keyed by cell index
+
+    int cellIndex(const cell_t& cell) const { return cell.y * distances_.widthInCells() + cell.x; }
+    int clusterIndex(int clusterX, int clusterY) const { return clusterY * clustersWide_ + clusterX; }
+    int clusterOf(const cell_t& cell) const { return clusterIndex(cell.x / clusterSize_, cell.y / clusterSize_); }
+
+    bool clusterChanged(int clusterX, int clusterY, const ObstacleDistanceGrid& distances) const;
+    void rebuildBorder(int clusterX, int clusterY, bool vertical);
+    void removeBorderEdges(int clusterX, int clusterY, bool vertical);
+    void addEntrance(const cell_t& from, const cell_t& to);
+    void rebuildIntraEdges(int clusterX, int clusterY);
+    std::vector<int> clusterNodes(int clusterX, int clusterY) const;
+
+    // Search for the cheapest path between the ends of cellPath that stays within the clusters cellPath crosses. The
+    // cells expanded are added to numExpanded.
+    std::vector<cell_t> refinePath(const std::vector<cell_t>& cellPath, int64_t& numExpanded) const;
+
+    // Search within a single cluster from source to each of the targets. Unreachable targets aren't included in the
+    // returned edges.
+    std::vector<AbstractEdge> searchCluster(const cell_t& source, const std::vector<cell_t>& targets) const;
+};
+
+#endif // PLANNING_HIERARCHICAL_PLANNER_HPP
@@ -0,0 +1,142 @@
+#ifndef PLANNING_LOCAL_PLANNER_HPP
+#define PLANNING_LOCAL_PLANNER_HPP
+
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <mbot_lcm_msgs/twist2D_t.hpp>
+#include <vector>
+
+class ObstacleDistanceGrid;
+
+/**
+* LocalPlannerParams defines the samples and costs used by the DynamicWindowPlanner.
+*/
+struct LocalPlannerParams
+{
+    // Limits of the robot
+    double maxVel;                  ///< Maximum forward speed (m/s)
+    double maxLateralVel;           ///< Maximum sideways speed (m/s). Zero for a differential-drive robot
+    double maxAngularVel;           ///< Maximum turn rate (rad/s)
+    double maxAccel;                ///< Maximum forward and sideways acceleration (m/s^2)
+    double maxAngularAccel;         ///< Maximum angular acceleration (rad/s^2)
+
+    // Samples
+    double windowSec;               ///< The window holds the commands reachable from the last one within this time
+    int numVelSamples;              ///< Number of forward speeds sampled in the window
+    int numLateralSamples;          ///< Number of sideways speeds sampled. Only used if maxLateralVel > 0
+    int numAngularSamples;          ///< Number of turn rates sampled in the window
+    double horizonSec;              ///< How far ahead each sample is simulated (s)
+    double stepSec;                 ///< Time between the poses checked along each simulated motion (s)
+
+    // Costs
+    double robotRadius;             ///< Motions that come closer than this to an obstacle are rejected (m)
+    double comfortClearance;        ///< Motions that come closer than this to an obstacle are penalized (m)
+    double commandWeight;           ///< Cost of differing from the desired command
+    double pathWeight;              ///< Cost per meter the end of the motion is from the path
+    double progressWeight;          ///< Reward for moving along the path, scaled so maxVel for horizonSec is 1
+    double clearanceWeight;         ///< Cost of coming within comfortClearance, scaled from 0 to 1
+
+    LocalPlannerParams(void)
+    : maxVel(0.5)
+    , maxLateralVel(0.0)
+    , maxAngularVel(2.5)
+    , maxAccel(0.5)
+    , maxAngularAccel(5.0)
+    , windowSec(0.25)
+    , numVelSamples(11)
+    , numLateralSamples(7)
+    , numAngularSamples(21)
+    , horizonSec(2.0)
+    , stepSec(0.1)
+    , robotRadius(0.15)         // less than the MotionPlanner robotRadius, so planned paths are always allowed
+    , comfortClearance(0.3)
+    , commandWeight(1.0)
+    , pathWeight(1.0)
+    , progressWeight(2.0)
+    , clearanceWeight(2.0)
+    {
+    }
+};
+
+/**
+* LocalPlannerStats describes the last command chosen by the DynamicWindowPlanner.
+*/
+struct LocalPlannerStats
+{
+    int numSamples;                 ///< Number of commands that were simulated
+    int numRejected;                ///< Number of commands that would have hit an obstacle
+    bool changedCommand;            ///< The desired command was rejected or a better one was found
+    double minClearance;            ///< Closest the chosen command comes to an obstacle (m)
+};
+
+/**
+* DynamicWindowPlanner checks the commands from a motion controller against the latest map and replaces them with safe
+* ones when needed, so small changes in the map don't require planning a new path.
+*
+* Each cycle, the planner samples the commands reachable from the last command given the acceleration limits (the
+* dynamic window) and simulates each one for horizonSec, holding it constant. Forward speed and turn rate are sampled
+* for a differential-drive robot, and sideways speed as well when maxLateralVel > 0. The desired command is always one
+* of the samples.
+*
+* Samples that come within robotRadius of an obstacle are rejected. The rest are scored by how much they differ from
+* the desired command, how far they end from the path, how far along the path they get, and how close they come to
+* obstacles, and the cheapest is chosen. If the desired command stays comfortClearance from obstacles, it's used as is.
+*
+* All samples are simulated together, one step at a time, with their poses stored in flat arrays so the compiler can
+* vectorize the motion updates. Headings are advanced by a fixed rotation per step rather than calls to sin and cos.
+*/
+class DynamicWindowPlanner
+{
+public:
+
+    /**
+    * Constructor for DynamicWindowPlanner.
+    *
+    * \param    params          Samples and costs to use
+    */
+    explicit DynamicWindowPlanner(const LocalPlannerParams& params = LocalPlannerParams());
+
+    /**
+    * computeCommand finds the best safe command near the desired command.
+    *
+    * \param    pose            Current pose of the robot in the map frame
+    * \param    desired         Command from the motion controller
+    * \param    path            Path the robot is following. If empty, the path cost isn't used
+    * \param    distances       Distance to the nearest obstacle in each cell of the latest map
+    * \return   The chosen command. If every sample would hit an obstacle, the robot is stopped.
+    */
+    mbot_lcm_msgs::twist2D_t computeCommand(const mbot_lcm_msgs::pose2D_t& pose,
+                                            const mbot_lcm_msgs::twist2D_t& desired,
+                                            const std::vector<mbot_lcm_msgs::pose2D_t>& path,
+                                            const ObstacleDistanceGrid& distances);
+
+    /**
+    * reset forgets the last command, so the next window is centered on stopped.
+    */
+    void reset(void);
+
+    const LocalPlannerParams& params(void) const { return params_; }
+    const LocalPlannerStats& lastStats(void) const { return stats_; }
+
+private:
+
+    LocalPlannerParams params_;
+    mbot_lcm_msgs::twist2D_t lastCommand_;
+    LocalPlannerStats stats_;
+
+    // Samples, stored as one array per value
+    std::vector<float> vel_;
+    std::vector<float> lateralVel_;
+    std::vector<float> angularVel_;
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> cosTheta_;
+    std::vector<float> sinTheta_;
+    std::vector<float> cosStep_;
+    std::vector<float> sinStep_;
+    std::vector<float> minClearance_;
+
+    void sampleWindow(const mbot_lcm_msgs::twist2D_t& desired);
+    void simulateSamples(const mbot_lcm_msgs::pose2D_t& pose, const ObstacleDistanceGrid& distances);
+};
+
+#endif // PLANNING_LOCAL_PLANNER_HPP
@@ -4,6 +4,7 @@
 #include <mbot_lcm_msgs/path2D_t.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <planning/astar.hpp>
+#include <planning/hierarchical_planner.hpp>
 #include <planning/obstacle_distance_grid.hpp>
 
 //for visualization
@@ -16,6 +17,10 @@ struct MotionPlannerParams
 {
     double robotRadius;     ///< Radius of the robot for which paths are being planned
 
+    bool useHierarchicalSearch;     ///< Plan over a HierarchicalPlanner abstraction of the map instead of searching
+                                    ///< the full grid. Paths are slightly longer, but planning scales to large maps.
+    int clusterSizeInCells;         ///< Side length of the clusters used by the hierarchical search
+
     /**
     * Default constructor for MotionPlannerParams.
     *
@@ -28,6 +33,8 @@ struct MotionPlannerParams
     */
     MotionPlannerParams(void)
     : robotRadius(0.2) // by default, have a little extra slop to keep the robot from getting too close to the walls
+    , useHierarchicalSearch(false)
+    , clusterSizeInCells(40)
     {
     }
 };
@@ -126,7 +133,8 @@ public:
     bool isPathSafe(const mbot_lcm_msgs::path2D_t& path) const;
 
     /**
-    * setMap sets the map for which path's will be planned.
+    * setMap sets the map for which path's will be planned. If hierarchical search is enabled, only the clusters of
+    * the abstraction whose cells changed are rebuilt.
     *
     * \param    map         OccupancyGrid representation of the environment through which paths will be planned
     */
@@ -145,15 +153,22 @@ public:
 
     /**
     * obstacleDistances retrieves the ObstacleDistanceGrid used during motion planning. The distances are intended for
-    * debugging use to create a visualization of the configuration space of the environment.
+    * debugging use to create a visualization of the configuration space of the environment, and for searches that
+    * need to share the planner's configuration space, like frontier selection.
     *
     * \return   ObstacleDistanceGrid currently being used by the motion planner.
     */
-    ObstacleDistanceGrid obstacleDistances(void) const { return distances_; }
+    const ObstacleDistanceGrid& obstacleDistances(void) const { return distances_; }
+
+    /**
+    * searchParams retrieves the default SearchParams used by planPath.
+    */
+    const SearchParams& searchParams(void) const { return searchParams_; }
 
 private:
 
     ObstacleDistanceGrid distances_;
+    HierarchicalPlanner hierarchy_;
     MotionPlannerParams params_;
     SearchParams searchParams_;
 
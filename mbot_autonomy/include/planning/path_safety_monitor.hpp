@@ -0,0 +1,111 @@
+#ifndef PLANNING_PATH_SAFETY_MONITOR_HPP
+#define PLANNING_PATH_SAFETY_MONITOR_HPP
+
+#include <mbot_lcm_msgs/path2D_t.hpp>
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <utils/geometric/point.hpp>
+#include <cstdint>
+#include <vector>
+
+class ObstacleDistanceGrid;
+
+/**
+* PathSafetyMonitor keeps checking the active path as new maps arrive, so the robot can replan as soon as a new
+* obstacle blocks it rather than when it reaches the obstacle.
+*
+* When the path is set, each segment is traced through the grid once and the cells it passes through are saved in
+* path order. When new obstacle distances arrive, only the saved cells of the segments still ahead of the robot are
+* looked at, rather than tracing the whole path again. A segment becomes unsafe when any of its cells is closer than
+* clearance to an obstacle. Segments the robot has already driven past are ignored, so obstacles mapped behind the
+* robot don't invalidate the path.
+*
+* The cells are stored in a few flat arrays sorted by segment, so the check is a single pass over contiguous memory.
+* For a few meters of path, it takes a few microseconds.
+*
+* To use the monitor:
+*
+*   - Call setPath whenever a new path is sent to the motion controller.
+*   - Call update with the distances for each new map. If it returns an index >= 0, the path is blocked after
+*     path[index].
+*/
+class PathSafetyMonitor
+{
+public:
+
+    /**
+    * Constructor for PathSafetyMonitor.
+    *
+    * \param    clearance       Cells on the path closer than this to an obstacle block it (m). The default leaves a
+    *                           little room around the MBot, but is less than the planner's robotRadius, so a newly
+    *                           planned path is always safe
+    */
+    explicit PathSafetyMonitor(double clearance = 0.15);
+
+    /**
+    * setPath starts monitoring a new path.
+    *
+    * \param    path            Path being followed
+    * \param    distances       Obstacle distances for the map the path was planned in
+    */
+    void setPath(const mbot_lcm_msgs::path2D_t& path, const ObstacleDistanceGrid& distances);
+
+    /**
+    * clearPath stops monitoring. update always reports the path as safe until setPath is called again.
+    */
+    void clearPath(void);
+
+    /**
+    * update checks the path against new obstacle distances. If the size, resolution, or origin of the grid changed,
+    * the path is traced again.
+    *
+    * \param    distances       Obstacle distances for the latest map
+    * \param    robotPose       Pose of the robot in the map, used to skip the segments already driven
+    * \return   Index of the first blocked segment, which runs from path[index] to path[index + 1]. -1 if the rest of the
+    *   path is safe.
+    */
+    int update(const ObstacleDistanceGrid& distances, const mbot_lcm_msgs::pose2D_t& robotPose);
+
+    bool hasPath(void) const { return !path_.path.empty(); }
+    const mbot_lcm_msgs::path2D_t& path(void) const { return path_; }
+
+    // Number of cells the path passes through
+    int numPathCells(void) const { return cells_.size(); }
+
+    // Number of cells ahead of the robot that became blocked or clear in the last update
+    int numChangedCells(void) const { return numChangedCells_; }
+
+private:
+
+    double clearance_;
+    mbot_lcm_msgs::path2D_t path_;
+    int currentSegment_;                // Segment the robot was closest to on the last update
+
+    // Geometry of the grid the path was traced in
+    int width_;
+    int height_;
+    float metersPerCell_;
+    Point<float> origin_;
+
+    // Cells along the path, stored as one array per value and sorted by segment
+    std::vector<Point<int>> cells_;
+    std::vector<int> cellSegment_;      // Segment that passes through each cell
+    std::vector<uint8_t> cellBlocked_;  // Closer than clearance to an obstacle in the last update
+    std::vector<int> segmentStart_;     // Index of the first cell of each segment
+
+    int numChangedCells_;
+
+    void traceCells(const ObstacleDistanceGrid& distances);
+    bool isSameGrid(const ObstacleDistanceGrid& distances) const;
+    int findCurrentSegment(const mbot_lcm_msgs::pose2D_t& robotPose) const;
+};
+
+/**
+* trace_segment_cells finds every cell a line segment passes through, in order from start to end.
+*
+* \param    start           Start of the segment, in grid coordinates (cells)
+* \param    end             End of the segment, in grid coordinates (cells)
+* \param    cells           Cells the segment passes through are appended here
+*/
+void trace_segment_cells(const Point<double>& start, const Point<double>& end, std::vector<Point<int>>& cells);
+
+#endif // PLANNING_PATH_SAFETY_MONITOR_HPP
@@ -2,5 +2,6 @@
 #define PLANNING_PLANNING_CHANNELS_H
 
 #define EXPLORATION_STATUS_CHANNEL "EXPLORATION_STATUS"
+#define PATH_INVALIDATION_CHANNEL "PATH_INVALIDATION"
 
 #endif // PLANNING_PLANNING_CHANNELS_H
\ No newline at end of file
@@ -0,0 +1,90 @@
+#ifndef SLAM_SCAN_SIMULATOR_HPP
+#define SLAM_SCAN_SIMULATOR_HPP
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <slam/occupancy_grid.hpp>
+#include <utils/geometric/pose_trace.hpp>
+#include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+
+/**
+* scan_simulator_params_t describes the simulated lidar.
+*/
+struct scan_simulator_params_t
+{
+    int   numBeams   = 720;     ///< Rays in each scan
+    float maxRange   = 12.0f;   ///< Rays that hit nothing closer than this have no return (meters)
+    float minRange   = 0.15f;   ///< Returns closer than this are dropped, as a real lidar does (meters)
+    float rangeNoise = 0.01f;   ///< Standard deviation of the Gaussian noise added to each range (meters)
+};
+
+/**
+* ScanSimulator makes lidar_t scans of a known world by casting rays through a saved OccupancyGrid. Any cell with
+* positive log-odds is a wall.
+*
+* Scans look like the ones from the rplidar driver: the rays are in the order they were measured, one after another
+* from the start of the scan to the end, and the lidar spins clockwise, so the angles decrease from 2*pi. The robot's
+* pose for each ray is interpolated between its poses at the start and end of the scan, so a scan from a moving robot
+* is distorted the way a real one is, which is what MovingLaserScan undoes.
+*
+* simulateScan doesn't change the simulator, so scans can be simulated on several threads at once, each with its own
+* random number generator.
+*/
+class ScanSimulator
+{
+public:
+
+    ScanSimulator(const OccupancyGrid& map, const scan_simulator_params_t& params);
+
+    /**
+    * simulateScan casts a scan measured from beginPose.utime until endPose.utime. Rays with no return have a range of 0.
+    *
+    * \param    beginPose   Pose of the robot at the start of the scan
+    * \param    endPose     Pose of the robot at the end of the scan
+    * \param    rng         Source of the range noise
+    * \param    scan        Filled with the scan. Its vectors are reused, so it doesn't allocate once it has held a scan
+    */
+    void simulateScan(const mbot_lcm_msgs::pose2D_t& beginPose,
+                      const mbot_lcm_msgs::pose2D_t& endPose,
+                      std::mt19937& rng,
+                      mbot_lcm_msgs::lidar_t& scan) const;
+
+    /**
+    * castRay finds the distance from (x, y) along the global angle theta to the first wall, or 0 if there is none within
+    * maxRange. No noise is added.
+    */
+    float castRay(float x, float y, float theta) const;
+
+private:
+
+    scan_simulator_params_t params_;
+    int width_;
+    int height_;
+    float cellsPerMeter_;
+    Point<float> origin_;
+    std::vector<uint8_t> walls_;        // 1 for each wall cell, in the grid's row-major order
+    std::vector<float> beamThetas_;     // Angle of each ray in the robot's frame
+};
+
+/**
+* make_waypoint_trace builds the trace of a robot that drives through the waypoints in order, starting at the first one
+* at time startUtime. At each waypoint, it turns in place to face the next one, then drives straight to it. Only the x
+* and y of the waypoints are used.
+*
+* The robot moves at a constant speed in each step, so interpolating between the poses in the trace gives its pose
+* at any time in between.
+*
+* \param    waypoints       Points to drive through. Pass the first one again at the end for a loop
+* \param    speed           Driving speed (m/s)
+* \param    turnRate        Turning speed (rad/s)
+* \param    startUtime      Time the robot starts at the first waypoint
+* \return   The trace of the robot's poses.
+*/
+PoseTrace make_waypoint_trace(const std::vector<mbot_lcm_msgs::pose2D_t>& waypoints,
+                              float speed,
+                              float turnRate,
+                              int64_t startUtime);
+
+#endif // SLAM_SCAN_SIMULATOR_HPP
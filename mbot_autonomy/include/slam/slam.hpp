@@ -6,6 +6,7 @@
 
 #include <lcm/lcm-cpp.hpp>
 #include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_t.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 
@@ -65,6 +66,7 @@ public:
 
     // Handlers for LCM messages
     void handleLaser(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::lidar_t* scan);
+    void handleCompactLaser(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::lidar_compact_t* scan);
     void handleOdometry(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::pose2D_t* odometry);
     void handlePose(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::pose2D_t* pose);
     void handleOptitrack(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::pose2D_t* pose);
@@ -89,12 +91,14 @@ private:
     bool waitingForOptitrack_;
     bool haveMap_;
     bool running_;
+    bool haveCompactScans_;     // Once compact scans arrive, full scans of the same revolutions are ignored.
     int  numIgnoredScans_;
     int iters_;
     std::string mapFile_;
 
     // Data from LCM
     std::deque<mbot_lcm_msgs::lidar_t> incomingScans_;
+    mbot_lcm_msgs::lidar_t expandedScan_;  // The last compact scan, expanded. Only used by the LCM thread.
     PoseTrace groundTruthPoses_;
     PoseTrace odometryPoses_;
 
@@ -118,6 +122,7 @@ private:
     std::mutex dataMutex_;
     std::mutex stopMutex_;
 
+    void addScan(const mbot_lcm_msgs::lidar_t& scan);
     bool isReadyToUpdate(void);
     void runSLAMIteration(void);
     void copyDataForSLAMUpdate(void);
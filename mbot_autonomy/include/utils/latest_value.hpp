@@ -0,0 +1,70 @@
+#ifndef UTILS_LATEST_VALUE_HPP
+#define UTILS_LATEST_VALUE_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/**
+* LatestValue is a lock-free slot that passes the most recent value from one writer thread to one reader thread. Values
+* written faster than they are read are overwritten, so the reader always gets the newest value and never waits on the
+* writer.
+*
+* The slot is a triple buffer. The writer and reader each own a buffer, and the third buffer holds the latest value
+* that has been written but not yet read. Writing or reading a value swaps the thread's buffer with the middle one,
+* so neither thread ever touches a buffer the other is using.
+*
+* Only one thread may call write and only one thread may call read.
+*/
+template <class T>
+class LatestValue
+{
+public:
+
+    LatestValue(void)
+    : writeIndex_(0)
+    , middle_(1)
+    , readIndex_(2)
+    {
+    }
+
+    /**
+    * write stores a new value in the slot, replacing any value that hasn't been read yet.
+    */
+    void write(const T& value)
+    {
+        buffers_[writeIndex_] = value;
+        uint8_t previous = middle_.exchange(writeIndex_ | kNewValueFlag, std::memory_order_acq_rel);
+        writeIndex_ = previous & kIndexMask;
+    }
+
+    /**
+    * read copies the newest value into value if one has been written since the last read.
+    *
+    * \param    value           Filled with the newest value if there is one. Otherwise, it isn't changed
+    * \return   True if a new value was read.
+    */
+    bool read(T& value)
+    {
+        if(!(middle_.load(std::memory_order_acquire) & kNewValueFlag))
+        {
+            return false;
+        }
+
+        uint8_t previous = middle_.exchange(readIndex_, std::memory_order_acq_rel);
+        readIndex_ = previous & kIndexMask;
+        value = buffers_[readIndex_];
+        return true;
+    }
+
+private:
+
+    static const uint8_t kIndexMask = 0x3;
+    static const uint8_t kNewValueFlag = 0x4;
+
+    T buffers_[3];
+    uint8_t writeIndex_;                // Only used by the writer
+    std::atomic<uint8_t> middle_;       // Index of the middle buffer, plus kNewValueFlag if it hasn't been read
+    uint8_t readIndex_;                 // Only used by the reader
+};
+
+#endif // UTILS_LATEST_VALUE_HPP
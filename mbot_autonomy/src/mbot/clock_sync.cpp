@@ -0,0 +1,69 @@
+#include <mbot/clock_sync.hpp>
+#include <mbot/mbot_channels.h>
+#include <utils/timestamp.h>
+#include <algorithm>
+
+
+ClockSync::ClockSync(lcm::LCM* lcmInstance, int64_t requestPeriodUs)
+: lcmInstance_(lcmInstance)
+, requestPeriodUs_(requestPeriodUs)
+, lastRequestUtime_(0)
+, offset_(0)
+, error_(0.0)
+, isSynced_(false)
+{
+    // The best round trip of each second is kept, and the drift is fit over the last minute
+    const int requestsPerSecond = std::max<int64_t>(1000000 / requestPeriodUs_, 1);
+    estimator_ = clock_estimator_create(requestsPerSecond, 60);
+    lcmInstance_->subscribe(MBOT_TIMESYNC_RESPONSE_CHANNEL, &ClockSync::handleResponse, this);
+}
+
+
+ClockSync::~ClockSync(void)
+{
+    clock_estimator_destroy(estimator_);
+}
+
+
+void ClockSync::sendRequestIfDue(void)
+{
+    int64_t utime = utime_now();
+    if(utime - lastRequestUtime_ < requestPeriodUs_)
+    {
+        return;
+    }
+
+    mbot_lcm_msgs::timesync_t request;
+    request.request_utime = utime;
+    request.receive_utime = 0;
+    request.transmit_utime = 0;
+    lastRequestUtime_ = utime;
+    lcmInstance_->publish(MBOT_TIMESYNC_REQUEST_CHANNEL, &request);
+}
+
+
+int64_t ClockSync::now(void) const
+{
+    return utime_now() + offset_;
+}
+
+
+void ClockSync::handleResponse(const lcm::ReceiveBuffer* buf, const std::string& channel,
+                               const mbot_lcm_msgs::timesync_t* response)
+{
+    // Every program sees every reply, so only the one to our latest request is used
+    if(response->request_utime != lastRequestUtime_)
+    {
+        return;
+    }
+
+    if(clock_estimator_add_sample(estimator_, response->request_utime, response->receive_utime,
+                                  response->transmit_utime, buf->recv_utime))
+    {
+        // The estimator converts from the MBot's clock to ours. Replies come often enough that the drift in between
+        // them is well under the error.
+        offset_ = clock_estimator_to_remote(estimator_, buf->recv_utime) - buf->recv_utime;
+        error_ = estimator_->error;
+        isSynced_ = true;
+    }
+}
@@ -0,0 +1,321 @@
+#include <utils/clock_estimator.h>
+#include <utils/geometric/angle_functions.hpp>
+#include <utils/geometric/pose_trace.hpp>
+#include <utils/getopt.h>
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mbot_lcm_msgs;
+
+/*
+* clock_sync_benchmark compares how well odometry lines up with lidar scans when the Pico stamps odometry with the
+* old single-sample offset and with the round-trip clock estimate.
+*
+* The serial link between the RPi and the Pico is simulated with random delays, and the Pico's clock runs fast by a
+* fixed drift. The RPi sends a timesync request every 10 ms, and the Pico runs its main loop at 25 Hz:
+*
+*   - single-sample: each request sets the Pico's offset to the RPi time in the request minus the Pico time it arrived,
+*       which is late by the delay of the request.
+*   - round-trip: the Pico replies to requests from its main loop, the RPi fits the offset and drift with a
+*       clock_estimator, and the Pico converts its time with the latest fit it was sent.
+*
+* The robot drives an arc and the odometry is stamped each main loop. Lidar scans are stamped with the RPi's clock, so
+* SLAM looks up the odometry at the true scan times with PoseTrace::poseAt. For each link, the benchmark reports the
+* timestamp error and the error of the looked-up poses, including where the end of a 3 m ray lands.
+*/
+
+const double kLoopPeriodUs = 40000.0;       // Pico main loop
+const double kRequestPeriodUs = 10000.0;    // timesync requests from the RPi
+const double kRayRange = 3.0;
+
+struct link_params_t
+{
+    std::string name;
+    double toPicoUs;            // Fixed delay from the RPi to the Pico
+    double toRPiUs;             // Fixed delay from the Pico to the RPi
+    double jitterUs;            // Uniform random delay added in both directions
+    double spikeProbability;    // Chance a message is stuck in a queue
+    double spikeUs;             // Longest time a message is stuck
+};
+
+struct sim_params_t
+{
+    double durationSec;
+    double settleSec;
+    double driftPpm;
+    double vel;
+    double angularVel;
+};
+
+struct stamp_result_t
+{
+    std::vector<double> stampErrorUs;
+    std::vector<double> headingError;
+    std::vector<double> positionError;
+    std::vector<double> rayError;
+};
+
+
+class SerialLink
+{
+public:
+
+    SerialLink(const link_params_t& params, unsigned seed)
+    : params_(params)
+    , rng_(seed)
+    , uniform_(0.0, 1.0)
+    {
+    }
+
+    double toPico(void) { return params_.toPicoUs + randomDelay(); }
+    double toRPi(void) { return params_.toRPiUs + randomDelay(); }
+
+private:
+
+    link_params_t params_;
+    std::mt19937 rng_;
+    std::uniform_real_distribution<double> uniform_;
+
+    double randomDelay(void)
+    {
+        double delay = params_.jitterUs * uniform_(rng_);
+        if(uniform_(rng_) < params_.spikeProbability)
+        {
+            delay += params_.spikeUs * uniform_(rng_);
+        }
+        return delay;
+    }
+};
+
+
+std::vector<link_params_t> benchmark_links(void);
+void run_link(const link_params_t& link, const sim_params_t& params, stamp_result_t& single, stamp_result_t& roundTrip);
+void print_result(const std::string& linkName, const std::string& methodName, const stamp_result_t& result);
+
+
+int main(int argc, char** argv)
+{
+    const char* durationArg = "duration";
+    const char* driftArg = "drift";
+    const char* velArg = "vel";
+    const char* angularVelArg = "angular-vel";
+
+    getopt_t* gopt = getopt_create();
+    getopt_add_bool(gopt, 'h', "help", 0, "Show this help message.");
+    getopt_add_double(gopt, '\0', durationArg, "120", "Simulated time for each link (s).");
+    getopt_add_double(gopt, '\0', driftArg, "30", "How much faster the Pico's clock runs than the RPi's (ppm).");
+    getopt_add_double(gopt, '\0', velArg, "0.3", "Forward speed of the robot (m/s).");
+    getopt_add_double(gopt, '\0', angularVelArg, "1.0", "Turn rate of the robot (rad/s).");
+
+    if(!getopt_parse(gopt, argc, argv, 1) || getopt_get_bool(gopt, "help"))
+    {
+        printf("Usage: %s [options]\n", argv[0]);
+        getopt_do_usage(gopt);
+        return 1;
+    }
+
+    sim_params_t params;
+    params.durationSec = getopt_get_double(gopt, durationArg);
+    params.settleSec = 10.0;
+    params.driftPpm = getopt_get_double(gopt, driftArg);
+    params.vel = getopt_get_double(gopt, velArg);
+    params.angularVel = getopt_get_double(gopt, angularVelArg);
+    getopt_destroy(gopt);
+
+    printf("%-12s %-14s %12s %12s %14s %14s %14s\n", "link", "method", "stamp(us)", "max(us)", "heading(mrad)",
+           "position(mm)", "3m ray(mm)");
+
+    for(auto& link : benchmark_links())
+    {
+        stamp_result_t single;
+        stamp_result_t roundTrip;
+        run_link(link, params, single, roundTrip);
+        print_result(link.name, "single-sample", single);
+        print_result(link.name, "round-trip", roundTrip);
+    }
+
+    return 0;
+}
+
+
+std::vector<link_params_t> benchmark_links(void)
+{
+    std::vector<link_params_t> links;
+    links.push_back({"idle", 300.0, 300.0, 400.0, 0.0, 0.0});
+    links.push_back({"busy", 500.0, 500.0, 1000.0, 0.1, 10000.0});
+    // Requests to the Pico wait for a USB poll, while replies go out right away
+    links.push_back({"asymmetric", 1500.0, 300.0, 500.0, 0.02, 5000.0});
+    return links;
+}
+
+
+pose2D_t true_pose(double timeUs, const sim_params_t& params)
+{
+    double t = timeUs * 1e-6;
+    double radius = params.vel / params.angularVel;
+    double theta = params.angularVel * t;
+
+    pose2D_t pose;
+    pose.utime = static_cast<int64_t>(timeUs);
+    pose.x = radius * std::sin(theta);
+    pose.y = radius * (1.0 - std::cos(theta));
+    pose.theta = wrap_to_pi(theta);
+    return pose;
+}
+
+
+void record_error(const pose2D_t& estimated, const pose2D_t& actual, stamp_result_t& result)
+{
+    double headingError = std::abs(angle_diff(estimated.theta, actual.theta));
+    double positionError = std::sqrt(std::pow(estimated.x - actual.x, 2) + std::pow(estimated.y - actual.y, 2));
+    double rayX = (estimated.x + kRayRange * std::cos(estimated.theta)) - (actual.x + kRayRange * std::cos(actual.theta));
+    double rayY = (estimated.y + kRayRange * std::sin(estimated.theta)) - (actual.y + kRayRange * std::sin(actual.theta));
+
+    result.headingError.push_back(headingError);
+    result.positionError.push_back(positionError);
+    result.rayError.push_back(std::sqrt(rayX * rayX + rayY * rayY));
+}
+
+
+void run_link(const link_params_t& link, const sim_params_t& params, stamp_result_t& single, stamp_result_t& roundTrip)
+{
+    SerialLink serial(link, 42);
+    clock_estimator_t* estimator = clock_estimator_create(10, 60);  // Same as lcm_serial_server
+
+    // The Pico's clock started when it booted, well after the Unix epoch, and runs fast
+    const double rpiStartUs = 1.7e15;
+    const double drift = params.driftPpm * 1e-6;
+    auto pico_time = [&](double rpiTime) { return (rpiTime - rpiStartUs) * (1.0 + drift); };
+
+    // State on the Pico
+    double singleOffset = 0.0;
+    bool haveRequest = false;
+    double requestUtime = 0.0;
+    double receiveUtime = 0.0;
+    std::vector<std::pair<double, clock_estimator_t>> pendingEstimates;     // Arrival time and estimate sent
+    clock_estimator_t picoEstimate = *estimator;
+
+    PoseTrace singleTrace;
+    PoseTrace roundTripTrace;
+
+    const double endUs = rpiStartUs + params.durationSec * 1e6;
+    double nextRequest = rpiStartUs;
+    double nextLoop = rpiStartUs + kLoopPeriodUs;
+    std::vector<std::pair<double, double>> requestsInFlight;   // Arrival time and RPi send time
+
+    while(nextLoop < endUs)
+    {
+        // Send every request due before the next loop. The RPi time in the request is when it was sent.
+        for(; nextRequest < nextLoop; nextRequest += kRequestPeriodUs)
+        {
+            requestsInFlight.push_back(std::make_pair(nextRequest + serial.toPico(), nextRequest));
+        }
+
+        // Requests that have arrived are handled on the Pico's other core as soon as they arrive
+        std::sort(requestsInFlight.begin(), requestsInFlight.end());
+        auto arrived = requestsInFlight.begin();
+        for(; arrived != requestsInFlight.end() && arrived->first <= nextLoop; ++arrived)
+        {
+            singleOffset = arrived->second - pico_time(arrived->first);
+            if(!haveRequest)
+            {
+                haveRequest = true;
+                requestUtime = arrived->second;
+                receiveUtime = pico_time(arrived->first);
+            }
+        }
+        requestsInFlight.erase(requestsInFlight.begin(), arrived);
+
+        for(auto estimateIt = pendingEstimates.begin(); estimateIt != pendingEstimates.end(); )
+        {
+            if(estimateIt->first <= nextLoop)
+            {
+                picoEstimate = estimateIt->second;
+                estimateIt = pendingEstimates.erase(estimateIt);
+            }
+            else
+            {
+                ++estimateIt;
+            }
+        }
+
+        // The main loop replies to the waiting request, then stamps the odometry
+        double loopPicoTime = pico_time(nextLoop);
+        if(haveRequest)
+        {
+            double responseUtime = nextLoop + serial.toRPi();
+            clock_estimator_add_sample(estimator, static_cast<int64_t>(requestUtime), static_cast<int64_t>(receiveUtime),
+                                       static_cast<int64_t>(loopPicoTime), static_cast<int64_t>(responseUtime));
+            if(estimator->samples_in_group == 0)
+            {
+                pendingEstimates.push_back(std::make_pair(responseUtime + serial.toPico(), *estimator));
+            }
+            haveRequest = false;
+        }
+
+        pose2D_t odometry = true_pose(nextLoop - rpiStartUs, params);
+        odometry.utime = static_cast<int64_t>(loopPicoTime + singleOffset);
+        singleTrace.addPose(odometry);
+
+        odometry.utime = picoEstimate.is_valid
+            ? clock_estimator_to_local(&picoEstimate, static_cast<int64_t>(loopPicoTime))
+            : static_cast<int64_t>(loopPicoTime + singleOffset);
+        roundTripTrace.addPose(odometry);
+
+        if(nextLoop - rpiStartUs > params.settleSec * 1e6)
+        {
+            single.stampErrorUs.push_back(std::abs(loopPicoTime + singleOffset - nextLoop));
+            roundTrip.stampErrorUs.push_back(std::abs(static_cast<double>(odometry.utime) - nextLoop));
+        }
+
+        nextLoop += kLoopPeriodUs;
+    }
+
+    // Scans are stamped with the RPi's clock, 10 per second, and the pose is looked up at the start and end of each
+    const double scanPeriodUs = 100000.0;
+    for(double scanTime = rpiStartUs + params.settleSec * 1e6; scanTime + scanPeriodUs < endUs - kLoopPeriodUs;
+        scanTime += scanPeriodUs)
+    {
+        for(double rayTime : {scanTime, scanTime + scanPeriodUs})
+        {
+            int64_t utime = static_cast<int64_t>(rayTime);
+            pose2D_t actual = true_pose(rayTime - rpiStartUs, params);
+            record_error(singleTrace.poseAt(utime), actual, single);
+            record_error(roundTripTrace.poseAt(utime), actual, roundTrip);
+        }
+    }
+
+    clock_estimator_destroy(estimator);
+}
+
+
+void summarize(std::vector<double> values, double& mean, double& max)
+{
+    mean = 0.0;
+    max = 0.0;
+    for(double value : values)
+    {
+        mean += value;
+        max = std::max(max, value);
+    }
+    mean /= std::max<std::size_t>(values.size(), 1);
+}
+
+
+void print_result(const std::string& linkName, const std::string& methodName, const stamp_result_t& result)
+{
+    double stampMean, stampMax, headingMean, headingMax, positionMean, positionMax, rayMean, rayMax;
+    summarize(result.stampErrorUs, stampMean, stampMax);
+    summarize(result.headingError, headingMean, headingMax);
+    summarize(result.positionError, positionMean, positionMax);
+    summarize(result.rayError, rayMean, rayMax);
+
+    printf("%-12s %-14s %12.0f %12.0f %14.3f %14.3f %14.3f\n", linkName.c_str(), methodName.c_str(), stampMean,
+           stampMax, headingMean * 1000.0, positionMean * 1000.0, rayMean * 1000.0);
+}
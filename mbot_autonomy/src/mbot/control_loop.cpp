@@ -0,0 +1,193 @@
+#include <mbot/control_loop.hpp>
+#include <mbot/mbot_channels.h>
+#include <utils/timestamp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+
+namespace
+{
+
+const int64_t kNsPerSec = 1000000000;
+
+int64_t monotonic_ns(void)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * kNsPerSec + now.tv_nsec;
+}
+
+timespec to_timespec(int64_t ns)
+{
+    timespec time;
+    time.tv_sec = ns / kNsPerSec;
+    time.tv_nsec = ns % kNsPerSec;
+    return time;
+}
+
+} // namespace
+
+
+ControlLoop::ControlLoop(lcm::LCM* lcmInstance, const ControlLoopParams& params)
+: lcmInstance_(lcmInstance)
+, params_(params)
+{
+    params_.rateHz = std::max(params_.rateHz, 1.0);
+    stats_.utime = 0;
+    stats_.rate_hz = params_.rateHz;
+    stats_.realtime = false;
+    resetStats();
+}
+
+
+bool ControlLoop::run(const std::function<void(void)>& cycle, const std::atomic<bool>& shouldStop)
+{
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if(timer < 0)
+    {
+        std::cerr << "ERROR: ControlLoop: Failed to create the control timer: " << strerror(errno) << '\n';
+        return false;
+    }
+
+    // Handle messages on their own thread, so a burst of messages never delays a control cycle
+    std::thread lcmThread([this, &shouldStop]() {
+        while(!shouldStop)
+        {
+            lcmInstance_->handleTimeout(100);
+        }
+    });
+
+    std::thread controlThread([this, timer, &cycle, &shouldStop]() {
+        stats_.realtime = setRealtimePriority();
+
+        const int64_t periodNs = std::llround(kNsPerSec / params_.rateHz);
+
+        // Cycles are due at fixed times measured from the first one. Using an absolute timer means a late cycle
+        // doesn't push back the ones after it.
+        int64_t firstCycleNs = monotonic_ns() + periodNs;
+        itimerspec timerSpec;
+        timerSpec.it_value = to_timespec(firstCycleNs);
+        timerSpec.it_interval = to_timespec(periodNs);
+        timerfd_settime(timer, TFD_TIMER_ABSTIME, &timerSpec, nullptr);
+
+        int64_t numPeriods = 0;
+        int64_t nextStatsUtime = utime_now() + params_.statsPeriodUs;
+
+        while(!shouldStop)
+        {
+            // Each read returns the number of periods that have passed since the last one. More than one means
+            // cycles were skipped.
+            uint64_t numExpirations = 0;
+            if(read(timer, &numExpirations, sizeof(numExpirations)) != sizeof(numExpirations))
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                std::cerr << "ERROR: ControlLoop: Failed to read the control timer: " << strerror(errno) << '\n';
+                break;
+            }
+
+            numPeriods += numExpirations;
+            int64_t dueNs = firstCycleNs + (numPeriods - 1) * periodNs;
+            int64_t startNs = monotonic_ns();
+
+            cycle();
+
+            int64_t endNs = monotonic_ns();
+            recordCycle((startNs - dueNs) / 1000,
+                        (endNs - startNs) / 1000,
+                        endNs > dueNs + periodNs,
+                        numExpirations - 1);
+
+            int64_t utime = utime_now();
+            if(utime >= nextStatsUtime)
+            {
+                publishStats(utime);
+                nextStatsUtime = utime + params_.statsPeriodUs;
+            }
+        }
+    });
+
+    controlThread.join();
+    lcmThread.join();
+    close(timer);
+    return true;
+}
+
+
+bool ControlLoop::setRealtimePriority(void)
+{
+    if(params_.realtimePriority <= 0)
+    {
+        return false;
+    }
+
+    // Lock all memory so the control thread never waits on a page fault
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        std::cerr << "WARNING: ControlLoop: Failed to lock memory: " << strerror(errno) << '\n';
+    }
+
+    sched_param param;
+    param.sched_priority = std::min(params_.realtimePriority, sched_get_priority_max(SCHED_FIFO));
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if(result != 0)
+    {
+        std::cerr << "WARNING: ControlLoop: Failed to set SCHED_FIFO priority " << param.sched_priority << ": "
+            << strerror(result) << ". Running with normal scheduling. Real-time priority needs root or CAP_SYS_NICE.\n";
+        return false;
+    }
+
+    return true;
+}
+
+
+void ControlLoop::recordCycle(int64_t jitterUs, int64_t computeUs, bool missedDeadline, int64_t numSkipped)
+{
+    ++stats_.num_cycles;
+    stats_.num_deadline_misses += missedDeadline ? 1 : 0;
+    stats_.num_skipped_cycles += numSkipped;
+
+    jitterSumUs_ += jitterUs;
+    computeSumUs_ += computeUs;
+    stats_.jitter_max_us = std::max(stats_.jitter_max_us, static_cast<float>(jitterUs));
+    stats_.compute_max_us = std::max(stats_.compute_max_us, static_cast<float>(computeUs));
+}
+
+
+void ControlLoop::publishStats(int64_t utime)
+{
+    if(stats_.num_cycles > 0)
+    {
+        stats_.utime = utime;
+        stats_.jitter_mean_us = jitterSumUs_ / stats_.num_cycles;
+        stats_.compute_mean_us = computeSumUs_ / stats_.num_cycles;
+        lcmInstance_->publish(CONTROL_LOOP_STATS_CHANNEL, &stats_);
+    }
+
+    resetStats();
+}
+
+
+void ControlLoop::resetStats(void)
+{
+    stats_.num_cycles = 0;
+    stats_.num_deadline_misses = 0;
+    stats_.num_skipped_cycles = 0;
+    stats_.jitter_mean_us = 0.0f;
+    stats_.jitter_max_us = 0.0f;
+    stats_.compute_mean_us = 0.0f;
+    stats_.compute_max_us = 0.0f;
+    jitterSumUs_ = 0.0;
+    computeSumUs_ = 0.0;
+}
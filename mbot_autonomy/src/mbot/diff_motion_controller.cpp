@@ -1,191 +1,38 @@
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <cassert>
 #include <signal.h>
 
 #include <lcm/lcm-cpp.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <mbot_lcm_msgs/path2D_t.hpp>
-#include <mbot_lcm_msgs/timestamp_t.hpp>
 #include <mbot_lcm_msgs/mbot_message_received_t.hpp>
 #include <mbot_lcm_msgs/mbot_slam_reset_t.hpp>
+#include <mbot_lcm_msgs/occupancy_grid_t.hpp>
 #include <utils/timestamp.h>
 #include <utils/geometric/angle_functions.hpp>
 #include <utils/geometric/pose_trace.hpp>
 #include <utils/lcm_config.h>
+#include <utils/getopt.h>
+#include <utils/latest_value.hpp>
+#include <mbot/clock_sync.hpp>
+#include <mbot/control_loop.hpp>
+#include <mbot/distance_grid_worker.hpp>
+#include <mbot/trajectory_tracker.hpp>
+#include <planning/local_planner.hpp>
+#include <planning/obstacle_distance_grid.hpp>
+#include <slam/occupancy_grid.hpp>
 #include <mbot/mbot_channels.h>
 #include <slam/slam_channels.h>
 
-#include "diff_maneuver_controller.h"
-
-/////////////////////// TODO: /////////////////////////////
-/**
- * Code below is a little more than a template. You will need
- * to update the maneuver controllers to function more effectively
- * and/or add different controllers. 
- * You will at least want to:
- *  - Add a form of PID to control the speed at which your
- *      robot reaches its target pose.
- *  - Add a rotation element to the StratingManeuverController
- *      to maintian a avoid deviating from the intended path.
- *  - Limit (min max) the speeds that your robot is commanded
- *      to avoid commands to slow for your bots or ones too high
- */
-///////////////////////////////////////////////////////////
-
-class StraightManeuverController : public ManeuverControllerBase
-{
-
-private:
-    float fwd_pid[3] = {1.0, 0, 0};
-    float fwd_sum_error = 0;
-    float fwd_last_error = 0;
-    float turn_pid[3] = {3.0, 0, 0};
-    float turn_sum_error = 0;
-    float turn_last_error = 0;
-public:
-    StraightManeuverController() = default;   
-    virtual mbot_lcm_msgs::twist2D_t get_command(const mbot_lcm_msgs::pose2D_t& pose, const mbot_lcm_msgs::pose2D_t& target) override
-    {
-        float dx = target.x - pose.x;
-        float dy = target.y - pose.y;
-        float d_fwd = sqrt(pow(dx,2) + pow(dy,2));
-        float d_theta = angle_diff(atan2(dy,dx), pose.theta);
-
-        // PID separately for the fwd and the angular velocity output given the fwd and angular error
-        fwd_sum_error += d_fwd;
-        float fwd_der = 0;
-        if (fwd_last_error > 0)
-            fwd_der = (d_fwd - fwd_last_error) / 0.05;
-        
-        float fwd_vel = fwd_pid[0] * d_fwd + fwd_pid[1] * fwd_sum_error + fwd_pid[2] * fwd_der;
-        // fprintf(stdout,"Fwd error: %f\tFwd vel: %f\n", d_fwd, fwd_vel);
-
-        turn_sum_error += d_theta;
-        float turn_der = 0;
-        if (turn_last_error > 0)
-            turn_der = angle_diff(d_theta, turn_last_error) / 0.05;
-        
-        float turn_vel = turn_pid[0] * d_theta + turn_pid[1] * turn_sum_error + turn_pid[2] * turn_der;
-        // fprintf(stdout,"Turn error: %f\tTurn vel: %f\n", d_theta, turn_vel);
+#include "diff_waypoint_controller.h"
 
-        return {0, fwd_vel, 0, turn_vel};
-    }
-
-    virtual bool target_reached(const mbot_lcm_msgs::pose2D_t& pose, const mbot_lcm_msgs::pose2D_t& target, bool is_end_pose)  override
-    {
-        return ((fabs(pose.x - target.x) < 0.02) && (fabs(pose.y - target.y)  < 0.02));
-    }
-};
-
-class TurnManeuverController : public ManeuverControllerBase
+enum ControlMode
 {
-private:
-    float turn_pid[3] = {3.0, 0, 0};
-    float turn_sum_error = 0;
-    float turn_last_error = 0;
-public:
-    TurnManeuverController() = default;   
-    virtual mbot_lcm_msgs::twist2D_t get_command(const mbot_lcm_msgs::pose2D_t& pose, const mbot_lcm_msgs::pose2D_t& target) override
-    {
-        float dx = target.x - pose.x;
-        float dy = target.y - pose.y;
-        float d_theta = angle_diff(atan2(dy,dx), pose.theta);
-        // fprintf(stdout,"dx: %f\tdy: %f\td_theta: %f\n", dx, dy, d_theta);
-
-        // PID for the angular velocity given the delta theta
-        turn_sum_error += d_theta;
-        float turn_der = 0.0;
-        if (turn_last_error > 0)
-            turn_der = (d_theta - turn_last_error) / 0.05;
-        
-        float turn_vel = turn_pid[0] * d_theta + turn_pid[1] * turn_sum_error + turn_pid[2] * turn_der;
-        // fprintf(stdout,"Turn error: %f\tTurn vel: %f\tPose theta: %f\n", d_theta, turn_vel, pose.theta);
-
-        return {0, 0, 0, turn_vel};
-    }
-    mbot_lcm_msgs::twist2D_t get_command_final_turn(const mbot_lcm_msgs::pose2D_t& pose, const mbot_lcm_msgs::pose2D_t& target)
-    {
-        float d_theta = angle_diff(target.theta, pose.theta);
-        // fprintf(stdout,"dx: %f\tdy: %f\td_theta: %f\n", dx, dy, d_theta);
-
-        // PID for the angular velocity given the delta theta
-        turn_sum_error += d_theta;
-        float turn_der = 0;
-        if (turn_last_error > 0)
-            turn_der = (d_theta - turn_last_error) / 0.05;
-        
-        float turn_vel = turn_pid[0] * d_theta + turn_pid[1] * turn_sum_error + turn_pid[2] * turn_der;
-        // fprintf(stdout,"Turn error: %f\tTurn vel: %f\tPose theta: %f\n", d_theta, turn_vel, pose.theta);
-
-        return {0, 0, 0, turn_vel};
-    }
-
-    virtual bool target_reached(const mbot_lcm_msgs::pose2D_t& pose, const mbot_lcm_msgs::pose2D_t& target, bool is_end_pose)  override
-    {
-        float dx = target.x - pose.x;
-        float dy = target.y - pose.y;
-        float target_heading = atan2(dy, dx);
-        // Handle the case when the target is on the same x,y but on a different theta
-        return (fabs(angle_diff(pose.theta, target_heading)) < 0.05);
-    }
-    bool target_reached_final_turn(const mbot_lcm_msgs::pose2D_t& pose, const mbot_lcm_msgs::pose2D_t& target)
-    {
-        float dx = target.x - pose.x;
-        float dy = target.y - pose.y;
-        float target_heading = atan2(dy, dx);
-        // Handle the case when the target is on the same x,y but on a different theta
-        return (fabs(angle_diff(target.theta, pose.theta)) < 0.05);
-    }
-};
-
-class SmartManeuverController : public ManeuverControllerBase
-{
-
-private:
-    float pid[3] = {1.0, 2.5, 0.0}; //kp, ka, kb
-    float d_end_crit = 0.02;
-    float d_end_midsteps = 0.08;
-    float angle_end_crit = 0.2;
-public:
-    SmartManeuverController() = default;   
-    virtual mbot_lcm_msgs::twist2D_t get_command(const mbot_lcm_msgs::pose2D_t& pose, const mbot_lcm_msgs::pose2D_t& target) override
-    {
-        float vel_sign = 1;
-        float dx = target.x - pose.x;
-        float dy = target.y - pose.y;
-        float d_fwd = sqrt(dx * dx + dy * dy);
-        float alpha = angle_diff(atan2(dy,dx), pose.theta);
-        // printf("alpha: %f\n", alpha);
-
-        // // To avoid weird behaviour at alpha=pi/2, because it is a common case
-        // float margin = 2 * M_PI / 180;
-        // if (fabs(alpha) > M_PI_2 + margin)
-        // {
-        //     alpha = wrap_to_pi(alpha - M_PI);
-        //     vel_sign = -1;
-        // }
-        float beta = wrap_to_pi(target.theta -(alpha + pose.theta));
-        float fwd_vel = vel_sign *  pid[0] * d_fwd;
-        float turn_vel = pid[1] * alpha + pid[2] * beta;
-
-        // If alpha is more than 45 degrees, turn in place and then go
-        if (fabs(alpha) > M_PI_4)
-        {
-            fwd_vel = 0;
-        }
-
-        // printf("%f,%f\n", fwd_vel, turn_vel);
-        return {0, fwd_vel, 0, turn_vel};
-    }
-
-    virtual bool target_reached(const mbot_lcm_msgs::pose2D_t& pose, const mbot_lcm_msgs::pose2D_t& target, bool is_end_pose)  override
-    {
-        float distance = d_end_midsteps;
-        if (is_end_pose)
-            distance = d_end_crit;
-        return ((fabs(pose.x - target.x) < distance) && (fabs(pose.y - target.y)  < distance));
-    }
+    WAYPOINT,
+    TRAJECTORY
 };
 
 class MotionController
@@ -194,16 +41,29 @@ public:
     
     /**
     * Constructor for MotionController.
+    *
+    * The LCM handlers run on the LCM thread and only pass the latest data on to the control thread. Everything else
+    * runs on the control thread, starting with readInputs.
+    *
+    * \param    instance        LCM instance to subscribe and publish on
+    * \param    mode            WAYPOINT stops at each pose in a path. TRAJECTORY tracks a time-parameterized path
+    * \param    useLocalPlanner Check each command against the SLAM map and steer around new obstacles
     */
-    MotionController(lcm::LCM * instance)
+    MotionController(lcm::LCM * instance, ControlMode mode, bool useLocalPlanner)
     :
-        lcmInstance(instance),
-        odomToGlobalFrame_{0, 0, 0, 0}
+        clockSync_(instance),
+        odomToGlobalFrame_{0, 0, 0, 0},
+        mode_(mode),
+        useLocalPlanner_(useLocalPlanner),
+        lcmInstance(instance)
     {
+        if(useLocalPlanner_)
+        {
+            distanceWorker_ = std::make_unique<DistanceGridWorker>();
+        }
         subscribeToLcm();
 
-	    time_offset = 0;
-	    timesync_initialized_ = false;
+        havePose_ = false;
 
         // Default velocity limits
         vel_limits_.vx = 0.1;
@@ -212,12 +72,74 @@ public:
         // vel_limits_.vx = 0.8;
         // vel_limits_.vy = 0;
         // vel_limits_.wz = M_PI;
+
+        // The trajectory already respects the acceleration limits, so it can use the robot's full speed
+        if(mode_ == TRAJECTORY)
+        {
+            vel_limits_.vx = trajectory_tracker_.limits().maxVel;
+            vel_limits_.wz = trajectory_tracker_.limits().maxAngularVel;
+        }
+        setLocalPlannerLimits();
     }
     
     /**
-    * \brief updateCommand calculates the new motor command to send to the Mbot. This method is called after each call to
-    * lcm.handle. You need to check if you have sufficient data to calculate a new command, or if the previous command
-    * should just be used again until for feedback becomes available.
+    * \brief readInputs copies the newest path, pose, and velocity limits received by the LCM thread. It is called at
+    * the start of every control cycle.
+    */
+    void readInputs(void)
+    {
+        clockSync_.sendRequestIfDue();
+
+        if(newVelLimits_.read(vel_limits_))
+        {
+            TrajectoryLimits limits = trajectory_tracker_.limits();
+            limits.maxVel = vel_limits_.vx;
+            limits.maxAngularVel = vel_limits_.wz;
+            trajectory_tracker_.setLimits(limits);
+            setLocalPlannerLimits();
+        }
+
+        if(distanceWorker_)
+        {
+            distanceWorker_->read(distances_);
+        }
+
+        mbot_lcm_msgs::path2D_t path;
+        if(newPath_.read(path))
+        {
+            path_ = path.path;
+            local_planner_.reset();
+
+            if(mode_ == TRAJECTORY)
+            {
+                Trajectory trajectory(path.path, trajectory_tracker_.limits());
+                trajectory_tracker_.setTrajectory(trajectory, path.path.empty() ? 0.0 : path.path.back().theta);
+                printf("Trajectory: %d points, %.2fs\n", static_cast<int>(trajectory.size()), trajectory.duration());
+            }
+            else
+            {
+                waypoint_controller_.setPath(path.path);
+            }
+        }
+
+        if(latestPose_.read(pose_))
+        {
+            havePose_ = true;
+        }
+    }
+
+    /**
+    * hasPath checks if the robot is still following a path.
+    */
+    bool hasPath(void) const
+    {
+        return (mode_ == TRAJECTORY) ? !trajectory_tracker_.isDone() : !waypoint_controller_.getTargets().empty();
+    }
+
+    /**
+    * \brief updateCommand calculates the new motor command to send to the Mbot. This method is called once per control
+    * cycle, after readInputs. You need to check if you have sufficient data to calculate a new command, or if the
+    * previous command should just be used again until for feedback becomes available.
     * 
     * \return   The motor command to send to the mbot_driver.
     */
@@ -225,97 +147,44 @@ public:
     {
         mbot_lcm_msgs::twist2D_t cmd {now(), 0.0, 0.0, 0.0};
         
-        if(!targets_.empty() && !odomTrace_.empty()) 
+        if(hasPath() && havePose_)
         {
-            mbot_lcm_msgs::pose2D_t target = targets_.back();
-            bool is_last_target = targets_.size() == 1;
-            mbot_lcm_msgs::pose2D_t pose = currentPose();
-
-            if (state_ == SMART) 
+            if(mode_ == TRAJECTORY)
             {
-                if (smart_controller.target_reached(pose, target, is_last_target))
+                cmd = trajectory_tracker_.getCommand(pose_, utime_now());
+                if(trajectory_tracker_.isDone())
                 {
-                    if (is_last_target)
-                        state_ = FINAL_TURN;
-                    else if(!assignNextTarget())
-                        printf("Target reached! (%f,%f,%f)\n", target.x, target.y, target.theta);
+                    printf("Target reached! (%f,%f,%f)\n", pose_.x, pose_.y, pose_.theta);
                 }
-                else cmd = smart_controller.get_command(pose, target);
             }
-
-            ///////  TODO: Add different states when adding maneuver controls /////// 
-            if(state_ == INITIAL_TURN)
-            { 
-                if(turn_controller.target_reached(pose, target, is_last_target))
-                {
-		            state_ = DRIVE;
-                } 
-                else
-                {
-                    cmd = turn_controller.get_command(pose, target);
-                }
+            else
+            {
+                cmd = waypoint_controller_.updateCommand(pose_);
             }
-            else if(state_ == DRIVE) 
+
+            // Steer around anything in the way that wasn't there when the path was planned
+            if(useLocalPlanner_ && distances_)
             {
-                if(straight_controller.target_reached(pose, target, is_last_target))
-                {
-                    state_ = FINAL_TURN;
-                    // if(!assignNextTarget())
-                    // {
-                    //     // std::cout << "\rTarget Reached!\n";
-                    //     printf("Target reached! (%f,%f,%f)\n", target.x, target.y, target.theta);
-                    // }
-                }
-                else
-                { 
-                    cmd = straight_controller.get_command(pose, target);
-                }
-		    }
-            else if(state_ == FINAL_TURN)
-            { 
-                if(turn_controller.target_reached_final_turn(pose, target))
-                {
-		            if(!assignNextTarget())
-                    {
-                        // std::cout << "\rTarget Reached!\n";
-                        printf("Target reached! (%f,%f,%f)\n", target.x, target.y, target.theta);
-                    }
-                } 
-                else
-                {
-                    cmd = turn_controller.get_command_final_turn(pose, target);
-                }
+                cmd = local_planner_.computeCommand(pose_, cmd, path_, *distances_);
             }
-            // else
-            // {
-            //     std::cerr << "ERROR: MotionController: Entered unknown state: " << state_ << '\n';
-            // }
-		} 
+        }
         return cmd; 
     }
 
-    bool timesync_initialized(){ return timesync_initialized_; }
-
-    void handleTimesync(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::timestamp_t* timesync)
-    {
-	    timesync_initialized_ = true;
-	    time_offset = timesync->utime-utime_now();
-    }
+    bool timesync_initialized(){ return clockSync_.isSynced(); }
     
     void handlePath(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::path2D_t* path)
     {
-        targets_ = path->path;
-        std::reverse(targets_.begin(), targets_.end()); // store first at back to allow for easy pop_back()
+        newPath_.write(*path);
 
     	std::cout << "received new path at time: " << path->utime << "\n"; 
-    	for(auto pose : targets_)
+    	for(auto pose : path->path)
         {
     		std::cout << "(" << pose.x << "," << pose.y << "," << pose.theta << "); ";
     	}
         std::cout << std::endl;
 
         // assignNextTarget(); // This eats the first waypoint
-        state_ = SMART;
 
         //confirm that the path was received
         mbot_lcm_msgs::mbot_message_received_t confirm {now(), path->utime, channel};
@@ -326,26 +195,32 @@ public:
     {
         mbot_lcm_msgs::pose2D_t pose {odometry->utime, odometry->x, odometry->y, odometry->theta};
         odomTrace_.addPose(pose);
+        latestPose_.write(currentPose());
     }
     
     void handlePose(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::pose2D_t* pose)
     {
         computeOdometryOffset(*pose);
+        if(!odomTrace_.empty())
+        {
+            latestPose_.write(currentPose());
+        }
     }
 
     void handleMaxVelocity(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::twist2D_t* new_limits)
     {
-        vel_limits_.vx = new_limits->vx;
-        vel_limits_.vy = new_limits->vy;
-        vel_limits_.wz = new_limits->wz;
+        newVelLimits_.write(*new_limits);
     }
-    
-    // getter method to access targets_
-    const std::vector<mbot_lcm_msgs::pose2D_t>& getTargets() const
+
+    void handleMap(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::occupancy_grid_t* map)
     {
-        return targets_;
+        // Only the raw map is passed on here. The distances are computed by the worker, so the messages queued
+        // behind this one aren't held up
+        std::shared_ptr<OccupancyGrid> grid = std::make_shared<OccupancyGrid>();
+        grid->fromLCM(*map);
+        distanceWorker_->setMap(grid);
     }
-
+    
     const mbot_lcm_msgs::twist2D_t& getVelLimits() const
     {
         return vel_limits_;
@@ -353,42 +228,47 @@ public:
 
 private:
     
-    enum State
-    {
-        INITIAL_TURN,
-        DRIVE,
-        FINAL_TURN, // to get to the pose heading
-        SMART
-    };
-    
+    ClockSync clockSync_;               // time on the MBot's clock, for stamping messages
+
+    // Used by the LCM thread
     mbot_lcm_msgs::pose2D_t odomToGlobalFrame_;      // transform to convert odometry into the global/map coordinates for navigating in a map
     PoseTrace  odomTrace_;              // trace of odometry for maintaining the offset estimate
-    std::vector<mbot_lcm_msgs::pose2D_t> targets_;
-    mbot_lcm_msgs::twist2D_t vel_limits_;
 
-    State state_;
+    // Passed from the LCM thread to the control thread
+    LatestValue<mbot_lcm_msgs::path2D_t> newPath_;
+    LatestValue<mbot_lcm_msgs::pose2D_t> latestPose_;   // odometry transformed into the global frame
+    LatestValue<mbot_lcm_msgs::twist2D_t> newVelLimits_;
+    std::unique_ptr<DistanceGridWorker> distanceWorker_;    // Computes the distances for each new map
+
+    // Used by the control thread
+    ControlMode mode_;
+    DiffWaypointController waypoint_controller_;
+    TrajectoryTracker trajectory_tracker_;
+    bool useLocalPlanner_;
+    DynamicWindowPlanner local_planner_;
+    std::shared_ptr<const ObstacleDistanceGrid> distances_;
+    std::vector<mbot_lcm_msgs::pose2D_t> path_;
+    mbot_lcm_msgs::twist2D_t vel_limits_;
+    mbot_lcm_msgs::pose2D_t pose_;
+    bool havePose_;
 
-    int64_t time_offset;
-    bool timesync_initialized_;
 
     lcm::LCM * lcmInstance;
- 
-    TurnManeuverController turn_controller;
-    StraightManeuverController straight_controller;
-    SmartManeuverController smart_controller;
 
     int64_t now()
     {
-	    return utime_now() + time_offset;
+	    return clockSync_.now();
     }
     
-    bool assignNextTarget(void)
+    void setLocalPlannerLimits(void)
     {
-        if(!targets_.empty()) { targets_.pop_back(); }
-        state_ = SMART; 
-        return !targets_.empty();
+        LocalPlannerParams params = local_planner_.params();
+        params.maxVel = vel_limits_.vx;
+        params.maxLateralVel = 0.0;
+        params.maxAngularVel = vel_limits_.wz;
+        local_planner_ = DynamicWindowPlanner(params);
     }
-    
+
     void computeOdometryOffset(const mbot_lcm_msgs::pose2D_t& globalPose)
     {
         mbot_lcm_msgs::pose2D_t odomAtTime = odomTrace_.poseAt(globalPose.utime);
@@ -421,12 +301,15 @@ private:
         lcmInstance->subscribe(ODOMETRY_CHANNEL, &MotionController::handleOdometry, this);
         lcmInstance->subscribe(SLAM_POSE_CHANNEL, &MotionController::handlePose, this);
         lcmInstance->subscribe(CONTROLLER_PATH_CHANNEL, &MotionController::handlePath, this);
-        lcmInstance->subscribe(MBOT_TIMESYNC_CHANNEL, &MotionController::handleTimesync, this);
         lcmInstance->subscribe(MBOT_MAX_VEL_CHANNEL, &MotionController::handleMaxVelocity, this);
+        if(useLocalPlanner_)
+        {
+            lcmInstance->subscribe(SLAM_MAP_CHANNEL, &MotionController::handleMap, this);
+        }
     }
 };
 
-bool ctrl_c_pressed;
+std::atomic<bool> ctrl_c_pressed(false);
 void ctrlc(int)
 {
     ctrl_c_pressed = true;
@@ -434,18 +317,47 @@ void ctrlc(int)
 
 int main(int argc, char** argv)
 {
+    const char* rateArg = "rate";
+    const char* rtPriorityArg = "rt-priority";
+    const char* trajectoryArg = "trajectory";
+    const char* localPlannerArg = "local-planner";
+
+    getopt_t *gopt = getopt_create();
+    getopt_add_bool(gopt, 'h', "help", 0, "Show this help message.");
+    getopt_add_double(gopt, '\0', rateArg, "50", "Rate, in Hz, at which motor commands are computed and published.");
+    getopt_add_int(gopt, '\0', rtPriorityArg, "0", "SCHED_FIFO priority (1-99) of the control thread. 0 uses normal"
+                    " scheduling. Needs root or CAP_SYS_NICE.");
+    getopt_add_bool(gopt, '\0', trajectoryArg, 0, "Track each path as a time-parameterized trajectory instead of"
+                    " stopping at every waypoint.");
+    getopt_add_bool(gopt, '\0', localPlannerArg, 0, "Check commands against the SLAM map and steer around obstacles"
+                    " that weren't there when the path was planned.");
+
+    if(!getopt_parse(gopt, argc, argv, 1) || getopt_get_bool(gopt, "help"))
+    {
+        printf("Usage: %s [options]\n", argv[0]);
+        getopt_do_usage(gopt);
+        return 1;
+    }
+
+    ControlLoopParams loopParams;
+    loopParams.rateHz = getopt_get_double(gopt, rateArg);
+    loopParams.realtimePriority = getopt_get_int(gopt, rtPriorityArg);
+    ControlMode mode = getopt_get_bool(gopt, trajectoryArg) ? TRAJECTORY : WAYPOINT;
+    bool useLocalPlanner = getopt_get_bool(gopt, localPlannerArg);
+    getopt_destroy(gopt);
+
     lcm::LCM lcmInstance(MULTICAST_URL);
-    MotionController controller(&lcmInstance);
+    MotionController controller(&lcmInstance, mode, useLocalPlanner);
 
-    ctrl_c_pressed = false;
     signal(SIGINT, ctrlc);
     signal(SIGTERM, ctrlc);
-    
-    while(true)
-    {
-        lcmInstance.handleTimeout(50);  // update at 20Hz minimum
 
-    	if(controller.timesync_initialized() && !controller.getTargets().empty()){
+    // Commands go out at a fixed rate, no matter when messages arrive
+    ControlLoop loop(&lcmInstance, loopParams);
+    loop.run([&lcmInstance, &controller]() {
+        controller.readInputs();
+
+    	if(controller.timesync_initialized() && controller.hasPath()){
             mbot_lcm_msgs::twist2D_t cmd = controller.updateCommand();
             // Limit command values
             // Fwd vel
@@ -460,9 +372,7 @@ int main(int argc, char** argv)
             
             lcmInstance.publish(MBOT_MOTOR_COMMAND_CHANNEL, &cmd);
     	}
-        
-        if (ctrl_c_pressed) break;
-    }
+    }, ctrl_c_pressed);
 
     // Stop the robot when motion controller quits.
     mbot_lcm_msgs::twist2D_t zero;
@@ -473,4 +383,4 @@ int main(int argc, char** argv)
     std::cout << "Robot stopped successfully. Exiting..." << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
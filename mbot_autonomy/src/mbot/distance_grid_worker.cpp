@@ -0,0 +1,65 @@
+#include <mbot/distance_grid_worker.hpp>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+
+namespace
+{
+
+const useconds_t kIdleSleepUs = 10000;      // how long the worker waits before checking for a new map again
+const int kWorkerNice = 10;                 // nice value of the worker, so it yields to the LCM and control threads
+
+} // namespace
+
+
+DistanceGridWorker::DistanceGridWorker(void)
+: isRunning_(true)
+, thread_(&DistanceGridWorker::run, this)
+{
+}
+
+
+DistanceGridWorker::~DistanceGridWorker(void)
+{
+    isRunning_ = false;
+    thread_.join();
+}
+
+
+void DistanceGridWorker::setMap(const std::shared_ptr<const OccupancyGrid>& map)
+{
+    incomingMap_.write(map);
+}
+
+
+bool DistanceGridWorker::read(std::shared_ptr<const ObstacleDistanceGrid>& distances)
+{
+    return newDistances_.read(distances);
+}
+
+
+void DistanceGridWorker::run(void)
+{
+    // On Linux, the nice value belongs to each thread, so this only lowers the priority of the worker
+    if(setpriority(PRIO_PROCESS, 0, kWorkerNice) != 0)
+    {
+        std::cerr << "WARNING: DistanceGridWorker: Failed to lower the worker priority: " << strerror(errno) << '\n';
+    }
+
+    std::shared_ptr<const OccupancyGrid> map;
+    while(isRunning_)
+    {
+        if(!incomingMap_.read(map))
+        {
+            usleep(kIdleSleepUs);
+            continue;
+        }
+
+        std::shared_ptr<ObstacleDistanceGrid> distances = std::make_shared<ObstacleDistanceGrid>();
+        distances->setDistances(*map);
+        newDistances_.write(distances);
+    }
+}
@@ -1,5 +1,7 @@
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <cassert>
 #include <signal.h>
 
@@ -7,14 +9,22 @@
 #include <mbot_lcm_msgs/twist2D_t.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <mbot_lcm_msgs/path2D_t.hpp>
-#include <mbot_lcm_msgs/timestamp_t.hpp>
 #include <mbot_lcm_msgs/mbot_message_received_t.hpp>
 #include <mbot_lcm_msgs/mbot_slam_reset_t.hpp>
+#include <mbot_lcm_msgs/occupancy_grid_t.hpp>
 
 #include <utils/timestamp.h>
 #include <utils/geometric/angle_functions.hpp>
 #include <utils/geometric/pose_trace.hpp>
 #include <utils/lcm_config.h>
+#include <utils/getopt.h>
+#include <utils/latest_value.hpp>
+#include <mbot/clock_sync.hpp>
+#include <mbot/control_loop.hpp>
+#include <mbot/distance_grid_worker.hpp>
+#include <planning/local_planner.hpp>
+#include <planning/obstacle_distance_grid.hpp>
+#include <slam/occupancy_grid.hpp>
 #include <mbot/mbot_channels.h>
 #include <slam/slam_channels.h>
 
@@ -35,7 +45,7 @@
  */
 ///////////////////////////////////////////////////////////
 
-bool ctrl_c_pressed;
+std::atomic<bool> ctrl_c_pressed(false);
 void ctrlc(int)
 {
     ctrl_c_pressed = true;
@@ -174,6 +184,8 @@ class OmniXYManeuverController : public OmniManeuverControllerBase
             return distBetweenPoses(pose, target) < target_reached_thresh_;
         }
 
+        float maxVel() const { return max_vel_; }
+
         void reset()
         {
             xy_sum_error_ = 0.0;
@@ -189,34 +201,78 @@ public:
 
     /**
     * Constructor for MotionController.
+    *
+    * The LCM handlers run on the LCM thread and only pass the latest data on to the control thread. Everything else
+    * runs on the control thread, starting with readInputs.
+    *
+    * \param    instance        LCM instance to subscribe and publish on
+    * \param    useLocalPlanner Check each command against the SLAM map and steer around new obstacles
     */
-    MotionController(lcm::LCM * instance)
+    MotionController(lcm::LCM * instance, bool useLocalPlanner)
     :
-        lcmInstance(instance),
-        odomToGlobalFrame_{0, 0, 0, 0}
+        clockSync_(instance),
+        odomToGlobalFrame_{0, 0, 0, 0},
+        useLocalPlanner_(useLocalPlanner),
+        lcmInstance(instance)
     {
+        if(useLocalPlanner_)
+        {
+            distanceWorker_ = std::make_unique<DistanceGridWorker>();
+        }
         subscribeToLcm();
 
-	    time_offset = 0;
-	    timesync_initialized_ = false;
         path_idx_ = -1;
+        havePose_ = false;
+
+        LocalPlannerParams plannerParams;
+        plannerParams.maxVel = omni_xy_controller.maxVel();
+        plannerParams.maxLateralVel = omni_xy_controller.maxVel();
+        local_planner_ = DynamicWindowPlanner(plannerParams);
+    }
+
+    /**
+    * \brief readInputs copies the newest path and pose received by the LCM thread. It is called at the start of every
+    * control cycle.
+    */
+    void readInputs(void)
+    {
+        clockSync_.sendRequestIfDue();
+
+        mbot_lcm_msgs::path2D_t path;
+        if(newPath_.read(path))
+        {
+            targets_ = path.path;
+            path_idx_ = targets_.empty() ? -1 : 0;
+            omni_xy_controller.reset();
+            local_planner_.reset();
+        }
+
+        if(latestPose_.read(pose_))
+        {
+            havePose_ = true;
+        }
+
+        if(distanceWorker_)
+        {
+            distanceWorker_->read(distances_);
+        }
     }
 
     /**
-    * \brief updateCommand calculates the new motor command to send to the Mbot. This method is called after each call to
-    * lcm.handle. You need to check if you have sufficient data to calculate a new command, or if the previous command
-    * should just be used again until for feedback becomes available.
+    * \brief updateCommand calculates the new motor command to send to the Mbot. This method is called once per control
+    * cycle, after readInputs. You need to check if you have sufficient data to calculate a new command, or if the
+    * previous command should just be used again until for feedback becomes available.
     *
     * \return   The motor command to send to the mbot_driver.
     */
     bool updateCommand(mbot_lcm_msgs::twist2D_t& cmd)
     {
-        if(targets_.empty() || odomTrace_.empty()) return false;
+        if(targets_.empty() || !havePose_) return false;
 
         cmd.utime = now();
         cmd.vx = cmd.vy = cmd.wz = 0;
 
-        mbot_lcm_msgs::pose2D_t pose = currentPose();
+        mbot_lcm_msgs::pose2D_t pose = pose_;
 
         if (!omni_xy_controller.target_reached(pose, targets_.back(), false))
         {
@@ -233,6 +289,12 @@ public:
                     cmd = omni_xy_controller.get_command(pose, targets_, path_idx_);
                 }
             }
+
+            // Steer around anything in the way that wasn't there when the path was planned
+            if(useLocalPlanner_ && distances_)
+            {
+                cmd = local_planner_.computeCommand(pose, cmd, targets_, *distances_);
+            }
 		}
         else
         {
@@ -245,24 +307,16 @@ public:
         return true;
     }
 
-    bool timesync_initialized(){ return timesync_initialized_; }
-
-    void handleTimesync(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::timestamp_t* timesync)
-    {
-	    timesync_initialized_ = true;
-	    time_offset = timesync->utime-utime_now();
-    }
+    bool timesync_initialized(){ return clockSync_.isSynced(); }
 
     void handlePath(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::path2D_t* path)
     {
-        targets_ = path->path;
+        newPath_.write(*path);
         // std::reverse(targets_.begin(), targets_.end()); // store first at back to allow for easy pop_back()
 
     	std::cout << "received new path at time: " << path->utime;
         std::cout << " with length: " << path->path.size() << std::endl;
 
-        path_idx_ = 0;
-
         //confirm that the path was received
         // mbot_lcm_msgs::message_received_t confirm {now(), path->utime, channel};
         // lcmInstance->publish(MESSAGE_CONFIRMATION_CHANNEL, &confirm);
@@ -272,18 +326,32 @@ public:
     {
         mbot_lcm_msgs::pose2D_t pose {odometry->utime, odometry->x, odometry->y, odometry->theta};
         odomTrace_.addPose(pose);
+        latestPose_.write(currentPose());
     }
 
     void handlePose(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::pose2D_t* pose)
     {
         computeOdometryOffset(*pose);
+        if(!odomTrace_.empty())
+        {
+            latestPose_.write(currentPose());
+        }
+    }
+
+    void handleMap(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::occupancy_grid_t* map)
+    {
+        // Only the raw map is passed on here. The distances are computed by the worker, so the messages queued
+        // behind this one aren't held up
+        std::shared_ptr<OccupancyGrid> grid = std::make_shared<OccupancyGrid>();
+        grid->fromLCM(*map);
+        distanceWorker_->setMap(grid);
     }
 
     void handleSystemReset(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::mbot_slam_reset_t* request)
     {
         mbot_lcm_msgs::twist2D_t cmd{now(), 0,0,0};
         lcmInstance->publish(MBOT_MOTOR_COMMAND_CHANNEL, &cmd);
-        targets_.clear();
+        newPath_.write(mbot_lcm_msgs::path2D_t());    // An empty path clears the targets on the next control cycle
         odomToGlobalFrame_.x = 0;
         odomToGlobalFrame_.y = 0;
         odomToGlobalFrame_.theta = 0;
@@ -298,14 +366,27 @@ private:
         OMNI
     };
 
+    ClockSync clockSync_;               // time on the MBot's clock, for stamping messages
+
+    // Used by the LCM thread
     mbot_lcm_msgs::pose2D_t odomToGlobalFrame_;      // transform to convert odometry into the global/map coordinates for navigating in a map
     PoseTrace  odomTrace_;              // trace of odometry for maintaining the offset estimate
+
+    // Passed from the LCM thread to the control thread
+    LatestValue<mbot_lcm_msgs::path2D_t> newPath_;
+    LatestValue<mbot_lcm_msgs::pose2D_t> latestPose_;   // odometry transformed into the global frame
+    std::unique_ptr<DistanceGridWorker> distanceWorker_;    // Computes the distances for each new map
+
+    // Used by the control thread
     std::vector<mbot_lcm_msgs::pose2D_t> targets_;
+    mbot_lcm_msgs::pose2D_t pose_;
+    bool havePose_;
+    bool useLocalPlanner_;
+    DynamicWindowPlanner local_planner_;
+    std::shared_ptr<const ObstacleDistanceGrid> distances_;
 
     State state_;
 
-    int64_t time_offset;
-    bool timesync_initialized_;
     int path_idx_;
 
     lcm::LCM * lcmInstance;
@@ -314,7 +395,7 @@ private:
 
     int64_t now()
     {
-	    return utime_now() + time_offset;
+	    return clockSync_.now();
     }
 
     bool assignNextTarget(void)
@@ -371,35 +452,62 @@ private:
         lcmInstance->subscribe(ODOMETRY_CHANNEL, &MotionController::handleOdometry, this);
         lcmInstance->subscribe(SLAM_POSE_CHANNEL, &MotionController::handlePose, this);
         lcmInstance->subscribe(CONTROLLER_PATH_CHANNEL, &MotionController::handlePath, this);
-        lcmInstance->subscribe(MBOT_TIMESYNC_CHANNEL, &MotionController::handleTimesync, this);
         lcmInstance->subscribe(MBOT_SYSTEM_RESET_CHANNEL, &MotionController::handleSystemReset, this);
+        if(useLocalPlanner_)
+        {
+            lcmInstance->subscribe(SLAM_MAP_CHANNEL, &MotionController::handleMap, this);
+        }
 
     }
 };
 
 int main(int argc, char** argv)
 {
+    const char* rateArg = "rate";
+    const char* rtPriorityArg = "rt-priority";
+    const char* localPlannerArg = "local-planner";
+
+    getopt_t *gopt = getopt_create();
+    getopt_add_bool(gopt, 'h', "help", 0, "Show this help message.");
+    getopt_add_double(gopt, '\0', rateArg, "50", "Rate, in Hz, at which motor commands are computed and published.");
+    getopt_add_int(gopt, '\0', rtPriorityArg, "0", "SCHED_FIFO priority (1-99) of the control thread. 0 uses normal"
+                    " scheduling. Needs root or CAP_SYS_NICE.");
+    getopt_add_bool(gopt, '\0', localPlannerArg, 0, "Check commands against the SLAM map and steer around obstacles"
+                    " that weren't there when the path was planned.");
+
+    if(!getopt_parse(gopt, argc, argv, 1) || getopt_get_bool(gopt, "help"))
+    {
+        printf("Usage: %s [options]\n", argv[0]);
+        getopt_do_usage(gopt);
+        return 1;
+    }
+
+    ControlLoopParams loopParams;
+    loopParams.rateHz = getopt_get_double(gopt, rateArg);
+    loopParams.realtimePriority = getopt_get_int(gopt, rtPriorityArg);
+    bool useLocalPlanner = getopt_get_bool(gopt, localPlannerArg);
+    getopt_destroy(gopt);
+
     lcm::LCM lcmInstance(MULTICAST_URL);
-    MotionController controller(&lcmInstance);
+    MotionController controller(&lcmInstance, useLocalPlanner);
 
     if(!lcmInstance.good()){
         return 1;
     }
 
-    ctrl_c_pressed = false;
     signal(SIGINT, ctrlc);
     signal(SIGTERM, ctrlc);
 
-    while(true)
-    {
-        lcmInstance.handleTimeout(50);  // update at 20Hz minimum
+    // Commands go out at a fixed rate, no matter when messages arrive
+    ControlLoop loop(&lcmInstance, loopParams);
+    loop.run([&lcmInstance, &controller]() {
+        controller.readInputs();
+
     	if(controller.timesync_initialized()){
             mbot_lcm_msgs::twist2D_t cmd;
             if(controller.updateCommand(cmd)) lcmInstance.publish(MBOT_MOTOR_COMMAND_CHANNEL, &cmd);
     	}
-
-        if (ctrl_c_pressed) break;
-    }
+    }, ctrl_c_pressed);
 
     // Stop the robot when motion controller quits.
     mbot_lcm_msgs::twist2D_t zero;
@@ -0,0 +1,201 @@
+#include <mbot/trajectory.hpp>
+#include <utils/geometric/angle_functions.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+
+// The trajectory is planned at this fraction of each limit, which leaves the tracker room to correct errors
+const double kPlanningMargin = 0.8;
+
+struct path_sample_t
+{
+    double x;
+    double y;
+};
+
+// Places samples every spacing meters along the polyline. Repeated waypoints are skipped, and the final waypoint is
+// always included.
+std::vector<path_sample_t> resample_path(const std::vector<mbot_lcm_msgs::pose2D_t>& path, double spacing)
+{
+    std::vector<path_sample_t> samples;
+    samples.push_back({path.front().x, path.front().y});
+
+    double distanceToNext = spacing;
+    for(std::size_t n = 1; n < path.size(); ++n)
+    {
+        double startX = path[n-1].x;
+        double startY = path[n-1].y;
+        double length = std::sqrt(std::pow(path[n].x - startX, 2) + std::pow(path[n].y - startY, 2));
+
+        double along = distanceToNext;
+        for(; along <= length; along += spacing)
+        {
+            double fraction = along / length;
+            samples.push_back({startX + fraction * (path[n].x - startX), startY + fraction * (path[n].y - startY)});
+        }
+        distanceToNext = along - length;
+    }
+
+    const mbot_lcm_msgs::pose2D_t& end = path.back();
+    const path_sample_t& last = samples.back();
+    if(std::abs(last.x - end.x) > 1e-6 || std::abs(last.y - end.y) > 1e-6)
+    {
+        samples.push_back({end.x, end.y});
+    }
+
+    return samples;
+}
+
+// Rounds corners with a moving average. The window shrinks near the ends so the first and last samples don't move.
+std::vector<path_sample_t> smooth_path(const std::vector<path_sample_t>& samples, int halfWindow)
+{
+    int numSamples = samples.size();
+    std::vector<path_sample_t> smoothed(numSamples);
+    for(int n = 0; n < numSamples; ++n)
+    {
+        int window = std::min(halfWindow, std::min(n, numSamples - 1 - n));
+        double sumX = 0.0;
+        double sumY = 0.0;
+        for(int i = n - window; i <= n + window; ++i)
+        {
+            sumX += samples[i].x;
+            sumY += samples[i].y;
+        }
+        smoothed[n].x = sumX / (2 * window + 1);
+        smoothed[n].y = sumY / (2 * window + 1);
+    }
+    return smoothed;
+}
+
+} // namespace
+
+
+Trajectory::Trajectory(void)
+{
+}
+
+
+Trajectory::Trajectory(const std::vector<mbot_lcm_msgs::pose2D_t>& path, const TrajectoryLimits& limits)
+{
+    if(path.empty())
+    {
+        return;
+    }
+
+    const double maxVel = kPlanningMargin * limits.maxVel;
+    const double maxAccel = kPlanningMargin * limits.maxAccel;
+    const double maxAngularVel = kPlanningMargin * limits.maxAngularVel;
+    const double maxCentripetalAccel = kPlanningMargin * limits.maxCentripetalAccel;
+
+    int halfWindow = std::lround(0.5 * limits.cornerSmoothing / limits.sampleSpacing);
+    std::vector<path_sample_t> samples = smooth_path(resample_path(path, limits.sampleSpacing), halfWindow);
+    int numPoints = samples.size();
+
+    points_.resize(numPoints);
+    for(int n = 0; n < numPoints; ++n)
+    {
+        points_[n].x = samples[n].x;
+        points_[n].y = samples[n].y;
+    }
+
+    if(numPoints == 1)
+    {
+        points_[0].t = 0.0;
+        points_[0].theta = path.back().theta;
+        points_[0].v = 0.0;
+        points_[0].w = 0.0;
+        return;
+    }
+
+    // Each point faces the next one. The distance between points changes a little where corners were rounded.
+    std::vector<double> distances(numPoints, 0.0);
+    for(int n = 0; n + 1 < numPoints; ++n)
+    {
+        double dx = points_[n+1].x - points_[n].x;
+        double dy = points_[n+1].y - points_[n].y;
+        points_[n].theta = std::atan2(dy, dx);
+        distances[n] = std::sqrt(dx*dx + dy*dy);
+    }
+    points_.back().theta = points_[numPoints - 2].theta;
+
+    // The fastest speed allowed at each point, given the curvature there
+    std::vector<double> curvatures(numPoints, 0.0);
+    for(int n = 0; n + 1 < numPoints; ++n)
+    {
+        if(distances[n] > 0.0)
+        {
+            curvatures[n] = angle_diff(points_[n+1].theta, points_[n].theta) / distances[n];
+        }
+
+        double curvature = std::abs(curvatures[n]);
+        points_[n].v = maxVel;
+        if(curvature > 1e-6)
+        {
+            points_[n].v = std::min(points_[n].v, maxAngularVel / curvature);
+            points_[n].v = std::min(points_[n].v, std::sqrt(maxCentripetalAccel / curvature));
+        }
+    }
+
+    // Limit acceleration from rest at the start, then deceleration to rest at the end
+    points_.front().v = 0.0;
+    points_.back().v = 0.0;
+    for(int n = 1; n < numPoints; ++n)
+    {
+        double reachable = std::sqrt(std::pow(points_[n-1].v, 2) + 2.0 * maxAccel * distances[n-1]);
+        points_[n].v = std::min(points_[n].v, reachable);
+    }
+    for(int n = numPoints - 2; n >= 0; --n)
+    {
+        double stoppable = std::sqrt(std::pow(points_[n+1].v, 2) + 2.0 * maxAccel * distances[n]);
+        points_[n].v = std::min(points_[n].v, stoppable);
+    }
+
+    // Speed is linear in time between points, so each step takes its distance over the average speed
+    points_.front().t = 0.0;
+    for(int n = 0; n < numPoints; ++n)
+    {
+        points_[n].w = points_[n].v * curvatures[n];
+        if(n + 1 < numPoints)
+        {
+            double averageVel = std::max(0.5 * (points_[n].v + points_[n+1].v), 1e-3);
+            points_[n+1].t = points_[n].t + distances[n] / averageVel;
+        }
+    }
+}
+
+
+TrajectoryPoint Trajectory::sample(double t) const
+{
+    if(points_.empty())
+    {
+        return TrajectoryPoint{0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    }
+
+    if(t <= points_.front().t)
+    {
+        return points_.front();
+    }
+    if(t >= points_.back().t)
+    {
+        return points_.back();
+    }
+
+    auto after = std::upper_bound(points_.begin(), points_.end(), t, [](double time, const TrajectoryPoint& point) {
+        return time < point.t;
+    });
+    const TrajectoryPoint& end = *after;
+    const TrajectoryPoint& start = *(after - 1);
+
+    double fraction = (t - start.t) / (end.t - start.t);
+    TrajectoryPoint point;
+    point.t = t;
+    point.x = start.x + fraction * (end.x - start.x);
+    point.y = start.y + fraction * (end.y - start.y);
+    point.theta = wrap_to_pi(start.theta + fraction * angle_diff(end.theta, start.theta));
+    point.v = start.v + fraction * (end.v - start.v);
+    point.w = start.w + fraction * (end.w - start.w);
+    return point;
+}
@@ -0,0 +1,227 @@
+#include <mbot/trajectory_tracker.hpp>
+#include <utils/geometric/angle_functions.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+
+const double kTurnGain = 3.0;               // Turn rate per radian of heading error when turning in place
+const double kApproachGain = 1.0;           // Speed per meter of distance when approaching the goal
+const double kMaxStartHeadingError = M_PI / 6.0;    // Largest heading error the tracker starts with
+const double kMaxCycleSec = 0.1;            // Longer gaps between cycles only advance the reference this far
+
+double clamp(double value, double minValue, double maxValue)
+{
+    return std::max(minValue, std::min(value, maxValue));
+}
+
+} // namespace
+
+
+TrajectoryTracker::TrajectoryTracker(const TrajectoryLimits& limits, const TrackerParams& params)
+: limits_(limits)
+, params_(params)
+, goalHeading_(0.0)
+, phase_(DONE)
+, refTime_(0.0)
+, lastUtime_(-1)
+, lastVel_(0.0)
+{
+}
+
+
+void TrajectoryTracker::setTrajectory(const Trajectory& trajectory, double goalHeading)
+{
+    trajectory_ = trajectory;
+    goalHeading_ = goalHeading;
+    phase_ = trajectory_.empty() ? DONE : INITIAL_TURN;
+    refTime_ = 0.0;
+}
+
+
+void TrajectoryTracker::stop(void)
+{
+    trajectory_ = Trajectory();
+    phase_ = DONE;
+    refTime_ = 0.0;
+}
+
+
+mbot_lcm_msgs::twist2D_t TrajectoryTracker::getCommand(const mbot_lcm_msgs::pose2D_t& pose, int64_t utime)
+{
+    // The first cycle has nothing to measure from, so it doesn't advance the reference
+    double dt = (lastUtime_ < 0) ? 0.0 : clamp((utime - lastUtime_) * 1e-6, 0.0, kMaxCycleSec);
+    lastUtime_ = utime;
+
+    if(phase_ == INITIAL_TURN)
+    {
+        // Turning in place is only needed if the path starts behind or beside the robot
+        if(std::abs(angle_diff(trajectory_.front().theta, pose.theta)) > kMaxStartHeadingError
+            && trajectory_.duration() > 0.0)
+        {
+            return turnTo(pose, trajectory_.front().theta, dt);
+        }
+        phase_ = TRACK;
+    }
+
+    if(phase_ == TRACK)
+    {
+        // The reference moves at full speed while the robot keeps up and stops once it's maxLag behind
+        TrajectoryPoint ref = trajectory_.sample(refTime_);
+        double lag = std::sqrt(std::pow(ref.x - pose.x, 2) + std::pow(ref.y - pose.y, 2));
+        double progress = clamp(2.0 * (params_.maxLag - lag) / params_.maxLag, 0.0, 1.0);
+        refTime_ = std::min(refTime_ + progress * dt, trajectory_.duration());
+
+        // Once the reference stops at the end, the linearization can't correct sideways error, so go straight there
+        if(refTime_ >= trajectory_.duration())
+        {
+            return approachGoal(pose, dt);
+        }
+
+        ref = trajectory_.sample(refTime_);
+        double dx = ref.x - pose.x;
+        double dy = ref.y - pose.y;
+        double cosTheta = std::cos(pose.theta);
+        double sinTheta = std::sin(pose.theta);
+        double error[3] = {
+            cosTheta * dx + sinTheta * dy,          // along the robot's heading
+            -sinTheta * dx + cosTheta * dy,         // to the robot's left
+            angle_diff(ref.theta, pose.theta)
+        };
+
+        double velCorrection = 0.0;
+        double angularVelCorrection = 0.0;
+        solveHorizon(error, velCorrection, angularVelCorrection);
+
+        return limitCommand(ref.v * std::cos(error[2]) + velCorrection, ref.w + angularVelCorrection, dt);
+    }
+
+    if(phase_ == FINAL_TURN)
+    {
+        if(std::abs(angle_diff(goalHeading_, pose.theta)) > params_.headingTolerance)
+        {
+            return turnTo(pose, goalHeading_, dt);
+        }
+        phase_ = DONE;
+    }
+
+    lastVel_ = 0.0;
+    return {0, 0.0, 0.0, 0.0};
+}
+
+
+mbot_lcm_msgs::twist2D_t TrajectoryTracker::turnTo(const mbot_lcm_msgs::pose2D_t& pose, double heading, double dt)
+{
+    return limitCommand(0.0, kTurnGain * angle_diff(heading, pose.theta), dt);
+}
+
+
+mbot_lcm_msgs::twist2D_t TrajectoryTracker::approachGoal(const mbot_lcm_msgs::pose2D_t& pose, double dt)
+{
+    const TrajectoryPoint& end = trajectory_.back();
+    double dx = end.x - pose.x;
+    double dy = end.y - pose.y;
+    double distance = std::sqrt(dx*dx + dy*dy);
+    if(distance < params_.goalTolerance)
+    {
+        phase_ = FINAL_TURN;
+        return turnTo(pose, goalHeading_, dt);
+    }
+
+    // Back up to goals that are behind the robot, rather than turning around
+    double alpha = angle_diff(std::atan2(dy, dx), pose.theta);
+    double vel = kApproachGain * distance * std::cos(alpha);
+    if(std::abs(alpha) > M_PI_2)
+    {
+        alpha = angle_diff(alpha, M_PI);
+    }
+
+    return limitCommand(vel, kTurnGain * alpha, dt);
+}
+
+
+void TrajectoryTracker::solveHorizon(const double error[3], double& velCorrection, double& angularVelCorrection) const
+{
+    // The error e = (along, left, heading) and corrections u = (dv, dw) from the reference commands evolve as
+    //
+    //      e[k+1] = A[k] e[k] + B u[k],    A[k] = | 1       w_r h   0     |    B = | -h   0  |
+    //                                             | -w_r h  1       v_r h |        | 0    0  |
+    //                                             | 0       0       1     |        | 0    -h |
+    //
+    // where h is the step and v_r, w_r are the reference commands at step k. Minimizing sum(e'Qe + u'Ru) over the
+    // horizon gives u[0] = -K[0] e[0], with K[0] found by running the Riccati recursion backward from the end.
+    const double h = params_.stepSec;
+    const double q[3] = {params_.alongWeight, params_.crossWeight, params_.headingWeight};
+    const double r[2] = {params_.velWeight, params_.angularVelWeight};
+
+    double P[3][3] = {{q[0], 0.0, 0.0}, {0.0, q[1], 0.0}, {0.0, 0.0, q[2]}};
+    double K[2][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+
+    for(int k = params_.horizonSteps - 1; k >= 0; --k)
+    {
+        TrajectoryPoint ref = trajectory_.sample(refTime_ + k * h);
+        double A[3][3] = {{1.0, ref.w * h, 0.0}, {-ref.w * h, 1.0, ref.v * h}, {0.0, 0.0, 1.0}};
+
+        // B has one nonzero entry per column, so B'P is just rows 0 and 2 of P scaled by -h
+        double BtP[2][3];
+        for(int j = 0; j < 3; ++j)
+        {
+            BtP[0][j] = -h * P[0][j];
+            BtP[1][j] = -h * P[2][j];
+        }
+
+        double S[2][2] = {{r[0] - h * BtP[0][0], -h * BtP[0][2]},
+                          {-h * BtP[1][0], r[1] - h * BtP[1][2]}};
+
+        double BtPA[2][3];
+        for(int i = 0; i < 2; ++i)
+        {
+            for(int j = 0; j < 3; ++j)
+            {
+                BtPA[i][j] = BtP[i][0] * A[0][j] + BtP[i][1] * A[1][j] + BtP[i][2] * A[2][j];
+            }
+        }
+
+        // K = S^-1 B'PA
+        double det = S[0][0] * S[1][1] - S[0][1] * S[1][0];
+        for(int j = 0; j < 3; ++j)
+        {
+            K[0][j] = (S[1][1] * BtPA[0][j] - S[0][1] * BtPA[1][j]) / det;
+            K[1][j] = (-S[1][0] * BtPA[0][j] + S[0][0] * BtPA[1][j]) / det;
+        }
+
+        // P = Q + A'PA - (B'PA)'K
+        double PA[3][3];
+        for(int i = 0; i < 3; ++i)
+        {
+            for(int j = 0; j < 3; ++j)
+            {
+                PA[i][j] = P[i][0] * A[0][j] + P[i][1] * A[1][j] + P[i][2] * A[2][j];
+            }
+        }
+        for(int i = 0; i < 3; ++i)
+        {
+            for(int j = 0; j < 3; ++j)
+            {
+                P[i][j] = A[0][i] * PA[0][j] + A[1][i] * PA[1][j] + A[2][i] * PA[2][j]
+                    - BtPA[0][i] * K[0][j] - BtPA[1][i] * K[1][j]
+                    + ((i == j) ? q[i] : 0.0);
+            }
+        }
+    }
+
+    velCorrection = -(K[0][0] * error[0] + K[0][1] * error[1] + K[0][2] * error[2]);
+    angularVelCorrection = -(K[1][0] * error[0] + K[1][1] * error[1] + K[1][2] * error[2]);
+}
+
+
+mbot_lcm_msgs::twist2D_t TrajectoryTracker::limitCommand(double vel, double angularVel, double dt)
+{
+    vel = clamp(vel, -limits_.maxVel, limits_.maxVel);
+    vel = clamp(vel, lastVel_ - limits_.maxAccel * dt, lastVel_ + limits_.maxAccel * dt);
+    angularVel = clamp(angularVel, -limits_.maxAngularVel, limits_.maxAngularVel);
+    lastVel_ = vel;
+    return {0, static_cast<float>(vel), 0.0f, static_cast<float>(angularVel)};
+}
@@ -0,0 +1,308 @@
+#include <mbot/trajectory_tracker.hpp>
+#include <utils/geometric/angle_functions.hpp>
+#include <utils/getopt.h>
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <mbot_lcm_msgs/twist2D_t.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "diff_waypoint_controller.h"
+
+using namespace mbot_lcm_msgs;
+using namespace std::chrono;
+
+/*
+* trajectory_tracking_benchmark compares the waypoint state machine of the diff-drive motion controller with the
+* trajectory tracker. Both drive a simulated unicycle along the same paths, with the commands applied through a
+* first-order lag to model the wheel speed controllers.
+*
+* For each path and controller, it reports the mission time, the largest distance from the path, the final position
+* error, and the time spent computing commands each cycle.
+*/
+
+const double kSimStepSec = 0.001;
+
+
+struct named_path_t
+{
+    std::string name;
+    std::vector<pose2D_t> path;
+};
+
+struct sim_params_t
+{
+    double rateHz;
+    double motorLagSec;
+    double timeoutSec;
+};
+
+struct run_result_t
+{
+    bool reachedGoal;
+    double missionSec;
+    double maxDeviation;
+    double finalError;
+    double setupUs;
+    std::vector<double> cycleUs;
+};
+
+
+class UnicycleSim
+{
+public:
+
+    UnicycleSim(double motorLagSec)
+    : motorLagSec_(motorLagSec)
+    , vel_(0.0)
+    , angularVel_(0.0)
+    {
+        pose_.utime = 0;
+        pose_.x = 0.0f;
+        pose_.y = 0.0f;
+        pose_.theta = 0.0f;
+    }
+
+    const pose2D_t& pose(void) const { return pose_; }
+
+    void step(const twist2D_t& cmd, double duration)
+    {
+        double x = pose_.x;
+        double y = pose_.y;
+        double theta = pose_.theta;
+        double blend = 1.0 - std::exp(-kSimStepSec / motorLagSec_);
+
+        for(double t = 0.0; t < duration - 1e-9; t += kSimStepSec)
+        {
+            vel_ += blend * (cmd.vx - vel_);
+            angularVel_ += blend * (cmd.wz - angularVel_);
+            x += vel_ * std::cos(theta) * kSimStepSec;
+            y += vel_ * std::sin(theta) * kSimStepSec;
+            theta = wrap_to_pi(theta + angularVel_ * kSimStepSec);
+        }
+
+        pose_.utime += static_cast<int64_t>(duration * 1e6);
+        pose_.x = x;
+        pose_.y = y;
+        pose_.theta = theta;
+    }
+
+private:
+
+    double motorLagSec_;
+    pose2D_t pose_;
+    double vel_;
+    double angularVel_;
+};
+
+
+std::vector<named_path_t> benchmark_paths(void);
+double distance_to_path(const pose2D_t& pose, const std::vector<pose2D_t>& path);
+run_result_t run_waypoint(const std::vector<pose2D_t>& path, const twist2D_t& limits, const sim_params_t& params);
+run_result_t run_trajectory(const std::vector<pose2D_t>& path, const TrajectoryLimits& limits,
+                            const sim_params_t& params);
+void print_result(const std::string& pathName, const std::string& controllerName, const run_result_t& result);
+
+
+int main(int argc, char** argv)
+{
+    const char* rateArg = "rate";
+    const char* lagArg = "motor-lag";
+    const char* timeoutArg = "timeout";
+    const char* waypointVelArg = "waypoint-vel";
+    const char* waypointTurnRateArg = "waypoint-turn-rate";
+
+    getopt_t* gopt = getopt_create();
+    getopt_add_bool(gopt, 'h', "help", 0, "Show this help message.");
+    getopt_add_double(gopt, '\0', rateArg, "50", "Control rate (Hz).");
+    getopt_add_double(gopt, '\0', lagArg, "0.05", "Time constant of the simulated wheel speed response (s).");
+    getopt_add_double(gopt, '\0', timeoutArg, "120", "Time after which a run is stopped as failed (s).");
+    getopt_add_double(gopt, '\0', waypointVelArg, "0.1", "Speed limit of the waypoint controller (m/s). The "
+                      "trajectory limits are also tried.");
+    getopt_add_double(gopt, '\0', waypointTurnRateArg, "0.314", "Turn rate limit of the waypoint controller (rad/s).");
+
+    if(!getopt_parse(gopt, argc, argv, 1) || getopt_get_bool(gopt, "help"))
+    {
+        printf("Usage: %s [options]\n", argv[0]);
+        getopt_do_usage(gopt);
+        return 1;
+    }
+
+    sim_params_t params;
+    params.rateHz = getopt_get_double(gopt, rateArg);
+    params.motorLagSec = getopt_get_double(gopt, lagArg);
+    params.timeoutSec = getopt_get_double(gopt, timeoutArg);
+
+    twist2D_t defaultLimits;
+    defaultLimits.vx = getopt_get_double(gopt, waypointVelArg);
+    defaultLimits.vy = 0.0f;
+    defaultLimits.wz = getopt_get_double(gopt, waypointTurnRateArg);
+    getopt_destroy(gopt);
+
+    TrajectoryLimits trajectoryLimits;
+    twist2D_t fastLimits;
+    fastLimits.vx = trajectoryLimits.maxVel;
+    fastLimits.vy = 0.0f;
+    fastLimits.wz = trajectoryLimits.maxAngularVel;
+
+    printf("%-10s %-18s %8s %12s %12s %10s %10s %10s %10s\n", "path", "controller", "goal", "mission(s)",
+           "deviation(m)", "error(m)", "setup(us)", "mean(us)", "max(us)");
+
+    for(auto& path : benchmark_paths())
+    {
+        print_result(path.name, "waypoint", run_waypoint(path.path, defaultLimits, params));
+        print_result(path.name, "waypoint-fast", run_waypoint(path.path, fastLimits, params));
+        print_result(path.name, "trajectory", run_trajectory(path.path, trajectoryLimits, params));
+    }
+
+    return 0;
+}
+
+
+std::vector<named_path_t> benchmark_paths(void)
+{
+    auto pose = [](double x, double y, double theta) {
+        pose2D_t pose;
+        pose.utime = 0;
+        pose.x = x;
+        pose.y = y;
+        pose.theta = theta;
+        return pose;
+    };
+
+    std::vector<named_path_t> paths;
+
+    // The same path drive_square sends
+    paths.push_back({"square", {pose(0.0, 0.0, 0.0), pose(0.5, 0.0, 0.0), pose(0.5, 0.5, 0.0), pose(0.0, 0.5, 0.0),
+                                pose(0.0, 0.0, 0.0)}});
+
+    paths.push_back({"slalom", {pose(0.0, 0.0, 0.0), pose(0.5, 0.3, 0.0), pose(1.0, -0.3, 0.0), pose(1.5, 0.3, 0.0),
+                                pose(2.0, 0.0, 0.0)}});
+
+    // Like a pruned A* path through a building, with each pose facing the next one
+    std::vector<pose2D_t> corridor = {pose(0.0, 0.0, 0.0), pose(1.5, 0.0, 0.0), pose(2.0, 0.5, 0.0),
+                                      pose(2.0, 2.0, 0.0), pose(3.5, 2.0, 0.0), pose(3.5, 1.0, 0.0)};
+    for(std::size_t n = 1; n < corridor.size(); ++n)
+    {
+        corridor[n-1].theta = std::atan2(corridor[n].y - corridor[n-1].y, corridor[n].x - corridor[n-1].x);
+        corridor[n].theta = corridor[n-1].theta;
+    }
+    paths.push_back({"corridor", corridor});
+
+    return paths;
+}
+
+
+double distance_to_path(const pose2D_t& pose, const std::vector<pose2D_t>& path)
+{
+    double minDistance = std::sqrt(std::pow(pose.x - path.front().x, 2) + std::pow(pose.y - path.front().y, 2));
+    for(std::size_t n = 1; n < path.size(); ++n)
+    {
+        double segmentX = path[n].x - path[n-1].x;
+        double segmentY = path[n].y - path[n-1].y;
+        double lengthSquared = segmentX * segmentX + segmentY * segmentY;
+        double fraction = 0.0;
+        if(lengthSquared > 0.0)
+        {
+            fraction = ((pose.x - path[n-1].x) * segmentX + (pose.y - path[n-1].y) * segmentY) / lengthSquared;
+            fraction = std::max(0.0, std::min(fraction, 1.0));
+        }
+        double dx = pose.x - (path[n-1].x + fraction * segmentX);
+        double dy = pose.y - (path[n-1].y + fraction * segmentY);
+        minDistance = std::min(minDistance, std::sqrt(dx*dx + dy*dy));
+    }
+    return minDistance;
+}
+
+
+// Runs the control loop until isDone returns true or the timeout passes. computeCommand is timed every cycle.
+template <class CommandFunc, class DoneFunc>
+run_result_t run_mission(const std::vector<pose2D_t>& path, const sim_params_t& params, CommandFunc computeCommand,
+                         DoneFunc isDone)
+{
+    run_result_t result;
+    result.reachedGoal = false;
+    result.maxDeviation = 0.0;
+    result.setupUs = 0.0;
+
+    UnicycleSim sim(params.motorLagSec);
+    const double period = 1.0 / params.rateHz;
+    double time = 0.0;
+
+    for(; time < params.timeoutSec; time += period)
+    {
+        auto start = steady_clock::now();
+        twist2D_t cmd = computeCommand(sim.pose());
+        bool done = isDone();
+        result.cycleUs.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0);
+
+        if(done)
+        {
+            result.reachedGoal = true;
+            break;
+        }
+
+        sim.step(cmd, period);
+        result.maxDeviation = std::max(result.maxDeviation, distance_to_path(sim.pose(), path));
+    }
+
+    result.missionSec = time;
+    result.finalError = std::sqrt(std::pow(sim.pose().x - path.back().x, 2) + std::pow(sim.pose().y - path.back().y, 2));
+    return result;
+}
+
+
+run_result_t run_waypoint(const std::vector<pose2D_t>& path, const twist2D_t& limits, const sim_params_t& params)
+{
+    DiffWaypointController controller;
+    controller.setPath(path);
+
+    return run_mission(path, params,
+        [&](const pose2D_t& pose) {
+            // Limited the same way as in diff_motion_controller
+            twist2D_t cmd = controller.updateCommand(pose);
+            cmd.vx = std::max(-limits.vx, std::min(cmd.vx, limits.vx));
+            cmd.wz = std::max(-limits.wz, std::min(cmd.wz, limits.wz));
+            return cmd;
+        },
+        [&]() { return controller.getTargets().empty(); });
+}
+
+
+run_result_t run_trajectory(const std::vector<pose2D_t>& path, const TrajectoryLimits& limits,
+                            const sim_params_t& params)
+{
+    auto start = steady_clock::now();
+    Trajectory trajectory(path, limits);
+    double setupUs = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0;
+
+    TrajectoryTracker tracker(limits);
+    tracker.setTrajectory(trajectory, path.back().theta);
+
+    run_result_t result = run_mission(path, params,
+        [&](const pose2D_t& pose) { return tracker.getCommand(pose, pose.utime); },
+        [&]() { return tracker.isDone(); });
+    result.setupUs = setupUs;
+    return result;
+}
+
+
+void print_result(const std::string& pathName, const std::string& controllerName, const run_result_t& result)
+{
+    double meanUs = 0.0;
+    double maxUs = 0.0;
+    for(double us : result.cycleUs)
+    {
+        meanUs += us;
+        maxUs = std::max(maxUs, us);
+    }
+    meanUs /= std::max<std::size_t>(result.cycleUs.size(), 1);
+
+    printf("%-10s %-18s %8s %12.2f %12.3f %10.3f %10.1f %10.2f %10.1f\n", pathName.c_str(), controllerName.c_str(),
+           result.reachedGoal ? "yes" : "no", result.missionSec, result.maxDeviation, result.finalError,
+           result.setupUs, meanUs, maxUs);
+}
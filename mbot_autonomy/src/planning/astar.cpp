@@ -1,23 +1,341 @@
 #include <planning/astar.hpp>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
 
 using namespace std::chrono;
 
+namespace
+{
+
+const int kNumNeighbors = 8;
+const int xDeltas[kNumNeighbors] = {1, -1, 0, 0, 1, -1, 1, -1};
+const int yDeltas[kNumNeighbors] = {0, 0, 1, -1, 1, -1, -1, 1};
+
+int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+
+/*
+* JumpPointSearch finds the successors of a node for Jump Point Search. Cells at least maxDistanceWithCost from an
+* obstacle all cost the same, so the search walks straight across them until it reaches a jump point: the goal, a cell
+* with a forced neighbor, or a cell where the cost changes: the first weighted cell in that direction or any uniform cell
+* next to a weighted cell. Weighted cells are treated like obstacles when looking for forced neighbors, so the search
+* stops wherever the path might need to bend around them. The optimal path can turn into the weighted cells from
+* anywhere along their edge, so cells where the cost changes expand all of their neighbors, just like the normal search.
+*
+* A JumpPointSearch is valid for a single search, as it caches the straight jumps scanned from each diagonal step.
+*/
+class JumpPointSearch
+{
+public:
+
+    JumpPointSearch(const cell_t& goal, const ObstacleDistanceGrid& distances, const SearchParams& params)
+    : goal_(goal)
+    , distances_(distances)
+    , params_(params)
+    , straightJumps_(4 * distances.widthInCells() * distances.heightInCells(), kUnknown)
+    , costChanges_(distances.widthInCells() * distances.heightInCells(), kUnknown)
+    {
+    }
+
+    std::vector<Node*> successors(Node* node)
+    {
+        const cell_t& cell = node->cell;
+
+        // The start node and cells where the cost changes expand all neighbors. Uniform cells only continue in the
+        // natural and forced directions relative to the direction they were reached from.
+        std::vector<std::pair<int, int>> directions;
+        if(!node->parent || isBlocked(cell.x, cell.y) || touchesWeighted(cell))
+        {
+            for(int n = 0; n < kNumNeighbors; ++n)
+            {
+                directions.emplace_back(xDeltas[n], yDeltas[n]);
+            }
+        }
+        else
+        {
+            int dx = sign(cell.x - node->parent->cell.x);
+            int dy = sign(cell.y - node->parent->cell.y);
+
+            if(dx != 0 && dy != 0)
+            {
+                directions.emplace_back(dx, dy);
+                directions.emplace_back(dx, 0);
+                directions.emplace_back(0, dy);
+                if(isBlocked(cell.x - dx, cell.y)) directions.emplace_back(-dx, dy);
+                if(isBlocked(cell.x, cell.y - dy)) directions.emplace_back(dx, -dy);
+            }
+            else if(dx != 0)
+            {
+                directions.emplace_back(dx, 0);
+                if(isBlocked(cell.x, cell.y + 1)) directions.emplace_back(dx, 1);
+                if(isBlocked(cell.x, cell.y - 1)) directions.emplace_back(dx, -1);
+            }
+            else
+            {
+                directions.emplace_back(0, dy);
+                if(isBlocked(cell.x + 1, cell.y)) directions.emplace_back(1, dy);
+                if(isBlocked(cell.x - 1, cell.y)) directions.emplace_back(-1, dy);
+            }
+        }
+
+        std::vector<Node*> children;
+        for(auto&& dir : directions)
+        {
+            cell_t jumpPoint;
+            if(jump(cell, dir.first, dir.second, jumpPoint))
+            {
+                children.push_back(new Node(jumpPoint.x, jumpPoint.y));
+            }
+        }
+        return children;
+    }
+
+private:
+
+    enum JumpResult : uint8_t
+    {
+        kUnknown,
+        kNoJumpPoint,
+        kHasJumpPoint,
+    };
+
+    const cell_t goal_;
+    const ObstacleDistanceGrid& distances_;
+    const SearchParams& params_;
+
+    std::vector<uint8_t> straightJumps_;    // JumpResult for each cell and straight direction
+    std::vector<int> scannedCells_;         // Scratch space for filling in straightJumps_
+    std::vector<uint8_t> costChanges_;      // kHasJumpPoint for each uniform cell next to a weighted cell
+
+    bool isBlocked(int x, int y) const { return !is_uniform(x, y, distances_, params_); }
+
+    // Check if a uniform cell is next to a weighted cell, where the path might turn into the weighted cells. Scans
+    // pass over the same cells many times, so the answer is cached.
+    bool touchesWeighted(const cell_t& cell)
+    {
+        uint8_t& result = costChanges_[cell.y * distances_.widthInCells() + cell.x];
+        if(result == kUnknown)
+        {
+            result = kNoJumpPoint;
+            for(int n = 0; n < kNumNeighbors; ++n)
+            {
+                int x = cell.x + xDeltas[n];
+                int y = cell.y + yDeltas[n];
+                if(isBlocked(x, y) && is_traversable(x, y, distances_, params_))
+                {
+                    result = kHasJumpPoint;
+                    break;
+                }
+            }
+        }
+        return result == kHasJumpPoint;
+    }
+
+    bool hasForcedNeighbor(const cell_t& cell, int dx, int dy) const
+    {
+        if(dx != 0 && dy != 0)
+        {
+            return (isBlocked(cell.x - dx, cell.y) && !isBlocked(cell.x - dx, cell.y + dy))
+                || (isBlocked(cell.x, cell.y - dy) && !isBlocked(cell.x + dx, cell.y - dy));
+        }
+        else if(dx != 0)
+        {
+            return (isBlocked(cell.x, cell.y + 1) && !isBlocked(cell.x + dx, cell.y + 1))
+                || (isBlocked(cell.x, cell.y - 1) && !isBlocked(cell.x + dx, cell.y - 1));
+        }
+        else
+        {
+            return (isBlocked(cell.x + 1, cell.y) && !isBlocked(cell.x + 1, cell.y + dy))
+                || (isBlocked(cell.x - 1, cell.y) && !isBlocked(cell.x - 1, cell.y + dy));
+        }
+    }
+
+    // Walk from cell in direction (dx, dy) until a jump point is found or the way is blocked
+    bool jump(cell_t cell, int dx, int dy, cell_t& jumpPoint)
+    {
+        while(true)
+        {
+            cell.x += dx;
+            cell.y += dy;
+
+            if(!is_traversable(cell.x, cell.y, distances_, params_))
+            {
+                return false;
+            }
+
+            if((cell == goal_) || isBlocked(cell.x, cell.y) || touchesWeighted(cell)
+                || hasForcedNeighbor(cell, dx, dy))
+            {
+                jumpPoint = cell;
+                return true;
+            }
+
+            // A diagonal step is a jump point if either of its straight components reaches one
+            if(dx != 0 && dy != 0 && (hasStraightJumpPoint(cell, dx, 0) || hasStraightJumpPoint(cell, 0, dy)))
+            {
+                jumpPoint = cell;
+                return true;
+            }
+        }
+    }
+
+    // Check if a straight jump from cell finds a jump point without leaving the uniform-cost cells. Every cell passed
+    // along the way has the same answer, so they are all cached.
+    bool hasStraightJumpPoint(cell_t cell, int dx, int dy)
+    {
+        int direction = (dx > 0) ? 0 : (dx < 0) ? 1 : (dy > 0) ? 2 : 3;
+        bool found = false;
+        scannedCells_.clear();
+
+        while(true)
+        {
+            int index = 4 * (cell.y * distances_.widthInCells() + cell.x) + direction;
+            if(straightJumps_[index] != kUnknown)
+            {
+                found = straightJumps_[index] == kHasJumpPoint;
+                break;
+            }
+            scannedCells_.push_back(index);
+
+            cell.x += dx;
+            cell.y += dy;
+
+            if(!is_traversable(cell.x, cell.y, distances_, params_) || isBlocked(cell.x, cell.y))
+            {
+                break;
+            }
+
+            if((cell == goal_) || touchesWeighted(cell) || hasForcedNeighbor(cell, dx, dy))
+            {
+                found = true;
+                break;
+            }
+        }
+
+        for(int index : scannedCells_)
+        {
+            straightJumps_[index] = found ? kHasJumpPoint : kNoJumpPoint;
+        }
+        return found;
+    }
+};
+
+} // namespace
+
+
+bool is_traversable(int x, int y, const ObstacleDistanceGrid& distances, const SearchParams& params)
+{
+    return distances.isCellInGrid(x, y) && distances(x, y) > params.minDistanceToObstacle;
+}
+
+bool is_uniform(int x, int y, const ObstacleDistanceGrid& distances, const SearchParams& params)
+{
+    return distances.isCellInGrid(x, y) && distances(x, y) >= params.maxDistanceWithCost;
+}
+
+double step_cost(int x, int y, bool diagonal, const ObstacleDistanceGrid& distances, const SearchParams& params)
+{
+    double cost = (diagonal ? M_SQRT2 : 1.0) * distances.metersPerCell();
+    double cellDistance = distances(x, y);
+    if(cellDistance < params.maxDistanceWithCost)
+    {
+        cost *= std::pow(params.maxDistanceWithCost / cellDistance, params.distanceCostExponent);
+    }
+    return cost;
+}
+
+
 mbot_lcm_msgs::path2D_t search_for_path(mbot_lcm_msgs::pose2D_t start,
                                              mbot_lcm_msgs::pose2D_t goal,
                                              const ObstacleDistanceGrid& distances,
-                                             const SearchParams& params)
+                                             const SearchParams& params,
+                                             SearchStats* stats)
 {
+    auto searchStart = steady_clock::now();
+
     cell_t startCell = global_position_to_grid_cell(Point<double>(start.x, start.y), distances);
     cell_t goalCell = global_position_to_grid_cell(Point<double>(goal.x, goal.y), distances);
     bool found_path = false;
-    
-    ////////////////// TODO: Implement your A* search here //////////////////////////
-    
+    int64_t numExpanded = 0;
+
+    // The search owns every node it creates. Nodes are never updated in place once queued; a cheaper route to a cell
+    // queues a new node and the stale one is skipped when popped.
+    std::vector<std::unique_ptr<Node>> allNodes;
+    std::vector<double> bestCost(distances.widthInCells() * distances.heightInCells(), 1.0E16);
+    std::vector<bool> closed(bestCost.size(), false);
+    std::priority_queue<Node*, std::vector<Node*>, Compare_Node> openList;
+    auto cellIndex = [&distances](const cell_t& cell) { return cell.y * distances.widthInCells() + cell.x; };
+
+    std::unique_ptr<JumpPointSearch> jumpPoints;
+    if(params.useJumpPoints)
+    {
+        jumpPoints.reset(new JumpPointSearch(goalCell, distances, params));
+    }
+
     Node* startNode = new Node(startCell.x, startCell.y);
     Node* goalNode = new Node(goalCell.x, goalCell.y);
-    
+    allNodes.emplace_back(startNode);
+    allNodes.emplace_back(goalNode);
+
+    if(distances.isCellInGrid(startCell.x, startCell.y)
+        && is_traversable(goalCell.x, goalCell.y, distances, params))
+    {
+        startNode->g_cost = 0.0;
+        startNode->h_cost = h_cost(startNode, goalNode, distances);
+        bestCost[cellIndex(startCell)] = 0.0;
+        openList.push(startNode);
+    }
+
+    while(!openList.empty())
+    {
+        Node* node = openList.top();
+        openList.pop();
+
+        int index = cellIndex(node->cell);
+        if(closed[index])
+        {
+            continue;
+        }
+        closed[index] = true;
+        ++numExpanded;
+
+        if(node->cell == goalCell)
+        {
+            goalNode = node;
+            found_path = true;
+            break;
+        }
+
+        std::vector<Node*> children = jumpPoints ? jumpPoints->successors(node)
+                                                 : expand_node(node, distances, params);
+
+        for(auto&& child : children)
+        {
+            allNodes.emplace_back(child);
+
+            int childIndex = cellIndex(child->cell);
+            if(closed[childIndex])
+            {
+                continue;
+            }
+
+            double cost = g_cost(node, child, distances, params);
+            if(cost < bestCost[childIndex])
+            {
+                bestCost[childIndex] = cost;
+                child->g_cost = cost;
+                child->h_cost = h_cost(child, goalNode, distances);
+                child->parent = node;
+                openList.push(child);
+            }
+        }
+    }
 
     mbot_lcm_msgs::path2D_t path;
     path.utime = start.utime;
@@ -32,6 +350,14 @@ mbot_lcm_msgs::path2D_t search_for_path(mbot_lcm_msgs::pose2D_t start,
 
     else printf("[A*] Didn't find a path\n");
     path.path_length = path.path.size();
+
+    if(stats)
+    {
+        stats->expandedNodes = numExpanded;
+        stats->searchTimeUs = duration_cast<microseconds>(steady_clock::now() - searchStart).count();
+        stats->pathCost = found_path ? goalNode->g_cost : 0.0;
+    }
+
     return path;
 }
 
@@ -39,33 +365,55 @@ mbot_lcm_msgs::path2D_t search_for_path(mbot_lcm_msgs::pose2D_t start,
 
 double h_cost(Node* from, Node* goal, const ObstacleDistanceGrid& distances)
 {
-    double h_cost = 0.0;
-    ////////////////// TODO: Implement your heuristic //////////////////////////
-    
-    return h_cost;
+    // Octile distance is the exact length of the shortest 8-way path, so it never overestimates the cost
+    int dx = std::abs(goal->cell.x - from->cell.x);
+    int dy = std::abs(goal->cell.y - from->cell.y);
+    double h_cost = (dx + dy) + (M_SQRT2 - 2.0) * std::min(dx, dy);
+    return h_cost * distances.metersPerCell();
 }
 double g_cost(Node* from, Node* goal, const ObstacleDistanceGrid& distances, const SearchParams& params)
 {
-    double g_cost = 0.0;
-    ////////////////// TODO: Implement your goal cost, use obstacle distances //////////////////////////
-    
+    // The cost of reaching goal by the straight or diagonal line from the from node. With jump points, the line can
+    // span many cells, so sum the cost of each step.
+    int dx = sign(goal->cell.x - from->cell.x);
+    int dy = sign(goal->cell.y - from->cell.y);
+    bool diagonal = (dx != 0) && (dy != 0);
+
+    double g_cost = from->g_cost;
+    cell_t cell = from->cell;
+    while(cell != goal->cell)
+    {
+        cell.x += dx;
+        cell.y += dy;
+        g_cost += step_cost(cell.x, cell.y, diagonal, distances, params);
+    }
     return g_cost;
 }
 
 std::vector<Node*> expand_node(Node* node, const ObstacleDistanceGrid& distances, const SearchParams& params)
 {
     std::vector<Node*> children;
-    ////////////////// TODO: Implement your expand node algorithm //////////////////////////
-    
+    for(int n = 0; n < kNumNeighbors; ++n)
+    {
+        int x = node->cell.x + xDeltas[n];
+        int y = node->cell.y + yDeltas[n];
+        if(is_traversable(x, y, distances, params))
+        {
+            children.push_back(new Node(x, y));
+        }
+    }
     return children;
 }
 
 std::vector<Node*> extract_node_path(Node* goal_node, Node* start_node)
 {
     std::vector<Node*> path;
-    ////////////////// TODO: Implement your extract node function //////////////////////////
     // Traverse nodes and add parent nodes to the vector
-    
+    for(Node* node = goal_node; node; node = node->parent)
+    {
+        path.push_back(node);
+    }
+
     // Reverse path
     std::reverse(path.begin(), path.end());
     return path;
@@ -74,11 +422,30 @@ std::vector<Node*> extract_node_path(Node* goal_node, Node* start_node)
 std::vector<mbot_lcm_msgs::pose2D_t> extract_pose_path(std::vector<Node*> nodes, const ObstacleDistanceGrid& distances)
 {
     std::vector<mbot_lcm_msgs::pose2D_t> path;
-    ////////////////// TODO: Implement your extract_pose_path function //////////////////////////
-    // This should turn the node path into a vector of poses (with heading) in the global frame
-    // You should prune the path to get a waypoint path suitable for sending to motion controller
-    
-    
+    // Only the endpoints of straight segments are needed by the waypoint follower
+    std::vector<Node*> waypoints = prune_node_path(nodes);
+
+    for(auto&& node : waypoints)
+    {
+        // Drive to the center of each cell
+        Point<double> position = grid_position_to_global_position(Point<double>(node->cell.x + 0.5,
+                                                                                node->cell.y + 0.5),
+                                                                  distances);
+        mbot_lcm_msgs::pose2D_t pose;
+        pose.utime = 0;
+        pose.x = position.x;
+        pose.y = position.y;
+        pose.theta = 0.0;
+        path.push_back(pose);
+    }
+
+    // Each pose faces the next pose in the path, and the final pose keeps the last heading
+    for(std::size_t n = 1; n < path.size(); ++n)
+    {
+        path[n-1].theta = std::atan2(path[n].y - path[n-1].y, path[n].x - path[n-1].x);
+        path[n].theta = path[n-1].theta;
+    }
+
     return path;
 }
 
@@ -104,9 +471,26 @@ Node* get_from_list(Node* node, std::vector<Node*> list)
 std::vector<Node*> prune_node_path(std::vector<Node*> nodePath)
 {
     std::vector<Node*> new_node_path;
-    ////////////////// TODO: Optionally implement a prune_node_path function //////////////////////////
     // This should remove points in the path along the same line
-    
+    for(std::size_t n = 0; n < nodePath.size(); ++n)
+    {
+        if(n == 0 || n + 1 == nodePath.size())
+        {
+            new_node_path.push_back(nodePath[n]);
+            continue;
+        }
+
+        int dxIn = sign(nodePath[n]->cell.x - nodePath[n-1]->cell.x);
+        int dyIn = sign(nodePath[n]->cell.y - nodePath[n-1]->cell.y);
+        int dxOut = sign(nodePath[n+1]->cell.x - nodePath[n]->cell.x);
+        int dyOut = sign(nodePath[n+1]->cell.y - nodePath[n]->cell.y);
+
+        if((dxIn != dxOut) || (dyIn != dyOut))
+        {
+            new_node_path.push_back(nodePath[n]);
+        }
+    }
+
     return new_node_path;
 
 }
@@ -1,5 +1,6 @@
 #include <utils/grid_utils.hpp>
 #include <utils/timestamp.h>
+#include <planning/hierarchical_planner.hpp>
 #include <planning/motion_planner.hpp>
 #include <slam/occupancy_grid.hpp>
 #include <lcm/lcm-cpp.hpp>
@@ -18,9 +19,11 @@
 #include <cassert>
 #include <cmath>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <map>
+#include <set>
 
 using namespace mbot_lcm_msgs;
 
@@ -35,6 +38,11 @@ bool animatePath;
 int repeatTimes;            // Global Variable that sets number of repeat times, obtained from
 int pauseTime;           // Time to wait between executions of different cases
 int selected_test;
+bool compareJps;            // Also run each search with Jump Point Search and report the difference
+bool compareHpa;            // Also run each search with HPA* and check it against plain A*
+
+// HPA* only searches the clusters its abstract path crosses, so its paths can cost a little more than A* paths
+const double kMaxHpaCostRatio = 1.6;
 
 // Setup Lcm
 lcm::LCM lcmConnection(MULTICAST_URL);
@@ -45,6 +53,12 @@ lcm::LCM lcmConnection(MULTICAST_URL);
 typedef std::map<std::string, std::vector<int64_t>> timing_info_t;
 timing_info_t gSuccess;     // Time to successfully find paths  HACK -- don't put global variables in your own code!
 timing_info_t gFail;        // Time to find failures  HACK -- don't put global variables in your own code!
+timing_info_t gAStarExpanded;   // Nodes expanded by plain A* when comparing against Jump Point Search
+timing_info_t gJpsExpanded;     // Nodes expanded by Jump Point Search
+timing_info_t gAStarTime;       // Search time of plain A* when comparing against Jump Point Search
+timing_info_t gJpsTime;         // Search time of Jump Point Search
+timing_info_t gHpaAStarTime;    // Search time of plain A* when comparing against HPA*
+timing_info_t gHpaTime;         // Search time of HPA*
 
 
 bool test_empty_grid(void);
@@ -60,12 +74,36 @@ path2D_t timed_find_path(const pose2D_t& start,
                              const MotionPlanner& planner,
                              const std::string& testName);
 
+void compare_search_modes(const pose2D_t& start,
+                          const pose2D_t& end,
+                          const ObstacleDistanceGrid& distances,
+                          SearchParams params,
+                          const std::string& testName);
+
+bool compare_hierarchical_search(const pose2D_t& start,
+                                 const pose2D_t& end,
+                                 const HierarchicalPlanner& hierarchy,
+                                 const ObstacleDistanceGrid& distances,
+                                 SearchParams params,
+                                 double robotRadius,
+                                 const OccupancyGrid& map,
+                                 const std::string& testName);
+
+bool test_hierarchy_update(const OccupancyGrid& map,
+                           const std::vector<std::pair<pose2D_t, pose2D_t>>& queries,
+                           const MotionPlannerParams& plannerParams,
+                           const SearchParams& searchParams);
+
 bool is_valid_path(const path2D_t& path, double robotRadius, const OccupancyGrid& map);
 bool is_safe_cell(int x, int y, double robotRadius, const OccupancyGrid& map);
 
 std::ostream& operator<<(std::ostream& out, const pose2D_t& pose);
 
 void print_timing_info(timing_info_t& info);
+void print_comparison_info(timing_info_t& astar,
+                           timing_info_t& other,
+                           const std::string& otherName,
+                           const std::string& units);
 
 
 int main(int argc, char** argv)
@@ -76,6 +114,8 @@ int main(int argc, char** argv)
     const char* pauseTimeArg = "pause-time";
     const char* animatePathArg = "animate-path";
     const char* testSelectArg = "test-num";
+    const char* compareJpsArg = "compare-jps";
+    const char* compareHpaArg = "compare-hpa";
 
     // Handle Options
     getopt_t *gopt = getopt_create();
@@ -92,6 +132,11 @@ int main(int argc, char** argv)
                     " When set to 6 (default) all tests are run, otherwise the one corresponding test is run: "
                     "test_empty_grid, test_filled_grid, test_narrow_constriction_grid, "
                     "test_wide_constriction_grid, test_convex_grid, test_maze_grid");
+    getopt_add_bool(gopt, '\0', compareJpsArg, 0, "If this flag is set, every search is also run with plain A* and "
+                    "with Jump Point Search, and the expanded nodes and search times of the two are reported.");
+    getopt_add_bool(gopt, '\0', compareHpaArg, 0, "If this flag is set, every search is also run with HPA*, which must "
+                    "find a valid path whenever A* does. Each map is then edited near a path, and the hierarchy must "
+                    "rebuild only the changed clusters and their neighbors and plan the same paths as a full rebuild.");
 
     // PRINT HELP IF FAILED TO PARSE STRING, OR IF SENT --help ARGUMENT
     if (!getopt_parse(gopt, argc, argv, 1)  || getopt_get_bool(gopt, "help")) {
@@ -112,6 +157,8 @@ int main(int argc, char** argv)
     repeatTimes = getopt_get_int(gopt, numRepeatsArg);
     pauseTime = getopt_get_int(gopt, pauseTimeArg);
     selected_test = getopt_get_int(gopt, testSelectArg);
+    compareJps = getopt_get_bool(gopt, compareJpsArg);
+    compareHpa = getopt_get_bool(gopt, compareHpaArg);
 
     printf("\n%s",std::string(70,'=').c_str());
     printf("\nTesting your A* with the following settings :\n");
@@ -120,6 +167,8 @@ int main(int argc, char** argv)
     printf("Number of repeats : %d\n", repeatTimes);
     printf("Pause time in [s] : %d\n", pauseTime);
     printf("Working on test case : %d\n", selected_test);
+    printf("Comparing A* with Jump Point Search : %s\n", compareJps ? "true" : "false");
+    printf("Comparing A* with HPA* : %s\n", compareHpa ? "true" : "false");
     printf("Call the binary with --help argument passed for options\n");
     printf("%s\n",std::string(70,'=').c_str());
     // printf("="*20);
@@ -159,6 +208,21 @@ int main(int argc, char** argv)
     std::cout << "\nTiming information for failed planning attempts:\n";
     print_timing_info(gFail);
 
+    if(compareJps)
+    {
+        std::cout << "\nExpanded nodes, plain A* vs. Jump Point Search:\n";
+        print_comparison_info(gAStarExpanded, gJpsExpanded, "JPS", "nodes");
+
+        std::cout << "\nSearch time, plain A* vs. Jump Point Search:\n";
+        print_comparison_info(gAStarTime, gJpsTime, "JPS", "us");
+    }
+
+    if(compareHpa)
+    {
+        std::cout << "\nSearch time, plain A* vs. HPA*:\n";
+        print_comparison_info(gHpaAStarTime, gHpaTime, "HPA*", "us");
+    }
+
     if(numPassed != selected_func_vec.size())
     {
         std::cout << "\n\nINCOMPLETE: Passed " << numPassed << " of " << selected_func_vec.size()
@@ -246,6 +310,19 @@ bool test_saved_poses(const std::string& mapFile, const std::string& posesFile,
     MotionPlanner planner(plannerParams);
     planner.setMap(grid);
 
+    ObstacleDistanceGrid distances;
+    if(compareJps || compareHpa)
+    {
+        distances = planner.obstacleDistances();
+    }
+
+    HierarchicalPlanner hierarchy(plannerParams.clusterSizeInCells);
+    if(compareHpa)
+    {
+        hierarchy.setDistances(distances, planner.searchParams());
+    }
+    std::vector<std::pair<pose2D_t, pose2D_t>> queries;
+
     int numCorrect = 0;
 
     for(int n = 0; n < numGoals; ++n)
@@ -253,6 +330,17 @@ bool test_saved_poses(const std::string& mapFile, const std::string& posesFile,
         poseIn >> start.x >> start.y >> goal.x >> goal.y >> shouldExist;
 
         path2D_t path = timed_find_path(start, goal, planner, testName);
+        if(compareJps)
+        {
+            compare_search_modes(start, goal, distances, planner.searchParams(), testName);
+        }
+        bool hpaAgrees = true;
+        if(compareHpa)
+        {
+            hpaAgrees = compare_hierarchical_search(start, goal, hierarchy, distances, planner.searchParams(),
+                                                    plannerParams.robotRadius, grid, testName);
+            queries.emplace_back(start, goal);
+        }
         if(!animatePath && useGui) lcmConnection.publish(PATH_CHANNEL, &path); // Immediately print out path if no animation flag is sent in
         // See if the generated path was valid
         bool foundPath = path.path_length > 1;
@@ -269,7 +357,7 @@ bool test_saved_poses(const std::string& mapFile, const std::string& posesFile,
             if(shouldExist && is_valid_path(path, plannerParams.robotRadius, grid))
             {
                 std::cout << "Correctly found path between start and goal: " << start << " -> " << goal << "\n";
-                ++numCorrect;
+                numCorrect += hpaAgrees;
             }
             else if(!shouldExist && is_valid_path(path, plannerParams.robotRadius, grid))
             {
@@ -294,7 +382,7 @@ bool test_saved_poses(const std::string& mapFile, const std::string& posesFile,
             else
             {
                 std::cout << "Correctly found no path between start and goal: " << start << " -> " << goal << "\n";
-                ++numCorrect;
+                numCorrect += hpaAgrees;
             }
             if(useGui) lcmConnection.publish(PATH_CHANNEL, &path);
         }
@@ -304,7 +392,13 @@ bool test_saved_poses(const std::string& mapFile, const std::string& posesFile,
         std::this_thread::sleep_for(sleep_duration);
     }
 
-    if(numCorrect == numGoals)
+    bool updateCorrect = true;
+    if(compareHpa)
+    {
+        updateCorrect = test_hierarchy_update(grid, queries, plannerParams, planner.searchParams());
+    }
+
+    if((numCorrect == numGoals) && updateCorrect)
     {
         std::cout << "PASSED! " << testName << '\n';
     }
@@ -313,7 +407,7 @@ bool test_saved_poses(const std::string& mapFile, const std::string& posesFile,
         std::cout << "FAILED! " << testName << '\n';
     }
 
-    return numCorrect == numGoals;
+    return (numCorrect == numGoals) && updateCorrect;
 }
 
 
@@ -346,6 +440,176 @@ path2D_t timed_find_path(const pose2D_t& start,
 }
 
 
+void compare_search_modes(const pose2D_t& start,
+                          const pose2D_t& end,
+                          const ObstacleDistanceGrid& distances,
+                          SearchParams params,
+                          const std::string& testName)
+{
+    for(int n = 0; n < repeatTimes; ++n)
+    {
+        SearchStats stats;
+
+        params.useJumpPoints = false;
+        search_for_path(start, end, distances, params, &stats);
+        gAStarExpanded[testName].push_back(stats.expandedNodes);
+        gAStarTime[testName].push_back(stats.searchTimeUs);
+
+        params.useJumpPoints = true;
+        search_for_path(start, end, distances, params, &stats);
+        gJpsExpanded[testName].push_back(stats.expandedNodes);
+        gJpsTime[testName].push_back(stats.searchTimeUs);
+    }
+}
+
+
+bool compare_hierarchical_search(const pose2D_t& start,
+                                 const pose2D_t& end,
+                                 const HierarchicalPlanner& hierarchy,
+                                 const ObstacleDistanceGrid& distances,
+                                 SearchParams params,
+                                 double robotRadius,
+                                 const OccupancyGrid& map,
+                                 const std::string& testName)
+{
+    params.useJumpPoints = false;
+    SearchStats astarStats;
+    path2D_t astarPath = search_for_path(start, end, distances, params, &astarStats);
+    SearchStats hpaStats;
+    path2D_t hpaPath = hierarchy.planPath(start, end, &hpaStats);
+    gHpaAStarTime[testName].push_back(astarStats.searchTimeUs);
+    gHpaTime[testName].push_back(hpaStats.searchTimeUs);
+
+    bool astarFound = astarPath.path_length > 1;
+    bool hpaFound = hpaPath.path_length > 1;
+    if(astarFound != hpaFound)
+    {
+        std::cout << "HPA* " << (hpaFound ? "found" : "didn't find") << " a path between start and goal, but A* "
+            << (astarFound ? "did" : "didn't") << ": " << start << " -> " << end << "\n";
+        return false;
+    }
+
+    if(!hpaFound)
+    {
+        return true;
+    }
+
+    if(!is_valid_path(hpaPath, robotRadius, map))
+    {
+        std::cout << "HPA* found unsafe path between start and goal: " << start << " -> " << end << "\n";
+        return false;
+    }
+
+    // A* is optimal, so HPA* can't beat it, and it shouldn't lose by much either
+    if((hpaStats.pathCost < astarStats.pathCost * (1.0 - 1e-6))
+        || (hpaStats.pathCost > astarStats.pathCost * kMaxHpaCostRatio))
+    {
+        std::cout << "HPA* path between start and goal costs " << hpaStats.pathCost << ", but the A* path costs "
+            << astarStats.pathCost << ": " << start << " -> " << end << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+
+bool test_hierarchy_update(const OccupancyGrid& map,
+                           const std::vector<std::pair<pose2D_t, pose2D_t>>& queries,
+                           const MotionPlannerParams& plannerParams,
+                           const SearchParams& searchParams)
+{
+    ObstacleDistanceGrid distances;
+    distances.setDistances(map);
+    HierarchicalPlanner updated(plannerParams.clusterSizeInCells);
+    updated.setDistances(distances, searchParams);
+
+    // Drop a small obstacle in the middle of the first path found, so the edit changes some of the paths
+    OccupancyGrid editedMap = map;
+    cell_t center(map.widthInCells() / 2, map.heightInCells() / 2);
+    for(auto& query : queries)
+    {
+        path2D_t path = search_for_path(query.first, query.second, distances, searchParams);
+        if(path.path_length > 1)
+        {
+            const pose2D_t& middle = path.path[path.path.size() / 2];
+            center = global_position_to_grid_cell(Point<float>(middle.x, middle.y), map);
+            break;
+        }
+    }
+
+    const int kObstacleRadius = 2;
+    for(int y = center.y - kObstacleRadius; y <= center.y + kObstacleRadius; ++y)
+    {
+        for(int x = center.x - kObstacleRadius; x <= center.x + kObstacleRadius; ++x)
+        {
+            editedMap.setLogOdds(x, y, 127);
+        }
+    }
+
+    ObstacleDistanceGrid editedDistances;
+    editedDistances.setDistances(editedMap);
+
+    // Only the clusters with a cell whose cost changed, and the clusters sharing a border with them, should be rebuilt
+    const int clusterSize = updated.clusterSize();
+    const int clustersWide = (distances.widthInCells() + clusterSize - 1) / clusterSize;
+    const int clustersHigh = (distances.heightInCells() + clusterSize - 1) / clusterSize;
+    std::set<std::pair<int, int>> expectedClusters;
+    for(int y = 0; y < distances.heightInCells(); ++y)
+    {
+        for(int x = 0; x < distances.widthInCells(); ++x)
+        {
+            if(std::min<double>(distances(x, y), searchParams.maxDistanceWithCost)
+                == std::min<double>(editedDistances(x, y), searchParams.maxDistanceWithCost))
+            {
+                continue;
+            }
+
+            int cx = x / clusterSize;
+            int cy = y / clusterSize;
+            expectedClusters.emplace(cx, cy);
+            if(cx > 0) expectedClusters.emplace(cx - 1, cy);
+            if(cx + 1 < clustersWide) expectedClusters.emplace(cx + 1, cy);
+            if(cy > 0) expectedClusters.emplace(cx, cy - 1);
+            if(cy + 1 < clustersHigh) expectedClusters.emplace(cx, cy + 1);
+        }
+    }
+
+    int numRebuilt = updated.setDistances(editedDistances, searchParams);
+    bool isCorrect = numRebuilt == static_cast<int>(expectedClusters.size());
+    std::cout << "Editing the map at (" << center.x << ',' << center.y << ") rebuilt " << numRebuilt << " of "
+        << updated.numClusters() << " clusters. Expected " << expectedClusters.size() << ".\n";
+
+    // The updated hierarchy must plan the same paths as one built from scratch on the edited map
+    HierarchicalPlanner rebuilt(plannerParams.clusterSizeInCells);
+    rebuilt.setDistances(editedDistances, searchParams);
+    if(rebuilt.numAbstractNodes() != updated.numAbstractNodes())
+    {
+        std::cout << "Updated hierarchy has " << updated.numAbstractNodes() << " entrances, but a full rebuild has "
+            << rebuilt.numAbstractNodes() << ".\n";
+        isCorrect = false;
+    }
+
+    for(auto& query : queries)
+    {
+        SearchStats updatedStats;
+        SearchStats rebuiltStats;
+        path2D_t updatedPath = updated.planPath(query.first, query.second, &updatedStats);
+        path2D_t rebuiltPath = rebuilt.planPath(query.first, query.second, &rebuiltStats);
+
+        if((updatedPath.path_length != rebuiltPath.path_length)
+            || (std::abs(updatedStats.pathCost - rebuiltStats.pathCost) > 1e-6 * std::max(rebuiltStats.pathCost, 1.0)))
+        {
+            std::cout << "Updated hierarchy found a path costing " << updatedStats.pathCost << ", but a full rebuild "
+                << "found one costing " << rebuiltStats.pathCost << ": " << query.first << " -> " << query.second
+                << "\n";
+            isCorrect = false;
+        }
+    }
+
+    return isCorrect;
+}
+
+
 bool is_valid_path(const path2D_t& path, double robotRadius, const OccupancyGrid& map)
 {
     // If there's only a single entry, then it isn't a valid path
@@ -438,3 +702,30 @@ void print_timing_info(timing_info_t& info)
             << "\tStd dev: " << std::sqrt(variance(acc)) << '\n';
     }
 }
+
+
+void print_comparison_info(timing_info_t& astar,
+                           timing_info_t& other,
+                           const std::string& otherName,
+                           const std::string& units)
+{
+    using namespace boost::accumulators;
+    typedef accumulator_set<double, stats<tag::mean, tag::max>> ComparisonAcc;
+
+    for(auto& values : astar)
+    {
+        ComparisonAcc astarAcc;
+        ComparisonAcc otherAcc;
+        std::for_each(values.second.begin(), values.second.end(), std::ref(astarAcc));
+        std::for_each(other[values.first].begin(), other[values.first].end(), std::ref(otherAcc));
+
+        std::cout << values.first << " :: (" << units << ")\n"
+            << "\tA*   Mean: " << mean(astarAcc) << "\tMax: " << max(astarAcc) << '\n'
+            << '\t' << std::left << std::setw(5) << otherName << std::right
+            << "Mean: " << mean(otherAcc) << "\tMax: " << max(otherAcc) << '\n';
+        if(mean(otherAcc) > 0.0)
+        {
+            std::cout << "\tRatio:     " << mean(astarAcc) / mean(otherAcc) << "x\n";
+        }
+    }
+}
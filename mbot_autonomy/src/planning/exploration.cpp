@@ -4,15 +4,19 @@
 #include <utils/grid_utils.hpp>
 #include <utils/timestamp.h>
 #include <mbot/mbot_channels.h>
+#include <mbot_lcm_msgs/path_invalidation_t.hpp>
 #include <slam/slam_channels.h>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <queue>
+#include <thread>
 #include <unistd.h>
 #include <cassert>
 
 
 const float kReachedPositionThreshold = 0.05f;  // must get within this distance of a position for it to be explored
+const useconds_t kIdleSleepUs = 2000;           // how long a stage waits before checking for new data again
 
 // Define an equality operator for poses to allow direct comparison of two paths
 bool are_equal(const mbot_lcm_msgs::pose2D_t& lhs, const mbot_lcm_msgs::pose2D_t& rhs)
@@ -33,11 +37,13 @@ bool are_equal(const pose_vec_t& lhs, const pose_vec_t& rhs)
 
 Exploration::Exploration(lcm::LCM* lcmInstance)
 : state_(mbot_lcm_msgs::exploration_status_t::STATE_INITIALIZING)
-, haveNewPose_(false)
-, haveNewMap_(false)
+, pathInvalidated_(false)
+, havePose_(false)
 , haveHomePose_(false)
+, isExploring_(false)
 , lcmInstance_(lcmInstance)
 , pathReceived_(false)
+, most_recent_path_time(0)
 {
     assert(lcmInstance_);   // confirm a nullptr wasn't passed in
 
@@ -54,9 +60,7 @@ Exploration::Exploration(lcm::LCM* lcmInstance)
 
     lcmInstance_->publish(EXPLORATION_STATUS_CHANNEL, &status);
 
-    MotionPlannerParams params;
-    params.robotRadius = 0.2;
-    planner_.setParams(params);
+    plannerParams_.robotRadius = 0.2;
 
     // To prevent the exploration finishing on the start
     initialized_ = false;
@@ -65,86 +69,169 @@ Exploration::Exploration(lcm::LCM* lcmInstance)
 
 bool Exploration::exploreEnvironment()
 {
+    isExploring_ = true;
+    std::thread mapThread(&Exploration::runMapStage, this);
+    std::thread frontierThread(&Exploration::runFrontierStage, this);
+
     while((state_ != mbot_lcm_msgs::exploration_status_t::STATE_COMPLETED_EXPLORATION)
         && (state_ != mbot_lcm_msgs::exploration_status_t::STATE_FAILED_EXPLORATION))
     {
-        // If data is ready, then run an update of the exploration routine
-        if(isReadyToUpdate())
+        // If new frontiers are ready, then run an update of the exploration routine
+        if(copyDataForUpdate())
         {
-            runExploration();
+            // Only the cells along the path ahead of the robot are checked, so this is cheap enough to do for every map
+            checkPathSafety();
+            executeStateMachine();
         }
         // Otherwise wait a bit for data to arrive
         else
         {
-            usleep(10000);
+            usleep(kIdleSleepUs);
         }
     }
 
+    isExploring_ = false;
+    mapThread.join();
+    frontierThread.join();
+
     // If the state is completed, then we didn't fail
     return state_ == mbot_lcm_msgs::exploration_status_t::STATE_COMPLETED_EXPLORATION;
 }
 
 void Exploration::handleMap(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::occupancy_grid_t* map)
 {
-
-    std::lock_guard<std::mutex> autoLock(dataLock_);
-    incomingMap_.fromLCM(*map);
-    haveNewMap_ = true;
+    std::shared_ptr<OccupancyGrid> incoming = std::make_shared<OccupancyGrid>();
+    incoming->fromLCM(*map);
+    incomingMap_.write(incoming);
 }
 
 
 void Exploration::handlePose(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::pose2D_t* pose)
 {
-
-    std::lock_guard<std::mutex> autoLock(dataLock_);
-    incomingPose_ = *pose;
-    haveNewPose_ = true;
+    incomingFrontierPose_.write(*pose);
+    incomingPose_.write(*pose);
 }
 
 void Exploration::handleConfirmation(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::mbot_message_received_t* confirm)
 {
-    std::lock_guard<std::mutex> autoLock(dataLock_);
     if(confirm->channel == CONTROLLER_PATH_CHANNEL && confirm->creation_time == most_recent_path_time) pathReceived_ = true;
 }
 
-bool Exploration::isReadyToUpdate(void)
+
+void Exploration::runMapStage(void)
 {
-    std::lock_guard<std::mutex> autoLock(dataLock_);
-    return haveNewMap_ && haveNewPose_;
+    std::shared_ptr<const OccupancyGrid> map;
+    while(isExploring_)
+    {
+        if(!incomingMap_.read(map))
+        {
+            usleep(kIdleSleepUs);
+            continue;
+        }
+
+        // Reuse a planner that no other stage holds anymore, so its memory and hierarchy are only updated, not
+        // rebuilt. Only the map stage holds the pool, so a planner it alone holds can't be picked up by anyone else.
+        std::shared_ptr<MotionPlanner> planner;
+        for(auto& pooled : plannerPool_)
+        {
+            if(pooled.use_count() == 1)
+            {
+                // use_count() is a relaxed load. The fence orders it after the other stages' last reads of the
+                // planner, which happened before they released their copies.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                planner = pooled;
+                break;
+            }
+        }
+        if(!planner)
+        {
+            planner = std::make_shared<MotionPlanner>(plannerParams_);
+            plannerPool_.push_back(planner);
+        }
+
+        planner->setMap(*map);
+
+        std::shared_ptr<ExplorationMap> cspace = std::make_shared<ExplorationMap>();
+        cspace->map = map;
+        cspace->planner = planner;
+        newCSpace_.write(cspace);
+    }
 }
 
 
-void Exploration::runExploration(void)
+void Exploration::runFrontierStage(void)
 {
-    assert(isReadyToUpdate());
-    copyDataForUpdate();
-    executeStateMachine();
+    std::shared_ptr<const ExplorationMap> cspace;
+    mbot_lcm_msgs::pose2D_t robotPose;
+    bool haveNewCSpace = false;
+    bool havePose = false;
+
+    while(isExploring_)
+    {
+        haveNewCSpace |= newCSpace_.read(cspace);
+        havePose |= incomingFrontierPose_.read(robotPose);
+
+        // The frontiers only change with the map, but the reachable ones depend on where the robot is
+        if(!haveNewCSpace || !havePose)
+        {
+            usleep(kIdleSleepUs);
+            continue;
+        }
+
+        std::shared_ptr<ExplorationFrontiers> frontiers = std::make_shared<ExplorationFrontiers>();
+        frontiers->cspace = cspace;
+        frontiers->frontiers = frontierDetector_.update(*cspace->map, robotPose);
+        newFrontiers_.write(frontiers);
+        haveNewCSpace = false;
+    }
 }
 
 
-void Exploration::copyDataForUpdate(void)
+bool Exploration::copyDataForUpdate(void)
 {
-    std::lock_guard<std::mutex> autoLock(dataLock_);
+    // Always take the newest pose because it is a cheap copy
+    havePose_ |= incomingPose_.read(currentPose_);
 
-    // Only copy the map if a new one has arrived because it is a costly operation
-    if(haveNewMap_)
+    // The state machine runs once for each new set of frontiers, so it always sees a map newer than the last one
+    std::shared_ptr<const ExplorationFrontiers> newFrontiers;
+    if(!havePose_ || !newFrontiers_.read(newFrontiers))
     {
-        currentMap_ = incomingMap_;
-        haveNewMap_ = false;
-        // Update planner
-        planner_.setMap(currentMap_);
+        return false;
     }
 
-    // Always copy the pose because it is a cheap copy
-    currentPose_ = incomingPose_;
-    haveNewPose_ = false;
+    currentMap_ = newFrontiers->cspace->map;
+    planner_ = newFrontiers->cspace->planner;
+    frontiers_ = newFrontiers->frontiers;
 
     // The first pose received is considered to be the home pose
     if(!haveHomePose_)
     {
-        homePose_ = incomingPose_;
+        homePose_ = currentPose_;
         haveHomePose_ = true;
     }
+
+    return true;
+}
+
+
+void Exploration::checkPathSafety(void)
+{
+    int unsafeSegment = pathMonitor_.update(planner_->obstacleDistances(), currentPose_);
+    if(unsafeSegment < 0)
+    {
+        return;
+    }
+
+    mbot_lcm_msgs::path_invalidation_t invalidation;
+    invalidation.utime = utime_now();
+    invalidation.path_utime = pathMonitor_.path().utime;
+    invalidation.first_unsafe_segment = unsafeSegment;
+    invalidation.num_changed_cells = pathMonitor_.numChangedCells();
+    lcmInstance_->publish(PATH_INVALIDATION_CHANNEL, &invalidation);
+
+    // Only report each path once. The monitor starts again when a new path is sent.
+    pathMonitor_.clearPath();
+    pathInvalidated_ = true;
 }
 
 
@@ -202,6 +289,9 @@ void Exploration::executeStateMachine(void)
 
         pathReceived_ = false;
         most_recent_path_time = currentPath_.utime;
+
+        pathMonitor_.setPath(currentPath_, planner_->obstacleDistances());
+        pathInvalidated_ = false;
     }
 
 }
@@ -231,12 +321,16 @@ int8_t Exploration::executeExploringMap(bool initialize)
     *       (1) frontiers_.empty() == true      : all frontiers have been explored as determined by find_map_frontiers()
     *       (2) currentPath_.path_length > 1 : currently following a path to the next frontier
     *
-    *   - Use the provided function find_map_frontiers() to find all frontiers in the map.
+    *   - frontiers_ already holds all frontiers in currentMap_. The frontier stage finds them with frontierDetector_,
+    *       which only re-examines the parts of the map that changed since the last update, and finds the same
+    *       frontiers as find_map_frontiers(). Use *currentMap_ and *planner_ when selecting and planning.
     *   - You will need to implement logic to select which frontier to explore.
     *   - You will need to implement logic to decide when to select a new frontier to explore. Take into consideration:
     *       -- The map is evolving as you drive, so what previously looked like a safe path might not be once you have
     *           explored more of the map.
     *       -- You will likely be able to see the frontier before actually reaching the end of the path leading to it.
+    *   - pathInvalidated_ is set when a new map blocks currentPath_. Plan a new path right away when it's set, rather
+    *       than waiting for the robot to reach the obstacle.
     */
 
     /// TODO: Implement logic for finding and selecting 
@@ -286,6 +380,7 @@ int8_t Exploration::executeReturningHome(bool initialize)
     *   - At the end of each iteration, then (1) or (2) must hold, otherwise exploration is considered to have failed:
     *       (1) dist(currentPose_, targetPose_) < kReachedPositionThreshold  :  reached the home pose
     *       (2) currentPath_.path_length > 1  :  currently following a path to the home pose
+    *   - If pathInvalidated_ is set, a new map blocked currentPath_, so a new path home is needed.
     */
 
     
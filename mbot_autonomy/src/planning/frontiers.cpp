@@ -1,16 +1,20 @@
 #include <planning/frontiers.hpp>
 #include <planning/motion_planner.hpp>
+#include <planning/astar.hpp>
 #include <utils/grid_utils.hpp>
 #include <utils/timestamp.h>
 #include <slam/occupancy_grid.hpp>
 #include <mbot_lcm_msgs/path2D_t.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
 #include <queue>
-#include <set>
+#include <thread>
 #include <cassert>
 
 
 bool is_frontier_cell(int x, int y, const OccupancyGrid& map);
-frontier_t grow_frontier(Point<int> cell, const OccupancyGrid& map, std::set<Point<int>>& visitedFrontiers);
 mbot_lcm_msgs::path2D_t path_to_frontier(const frontier_t& frontier,
                                               const mbot_lcm_msgs::pose2D_t& pose,
                                               const OccupancyGrid& map,
@@ -29,205 +33,316 @@ std::vector<frontier_t> find_map_frontiers(const OccupancyGrid& map,
                                            const mbot_lcm_msgs::pose2D_t& robotPose,
                                            double minFrontierLength)
 {
-    /*
-    * To find frontiers, we use a connected components search in the occupancy grid. Each connected components consists
-    * only of cells where is_frontier_cell returns true. We scan the grid until an unvisited frontier cell is
-    * encountered, then we grow that frontier until all connected cells are found. We then continue scanning through the
-    * grid. This algorithm can also perform very fast blob detection if you change is_frontier_cell to some other check
-    * based on pixel color or another condition amongst pixels.
-    */
-    std::vector<frontier_t> frontiers;
-    std::set<Point<int>> visitedCells;
+    // A new detector has no previous map, so it searches the whole map
+    FrontierDetector detector(minFrontierLength);
+    return detector.update(map, robotPose);
+}
 
-    Point<int> robotCell = global_position_to_grid_cell(Point<float>(robotPose.x, robotPose.y), map);
-    std::queue<Point<int>> cellQueue;
-    cellQueue.push(robotCell);
-    visitedCells.insert(robotCell);
 
-    // Use a 4-way connected check for expanding through free space.
-    const int kNumNeighbors = 4;
-    const int xDeltas[] = { -1, 1, 0, 0 };
-    const int yDeltas[] = { 0, 0, 1, -1 };
+namespace
+{
+
+// Frontier cells are unknown, so the robot drives to a nearby cell in its configuration space instead. Goal cells are
+// searched for up to this many cells away from the frontier.
+const int kMaxGoalDistanceCells = 40;
 
-    // Do a simple BFS to find all connected free space cells and thus avoid unreachable frontiers
+// Path cost the robot will accept in exchange for one more square meter of unknown space in view of the goal
+const double kInfoGainWeight = 0.5;
+
+// Each thread scoring goal cells gets at least this many. Threads are started on every call, so a thread is only worth
+// starting for a few milliseconds of ray casting. Small frontier sets, the usual case, are scored on the calling thread.
+const int kMinGoalsPerThread = 32;
+
+// The first four neighbors share an edge with the cell, the last four only a corner
+const int kNumNeighbors = 8;
+const int kNumEdgeNeighbors = 4;
+const int xDeltas[kNumNeighbors] = {1, -1, 0, 0, 1, -1, 1, -1};
+const int yDeltas[kNumNeighbors] = {0, 0, 1, -1, 1, -1, -1, 1};
+
+// Radius of the window searched when checking if free space is still connected around a cell that's no longer free
+const int kLocalConnectivityRadius = 3;
+
+// The best place found to observe a frontier from. The goal is the reachable cell closest to the frontier, with ties
+// going to the cheapest path.
+struct frontier_goal_t
+{
+    int cellIndex = -1;         // Index of the goal cell, or -1 if no goal cell is reachable
+    int distance = kMaxGoalDistanceCells + 1;   // Distance in cells from the goal cell to the frontier
+    int minDistance = kMaxGoalDistanceCells + 1;// Distance of the closest goal cell, reachable or not
+    double cost = 1.0E16;       // Path cost to the goal cell
+};
+
+/*
+* label_goal_cells does a multi-source BFS outward from the cells of every frontier, through cells that aren't known to
+* be occupied. Each cell reached is labeled with the nearest frontier and its distance from it. Only cells where the
+* robot is allowed to stop keep their label; every other cell is -1. The distance to the closest goal cell of each
+* frontier is stored in its goal.
+*/
+int label_goal_cells(const std::vector<frontier_t>& frontiers,
+                     const OccupancyGrid& map,
+                     const MotionPlanner& planner,
+                     std::vector<int>& goalFrontier,
+                     std::vector<int>& goalDistance,
+                     std::vector<frontier_goal_t>& goals)
+{
+    const int width = map.widthInCells();
+    std::vector<int> label(goalFrontier.size(), -1);
+    std::queue<cell_t> cellQueue;
+
+    for(std::size_t f = 0; f < frontiers.size(); ++f)
+    {
+        for(auto&& position : frontiers[f].cells)
+        {
+            cell_t cell = global_position_to_grid_cell(Point<double>(position.x, position.y), map);
+            if(map.isCellInGrid(cell.x, cell.y) && label[cell.y * width + cell.x] < 0)
+            {
+                label[cell.y * width + cell.x] = f;
+                goalDistance[cell.y * width + cell.x] = 0;
+                cellQueue.push(cell);
+            }
+        }
+    }
+
+    int numGoalCells = 0;
     while(!cellQueue.empty())
     {
-        Point<int> nextCell = cellQueue.front();
+        cell_t cell = cellQueue.front();
         cellQueue.pop();
 
-        // Check each neighbor to see if it is also a frontier
-        for(int n = 0; n < kNumNeighbors; ++n)
+        int index = cell.y * width + cell.x;
+        if(planner.isValidGoal(cell))
         {
-            Point<int> neighbor(nextCell.x + xDeltas[n], nextCell.y + yDeltas[n]);
+            goalFrontier[index] = label[index];
+            goals[label[index]].minDistance = std::min(goals[label[index]].minDistance, goalDistance[index]);
+            ++numGoalCells;
+        }
 
-            // If the cell has been visited or isn't in the map, then skip it
-            if(visitedCells.find(neighbor) != visitedCells.end() || !map.isCellInGrid(neighbor.x, neighbor.y))
+        if(goalDistance[index] == kMaxGoalDistanceCells)
+        {
+            continue;
+        }
+
+        for(int n = 0; n < kNumNeighbors; ++n)
+        {
+            cell_t neighbor(cell.x + xDeltas[n], cell.y + yDeltas[n]);
+            if(!map.isCellInGrid(neighbor.x, neighbor.y) || map.logOdds(neighbor.x, neighbor.y) > 0)
             {
                 continue;
             }
-            // If it is a frontier cell, then grow that frontier
-            else if(is_frontier_cell(neighbor.x, neighbor.y, map))
-            {
-                frontier_t f = grow_frontier(neighbor, map, visitedCells);
 
-                // If the frontier is large enough, then add it to the collection of map frontiers
-                if(f.cells.size() * map.metersPerCell() >= minFrontierLength)
-                {
-                    frontiers.push_back(f);
-                }
-            }
-            // If it is a free space cell, then keep growing the frontiers
-            else if(map(neighbor.x, neighbor.y) < 0)
+            int neighborIndex = neighbor.y * width + neighbor.x;
+            if(label[neighborIndex] < 0)
             {
-                visitedCells.insert(neighbor);
+                label[neighborIndex] = label[index];
+                goalDistance[neighborIndex] = goalDistance[index] + 1;
                 cellQueue.push(neighbor);
             }
         }
     }
-    return frontiers;
+
+    return numGoalCells;
 }
 
-struct CompareCentroids
+/*
+* compute_information_gains finds the expected_information_gain of each goal cell. The goal cells are split between
+* threads, since every ray cast is independent and only reads the map.
+*/
+std::vector<double> compute_information_gains(const std::vector<Point<double>>& positions, const OccupancyGrid& map)
 {
-    CompareCentroids(mbot_lcm_msgs::pose2D_t robotPose) { this->robotPose = robotPose;}
-    inline bool operator() (const Point<double>& centr_1, const Point<double>& centr_2)
-    {
-        // Diff 1
-        float diff_1_x = robotPose.x - centr_1.x;
-        float diff_1_y = robotPose.y - centr_1.y;
-        float diff_1 = diff_1_x * diff_1_x + diff_1_y * diff_1_y;
-        // Diff 2
-        float diff_2_x = robotPose.x - centr_2.x;
-        float diff_2_y = robotPose.y - centr_2.y;
-        float diff_2 = diff_2_x * diff_2_x + diff_2_y * diff_2_y;
+    std::vector<double> gains(positions.size(), 0.0);
+    const int numPositions = positions.size();
+    const int maxThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    const int numThreads = std::max(std::min(maxThreads, numPositions / kMinGoalsPerThread), 1);
+
+    // Positions are interleaved between the threads, so nearby positions, which tend to cost the same, are spread out
+    auto computeGains = [&](int first) {
+        for(int n = first; n < numPositions; n += numThreads)
+        {
+            gains[n] = expected_information_gain(positions[n], map);
+        }
+    };
 
-        return (diff_1 < diff_2);
+    std::vector<std::thread> threads;
+    for(int t = 1; t < numThreads; ++t)
+    {
+        threads.emplace_back(computeGains, t);
     }
-    mbot_lcm_msgs::pose2D_t robotPose;
-};
+    computeGains(0);
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    return gains;
+}
+
+} // namespace
+
 
 frontier_processing_t plan_path_to_frontier(const std::vector<frontier_t>& frontiers,
                                             const mbot_lcm_msgs::pose2D_t& robotPose,
                                             const OccupancyGrid& map,
                                             const MotionPlanner& planner)
 {
-    ///////////// TODO: Implement your strategy to select the next frontier to explore here //////////////////
     /*
-    * NOTES:
-    *   - If there's multiple frontiers, you'll need to decide which to drive to.
-    *   - A frontier is a collection of cells, you'll need to decide which one to attempt to drive to.
-    *   - The cells along the frontier might not be in the configuration space of the robot, so you won't necessarily
-    *       be able to drive straight to a frontier cell, but will need to drive somewhere close.
+    * Rather than planning a separate path to each frontier, a single Dijkstra sweep outward from the robot finds the
+    * true path cost to every cell in the configuration space at once. The sweep uses the same costs as the A* search,
+    * so the path it returns is the one the planner would have found. The sweep ends as soon as every frontier has found
+    * its best goal cell.
+    *
+    * Each frontier is scored by the cost of reaching its goal cell, less a bonus for the information gain there -- how
+    * much unknown space the lidar would see from the goal cell. The frontier with the lowest score is chosen and the
+    * path to it is extracted from the sweep.
     */
 
-    // First, choose the frontier to go to
-    // Initial alg: find the nearest one
-
     // Returnable path
     mbot_lcm_msgs::path2D_t path;
     path.utime = utime_now();
     path.path_length = 1;
     path.path.push_back(robotPose);
 
-    int unreachable_frontiers = 0;
+    const ObstacleDistanceGrid& distances = planner.obstacleDistances();
+    const SearchParams& params = planner.searchParams();
+    const int width = distances.widthInCells();
+    const std::size_t numCells = distances.widthInCells() * distances.heightInCells();
 
-    // Get the centroids of every frontier, and sort them in ascending order by distance to the robot
-    frontier_t chosen_frontier;
-    std::vector<Point<double>> centroids;
-    for (auto &&frontier : frontiers)
+    cell_t robotCell = global_position_to_grid_cell(Point<double>(robotPose.x, robotPose.y), distances);
+    if(frontiers.empty()
+        || !distances.isCellInGrid(robotCell.x, robotCell.y)
+        || numCells != static_cast<std::size_t>(map.widthInCells() * map.heightInCells()))
     {
-        // Find the centroid of the frontier
-        auto centroid = find_frontier_centroid(frontier);
-        centroids.push_back(centroid);
+        return frontier_processing_t(path, frontiers.size());
     }
-    // Order the centroids by their distance to the robot
-    std::sort(centroids.begin(), centroids.end(), CompareCentroids(robotPose));
-    Point<double> goal;
-    bool found_valid_cell = false;
 
-    int max_counter_dist = 40;
-    // Number of directions to search from the centroid cell
-    int num_directions = 36;
-    // std::vector<std::pair<int,int>> directions = {{1,0},{-1,0},{0,1},{0,-1},{1,1},{-1,-1},{1,-1},{-1,1}};
-    std::vector<std::pair<float,float>> directions;
-    for (size_t i = 0; i < num_directions; i++)
+    std::vector<int> goalFrontier(numCells, -1);
+    std::vector<int> goalDistance(numCells, 0);
+    std::vector<frontier_goal_t> goals(frontiers.size());
+    int remainingGoalCells = label_goal_cells(frontiers, map, planner, goalFrontier, goalDistance, goals);
+
+    // A frontier is settled once it has a goal at its closest distance. The sweep reaches goal cells in order of path
+    // cost, so no later goal cell can be better.
+    std::size_t numSettledFrontiers = 0;
+    for(auto&& goal : goals)
     {
-        float curr_angle = 2.0 * M_PI / num_directions * i;
-        directions.push_back(std::pair<float,float>(std::cos(curr_angle), std::sin(curr_angle)));
+        if(goal.minDistance > kMaxGoalDistanceCells)
+        {
+            ++numSettledFrontiers;
+        }
     }
 
-    for (auto &&c : centroids)
-    {
-        // Find the closest cell that is a valid goal
-        // Do a breadth first search 4 way
-        Point<int> centr_cell = global_position_to_grid_cell(c, map);
-        // printf("centroid (%d,%d)\n", centr_cell.x, centr_cell.y);
+    std::vector<double> cost(numCells, 1.0E16);
+    std::vector<int> parent(numCells, -1);
+    std::vector<bool> closed(numCells, false);
+    typedef std::pair<double, int> queue_entry_t;
+    std::priority_queue<queue_entry_t, std::vector<queue_entry_t>, std::greater<queue_entry_t>> openList;
 
-        // This will mark how many cells from the initial one are we. We can stop searching if we get to a certain value
-        int counter_dist = 1;
-        // Step to accelerate the finding
-        int distance_step = 1;
+    int robotIndex = robotCell.y * width + robotCell.x;
+    cost[robotIndex] = 0.0;
+    openList.push(std::make_pair(0.0, robotIndex));
 
-        Point<int> goal_cell;
-        auto centr_directions = directions;
+    while(!openList.empty() && remainingGoalCells > 0 && numSettledFrontiers < frontiers.size())
+    {
+        double cellCost = openList.top().first;
+        int index = openList.top().second;
+        openList.pop();
 
-        while (!found_valid_cell && counter_dist <= max_counter_dist)
+        if(closed[index])
         {
-            for (auto &&dir : centr_directions)
-            {
-                // printf("dir: (%d,%d)\n", dir.first, dir.second);
-                // Way to block certain directions
-                if (dir.first == 0.0 && dir.second == 0.0)
-                    continue;
+            continue;
+        }
+        closed[index] = true;
 
-                cell_t new_cell(
-                    centr_cell.x + dir.first * counter_dist,
-                    centr_cell.y + dir.second * counter_dist
-                );
-                // printf("new cell: (%d,%d)\n", new_cell.x, new_cell.y);
-                // Check if cell is a wall. Block that direction
-                if (map.isCellInGrid(new_cell.x, new_cell.y) && map.logOdds(new_cell.x, new_cell.y) > 0)
+        int f = goalFrontier[index];
+        if(f >= 0)
+        {
+            --remainingGoalCells;
+            if(goalDistance[index] < goals[f].distance)
+            {
+                goals[f].cellIndex = index;
+                goals[f].distance = goalDistance[index];
+                goals[f].cost = cellCost;
+                if(goals[f].distance == goals[f].minDistance)
                 {
-                    dir = std::pair<float,float>(0.0,0.0);
-                    continue;
+                    ++numSettledFrontiers;
                 }
+            }
+        }
 
-                // Check if it is a valid goal
-                if (planner.isValidGoal(new_cell))
-                {
-                    goal_cell = new_cell;
-                    found_valid_cell = true;
-                    goal = grid_position_to_global_position(goal_cell, map);
-                    mbot_lcm_msgs::pose2D_t goal_pose;
-                    goal_pose.x = goal.x;
-                    goal_pose.y = goal.y;
-                    goal_pose.theta = 0.0;
-                    goal_pose.utime = utime_now();
-
-                    // printf("goal (%f,%f)\n", goal.x, goal.y);
-                    // Plan the path to that chosen centroid
-                    path = planner.planPath(robotPose, goal_pose);
-                    // Only end the processing if it found a valid path
-                    if (path.path_length > 1)
-                        break;
-                    else
-                        found_valid_cell = false;
-                }
+        int x = index % width;
+        int y = index / width;
+        for(int n = 0; n < kNumNeighbors; ++n)
+        {
+            int nx = x + xDeltas[n];
+            int ny = y + yDeltas[n];
+            if(!is_traversable(nx, ny, distances, params))
+            {
+                continue;
             }
 
-            counter_dist++;
+            int neighborIndex = ny * width + nx;
+            double neighborCost = cellCost + step_cost(nx, ny, n >= 4, distances, params);
+            if(!closed[neighborIndex] && neighborCost < cost[neighborIndex])
+            {
+                cost[neighborIndex] = neighborCost;
+                parent[neighborIndex] = index;
+                openList.push(std::make_pair(neighborCost, neighborIndex));
+            }
         }
-        if (found_valid_cell)
+    }
+
+    // Pick the frontier with the best trade-off between the cost to reach it and how much can be seen from there
+    int unreachable_frontiers = 0;
+    std::vector<int> reachableFrontiers;
+    std::vector<Point<double>> goalPositions;
+    for(std::size_t f = 0; f < frontiers.size(); ++f)
+    {
+        if(goals[f].cellIndex < 0)
         {
-            break;
+            ++unreachable_frontiers;
+            continue;
         }
-        if (!found_valid_cell)
+
+        Point<double> goalCell(goals[f].cellIndex % width + 0.5, goals[f].cellIndex / width + 0.5);
+        reachableFrontiers.push_back(f);
+        goalPositions.push_back(grid_position_to_global_position(goalCell, distances));
+    }
+
+    std::vector<double> gains = compute_information_gains(goalPositions, map);
+
+    int bestFrontier = -1;
+    double bestScore = 0.0;
+    for(std::size_t n = 0; n < reachableFrontiers.size(); ++n)
+    {
+        int f = reachableFrontiers[n];
+        double score = goals[f].cost - kInfoGainWeight * gains[n];
+        if(bestFrontier < 0 || score < bestScore)
         {
-            // printf("was unreachable\n");
-            unreachable_frontiers++;
+            bestFrontier = f;
+            bestScore = score;
         }
     }
 
+    // A goal in the robot's own cell doesn't go anywhere
+    if(bestFrontier < 0 || goals[bestFrontier].cellIndex == robotIndex)
+    {
+        return frontier_processing_t(path, unreachable_frontiers);
+    }
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    for(int index = goals[bestFrontier].cellIndex; index >= 0; index = parent[index])
+    {
+        nodes.emplace_back(new Node(index % width, index / width));
+    }
+    std::reverse(nodes.begin(), nodes.end());
+
+    std::vector<Node*> nodePath;
+    for(auto&& node : nodes)
+    {
+        nodePath.push_back(node.get());
+    }
+
+    path.path = extract_pose_path(nodePath, distances);
+    path.path_length = path.path.size();
     return frontier_processing_t(path, unreachable_frontiers);
 }
 
@@ -260,66 +375,519 @@ bool is_frontier_cell(int x, int y, const OccupancyGrid& map)
 }
 
 
-frontier_t grow_frontier(Point<int> cell, const OccupancyGrid& map, std::set<Point<int>>& visitedFrontiers)
+FrontierDetector::FrontierDetector(double minFrontierLength)
+: minFrontierLength_(minFrontierLength)
 {
-    // Every cell in cellQueue is assumed to be in visitedFrontiers as well
-    std::queue<Point<int>> cellQueue;
-    cellQueue.push(cell);
-    visitedFrontiers.insert(cell);
+    reset();
+}
 
-    // Use an 8-way connected search for growing a frontier
-    const int kNumNeighbors = 8;
-    const int xDeltas[] = { -1, -1, -1, 1, 1, 1, 0, 0 };
-    const int yDeltas[] = {  0,  1, -1, 0, 1,-1, 1,-1 };
 
-    frontier_t frontier;
+std::vector<frontier_t> FrontierDetector::update(const OccupancyGrid& map, const mbot_lcm_msgs::pose2D_t& robotPose)
+{
+    Point<int> robotCell = global_position_to_grid_cell(Point<float>(robotPose.x, robotPose.y), map);
+    int robotIndex = map.isCellInGrid(robotCell.x, robotCell.y) ? robotCell.y * map.widthInCells() + robotCell.x : -1;
 
-    // Do a simple BFS to find all connected frontier cells to the starting cell
-    while(!cellQueue.empty())
+    bool isSameGrid = (map.widthInCells() == width_)
+        && (map.heightInCells() == height_)
+        && (map.metersPerCell() == metersPerCell_)
+        && (map.originInGlobalFrame().x == origin_.x)
+        && (map.originInGlobalFrame().y == origin_.y);
+
+    if(!isSameGrid)
     {
-        Point<int> nextCell = cellQueue.front();
-        cellQueue.pop();
+        rebuild(map, robotIndex);
+    }
+    else
+    {
+        // The map arrives whole, so a linear scan finds the cells that changed. Everything after this only looks at
+        // the changed cells and their neighborhoods.
+        std::vector<int> changedCells;
+        std::vector<int> lostFreeCells;
+        std::vector<int> gainedFreeCells;
+        for(int y = 0; y < height_; ++y)
+        {
+            for(int x = 0; x < width_; ++x)
+            {
+                int index = y * width_ + x;
+                bool isFree = map(x, y) < 0;
+                bool isUnknown = map(x, y) == 0;
+                if((isFree == isFree_[index]) && (isUnknown == isUnknown_[index]))
+                {
+                    continue;
+                }
 
-        // The frontier stores the global coordinate of the cells, so convert it first
-        frontier.cells.push_back(grid_position_to_global_position(nextCell, map));
+                changedCells.push_back(index);
+                if(isFree_[index] && !isFree)
+                {
+                    lostFreeCells.push_back(index);
+                }
+                else if(!isFree_[index] && isFree)
+                {
+                    gainedFreeCells.push_back(index);
+                }
+                isFree_[index] = isFree;
+                isUnknown_[index] = isUnknown;
+            }
+        }
+        numChangedCells_ = changedCells.size();
 
-        // Check each neighbor to see if it is also a frontier
-        for(int n = 0; n < kNumNeighbors; ++n)
+        // The robot cell is always reachable, even if it isn't free. If the robot left a cell that isn't free, then
+        // the space reached through it might not be reachable anymore.
+        bool needsRebuild = (robotIndex != robotIndex_)
+            && ((robotIndex < 0) || !isReachable_[robotIndex] || (robotIndex_ >= 0 && !isFree_[robotIndex_]));
+
+        std::vector<int> lostReachableCells;
+        for(int index : lostFreeCells)
         {
-            Point<int> neighbor(nextCell.x + xDeltas[n], nextCell.y + yDeltas[n]);
-            if((visitedFrontiers.find(neighbor) == visitedFrontiers.end())
-                && (is_frontier_cell(neighbor.x, neighbor.y, map)))
+            if(isReachable_[index] && (index != robotIndex))
             {
-                visitedFrontiers.insert(neighbor);
-                cellQueue.push(neighbor);
+                isReachable_[index] = false;
+                lostReachableCells.push_back(index);
             }
         }
+
+        for(std::size_t n = 0; !needsRebuild && (n < lostReachableCells.size()); ++n)
+        {
+            needsRebuild = !isStillConnected(lostReachableCells[n]);
+        }
+
+        if(needsRebuild)
+        {
+            rebuildReachable(robotIndex);
+        }
+        else
+        {
+            for(int index : gainedFreeCells)
+            {
+                if(!isReachable_[index] && isTouchingReachable(index))
+                {
+                    growReachable(index);
+                }
+            }
+        }
+
+        updateFrontiers(map, changedCells);
+    }
+
+    robotIndex_ = robotIndex;
+
+    // Sort the clusters so the frontiers come out in the same order for the same map
+    std::vector<int> roots;
+    roots.reserve(clusters_.size());
+    for(auto& cluster : clusters_)
+    {
+        roots.push_back(cluster.first);
+    }
+    std::sort(roots.begin(), roots.end());
+
+    std::vector<frontier_t> frontiers;
+    for(int root : roots)
+    {
+        std::vector<int>& cells = clusters_[root];
+        if(cells.size() * metersPerCell_ < minFrontierLength_)
+        {
+            continue;
+        }
+
+        // Only frontiers bordering free space that can be reached from the robot are returned
+        bool isReachable = false;
+        for(std::size_t n = 0; !isReachable && (n < cells.size()); ++n)
+        {
+            isReachable = isTouchingReachable(cells[n]);
+        }
+        if(!isReachable)
+        {
+            continue;
+        }
+
+        std::sort(cells.begin(), cells.end());
+
+        frontier_t frontier;
+        frontier.cells.reserve(cells.size());
+        for(int index : cells)
+        {
+            frontier.cells.push_back(grid_position_to_global_position(Point<double>(index % width_, index / width_),
+                                                                      map));
+        }
+        frontiers.push_back(frontier);
     }
 
-    return frontier;
+    return frontiers;
+}
+
+
+void FrontierDetector::reset(void)
+{
+    width_ = 0;
+    height_ = 0;
+    metersPerCell_ = 0.0f;
+    origin_ = Point<float>(0.0f, 0.0f);
+    robotIndex_ = -1;
+
+    isFree_.clear();
+    isUnknown_.clear();
+    isFrontier_.clear();
+    isReachable_.clear();
+    parent_.clear();
+    clusters_.clear();
+
+    numChangedCells_ = -1;
 }
 
+
+void FrontierDetector::rebuild(const OccupancyGrid& map, int robotIndex)
+{
+    width_ = map.widthInCells();
+    height_ = map.heightInCells();
+    metersPerCell_ = map.metersPerCell();
+    origin_ = map.originInGlobalFrame();
+    numChangedCells_ = -1;
+
+    const std::size_t numCells = width_ * height_;
+    isFree_.assign(numCells, false);
+    isUnknown_.assign(numCells, false);
+    isFrontier_.assign(numCells, false);
+    parent_.resize(numCells);
+    clusters_.clear();
+
+    for(int y = 0; y < height_; ++y)
+    {
+        for(int x = 0; x < width_; ++x)
+        {
+            int index = y * width_ + x;
+            isFree_[index] = map(x, y) < 0;
+            isUnknown_[index] = map(x, y) == 0;
+            isFrontier_[index] = is_frontier_cell(x, y, map);
+            parent_[index] = index;
+            if(isFrontier_[index])
+            {
+                clusters_[index].push_back(index);
+            }
+        }
+    }
+
+    for(std::size_t index = 0; index < numCells; ++index)
+    {
+        if(isFrontier_[index])
+        {
+            linkCluster(index);
+        }
+    }
+
+    rebuildReachable(robotIndex);
+}
+
+
+void FrontierDetector::rebuildReachable(int robotIndex)
+{
+    isReachable_.assign(width_ * height_, false);
+    if(robotIndex >= 0)
+    {
+        growReachable(robotIndex);
+    }
+}
+
+
+void FrontierDetector::growReachable(int seedIndex)
+{
+    // Use a 4-way connected search for expanding through free space
+    std::vector<int> cellQueue;
+    cellQueue.push_back(seedIndex);
+    isReachable_[seedIndex] = true;
+
+    for(std::size_t next = 0; next < cellQueue.size(); ++next)
+    {
+        int x = cellQueue[next] % width_;
+        int y = cellQueue[next] / width_;
+        for(int n = 0; n < kNumEdgeNeighbors; ++n)
+        {
+            int nx = x + xDeltas[n];
+            int ny = y + yDeltas[n];
+            if(nx < 0 || ny < 0 || nx >= width_ || ny >= height_)
+            {
+                continue;
+            }
+
+            int neighbor = ny * width_ + nx;
+            if(isFree_[neighbor] && !isReachable_[neighbor])
+            {
+                isReachable_[neighbor] = true;
+                cellQueue.push_back(neighbor);
+            }
+        }
+    }
+}
+
+
+bool FrontierDetector::isStillConnected(int lostIndex) const
+{
+    // Any path through the lost cell entered and left through two of its reachable neighbors. If those neighbors are
+    // still connected to each other nearby, then every path can detour around the lost cell.
+    const int kWindowWidth = 2 * kLocalConnectivityRadius + 1;
+    int lostX = lostIndex % width_;
+    int lostY = lostIndex / width_;
+
+    std::vector<Point<int>> neighbors;
+    for(int n = 0; n < kNumEdgeNeighbors; ++n)
+    {
+        int nx = lostX + xDeltas[n];
+        int ny = lostY + yDeltas[n];
+        if(nx >= 0 && ny >= 0 && nx < width_ && ny < height_ && isReachable_[ny * width_ + nx])
+        {
+            neighbors.emplace_back(nx, ny);
+        }
+    }
+
+    if(neighbors.size() < 2)
+    {
+        return true;
+    }
+
+    bool visited[kWindowWidth][kWindowWidth] = {};
+    std::vector<Point<int>> cellQueue;
+    cellQueue.push_back(neighbors.front());
+    visited[neighbors.front().y - lostY + kLocalConnectivityRadius][neighbors.front().x - lostX + kLocalConnectivityRadius] = true;
+
+    for(std::size_t next = 0; next < cellQueue.size(); ++next)
+    {
+        for(int n = 0; n < kNumEdgeNeighbors; ++n)
+        {
+            int nx = cellQueue[next].x + xDeltas[n];
+            int ny = cellQueue[next].y + yDeltas[n];
+            int wx = nx - lostX + kLocalConnectivityRadius;
+            int wy = ny - lostY + kLocalConnectivityRadius;
+            if(wx < 0 || wy < 0 || wx >= kWindowWidth || wy >= kWindowWidth
+                || nx < 0 || ny < 0 || nx >= width_ || ny >= height_
+                || visited[wy][wx] || !isReachable_[ny * width_ + nx])
+            {
+                continue;
+            }
+
+            visited[wy][wx] = true;
+            cellQueue.emplace_back(nx, ny);
+        }
+    }
+
+    for(auto& neighbor : neighbors)
+    {
+        if(!visited[neighbor.y - lostY + kLocalConnectivityRadius][neighbor.x - lostX + kLocalConnectivityRadius])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void FrontierDetector::updateFrontiers(const OccupancyGrid& map, const std::vector<int>& changedCells)
+{
+    // Whether a cell is a frontier depends on itself and its edge neighbors, so only those can change
+    std::vector<int> candidates;
+    candidates.reserve(changedCells.size() * (kNumEdgeNeighbors + 1));
+    for(int index : changedCells)
+    {
+        candidates.push_back(index);
+        int x = index % width_;
+        int y = index / width_;
+        for(int n = 0; n < kNumEdgeNeighbors; ++n)
+        {
+            if(map.isCellInGrid(x + xDeltas[n], y + yDeltas[n]))
+            {
+                candidates.push_back((y + yDeltas[n]) * width_ + x + xDeltas[n]);
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<int> brokenRoots;
+    std::vector<int> unlinkedCells;
+    for(int index : candidates)
+    {
+        bool isFrontier = is_frontier_cell(index % width_, index / width_, map);
+        if(isFrontier == isFrontier_[index])
+        {
+            continue;
+        }
+
+        if(isFrontier)
+        {
+            unlinkedCells.push_back(index);
+        }
+        else
+        {
+            brokenRoots.push_back(findRoot(index));
+        }
+        isFrontier_[index] = isFrontier;
+    }
+    std::sort(brokenRoots.begin(), brokenRoots.end());
+    brokenRoots.erase(std::unique(brokenRoots.begin(), brokenRoots.end()), brokenRoots.end());
+
+    // Union-find can't split a cluster, so a cluster that lost a cell is taken apart and its remaining cells are
+    // linked again along with the new frontier cells
+    for(int root : brokenRoots)
+    {
+        auto clusterIt = clusters_.find(root);
+        std::vector<int> cells = std::move(clusterIt->second);
+        clusters_.erase(clusterIt);
+
+        for(int index : cells)
+        {
+            parent_[index] = index;
+            if(isFrontier_[index])
+            {
+                unlinkedCells.push_back(index);
+            }
+        }
+    }
+
+    for(int index : unlinkedCells)
+    {
+        parent_[index] = index;
+        clusters_[index].assign(1, index);
+    }
+
+    for(int index : unlinkedCells)
+    {
+        linkCluster(index);
+    }
+}
+
+
+void FrontierDetector::linkCluster(int index)
+{
+    // Use an 8-way connected search for growing a frontier
+    int x = index % width_;
+    int y = index / width_;
+    for(int n = 0; n < kNumNeighbors; ++n)
+    {
+        int nx = x + xDeltas[n];
+        int ny = y + yDeltas[n];
+        if(nx >= 0 && ny >= 0 && nx < width_ && ny < height_ && isFrontier_[ny * width_ + nx])
+        {
+            unionClusters(index, ny * width_ + nx);
+        }
+    }
+}
+
+
+int FrontierDetector::findRoot(int index)
+{
+    while(parent_[index] != index)
+    {
+        parent_[index] = parent_[parent_[index]];
+        index = parent_[index];
+    }
+    return index;
+}
+
+
+void FrontierDetector::unionClusters(int indexA, int indexB)
+{
+    int rootA = findRoot(indexA);
+    int rootB = findRoot(indexB);
+    if(rootA == rootB)
+    {
+        return;
+    }
+
+    // Merge the smaller cluster into the larger
+    if(clusters_[rootA].size() < clusters_[rootB].size())
+    {
+        std::swap(rootA, rootB);
+    }
+
+    std::vector<int>& larger = clusters_[rootA];
+    std::vector<int>& smaller = clusters_[rootB];
+    larger.insert(larger.end(), smaller.begin(), smaller.end());
+    parent_[rootB] = rootA;
+    clusters_.erase(rootB);
+}
+
+
+bool FrontierDetector::isTouchingReachable(int index) const
+{
+    int x = index % width_;
+    int y = index / width_;
+    for(int n = 0; n < kNumEdgeNeighbors; ++n)
+    {
+        int nx = x + xDeltas[n];
+        int ny = y + yDeltas[n];
+        if(nx >= 0 && ny >= 0 && nx < width_ && ny < height_ && isReachable_[ny * width_ + nx])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 Point<double> find_frontier_centroid(const frontier_t& frontier)
 {
-    // Using the mid point of the frontier
-    Point<double> mid_point;
-    int index = (int)(frontier.cells.size() / 2.0);
-    // printf("index: %d, size: %d\n", index, frontier.cells.size());
-    mid_point = frontier.cells[index];
-    printf("Mid point of frontier: (%f,%f)\n", mid_point.x, mid_point.y);
-
-    return mid_point;
-    // // use the geometric median instead
-    // float sum_x = 0;
-    // float sum_y = 0;
-    // for (auto &&cell : frontier.cells)
-    // {
-    //     sum_x += cell.x;
-    //     sum_y += cell.y;
-    // }
-    // Point<double> centroid(
-    //         sum_x / frontier.cells.size(),
-    //         sum_y / frontier.cells.size()
-    //         );
-    // return centroid;
+    Point<double> mean(0.0, 0.0);
+    for(auto& cell : frontier.cells)
+    {
+        mean.x += cell.x;
+        mean.y += cell.y;
+    }
+    mean.x /= frontier.cells.size();
+    mean.y /= frontier.cells.size();
+
+    Point<double> centroid = frontier.cells.front();
+    double minDistanceSq = 1.0E16;
+    for(auto& cell : frontier.cells)
+    {
+        double distanceSq = (cell.x - mean.x) * (cell.x - mean.x) + (cell.y - mean.y) * (cell.y - mean.y);
+        if(distanceSq < minDistanceSq)
+        {
+            minDistanceSq = distanceSq;
+            centroid = cell;
+        }
+    }
+
+    return centroid;
+}
+
+
+double expected_information_gain(const Point<double>& position, const OccupancyGrid& map, double maxRange, int numRays)
+{
+    // Step half a cell at a time, so no cell along a ray is skipped
+    const double stepSize = 0.5 * map.metersPerCell();
+    const int numSteps = static_cast<int>(maxRange / stepSize);
+    const double rayAngle = 2.0 * M_PI / numRays;
+    const Point<double> start = global_position_to_grid_position(position, map);
+    const double stepInCells = stepSize * map.cellsPerMeter();
+    const double width = map.widthInCells();
+    const double height = map.heightInCells();
+
+    // Unknown samples are counted per step, and converted to area at the end. The sample at step s stands for the
+    // area of its ray's wedge between s and s+1 steps out, which is proportional to s + 0.5.
+    double weightedUnknownSteps = 0.0;
+    for(int ray = 0; ray < numRays; ++ray)
+    {
+        double dx = std::cos(ray * rayAngle) * stepInCells;
+        double dy = std::sin(ray * rayAngle) * stepInCells;
+        for(int step = 0; step < numSteps; ++step)
+        {
+            double x = start.x + step * dx;
+            double y = start.y + step * dy;
+            if(x < 0.0 || y < 0.0 || x >= width || y >= height)
+            {
+                break;
+            }
+
+            // The position is known to be in the grid, so the unchecked access is safe
+            CellOdds odds = map(static_cast<int>(x), static_cast<int>(y));
+            if(odds > 0)
+            {
+                break;
+            }
+            if(odds == 0)
+            {
+                weightedUnknownSteps += step + 0.5;
+            }
+        }
+    }
+
+    return weightedUnknownSteps * stepSize * stepSize * rayAngle;
 }
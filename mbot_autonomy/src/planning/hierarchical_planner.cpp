@@ -0,0 +1,693 @@
+#include <planning/hierarchical_planner.hpp>
+#include <utils/grid_utils.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <set>
+#include <tuple>
+
+using namespace std::chrono;
+
+namespace
+{
+
+// Borders with at least this many crossable cells in a row get an entrance at each end instead of one in the middle
+const int kMinWideEntrance = 6;
+
+const int kNumNeighbors = 8;
+const int xDeltas[kNumNeighbors] = {1, -1, 0, 0, 1, -1, 1, -1};
+const int yDeltas[kNumNeighbors] = {0, 0, 1, -1, 1, -1, -1, 1};
+
+// Cost of following cells, starting from a neighbor of the first cell
+double cells_cost(const cell_t& from,
+                  const std::vector<cell_t>& cells,
+                  const ObstacleDistanceGrid& distances,
+                  const SearchParams& params)
+{
+    double cost = 0.0;
+    cell_t previous = from;
+    for(auto&& cell : cells)
+    {
+        bool diagonal = (cell.x != previous.x) && (cell.y != previous.y);
+        cost += step_cost(cell.x, cell.y, diagonal, distances, params);
+        previous = cell;
+    }
+    return cost;
+}
+
+double octile_distance(const cell_t& from, const cell_t& to, float metersPerCell)
+{
+    int dx = std::abs(to.x - from.x);
+    int dy = std::abs(to.y - from.y);
+    return ((dx + dy) + (M_SQRT2 - 2.0) * std::min(dx, dy)) * metersPerCell;
+}
+
+} // namespace
+
+
+HierarchicalPlanner::HierarchicalPlanner(int clusterSize)
+: clusterSize_(clusterSize)
+, clustersWide_(0)
+, clustersHigh_(0)
+, haveGraph_(false)
+{
+}
+
+
+int HierarchicalPlanner::setDistances(const ObstacleDistanceGrid& distances, const SearchParams& params)
+{
+    bool rebuildAll = !haveGraph_
+        || (distances.widthInCells() != distances_.widthInCells())
+        || (distances.heightInCells() != distances_.heightInCells())
+        || (params.minDistanceToObstacle != params_.minDistanceToObstacle)
+        || (params.maxDistanceWithCost != params_.maxDistanceWithCost)
+        || (params.distanceCostExponent != params_.distanceCostExponent);
+
+    std::vector<std::pair<int, int>> changedClusters;
+    if(rebuildAll)
+    {
+        clustersWide_ = (distances.widthInCells() + clusterSize_ - 1) / clusterSize_;
+        clustersHigh_ = (distances.heightInCells() + clusterSize_ - 1) / clusterSize_;
+        nodes_.clear();
+
+        for(int cy = 0; cy < clustersHigh_; ++cy)
+        {
+            for(int cx = 0; cx < clustersWide_; ++cx)
+            {
+                changedClusters.emplace_back(cx, cy);
+            }
+        }
+    }
+    else
+    {
+        for(int cy = 0; cy < clustersHigh_; ++cy)
+        {
+            for(int cx = 0; cx < clustersWide_; ++cx)
+            {
+                if(clusterChanged(cx, cy, distances))
+                {
+                    changedClusters.emplace_back(cx, cy);
+                }
+            }
+        }
+    }
+
+    distances_ = distances;
+    params_ = params;
+    haveGraph_ = true;
+
+    // Each border is identified by the cluster to its left or below it. Every border touching a changed cluster can
+    // have different entrances now, so the clusters on both sides of it need new intra-cluster edges.
+    std::set<std::tuple<int, int, bool>> borders;
+    std::set<std::pair<int, int>> dirtyClusters;
+    for(auto&& cluster : changedClusters)
+    {
+        int cx = cluster.first;
+        int cy = cluster.second;
+        dirtyClusters.insert(cluster);
+
+        if(cx + 1 < clustersWide_) { borders.emplace(cx, cy, true); dirtyClusters.emplace(cx + 1, cy); }
+        if(cx > 0) { borders.emplace(cx - 1, cy, true); dirtyClusters.emplace(cx - 1, cy); }
+        if(cy + 1 < clustersHigh_) { borders.emplace(cx, cy, false); dirtyClusters.emplace(cx, cy + 1); }
+        if(cy > 0) { borders.emplace(cx, cy - 1, false); dirtyClusters.emplace(cx, cy - 1); }
+    }
+
+    for(auto&& border : borders)
+    {
+        removeBorderEdges(std::get<0>(border), std::get<1>(border), std::get<2>(border));
+        rebuildBorder(std::get<0>(border), std::get<1>(border), std::get<2>(border));
+    }
+
+    for(auto&& cluster : dirtyClusters)
+    {
+        rebuildIntraEdges(cluster.first, cluster.second);
+    }
+
+    return static_cast<int>(dirtyClusters.size());
+}
+
+
+mbot_lcm_msgs::path2D_t HierarchicalPlanner::planPath(const mbot_lcm_msgs::pose2D_t& start,
+                                                      const mbot_lcm_msgs::pose2D_t& goal,
+                                                      SearchStats* stats) const
+{
+    auto searchStart = steady_clock::now();
+    int64_t numExpanded = 0;
+
+    cell_t startCell = global_position_to_grid_cell(Point<double>(start.x, start.y), distances_);
+    cell_t goalCell = global_position_to_grid_cell(Point<double>(goal.x, goal.y), distances_);
+
+    std::vector<cell_t> cellPath;
+    bool found_path = false;
+
+    if(haveGraph_
+        && distances_.isCellInGrid(startCell.x, startCell.y)
+        && is_traversable(goalCell.x, goalCell.y, distances_, params_))
+    {
+        // When both ends are in the same cluster, a path inside the cluster is usually all that's needed
+        if(clusterOf(startCell) == clusterOf(goalCell))
+        {
+            auto local = searchCluster(startCell, {goalCell});
+            if(!local.empty())
+            {
+                cellPath.push_back(startCell);
+                cellPath.insert(cellPath.end(), local.front().cells.begin(), local.front().cells.end());
+                found_path = true;
+            }
+        }
+
+        if(!found_path)
+        {
+            // Temporarily connect the start and goal to the entrances of their clusters
+            std::vector<int> startNodes = clusterNodes(startCell.x / clusterSize_, startCell.y / clusterSize_);
+            std::vector<cell_t> startTargets;
+            for(int index : startNodes)
+            {
+                startTargets.push_back(nodes_.at(index).cell);
+            }
+            std::vector<AbstractEdge> startEdges = searchCluster(startCell, startTargets);
+
+            std::vector<int> goalNodes = clusterNodes(goalCell.x / clusterSize_, goalCell.y / clusterSize_);
+            std::vector<cell_t> goalTargets;
+            for(int index : goalNodes)
+            {
+                goalTargets.push_back(nodes_.at(index).cell);
+            }
+
+            // The edges are found by searching from the goal, so reverse them to lead into the goal
+            std::unordered_map<int, AbstractEdge> goalEdges;
+            int goalIndex = cellIndex(goalCell);
+            for(auto&& edge : searchCluster(goalCell, goalTargets))
+            {
+                AbstractEdge toGoal;
+                toGoal.target = goalIndex;
+                toGoal.cost = 0.0;
+                if(!edge.cells.empty())
+                {
+                    toGoal.cells.assign(edge.cells.rbegin() + 1, edge.cells.rend());
+                    toGoal.cells.push_back(goalCell);
+                    toGoal.cost = cells_cost(edge.cells.back(), toGoal.cells, distances_, params_);
+                }
+                goalEdges[edge.target] = toGoal;
+            }
+
+            // A* over the abstract graph
+            typedef std::pair<double, int> QueueEntry;
+            std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> openList;
+            std::unordered_map<int, double> gCost;
+            std::unordered_map<int, const AbstractEdge*> parentEdge;
+            std::unordered_map<int, int> parentNode;
+            std::set<int> closed;
+
+            int startIndex = cellIndex(startCell);
+            gCost[startIndex] = 0.0;
+            openList.emplace(octile_distance(startCell, goalCell, distances_.metersPerCell()), startIndex);
+
+            while(!openList.empty())
+            {
+                int index = openList.top().second;
+                openList.pop();
+
+                if(!closed.insert(index).second)
+                {
+                    continue;
+                }
+                ++numExpanded;
+
+                if(index == goalIndex)
+                {
+                    found_path = true;
+                    break;
+                }
+
+                auto relax = [&](const AbstractEdge& edge) {
+                    double cost = gCost[index] + edge.cost;
+                    auto existing = gCost.find(edge.target);
+                    if(closed.count(edge.target) || (existing != gCost.end() && existing->second <= cost))
+                    {
+                        return;
+                    }
+                    gCost[edge.target] = cost;
+                    parentEdge[edge.target] = &edge;
+                    parentNode[edge.target] = index;
+                    cell_t targetCell(edge.target % distances_.widthInCells(), edge.target / distances_.widthInCells());
+                    openList.emplace(cost + octile_distance(targetCell, goalCell, distances_.metersPerCell()),
+                                     edge.target);
+                };
+
+                if(index == startIndex)
+                {
+                    std::for_each(startEdges.begin(), startEdges.end(), relax);
+                }
+
+                auto node = nodes_.find(index);
+                if(node != nodes_.end())
+                {
+                    std::for_each(node->second.interEdges.begin(), node->second.interEdges.end(), relax);
+                    std::for_each(node->second.intraEdges.begin(), node->second.intraEdges.end(), relax);
+                }
+
+                auto toGoal = goalEdges.find(index);
+                if(toGoal != goalEdges.end())
+                {
+                    relax(toGoal->second);
+                }
+            }
+
+            // Refine the abstract path by stitching together the cells of each edge
+            if(found_path)
+            {
+                std::vector<const AbstractEdge*> edges;
+                for(int index = goalIndex; index != startIndex; index = parentNode[index])
+                {
+                    edges.push_back(parentEdge[index]);
+                }
+                std::reverse(edges.begin(), edges.end());
+
+                cellPath.push_back(startCell);
+                for(auto&& edge : edges)
+                {
+                    cellPath.insert(cellPath.end(), edge->cells.begin(), edge->cells.end());
+                }
+
+                // The stitched path has to pass through the entrance cells, which often sit next to walls or far
+                // along a wide border. Search again within the clusters it crosses for the best path through them.
+                cellPath = refinePath(cellPath, numExpanded);
+            }
+        }
+    }
+
+    mbot_lcm_msgs::path2D_t path;
+    path.utime = start.utime;
+    if(found_path)
+    {
+        std::vector<Node> nodes;
+        nodes.reserve(cellPath.size());
+        std::vector<Node*> nodePath;
+        for(auto&& cell : cellPath)
+        {
+            nodes.emplace_back(cell.x, cell.y);
+            nodePath.push_back(&nodes.back());
+        }
+
+        path.path = extract_pose_path(nodePath, distances_);
+        // Remove last pose, and add the goal pose
+        path.path.pop_back();
+        path.path.push_back(goal);
+    }
+    else
+    {
+        printf("[HPA*] Didn't find a path\n");
+        path.path.push_back(start);
+    }
+    path.path_length = path.path.size();
+
+    if(stats)
+    {
+        stats->expandedNodes = numExpanded;
+        stats->searchTimeUs = duration_cast<microseconds>(steady_clock::now() - searchStart).count();
+        stats->pathCost = 0.0;
+        if(found_path)
+        {
+            std::vector<cell_t> steps(cellPath.begin() + 1, cellPath.end());
+            stats->pathCost = cells_cost(cellPath.front(), steps, distances_, params_);
+        }
+    }
+
+    return path;
+}
+
+
+bool HierarchicalPlanner::clusterChanged(int clusterX, int clusterY, const ObstacleDistanceGrid& distances) const
+{
+    int xEnd = std::min((clusterX + 1) * clusterSize_, distances.widthInCells());
+    int yEnd = std::min((clusterY + 1) * clusterSize_, distances.heightInCells());
+
+    for(int y = clusterY * clusterSize_; y < yEnd; ++y)
+    {
+        for(int x = clusterX * clusterSize_; x < xEnd; ++x)
+        {
+            // Every cell beyond maxDistanceWithCost has the same cost, so only changes below it matter
+            if(std::min<double>(distances(x, y), params_.maxDistanceWithCost)
+                != std::min<double>(distances_(x, y), params_.maxDistanceWithCost))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+void HierarchicalPlanner::rebuildBorder(int clusterX, int clusterY, bool vertical)
+{
+    // Walk along the border, finding each run of cells that can be crossed
+    int length = vertical
+        ? std::min((clusterY + 1) * clusterSize_, distances_.heightInCells()) - clusterY * clusterSize_
+        : std::min((clusterX + 1) * clusterSize_, distances_.widthInCells()) - clusterX * clusterSize_;
+
+    auto borderCells = [&](int n, cell_t& near, cell_t& far) {
+        if(vertical)
+        {
+            near = cell_t((clusterX + 1) * clusterSize_ - 1, clusterY * clusterSize_ + n);
+            far = cell_t(near.x + 1, near.y);
+        }
+        else
+        {
+            near = cell_t(clusterX * clusterSize_ + n, (clusterY + 1) * clusterSize_ - 1);
+            far = cell_t(near.x, near.y + 1);
+        }
+        return is_traversable(near.x, near.y, distances_, params_) && is_traversable(far.x, far.y, distances_, params_);
+    };
+
+    int runStart = -1;
+    for(int n = 0; n <= length; ++n)
+    {
+        cell_t near;
+        cell_t far;
+        bool open = (n < length) && borderCells(n, near, far);
+
+        if(open && runStart < 0)
+        {
+            runStart = n;
+        }
+        else if(!open && runStart >= 0)
+        {
+            int runEnd = n - 1;
+            if(runEnd - runStart + 1 < kMinWideEntrance)
+            {
+                borderCells((runStart + runEnd) / 2, near, far);
+                addEntrance(near, far);
+            }
+            else
+            {
+                borderCells(runStart, near, far);
+                addEntrance(near, far);
+                borderCells(runEnd, near, far);
+                addEntrance(near, far);
+            }
+            runStart = -1;
+        }
+    }
+}
+
+
+void HierarchicalPlanner::removeBorderEdges(int clusterX, int clusterY, bool vertical)
+{
+    int length = vertical
+        ? std::min((clusterY + 1) * clusterSize_, distances_.heightInCells()) - clusterY * clusterSize_
+        : std::min((clusterX + 1) * clusterSize_, distances_.widthInCells()) - clusterX * clusterSize_;
+
+    for(int n = 0; n < length; ++n)
+    {
+        cell_t near = vertical ? cell_t((clusterX + 1) * clusterSize_ - 1, clusterY * clusterSize_ + n)
+                               : cell_t(clusterX * clusterSize_ + n, (clusterY + 1) * clusterSize_ - 1);
+        cell_t far = vertical ? cell_t(near.x + 1, near.y) : cell_t(near.x, near.y + 1);
+
+        for(auto&& pair : { std::make_pair(near, far), std::make_pair(far, near) })
+        {
+            auto node = nodes_.find(cellIndex(pair.first));
+            if(node == nodes_.end())
+            {
+                continue;
+            }
+
+            int crossing = cellIndex(pair.second);
+            auto& edges = node->second.interEdges;
+            edges.erase(std::remove_if(edges.begin(), edges.end(), [crossing](const AbstractEdge& edge) {
+                return edge.target == crossing;
+            }), edges.end());
+
+            if(edges.empty())
+            {
+                nodes_.erase(node);
+            }
+        }
+    }
+}
+
+
+void HierarchicalPlanner::addEntrance(const cell_t& from, const cell_t& to)
+{
+    AbstractNode& fromNode = nodes_[cellIndex(from)];
+    AbstractNode& toNode = nodes_[cellIndex(to)];
+    fromNode.cell = from;
+    toNode.cell = to;
+
+    bool diagonal = (from.x != to.x) && (from.y != to.y);
+    fromNode.interEdges.push_back({cellIndex(to), step_cost(to.x, to.y, diagonal, distances_, params_), {to}});
+    toNode.interEdges.push_back({cellIndex(from), step_cost(from.x, from.y, diagonal, distances_, params_), {from}});
+}
+
+
+void HierarchicalPlanner::rebuildIntraEdges(int clusterX, int clusterY)
+{
+    std::vector<int> indices = clusterNodes(clusterX, clusterY);
+    std::vector<cell_t> cells;
+    for(int index : indices)
+    {
+        cells.push_back(nodes_.at(index).cell);
+    }
+
+    for(int index : indices)
+    {
+        AbstractNode& node = nodes_.at(index);
+        node.intraEdges.clear();
+        for(auto&& edge : searchCluster(node.cell, cells))
+        {
+            if(edge.target != index)
+            {
+                node.intraEdges.push_back(std::move(edge));
+            }
+        }
+    }
+}
+
+
+std::vector<int> HierarchicalPlanner::clusterNodes(int clusterX, int clusterY) const
+{
+    // Entrances are always on the edge of a cluster, so only the perimeter needs to be checked
+    int xStart = clusterX * clusterSize_;
+    int yStart = clusterY * clusterSize_;
+    int xEnd = std::min(xStart + clusterSize_, distances_.widthInCells());
+    int yEnd = std::min(yStart + clusterSize_, distances_.heightInCells());
+
+    std::set<int> indices;
+    auto check = [&](int x, int y) {
+        int index = cellIndex(cell_t(x, y));
+        if(nodes_.count(index))
+        {
+            indices.insert(index);
+        }
+    };
+
+    for(int x = xStart; x < xEnd; ++x)
+    {
+        check(x, yStart);
+        check(x, yEnd - 1);
+    }
+    for(int y = yStart; y < yEnd; ++y)
+    {
+        check(xStart, y);
+        check(xEnd - 1, y);
+    }
+
+    return std::vector<int>(indices.begin(), indices.end());
+}
+
+
+std::vector<cell_t> HierarchicalPlanner::refinePath(const std::vector<cell_t>& cellPath, int64_t& numExpanded) const
+{
+    // Each cluster in the corridor gets a slot of clusterSize_ x clusterSize_ cells in the search arrays, so their
+    // size depends on the length of the path rather than the size of the map
+    const int cellsPerCluster = clusterSize_ * clusterSize_;
+    std::vector<int> clusterSlots(numClusters(), -1);
+    int numSlots = 0;
+    for(auto&& cell : cellPath)
+    {
+        int& slot = clusterSlots[clusterOf(cell)];
+        if(slot < 0)
+        {
+            slot = numSlots++;
+        }
+    }
+
+    auto slotIndex = [&](const cell_t& cell) {
+        int slot = clusterSlots[clusterOf(cell)];
+        if(slot < 0)
+        {
+            return -1;
+        }
+        return slot * cellsPerCluster + (cell.y % clusterSize_) * clusterSize_ + (cell.x % clusterSize_);
+    };
+
+    std::vector<double> cost(numSlots * cellsPerCluster, 1.0E16);
+    std::vector<int> parent(cost.size(), -1);
+    std::vector<cell_t> cells(cost.size());
+    std::vector<bool> closed(cost.size(), false);
+
+    const cell_t& startCell = cellPath.front();
+    const cell_t& goalCell = cellPath.back();
+    const int startIndex = slotIndex(startCell);
+    const int goalIndex = slotIndex(goalCell);
+
+    typedef std::pair<double, int> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> openList;
+    cost[startIndex] = 0.0;
+    cells[startIndex] = startCell;
+    openList.emplace(octile_distance(startCell, goalCell, distances_.metersPerCell()), startIndex);
+
+    while(!openList.empty())
+    {
+        int index = openList.top().second;
+        openList.pop();
+
+        if(closed[index])
+        {
+            continue;
+        }
+        closed[index] = true;
+        ++numExpanded;
+
+        if(index == goalIndex)
+        {
+            break;
+        }
+
+        const cell_t cell = cells[index];
+        for(int n = 0; n < kNumNeighbors; ++n)
+        {
+            cell_t neighbor(cell.x + xDeltas[n], cell.y + yDeltas[n]);
+            if(!is_traversable(neighbor.x, neighbor.y, distances_, params_))
+            {
+                continue;
+            }
+
+            int neighborIndex = slotIndex(neighbor);
+            if(neighborIndex < 0)
+            {
+                continue;
+            }
+
+            double neighborCost = cost[index] + step_cost(neighbor.x, neighbor.y, n >= 4, distances_, params_);
+            if(neighborCost < cost[neighborIndex])
+            {
+                cost[neighborIndex] = neighborCost;
+                parent[neighborIndex] = index;
+                cells[neighborIndex] = neighbor;
+                openList.emplace(neighborCost + octile_distance(neighbor, goalCell, distances_.metersPerCell()),
+                                 neighborIndex);
+            }
+        }
+    }
+
+    // The stitched path lies within the corridor, so the goal is always reached. Keep the stitched path just in case.
+    if(!closed[goalIndex])
+    {
+        return cellPath;
+    }
+
+    std::vector<cell_t> refined;
+    for(int index = goalIndex; index != startIndex; index = parent[index])
+    {
+        refined.push_back(cells[index]);
+    }
+    refined.push_back(startCell);
+    std::reverse(refined.begin(), refined.end());
+    return refined;
+}
+
+
+std::vector<HierarchicalPlanner::AbstractEdge> HierarchicalPlanner::searchCluster(
+    const cell_t& source,
+    const std::vector<cell_t>& targets) const
+{
+    // Dijkstra's algorithm, confined to the cluster containing source
+    int xStart = (source.x / clusterSize_) * clusterSize_;
+    int yStart = (source.y / clusterSize_) * clusterSize_;
+    int xEnd = std::min(xStart + clusterSize_, distances_.widthInCells());
+    int yEnd = std::min(yStart + clusterSize_, distances_.heightInCells());
+    int width = xEnd - xStart;
+
+    auto localIndex = [&](const cell_t& cell) { return (cell.y - yStart) * width + (cell.x - xStart); };
+
+    std::vector<double> cost(width * (yEnd - yStart), 1.0E16);
+    std::vector<int> parent(cost.size(), -1);
+    std::vector<bool> closed(cost.size(), false);
+
+    std::vector<bool> isTarget(cost.size(), false);
+    int numTargetsLeft = 0;
+    for(auto&& target : targets)
+    {
+        if(!isTarget[localIndex(target)])
+        {
+            isTarget[localIndex(target)] = true;
+            ++numTargetsLeft;
+        }
+    }
+
+    typedef std::pair<double, int> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> searchQueue;
+    cost[localIndex(source)] = 0.0;
+    searchQueue.emplace(0.0, localIndex(source));
+
+    while(!searchQueue.empty() && numTargetsLeft > 0)
+    {
+        int index = searchQueue.top().second;
+        searchQueue.pop();
+
+        if(closed[index])
+        {
+            continue;
+        }
+        closed[index] = true;
+        if(isTarget[index])
+        {
+            --numTargetsLeft;
+        }
+
+        cell_t cell(xStart + index % width, yStart + index / width);
+        for(int n = 0; n < kNumNeighbors; ++n)
+        {
+            cell_t neighbor(cell.x + xDeltas[n], cell.y + yDeltas[n]);
+            if(neighbor.x < xStart || neighbor.x >= xEnd || neighbor.y < yStart || neighbor.y >= yEnd
+                || !is_traversable(neighbor.x, neighbor.y, distances_, params_))
+            {
+                continue;
+            }
+
+            int neighborIndex = localIndex(neighbor);
+            double neighborCost = cost[index] + step_cost(neighbor.x, neighbor.y, n >= 4, distances_, params_);
+            if(neighborCost < cost[neighborIndex])
+            {
+                cost[neighborIndex] = neighborCost;
+                parent[neighborIndex] = index;
+                searchQueue.emplace(neighborCost, neighborIndex);
+            }
+        }
+    }
+
+    std::vector<AbstractEdge> edges;
+    for(auto&& target : targets)
+    {
+        int index = localIndex(target);
+        if(!closed[index])
+        {
+            continue;
+        }
+
+        AbstractEdge edge;
+        edge.target = cellIndex(target);
+        edge.cost = cost[index];
+        for(; index != localIndex(source); index = parent[index])
+        {
+            edge.cells.emplace_back(xStart + index % width, yStart + index / width);
+        }
+        std::reverse(edge.cells.begin(), edge.cells.end());
+        edges.push_back(std::move(edge));
+    }
+
+    return edges;
+}
@@ -0,0 +1,256 @@
+#include <planning/local_planner.hpp>
+#include <planning/obstacle_distance_grid.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace
+{
+
+double clamp(double value, double minValue, double maxValue)
+{
+    return std::max(minValue, std::min(value, maxValue));
+}
+
+// Evenly spaced values from minValue to maxValue
+double sample_value(double minValue, double maxValue, int index, int numSamples)
+{
+    return (numSamples > 1) ? minValue + (maxValue - minValue) * index / (numSamples - 1)
+                            : 0.5 * (minValue + maxValue);
+}
+
+float clearance_at(float x, float y, const ObstacleDistanceGrid& distances)
+{
+    Point<float> origin = distances.originInGlobalFrame();
+    int cellX = static_cast<int>(std::floor((x - origin.x) * distances.cellsPerMeter()));
+    int cellY = static_cast<int>(std::floor((y - origin.y) * distances.cellsPerMeter()));
+    // Anywhere off the map is treated like unknown space
+    return distances.isCellInGrid(cellX, cellY) ? distances(cellX, cellY) : 0.0f;
+}
+
+// Finds the closest point on the path. Returns its distance, and sets pathLength to how far along the path it is
+double distance_to_path(double x, double y, const std::vector<mbot_lcm_msgs::pose2D_t>& path, double& pathLength)
+{
+    double minDistanceSq = std::pow(x - path.front().x, 2) + std::pow(y - path.front().y, 2);
+    double segmentStart = 0.0;
+    pathLength = 0.0;
+    for(std::size_t n = 1; n < path.size(); ++n)
+    {
+        double segmentX = path[n].x - path[n-1].x;
+        double segmentY = path[n].y - path[n-1].y;
+        double lengthSq = segmentX * segmentX + segmentY * segmentY;
+        double fraction = 0.0;
+        if(lengthSq > 0.0)
+        {
+            fraction = clamp(((x - path[n-1].x) * segmentX + (y - path[n-1].y) * segmentY) / lengthSq, 0.0, 1.0);
+        }
+        double dx = x - (path[n-1].x + fraction * segmentX);
+        double dy = y - (path[n-1].y + fraction * segmentY);
+        if(dx*dx + dy*dy < minDistanceSq)
+        {
+            minDistanceSq = dx*dx + dy*dy;
+            pathLength = segmentStart + fraction * std::sqrt(lengthSq);
+        }
+        segmentStart += std::sqrt(lengthSq);
+    }
+    return std::sqrt(minDistanceSq);
+}
+
+} // namespace
+
+
+DynamicWindowPlanner::DynamicWindowPlanner(const LocalPlannerParams& params)
+: params_(params)
+{
+    reset();
+}
+
+
+void DynamicWindowPlanner::reset(void)
+{
+    lastCommand_.utime = 0;
+    lastCommand_.vx = 0.0f;
+    lastCommand_.vy = 0.0f;
+    lastCommand_.wz = 0.0f;
+    stats_ = LocalPlannerStats{0, 0, false, 0.0};
+}
+
+
+mbot_lcm_msgs::twist2D_t DynamicWindowPlanner::computeCommand(const mbot_lcm_msgs::pose2D_t& pose,
+                                                              const mbot_lcm_msgs::twist2D_t& desired,
+                                                              const std::vector<mbot_lcm_msgs::pose2D_t>& path,
+                                                              const ObstacleDistanceGrid& distances)
+{
+    sampleWindow(desired);
+    simulateSamples(pose, distances);
+
+    // Moving away from an obstacle is always allowed, even if the robot has already ended up too close to it
+    const float startClearance = clearance_at(pose.x, pose.y, distances);
+    const float minAllowedClearance = std::min(static_cast<float>(params_.robotRadius), startClearance);
+    const double clearanceRange = std::max(params_.comfortClearance - params_.robotRadius, 1e-3);
+    const double maxProgress = std::max(params_.maxVel * params_.horizonSec, 1e-3);
+    const int numSamples = vel_.size();
+
+    double startPathLength = 0.0;
+    if(!path.empty())
+    {
+        distance_to_path(pose.x, pose.y, path, startPathLength);
+    }
+
+    int bestSample = -1;
+    double bestCost = std::numeric_limits<double>::max();
+    int numRejected = 0;
+
+    // The desired command is sample 0. If it stays clear of obstacles, there's nothing to improve on
+    if(minClearance_[0] >= params_.comfortClearance)
+    {
+        bestSample = 0;
+    }
+
+    for(int n = 0; (n < numSamples) && (bestSample != 0); ++n)
+    {
+        if(minClearance_[n] < minAllowedClearance)
+        {
+            ++numRejected;
+            continue;
+        }
+
+        double velError = (vel_[n] - desired.vx) / params_.maxVel;
+        double angularVelError = (angularVel_[n] - desired.wz) / params_.maxAngularVel;
+        double cost = params_.commandWeight * (velError * velError + angularVelError * angularVelError);
+        if(params_.maxLateralVel > 0.0)
+        {
+            double lateralVelError = (lateralVel_[n] - desired.vy) / params_.maxLateralVel;
+            cost += params_.commandWeight * lateralVelError * lateralVelError;
+        }
+
+        // Without a reward for making progress, stopping would always be the cheapest way around an obstacle
+        if(!path.empty())
+        {
+            double pathLength = 0.0;
+            cost += params_.pathWeight * distance_to_path(x_[n], y_[n], path, pathLength);
+            cost -= params_.progressWeight * (pathLength - startPathLength) / maxProgress;
+        }
+
+        cost += params_.clearanceWeight * clamp((params_.comfortClearance - minClearance_[n]) / clearanceRange, 0.0, 1.0);
+
+        if(cost < bestCost)
+        {
+            bestCost = cost;
+            bestSample = n;
+        }
+    }
+
+    mbot_lcm_msgs::twist2D_t command {desired.utime, 0.0f, 0.0f, 0.0f};
+    if(bestSample >= 0)
+    {
+        command.vx = vel_[bestSample];
+        command.vy = lateralVel_[bestSample];
+        command.wz = angularVel_[bestSample];
+    }
+
+    stats_.numSamples = numSamples;
+    stats_.numRejected = numRejected;
+    stats_.changedCommand = bestSample != 0;
+    stats_.minClearance = (bestSample >= 0) ? minClearance_[bestSample] : startClearance;
+
+    lastCommand_ = command;
+    return command;
+}
+
+
+void DynamicWindowPlanner::sampleWindow(const mbot_lcm_msgs::twist2D_t& desired)
+{
+    const bool isHolonomic = params_.maxLateralVel > 0.0;
+    const int numVel = std::max(params_.numVelSamples, 1);
+    const int numLateral = isHolonomic ? std::max(params_.numLateralSamples, 1) : 1;
+    const int numAngular = std::max(params_.numAngularSamples, 1);
+
+    vel_.clear();
+    lateralVel_.clear();
+    angularVel_.clear();
+
+    // The desired command comes first, so it wins ties. Stopping comes next, so there's a choice when everything
+    // else is blocked.
+    vel_.push_back(clamp(desired.vx, -params_.maxVel, params_.maxVel));
+    lateralVel_.push_back(isHolonomic ? clamp(desired.vy, -params_.maxLateralVel, params_.maxLateralVel) : 0.0);
+    angularVel_.push_back(clamp(desired.wz, -params_.maxAngularVel, params_.maxAngularVel));
+
+    vel_.push_back(0.0f);
+    lateralVel_.push_back(0.0f);
+    angularVel_.push_back(0.0f);
+
+    double velChange = params_.maxAccel * params_.windowSec;
+    double angularVelChange = params_.maxAngularAccel * params_.windowSec;
+
+    double minVel = clamp(lastCommand_.vx - velChange, -params_.maxVel, params_.maxVel);
+    double maxVel = clamp(lastCommand_.vx + velChange, -params_.maxVel, params_.maxVel);
+    double minLateralVel = clamp(lastCommand_.vy - velChange, -params_.maxLateralVel, params_.maxLateralVel);
+    double maxLateralVel = clamp(lastCommand_.vy + velChange, -params_.maxLateralVel, params_.maxLateralVel);
+    double minAngularVel = clamp(lastCommand_.wz - angularVelChange, -params_.maxAngularVel, params_.maxAngularVel);
+    double maxAngularVel = clamp(lastCommand_.wz + angularVelChange, -params_.maxAngularVel, params_.maxAngularVel);
+
+    for(int v = 0; v < numVel; ++v)
+    {
+        for(int l = 0; l < numLateral; ++l)
+        {
+            for(int w = 0; w < numAngular; ++w)
+            {
+                vel_.push_back(sample_value(minVel, maxVel, v, numVel));
+                lateralVel_.push_back(isHolonomic ? sample_value(minLateralVel, maxLateralVel, l, numLateral) : 0.0);
+                angularVel_.push_back(sample_value(minAngularVel, maxAngularVel, w, numAngular));
+            }
+        }
+    }
+}
+
+
+void DynamicWindowPlanner::simulateSamples(const mbot_lcm_msgs::pose2D_t& pose, const ObstacleDistanceGrid& distances)
+{
+    const int numSamples = vel_.size();
+    const int numSteps = std::max(static_cast<int>(std::lround(params_.horizonSec / params_.stepSec)), 1);
+    const float dt = params_.stepSec;
+
+    x_.assign(numSamples, pose.x);
+    y_.assign(numSamples, pose.y);
+    cosTheta_.assign(numSamples, std::cos(pose.theta));
+    sinTheta_.assign(numSamples, std::sin(pose.theta));
+    cosStep_.resize(numSamples);
+    sinStep_.resize(numSamples);
+    minClearance_.assign(numSamples, clearance_at(pose.x, pose.y, distances));
+
+    for(int n = 0; n < numSamples; ++n)
+    {
+        cosStep_[n] = std::cos(angularVel_[n] * dt);
+        sinStep_[n] = std::sin(angularVel_[n] * dt);
+    }
+
+    float* x = x_.data();
+    float* y = y_.data();
+    float* cosTheta = cosTheta_.data();
+    float* sinTheta = sinTheta_.data();
+    const float* vel = vel_.data();
+    const float* lateralVel = lateralVel_.data();
+    const float* cosStep = cosStep_.data();
+    const float* sinStep = sinStep_.data();
+
+    for(int step = 0; step < numSteps; ++step)
+    {
+        // Move every sample forward one step with no branches or calls, so the loop is vectorized
+        for(int n = 0; n < numSamples; ++n)
+        {
+            float c = cosTheta[n];
+            float s = sinTheta[n];
+            x[n] += (vel[n] * c - lateralVel[n] * s) * dt;
+            y[n] += (vel[n] * s + lateralVel[n] * c) * dt;
+            cosTheta[n] = c * cosStep[n] - s * sinStep[n];
+            sinTheta[n] = s * cosStep[n] + c * sinStep[n];
+        }
+
+        for(int n = 0; n < numSamples; ++n)
+        {
+            minClearance_[n] = std::min(minClearance_[n], clearance_at(x[n], y[n], distances));
+        }
+    }
+}
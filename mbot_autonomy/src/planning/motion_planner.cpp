@@ -1,5 +1,6 @@
 #include <planning/motion_planner.hpp>
 #include <planning/astar.hpp>
+#include <planning/path_safety_monitor.hpp>
 #include <utils/grid_utils.hpp>
 #include <utils/timestamp.h>
 #include <mbot_lcm_msgs/path2D_t.hpp>
@@ -7,14 +8,16 @@
 
 
 MotionPlanner::MotionPlanner(const MotionPlannerParams& params)
-: params_(params)
+: hierarchy_(params.clusterSizeInCells)
+, params_(params)
 {
     setParams(params);
 }
 
 
 MotionPlanner::MotionPlanner(const MotionPlannerParams& params, const SearchParams& searchParams)
-: params_(params)
+: hierarchy_(params.clusterSizeInCells)
+, params_(params)
 , searchParams_(searchParams)
 {
 }
@@ -45,6 +48,12 @@ mbot_lcm_msgs::path2D_t MotionPlanner::planPath(const mbot_lcm_msgs::pose2D_t& s
 mbot_lcm_msgs::path2D_t MotionPlanner::planPath(const mbot_lcm_msgs::pose2D_t& start,
                                                      const mbot_lcm_msgs::pose2D_t& goal) const
 {
+    // The hierarchy is built with the default search parameters, so it can only be used here
+    if(params_.useHierarchicalSearch && isValidGoal(goal))
+    {
+        return hierarchy_.planPath(start, goal);
+    }
+
     return planPath(start, goal, searchParams_);
 }
 
@@ -89,8 +98,28 @@ bool MotionPlanner::isValidGoal(const Point<int>& goalCell) const
 
 bool MotionPlanner::isPathSafe(const mbot_lcm_msgs::path2D_t& path) const
 {
+    // A path is safe if every cell it passes through is far enough from obstacles for the robot to occupy it. Allow
+    // a cell of slack, because the straight lines between poses can cut a little closer than the planned cells did.
+    const double minDistance = params_.robotRadius - distances_.metersPerCell();
 
-    ///////////// TODO: Implement your test for a safe path here //////////////////
+    std::vector<Point<int>> cells;
+    for(std::size_t n = 1; n < path.path.size(); ++n)
+    {
+        cells.clear();
+        trace_segment_cells(global_position_to_grid_position(Point<double>(path.path[n-1].x, path.path[n-1].y), distances_),
+                            global_position_to_grid_position(Point<double>(path.path[n].x, path.path[n].y), distances_),
+                            cells);
+
+        for(auto& cell : cells)
+        {
+            // The robot might already be close to an obstacle, so the cell it starts in isn't checked
+            bool isStartCell = (n == 1) && (&cell == &cells.front());
+            if(!isStartCell && (!distances_.isCellInGrid(cell.x, cell.y) || (distances_(cell.x, cell.y) < minDistance)))
+            {
+                return false;
+            }
+        }
+    }
 
     return true;
 }
@@ -99,6 +128,11 @@ bool MotionPlanner::isPathSafe(const mbot_lcm_msgs::path2D_t& path) const
 void MotionPlanner::setMap(const OccupancyGrid& map)
 {
     distances_.setDistances(map);
+
+    if(params_.useHierarchicalSearch)
+    {
+        hierarchy_.setDistances(distances_, searchParams_);
+    }
 }
 
 
@@ -53,6 +53,11 @@ void ObstacleDistanceGrid::setDistances(const OccupancyGrid& map)
     {
         auto nextNode = searchQueue.top();
         searchQueue.pop();
+        // Skip cells that were reached by a shorter route after this node was queued
+        if (nextNode.distance * metersPerCell() > distance(nextNode.cell.x, nextNode.cell.y))
+        {
+            continue;
+        }
         expand_node(nextNode, *this, searchQueue);
     }
 }
@@ -115,12 +120,15 @@ void expand_node(const DistanceNode& node, ObstacleDistanceGrid& grid, std::prio
         cell_t adjacentCell(node.cell.x + xDeltas[n], node.cell.y + yDeltas[n]);
         if (grid.isCellInGrid(adjacentCell.x, adjacentCell.y))
         {
-            // Not seen yet
-            if (grid(adjacentCell.x, adjacentCell.y) < 0)
+            float distance = node.distance;
+            if (n < 4) distance += 1.0;
+            else distance += 1.414;
+
+            // Not seen yet, or reached by a shorter route. Keeping the shortest route makes the distances independent
+            // of the order cells are expanded in, so changing part of the map only changes the distances near it.
+            float currentDistance = grid(adjacentCell.x, adjacentCell.y);
+            if (currentDistance < 0 || distance * grid.metersPerCell() < currentDistance)
             {
-                float distance = node.distance;
-                if (n < 4) distance += 1.0;
-                else distance += 1.414;
                 DistanceNode adjacentNode(adjacentCell, distance);
                 grid(adjacentCell.x, adjacentCell.y) = adjacentNode.distance * grid.metersPerCell();
                 search_queue.push(adjacentNode);
@@ -1,11 +1,18 @@
 #include <planning/obstacle_distance_grid.hpp>
 #include <slam/occupancy_grid.hpp>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <random>
+#include <vector>
 
 /*
 * The distance grid test uses a simple square environment with free space in the center of the square. Obstacles one
 * cell from the edge, and unknown cells along the edge. The test makes sure that unknown and obstacle cells are 
 * distance 0 and a scattering of cells inside the free space have the correct distances.
+*
+* A second environment scatters single obstacle cells over free space, so most cells can be reached from several
+* obstacles. Every free cell must hold the shortest 8-way distance to any of them, no matter which was expanded first.
 */
 
 
@@ -13,13 +20,18 @@ const int kGridSideLength = 25;
 const int obstacleLowIndex = 1;
 const int obstacleHighIndex = kGridSideLength - 2;
 
+const int kScatteredSideLength = 40;
+const int kNumScatteredObstacles = 30;
+
 
 bool test_unknown_distances(void);
 bool test_obstacle_distances(void);
 bool test_free_space_distances(void);
+bool test_scattered_obstacle_distances(void);
 float expected_free_distance(int x, int y, const OccupancyGrid& map);
 
 OccupancyGrid generate_grid(void);
+OccupancyGrid generate_scattered_grid(std::vector<cell_t>& obstacles);
 
 
 int main(int argc, char** argv)
@@ -50,6 +62,15 @@ int main(int argc, char** argv)
     {
         std::cout << "FAILED: test_free_space_distances\n";
     }
+
+    if(test_scattered_obstacle_distances())
+    {
+        std::cout << "PASSED: test_scattered_obstacle_distances\n";
+    }
+    else
+    {
+        std::cout << "FAILED: test_scattered_obstacle_distances\n";
+    }
     
     return 0;
 }
@@ -157,6 +178,57 @@ bool test_free_space_distances(void)
 }
 
 
+bool test_scattered_obstacle_distances(void)
+{
+    std::vector<cell_t> obstacles;
+    OccupancyGrid grid = generate_scattered_grid(obstacles);
+    ObstacleDistanceGrid distances;
+    distances.setDistances(grid);
+
+    int numFreeCells = 0;
+    int numCorrectFreeDistances = 0;
+
+    for(int y = 0; y < grid.heightInCells(); ++y)
+    {
+        for(int x = 0; x < grid.widthInCells(); ++x)
+        {
+            if(grid(x, y) >= 0)
+            {
+                continue;
+            }
+
+            ++numFreeCells;
+
+            // With nothing in the way, the shortest 8-way route to an obstacle takes the diagonal steps first, then
+            // the straight ones
+            float expectedDist = 1.0E16;
+            for(auto& obstacle : obstacles)
+            {
+                int dx = std::abs(obstacle.x - x);
+                int dy = std::abs(obstacle.y - y);
+                float routeDist = (std::max(dx, dy) - std::min(dx, dy)) + 1.414f * std::min(dx, dy);
+                expectedDist = std::min(expectedDist, routeDist * grid.metersPerCell());
+            }
+
+            if(std::abs(distances(x, y) - expectedDist) < 0.0001)
+            {
+                ++numCorrectFreeDistances;
+            }
+            else
+            {
+                std::cout << "FAILED: (" << x << ',' << y << ") Expected:" << expectedDist << " Stored:"
+                    << distances(x, y) << '\n';
+            }
+        }
+    }
+
+    std::cout << "Scattered test result: Num free cells:" << numFreeCells << " Num correct dists:"
+        << numCorrectFreeDistances << '\n';
+
+    return numFreeCells == numCorrectFreeDistances;
+}
+
+
 float expected_free_distance(int x, int y, const OccupancyGrid& map)
 {
     // Because the grid is a square, the nearest obstacle is always a horizontal or vertical wall. The expected distance
@@ -194,3 +266,30 @@ OccupancyGrid generate_grid(void)
     
     return grid;
 }
+
+
+OccupancyGrid generate_scattered_grid(std::vector<cell_t>& obstacles)
+{
+    const float kMetersPerCell = 0.05f;
+
+    OccupancyGrid grid(kScatteredSideLength * kMetersPerCell, kScatteredSideLength * kMetersPerCell, kMetersPerCell);
+    for(int y = 0; y < grid.heightInCells(); ++y)
+    {
+        for(int x = 0; x < grid.widthInCells(); ++x)
+        {
+            grid(x, y) = -50;
+        }
+    }
+
+    // A fixed seed keeps the test repeatable
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> cellDist(0, kScatteredSideLength - 1);
+    for(int n = 0; n < kNumScatteredObstacles; ++n)
+    {
+        cell_t obstacle(cellDist(rng), cellDist(rng));
+        grid(obstacle.x, obstacle.y) = 50;
+        obstacles.push_back(obstacle);
+    }
+
+    return grid;
+}
@@ -0,0 +1,205 @@
+#include <planning/path_safety_monitor.hpp>
+#include <planning/obstacle_distance_grid.hpp>
+#include <utils/grid_utils.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace
+{
+
+// Squared distance from (x, y) to the segment from a to b
+double distance_to_segment_sq(double x, double y, const mbot_lcm_msgs::pose2D_t& a, const mbot_lcm_msgs::pose2D_t& b)
+{
+    double segmentX = b.x - a.x;
+    double segmentY = b.y - a.y;
+    double lengthSq = segmentX * segmentX + segmentY * segmentY;
+    double fraction = 0.0;
+    if(lengthSq > 0.0)
+    {
+        fraction = std::max(0.0, std::min(((x - a.x) * segmentX + (y - a.y) * segmentY) / lengthSq, 1.0));
+    }
+    double dx = x - (a.x + fraction * segmentX);
+    double dy = y - (a.y + fraction * segmentY);
+    return dx*dx + dy*dy;
+}
+
+} // namespace
+
+
+PathSafetyMonitor::PathSafetyMonitor(double clearance)
+: clearance_(clearance)
+, currentSegment_(0)
+, width_(0)
+, height_(0)
+, metersPerCell_(0.0f)
+, numChangedCells_(0)
+{
+}
+
+
+void PathSafetyMonitor::setPath(const mbot_lcm_msgs::path2D_t& path, const ObstacleDistanceGrid& distances)
+{
+    path_ = path;
+    currentSegment_ = 0;
+    traceCells(distances);
+}
+
+
+void PathSafetyMonitor::clearPath(void)
+{
+    path_.path.clear();
+    path_.path_length = 0;
+    cells_.clear();
+    cellSegment_.clear();
+    cellBlocked_.clear();
+    segmentStart_.clear();
+    currentSegment_ = 0;
+}
+
+
+int PathSafetyMonitor::update(const ObstacleDistanceGrid& distances, const mbot_lcm_msgs::pose2D_t& robotPose)
+{
+    numChangedCells_ = 0;
+    if(segmentStart_.empty())
+    {
+        return -1;
+    }
+
+    if(!isSameGrid(distances))
+    {
+        traceCells(distances);
+    }
+
+    currentSegment_ = findCurrentSegment(robotPose);
+
+    // The robot might already be close to an obstacle, so the cells it's in the middle of are skipped
+    const float clearance = clearance_;
+    const float robotX = (robotPose.x - origin_.x) * distances.cellsPerMeter() - 0.5f;
+    const float robotY = (robotPose.y - origin_.y) * distances.cellsPerMeter() - 0.5f;
+    const float skipRadiusSq = std::pow(clearance_ * distances.cellsPerMeter(), 2);
+
+    // All saved cells are in the grid, so unchecked access is safe
+    const int numCells = cells_.size();
+    int firstUnsafeCell = numCells;
+    for(int n = segmentStart_[currentSegment_]; n < numCells; ++n)
+    {
+        const Point<int>& cell = cells_[n];
+        float dx = cell.x - robotX;
+        float dy = cell.y - robotY;
+        uint8_t isBlocked = (distances(cell.x, cell.y) < clearance) && (dx*dx + dy*dy > skipRadiusSq);
+        numChangedCells_ += isBlocked != cellBlocked_[n];
+        cellBlocked_[n] = isBlocked;
+        if(isBlocked && (firstUnsafeCell == numCells))
+        {
+            firstUnsafeCell = n;
+        }
+    }
+
+    // The cells are sorted by segment, so the first blocked cell belongs to the first unsafe segment
+    return (firstUnsafeCell < numCells) ? cellSegment_[firstUnsafeCell] : -1;
+}
+
+
+void PathSafetyMonitor::traceCells(const ObstacleDistanceGrid& distances)
+{
+    width_ = distances.widthInCells();
+    height_ = distances.heightInCells();
+    metersPerCell_ = distances.metersPerCell();
+    origin_ = distances.originInGlobalFrame();
+
+    cells_.clear();
+    cellSegment_.clear();
+    cellBlocked_.clear();
+    segmentStart_.clear();
+
+    std::vector<Point<int>> tracedCells;
+    const int numSegments = static_cast<int>(path_.path.size()) - 1;
+    for(int segment = 0; segment < numSegments; ++segment)
+    {
+        const mbot_lcm_msgs::pose2D_t& start = path_.path[segment];
+        const mbot_lcm_msgs::pose2D_t& end = path_.path[segment + 1];
+        segmentStart_.push_back(cells_.size());
+
+        tracedCells.clear();
+        trace_segment_cells(global_position_to_grid_position(Point<double>(start.x, start.y), distances),
+                            global_position_to_grid_position(Point<double>(end.x, end.y), distances),
+                            tracedCells);
+
+        // Each segment starts in the cell the last one ended in, so it's only saved once
+        for(std::size_t n = (segment == 0) ? 0 : 1; n < tracedCells.size(); ++n)
+        {
+            if(distances.isCellInGrid(tracedCells[n].x, tracedCells[n].y))
+            {
+                cells_.push_back(tracedCells[n]);
+                cellSegment_.push_back(segment);
+                cellBlocked_.push_back(0);
+            }
+        }
+    }
+}
+
+
+bool PathSafetyMonitor::isSameGrid(const ObstacleDistanceGrid& distances) const
+{
+    return (distances.widthInCells() == width_)
+        && (distances.heightInCells() == height_)
+        && (distances.metersPerCell() == metersPerCell_)
+        && (distances.originInGlobalFrame().x == origin_.x)
+        && (distances.originInGlobalFrame().y == origin_.y);
+}
+
+
+int PathSafetyMonitor::findCurrentSegment(const mbot_lcm_msgs::pose2D_t& robotPose) const
+{
+    // The robot only moves forward along the path, so segments already passed aren't searched
+    int bestSegment = currentSegment_;
+    double bestDistanceSq = std::numeric_limits<double>::max();
+    for(int segment = currentSegment_; segment + 1 < static_cast<int>(path_.path.size()); ++segment)
+    {
+        double distanceSq = distance_to_segment_sq(robotPose.x, robotPose.y, path_.path[segment], path_.path[segment + 1]);
+        if(distanceSq < bestDistanceSq)
+        {
+            bestDistanceSq = distanceSq;
+            bestSegment = segment;
+        }
+    }
+    return bestSegment;
+}
+
+
+void trace_segment_cells(const Point<double>& start, const Point<double>& end, std::vector<Point<int>>& cells)
+{
+    // Walk the cells along the segment one boundary crossing at a time (Amanatides & Woo)
+    Point<int> cell(static_cast<int>(std::floor(start.x)), static_cast<int>(std::floor(start.y)));
+    const Point<int> endCell(static_cast<int>(std::floor(end.x)), static_cast<int>(std::floor(end.y)));
+    const double dx = end.x - start.x;
+    const double dy = end.y - start.y;
+    const int stepX = (dx > 0.0) ? 1 : -1;
+    const int stepY = (dy > 0.0) ? 1 : -1;
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // Fraction of the segment needed to cross one cell, and to reach the next cell boundary, along each axis
+    const double deltaX = (dx != 0.0) ? std::abs(1.0 / dx) : inf;
+    const double deltaY = (dy != 0.0) ? std::abs(1.0 / dy) : inf;
+    double nextX = (dx != 0.0) ? ((stepX > 0) ? (cell.x + 1 - start.x) : (start.x - cell.x)) * deltaX : inf;
+    double nextY = (dy != 0.0) ? ((stepY > 0) ? (cell.y + 1 - start.y) : (start.y - cell.y)) * deltaY : inf;
+
+    cells.push_back(cell);
+    const int numSteps = std::abs(endCell.x - cell.x) + std::abs(endCell.y - cell.y);
+    for(int n = 0; n < numSteps; ++n)
+    {
+        if(nextX < nextY)
+        {
+            cell.x += stepX;
+            nextX += deltaX;
+        }
+        else
+        {
+            cell.y += stepY;
+            nextY += deltaY;
+        }
+        cells.push_back(cell);
+    }
+}
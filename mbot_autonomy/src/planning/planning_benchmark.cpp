@@ -0,0 +1,783 @@
+#include <planning/astar.hpp>
+#include <planning/frontiers.hpp>
+#include <planning/hierarchical_planner.hpp>
+#include <planning/motion_planner.hpp>
+#include <planning/obstacle_distance_grid.hpp>
+#include <planning/path_safety_monitor.hpp>
+#include <slam/occupancy_grid.hpp>
+#include <utils/grid_utils.hpp>
+#include <utils/getopt.h>
+#include <utils/zarray.h>
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <mbot_lcm_msgs/path2D_t.hpp>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace mbot_lcm_msgs;
+using namespace std::chrono;
+
+/*
+* planning_benchmark measures the latency of the planning pipeline on large maps, so regressions in the planner are
+* caught before they reach a robot. Each map is run through:
+*
+*   - ObstacleDistanceGrid::setDistances
+*   - search_for_path between random pairs of valid cells, with and without Jump Point Search, checking both find
+*     paths of the same cost
+*   - HierarchicalPlanner::planPath between the same pairs, checking it finds a path whenever A* does and that the path
+*     is no more than kMaxHpaCostRatio times the cost of the A* path
+*   - find_map_frontiers and plan_path_to_frontier on a partially explored copy of the map
+*   - FrontierDetector::update as the explored area grows
+*   - PathSafetyMonitor::update and MotionPlanner::isPathSafe on the paths found, with and without an obstacle added
+*     on the path
+*
+* Maps are either generated (mazes, offices, and open halls) or loaded from saved .map files given on the command line.
+* The results are written as JSON with the p50/p95/max latency of each operation, the nodes expanded by the searches,
+* and the peak memory used while benchmarking each map.
+*/
+
+const float kMetersPerCell = 0.05f;
+
+// Fraction of the map width around the robot that is known in the partially explored map
+const double kExploredRadiusFraction = 0.25;
+// How far the explored area grows between FrontierDetector updates (meters)
+const double kExploredGrowthPerUpdate = 0.5;
+
+// HPA* paths only search the clusters the abstract path crosses, so they can take a different doorway than A* paths
+const double kMaxHpaCostRatio = 1.6;
+
+const int8_t kFreeOdds = -50;
+const int8_t kOccupiedOdds = 100;
+
+
+/*
+* sample_stats_t holds the measurements of one operation on one map.
+*/
+struct sample_stats_t
+{
+    std::vector<double> latencyUs;
+    std::vector<double> expandedNodes;
+    int numSucceeded = 0;
+};
+
+struct operation_result_t
+{
+    std::string name;
+    sample_stats_t stats;
+};
+
+struct map_result_t
+{
+    std::string name;
+    std::string source;
+    int widthInCells;
+    int heightInCells;
+    long peakRssKb;
+    std::vector<operation_result_t> operations;
+};
+
+
+OccupancyGrid generate_maze(int sizeInCells, std::mt19937& rng);
+OccupancyGrid generate_office(int sizeInCells, std::mt19937& rng);
+OccupancyGrid generate_open_hall(int sizeInCells, std::mt19937& rng);
+
+map_result_t benchmark_map(const OccupancyGrid& map,
+                           const std::string& name,
+                           const std::string& source,
+                           int numRepeats,
+                           int numQueries,
+                           std::mt19937& rng);
+
+OccupancyGrid partially_explored_map(const OccupancyGrid& map, const pose2D_t& robotPose, double radius);
+bool find_start_pose(const MotionPlanner& planner, pose2D_t& pose);
+
+void reset_peak_rss(void);
+long read_peak_rss_kb(void);
+
+double percentile(std::vector<double> values, double fraction);
+void write_distribution(std::ostream& out, const std::vector<double>& values);
+void write_json(std::ostream& out, const std::vector<map_result_t>& results, int numRepeats, int numQueries, int seed);
+
+
+int main(int argc, char** argv)
+{
+    const char* sizesArg = "sizes";
+    const char* typesArg = "types";
+    const char* numRepeatsArg = "num-repeats";
+    const char* numQueriesArg = "num-queries";
+    const char* seedArg = "seed";
+    const char* outputArg = "output";
+
+    getopt_t *gopt = getopt_create();
+    getopt_add_bool(gopt, 'h', "help", 0, "Show this help message.");
+    getopt_add_string(gopt, '\0', sizesArg, "800,2000,4000", "Comma-separated side lengths, in cells, of the generated"
+                    " maps. Use an empty string to only run the saved maps.");
+    getopt_add_string(gopt, '\0', typesArg, "maze,office,hall", "Comma-separated types of generated maps to run.");
+    getopt_add_int(gopt, '\0', numRepeatsArg, "3", "Number of times setDistances and frontier detection are run"
+                    " on each map.");
+    getopt_add_int(gopt, '\0', numQueriesArg, "10", "Number of random start/goal pairs searched on each map.");
+    getopt_add_int(gopt, '\0', seedArg, "1", "Seed for the generated maps and queries.");
+    getopt_add_string(gopt, 'o', outputArg, "planning_benchmark.json", "File to write the JSON results to. The planner"
+                    " prints its own diagnostics to stdout, so the results aren't written there.");
+
+    if(!getopt_parse(gopt, argc, argv, 1) || getopt_get_bool(gopt, "help"))
+    {
+        printf("Usage: %s [options] [saved.map ...]\n", argv[0]);
+        printf("Any extra arguments are loaded as saved maps and benchmarked along with the generated maps.\n\n");
+        getopt_do_usage(gopt);
+        return 1;
+    }
+
+    int numRepeats = std::max(getopt_get_int(gopt, numRepeatsArg), 1);
+    int numQueries = std::max(getopt_get_int(gopt, numQueriesArg), 1);
+    int seed = getopt_get_int(gopt, seedArg);
+    std::string outputFile = getopt_get_string(gopt, outputArg);
+
+    std::vector<int> sizes;
+    std::stringstream sizesIn(getopt_get_string(gopt, sizesArg));
+    for(std::string size; std::getline(sizesIn, size, ',');)
+    {
+        if(!size.empty())
+        {
+            sizes.push_back(std::stoi(size));
+        }
+    }
+
+    std::vector<std::string> types;
+    std::stringstream typesIn(getopt_get_string(gopt, typesArg));
+    for(std::string type; std::getline(typesIn, type, ',');)
+    {
+        if(type == "maze" || type == "office" || type == "hall")
+        {
+            types.push_back(type);
+        }
+        else if(!type.empty())
+        {
+            fprintf(stderr, "ERROR: Unknown map type %s. Valid types are maze, office, and hall.\n", type.c_str());
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<map_result_t> results;
+
+    for(int size : sizes)
+    {
+        for(auto& type : types)
+        {
+            std::string name = type + "_" + std::to_string(size);
+            fprintf(stderr, "Benchmarking %s...\n", name.c_str());
+
+            reset_peak_rss();
+            OccupancyGrid map = (type == "maze") ? generate_maze(size, rng)
+                              : (type == "office") ? generate_office(size, rng)
+                              : generate_open_hall(size, rng);
+            results.push_back(benchmark_map(map, name, "generated", numRepeats, numQueries, rng));
+        }
+    }
+
+    const zarray_t* mapFiles = getopt_get_extra_args(gopt);
+    for(int n = 0; n < zarray_size(mapFiles); ++n)
+    {
+        char* mapFile;
+        zarray_get(mapFiles, n, &mapFile);
+        fprintf(stderr, "Benchmarking %s...\n", mapFile);
+
+        reset_peak_rss();
+        OccupancyGrid map;
+        if(!map.loadFromFile(mapFile))
+        {
+            fprintf(stderr, "ERROR: Failed to load map %s. Skipping it.\n", mapFile);
+            continue;
+        }
+        results.push_back(benchmark_map(map, mapFile, "file", numRepeats, numQueries, rng));
+    }
+
+    std::ofstream out(outputFile);
+    if(!out.is_open())
+    {
+        fprintf(stderr, "ERROR: Failed to open %s for writing.\n", outputFile.c_str());
+        return 1;
+    }
+    write_json(out, results, numRepeats, numQueries, seed);
+    fprintf(stderr, "Wrote results for %d maps to %s\n", static_cast<int>(results.size()), outputFile.c_str());
+
+    getopt_destroy(gopt);
+    return 0;
+}
+
+
+map_result_t benchmark_map(const OccupancyGrid& map,
+                           const std::string& name,
+                           const std::string& source,
+                           int numRepeats,
+                           int numQueries,
+                           std::mt19937& rng)
+{
+    map_result_t result;
+    result.name = name;
+    result.source = source;
+    result.widthInCells = map.widthInCells();
+    result.heightInCells = map.heightInCells();
+
+    // setDistances
+    operation_result_t distancesOp;
+    distancesOp.name = "set_distances";
+    for(int n = 0; n < numRepeats; ++n)
+    {
+        ObstacleDistanceGrid distances;
+        auto start = steady_clock::now();
+        distances.setDistances(map);
+        distancesOp.stats.latencyUs.push_back(duration_cast<microseconds>(steady_clock::now() - start).count());
+        ++distancesOp.stats.numSucceeded;
+    }
+    result.operations.push_back(distancesOp);
+
+    MotionPlanner planner;
+    planner.setMap(map);
+    const ObstacleDistanceGrid& distances = planner.obstacleDistances();
+
+    // search_for_path between random valid cells
+    std::vector<cell_t> validCells;
+    for(int y = 0; y < distances.heightInCells(); ++y)
+    {
+        for(int x = 0; x < distances.widthInCells(); ++x)
+        {
+            if(planner.isValidGoal(cell_t(x, y)))
+            {
+                validCells.emplace_back(x, y);
+            }
+        }
+    }
+
+    operation_result_t searchOp;
+    searchOp.name = "search_for_path";
+    // The same queries with Jump Point Search. A succeeded search is one whose path costs the same as the A* path.
+    operation_result_t jpsOp;
+    jpsOp.name = "search_for_path_jps";
+    // The same queries with HPA*. A succeeded search is one that finds a path exactly when A* does, costing at most
+    // kMaxHpaCostRatio times as much. Its expanded nodes are abstract nodes plus the cells expanded refining the path.
+    operation_result_t hpaOp;
+    hpaOp.name = "search_for_path_hpa";
+    HierarchicalPlanner hierarchy(MotionPlannerParams().clusterSizeInCells);
+    hierarchy.setDistances(distances, planner.searchParams());
+    std::vector<path2D_t> paths;
+    if(!validCells.empty())
+    {
+        std::uniform_int_distribution<std::size_t> cellDist(0, validCells.size() - 1);
+        for(int n = 0; n < numQueries; ++n)
+        {
+            pose2D_t start;
+            pose2D_t goal;
+            for(auto pose : { &start, &goal })
+            {
+                cell_t cell = validCells[cellDist(rng)];
+                Point<double> position = grid_position_to_global_position(Point<double>(cell.x + 0.5, cell.y + 0.5),
+                                                                          distances);
+                pose->utime = 0;
+                pose->x = position.x;
+                pose->y = position.y;
+                pose->theta = 0.0;
+            }
+
+            SearchParams params = planner.searchParams();
+            params.useJumpPoints = false;
+            SearchStats stats;
+            auto searchStart = steady_clock::now();
+            path2D_t path = search_for_path(start, goal, distances, params, &stats);
+            searchOp.stats.latencyUs.push_back(duration_cast<microseconds>(steady_clock::now() - searchStart).count());
+            searchOp.stats.expandedNodes.push_back(stats.expandedNodes);
+            if(path.path_length > 1)
+            {
+                ++searchOp.stats.numSucceeded;
+                paths.push_back(path);
+            }
+
+            // Jump Point Search must find a path of the same cost, or it changes the plans and not just the speed
+            params.useJumpPoints = true;
+            SearchStats jpsStats;
+            searchStart = steady_clock::now();
+            search_for_path(start, goal, distances, params, &jpsStats);
+            jpsOp.stats.latencyUs.push_back(duration_cast<microseconds>(steady_clock::now() - searchStart).count());
+            jpsOp.stats.expandedNodes.push_back(jpsStats.expandedNodes);
+            if(std::abs(jpsStats.pathCost - stats.pathCost) <= 1e-6 * std::max(stats.pathCost, 1.0))
+            {
+                ++jpsOp.stats.numSucceeded;
+            }
+            else
+            {
+                fprintf(stderr, "WARNING: JPS path from (%.2f, %.2f) to (%.2f, %.2f) costs %f, A* path costs %f.\n",
+                        start.x, start.y, goal.x, goal.y, jpsStats.pathCost, stats.pathCost);
+            }
+
+            SearchStats hpaStats;
+            searchStart = steady_clock::now();
+            path2D_t hpaPath = hierarchy.planPath(start, goal, &hpaStats);
+            hpaOp.stats.latencyUs.push_back(duration_cast<microseconds>(steady_clock::now() - searchStart).count());
+            hpaOp.stats.expandedNodes.push_back(hpaStats.expandedNodes);
+            bool hpaFound = hpaPath.path_length > 1;
+            if((hpaFound == (path.path_length > 1))
+                && (hpaStats.pathCost >= stats.pathCost - 1e-6 * std::max(stats.pathCost, 1.0))
+                && (hpaStats.pathCost <= kMaxHpaCostRatio * stats.pathCost + 1e-6))
+            {
+                ++hpaOp.stats.numSucceeded;
+            }
+            else
+            {
+                fprintf(stderr, "WARNING: HPA* path from (%.2f, %.2f) to (%.2f, %.2f) costs %f, A* path costs %f.\n",
+                        start.x, start.y, goal.x, goal.y, hpaStats.pathCost, stats.pathCost);
+            }
+        }
+    }
+    result.operations.push_back(searchOp);
+    result.operations.push_back(jpsOp);
+    result.operations.push_back(hpaOp);
+
+    // Path safety on the paths found above. A succeeded check is one that gives the right answer.
+    operation_result_t monitorOp;
+    monitorOp.name = "path_safety_monitor_update";
+    operation_result_t isSafeOp;
+    isSafeOp.name = "is_path_safe";
+    for(auto& path : paths)
+    {
+        PathSafetyMonitor monitor;
+        monitor.setPath(path, distances);
+
+        // Block the middle of the path on a copy of the map
+        OccupancyGrid blockedMap = map;
+        const pose2D_t& blockedPose = path.path[path.path.size() / 2];
+        cell_t blockedCell = global_position_to_grid_cell(Point<double>(blockedPose.x, blockedPose.y), map);
+        blockedMap(blockedCell.x, blockedCell.y) = kOccupiedOdds;
+        MotionPlanner blockedPlanner;
+        blockedPlanner.setMap(blockedMap);
+
+        for(bool isBlocked : { false, true })
+        {
+            const MotionPlanner& checkPlanner = isBlocked ? blockedPlanner : planner;
+            auto start = steady_clock::now();
+            int unsafeSegment = monitor.update(checkPlanner.obstacleDistances(), path.path.front());
+            monitorOp.stats.latencyUs.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0);
+            monitorOp.stats.expandedNodes.push_back(monitor.numPathCells());    // cells looked at per update
+            monitorOp.stats.numSucceeded += (unsafeSegment >= 0) == isBlocked;
+
+            start = steady_clock::now();
+            bool isSafe = checkPlanner.isPathSafe(path);
+            isSafeOp.stats.latencyUs.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0);
+            isSafeOp.stats.numSucceeded += isSafe != isBlocked;
+        }
+    }
+    result.operations.push_back(monitorOp);
+    result.operations.push_back(isSafeOp);
+
+    // Frontiers on a partially explored copy of the map
+    operation_result_t findFrontiersOp;
+    findFrontiersOp.name = "find_map_frontiers";
+    operation_result_t planFrontierOp;
+    planFrontierOp.name = "plan_path_to_frontier";
+    operation_result_t detectorOp;
+    detectorOp.name = "frontier_detector_update";
+
+    pose2D_t robotPose;
+    if(find_start_pose(planner, robotPose))
+    {
+        double exploredRadius = kExploredRadiusFraction * map.widthInMeters();
+        OccupancyGrid partialMap = partially_explored_map(map, robotPose, exploredRadius);
+
+        std::vector<frontier_t> frontiers;
+        for(int n = 0; n < numRepeats; ++n)
+        {
+            auto start = steady_clock::now();
+            frontiers = find_map_frontiers(partialMap, robotPose);
+            findFrontiersOp.stats.latencyUs.push_back(duration_cast<microseconds>(steady_clock::now() - start).count());
+            ++findFrontiersOp.stats.numSucceeded;
+        }
+
+        MotionPlanner partialPlanner;
+        partialPlanner.setMap(partialMap);
+        for(int n = 0; n < numRepeats; ++n)
+        {
+            auto start = steady_clock::now();
+            frontier_processing_t selected = plan_path_to_frontier(frontiers, robotPose, partialMap, partialPlanner);
+            planFrontierOp.stats.latencyUs.push_back(duration_cast<microseconds>(steady_clock::now() - start).count());
+            if(selected.path_selected.path_length > 1)
+            {
+                ++planFrontierOp.stats.numSucceeded;
+            }
+        }
+
+        // The first update of a detector searches the whole map, so only the updates after it are measured
+        FrontierDetector detector;
+        detector.update(partialMap, robotPose);
+        for(int n = 0; n < numRepeats; ++n)
+        {
+            exploredRadius += kExploredGrowthPerUpdate;
+            partialMap = partially_explored_map(map, robotPose, exploredRadius);
+
+            auto start = steady_clock::now();
+            detector.update(partialMap, robotPose);
+            detectorOp.stats.latencyUs.push_back(duration_cast<microseconds>(steady_clock::now() - start).count());
+            ++detectorOp.stats.numSucceeded;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "WARNING: No valid start pose in %s. Skipping the frontier benchmarks.\n", name.c_str());
+    }
+    result.operations.push_back(findFrontiersOp);
+    result.operations.push_back(planFrontierOp);
+    result.operations.push_back(detectorOp);
+
+    result.peakRssKb = read_peak_rss_kb();
+    return result;
+}
+
+
+void draw_wall(OccupancyGrid& map, int x0, int y0, int x1, int y1, int thickness)
+{
+    int minX = std::max(std::min(x0, x1), 0);
+    int minY = std::max(std::min(y0, y1), 0);
+    int maxX = std::min(std::max(x0, x1) + thickness - 1, map.widthInCells() - 1);
+    int maxY = std::min(std::max(y0, y1) + thickness - 1, map.heightInCells() - 1);
+
+    for(int y = minY; y <= maxY; ++y)
+    {
+        for(int x = minX; x <= maxX; ++x)
+        {
+            map(x, y) = kOccupiedOdds;
+        }
+    }
+}
+
+
+OccupancyGrid empty_map(int sizeInCells)
+{
+    // Add half a cell so the size doesn't get truncated to one cell less
+    float sizeInMeters = (sizeInCells + 0.5f) * kMetersPerCell;
+    OccupancyGrid map(sizeInMeters, sizeInMeters, kMetersPerCell);
+    for(int y = 0; y < map.heightInCells(); ++y)
+    {
+        for(int x = 0; x < map.widthInCells(); ++x)
+        {
+            map(x, y) = kFreeOdds;
+        }
+    }
+
+    int last = sizeInCells - 2;
+    draw_wall(map, 0, 0, last, 0, 2);
+    draw_wall(map, 0, last, last, last, 2);
+    draw_wall(map, 0, 0, 0, last, 2);
+    draw_wall(map, last, 0, last, last, 2);
+    return map;
+}
+
+
+OccupancyGrid generate_maze(int sizeInCells, std::mt19937& rng)
+{
+    // A perfect maze carved by a randomized depth-first search, with 1m corridors and 10cm walls
+    const int kCorridorWidth = 20;
+    const int kWallThickness = 2;
+    const int kPitch = kCorridorWidth + kWallThickness;
+
+    OccupancyGrid map = empty_map(sizeInCells);
+    int mazeSize = (sizeInCells - kWallThickness) / kPitch;
+    if(mazeSize < 1)
+    {
+        return map;
+    }
+
+    // Start with every wall in place, then remove the ones crossed by the search
+    std::vector<bool> eastWall(mazeSize * mazeSize, true);
+    std::vector<bool> northWall(mazeSize * mazeSize, true);
+    std::vector<bool> visited(mazeSize * mazeSize, false);
+    std::vector<int> stack = { 0 };
+    visited[0] = true;
+
+    while(!stack.empty())
+    {
+        int cell = stack.back();
+        int cx = cell % mazeSize;
+        int cy = cell / mazeSize;
+
+        std::vector<int> unvisited;
+        if(cx + 1 < mazeSize && !visited[cell + 1])        unvisited.push_back(cell + 1);
+        if(cx > 0 && !visited[cell - 1])                   unvisited.push_back(cell - 1);
+        if(cy + 1 < mazeSize && !visited[cell + mazeSize]) unvisited.push_back(cell + mazeSize);
+        if(cy > 0 && !visited[cell - mazeSize])            unvisited.push_back(cell - mazeSize);
+
+        if(unvisited.empty())
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        int next = unvisited[rng() % unvisited.size()];
+        if(next == cell + 1)             eastWall[cell] = false;
+        else if(next == cell - 1)        eastWall[next] = false;
+        else if(next == cell + mazeSize) northWall[cell] = false;
+        else                             northWall[next] = false;
+
+        visited[next] = true;
+        stack.push_back(next);
+    }
+
+    for(int cy = 0; cy < mazeSize; ++cy)
+    {
+        for(int cx = 0; cx < mazeSize; ++cx)
+        {
+            int x = cx * kPitch;
+            int y = cy * kPitch;
+            if(eastWall[cy * mazeSize + cx])
+            {
+                draw_wall(map, x + kPitch, y, x + kPitch, y + kPitch, kWallThickness);
+            }
+            if(northWall[cy * mazeSize + cx])
+            {
+                draw_wall(map, x, y + kPitch, x + kPitch, y + kPitch, kWallThickness);
+            }
+        }
+    }
+
+    return map;
+}
+
+
+OccupancyGrid generate_office(int sizeInCells, std::mt19937& rng)
+{
+    // Blocks of 6m rooms separated by 2m hallways. Every room has a 1m door in a random wall.
+    const int kRoomSize = 120;
+    const int kHallWidth = 40;
+    const int kDoorWidth = 20;
+    const int kWallThickness = 3;
+    const int kPitch = kRoomSize + kHallWidth;
+
+    OccupancyGrid map = empty_map(sizeInCells);
+
+    for(int y = kHallWidth; y + kRoomSize < sizeInCells - kHallWidth; y += kPitch)
+    {
+        for(int x = kHallWidth; x + kRoomSize < sizeInCells - kHallWidth; x += kPitch)
+        {
+            int right = x + kRoomSize;
+            int top = y + kRoomSize;
+            int doorSide = rng() % 4;
+            int doorStart = kWallThickness + rng() % (kRoomSize - kDoorWidth - 2 * kWallThickness);
+
+            // Draw each wall in two pieces with the door gap between them on the chosen side
+            int gapStart = (doorSide == 0) ? kRoomSize + 1 : doorStart;
+            int gapEnd = gapStart + kDoorWidth;
+            draw_wall(map, x, y, x + gapStart - 1, y, kWallThickness);
+            draw_wall(map, x + gapEnd, y, right, y, kWallThickness);
+
+            gapStart = (doorSide == 1) ? kRoomSize + 1 : doorStart;
+            gapEnd = gapStart + kDoorWidth;
+            draw_wall(map, x, top, x + gapStart - 1, top, kWallThickness);
+            draw_wall(map, x + gapEnd, top, right, top, kWallThickness);
+
+            gapStart = (doorSide == 2) ? kRoomSize + 1 : doorStart;
+            gapEnd = gapStart + kDoorWidth;
+            draw_wall(map, x, y, x, y + gapStart - 1, kWallThickness);
+            draw_wall(map, x, y + gapEnd, x, top, kWallThickness);
+
+            gapStart = (doorSide == 3) ? kRoomSize + 1 : doorStart;
+            gapEnd = gapStart + kDoorWidth;
+            draw_wall(map, right, y, right, y + gapStart - 1, kWallThickness);
+            draw_wall(map, right, y + gapEnd, right, top, kWallThickness);
+        }
+    }
+
+    return map;
+}
+
+
+OccupancyGrid generate_open_hall(int sizeInCells, std::mt19937& rng)
+{
+    // A large open space with 40cm pillars about every 4m and some scattered clutter
+    const int kPillarSpacing = 80;
+    const int kPillarSize = 8;
+    const int kClutterSize = 4;
+
+    OccupancyGrid map = empty_map(sizeInCells);
+
+    for(int y = kPillarSpacing; y < sizeInCells - kPillarSpacing / 2; y += kPillarSpacing)
+    {
+        for(int x = kPillarSpacing; x < sizeInCells - kPillarSpacing / 2; x += kPillarSpacing)
+        {
+            draw_wall(map, x, y, x, y, kPillarSize);
+        }
+    }
+
+    int numClutter = (sizeInCells / kPillarSpacing) * (sizeInCells / kPillarSpacing);
+    for(int n = 0; n < numClutter; ++n)
+    {
+        int x = rng() % sizeInCells;
+        int y = rng() % sizeInCells;
+        draw_wall(map, x, y, x, y, kClutterSize);
+    }
+
+    return map;
+}
+
+
+OccupancyGrid partially_explored_map(const OccupancyGrid& map, const pose2D_t& robotPose, double radius)
+{
+    // Everything farther than radius from the robot is unknown
+    OccupancyGrid partialMap = map;
+    Point<double> robotPosition = global_position_to_grid_position(Point<double>(robotPose.x, robotPose.y), map);
+    double radiusInCells = radius * map.cellsPerMeter();
+
+    for(int y = 0; y < map.heightInCells(); ++y)
+    {
+        for(int x = 0; x < map.widthInCells(); ++x)
+        {
+            if(std::hypot(x + 0.5 - robotPosition.x, y + 0.5 - robotPosition.y) > radiusInCells)
+            {
+                partialMap(x, y) = 0;
+            }
+        }
+    }
+
+    return partialMap;
+}
+
+
+bool find_start_pose(const MotionPlanner& planner, pose2D_t& pose)
+{
+    // Start from the valid cell closest to the center of the map
+    const ObstacleDistanceGrid& distances = planner.obstacleDistances();
+    int centerX = distances.widthInCells() / 2;
+    int centerY = distances.heightInCells() / 2;
+    int maxRadius = std::max(centerX, centerY);
+
+    for(int radius = 0; radius <= maxRadius; ++radius)
+    {
+        for(int y = centerY - radius; y <= centerY + radius; ++y)
+        {
+            for(int x = centerX - radius; x <= centerX + radius; ++x)
+            {
+                bool isOnRing = (std::abs(x - centerX) == radius) || (std::abs(y - centerY) == radius);
+                if(isOnRing && planner.isValidGoal(cell_t(x, y)))
+                {
+                    Point<double> position = grid_position_to_global_position(Point<double>(x + 0.5, y + 0.5),
+                                                                              distances);
+                    pose.utime = 0;
+                    pose.x = position.x;
+                    pose.y = position.y;
+                    pose.theta = 0.0;
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+
+void reset_peak_rss(void)
+{
+    // Writing 5 to clear_refs resets the peak resident set size reported in /proc/self/status (Linux 4.0+). If it
+    // fails, the peak covers the whole run up to that point.
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if(clearRefs.is_open())
+    {
+        clearRefs << "5";
+    }
+}
+
+
+long read_peak_rss_kb(void)
+{
+    std::ifstream status("/proc/self/status");
+    for(std::string line; std::getline(status, line);)
+    {
+        if(line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return std::stol(line.substr(6));
+        }
+    }
+
+    // ru_maxrss is in kilobytes on Linux
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+
+double percentile(std::vector<double> values, double fraction)
+{
+    // Nearest-rank percentile
+    if(values.empty())
+    {
+        return 0.0;
+    }
+
+    std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * values.size()));
+    rank = std::min(std::max(rank, std::size_t(1)), values.size());
+    std::nth_element(values.begin(), values.begin() + rank - 1, values.end());
+    return values[rank - 1];
+}
+
+
+void write_distribution(std::ostream& out, const std::vector<double>& values)
+{
+    // Path safety checks take well under a microsecond, so the values keep their fractions
+    double maxValue = values.empty() ? 0.0 : *std::max_element(values.begin(), values.end());
+    std::ostringstream distribution;
+    distribution << std::fixed << std::setprecision(3)
+                 << "{\"p50\": " << percentile(values, 0.5)
+                 << ", \"p95\": " << percentile(values, 0.95)
+                 << ", \"max\": " << maxValue << "}";
+    out << distribution.str();
+}
+
+
+void write_json(std::ostream& out, const std::vector<map_result_t>& results, int numRepeats, int numQueries, int seed)
+{
+    out << "{\n";
+    out << "  \"config\": {\"num_repeats\": " << numRepeats << ", \"num_queries\": " << numQueries
+        << ", \"seed\": " << seed << ", \"meters_per_cell\": " << kMetersPerCell << "},\n";
+    out << "  \"maps\": [";
+
+    for(std::size_t m = 0; m < results.size(); ++m)
+    {
+        const map_result_t& result = results[m];
+        out << (m == 0 ? "\n" : ",\n");
+        out << "    {\n";
+        out << "      \"name\": \"" << result.name << "\",\n";
+        out << "      \"source\": \"" << result.source << "\",\n";
+        out << "      \"width_cells\": " << result.widthInCells << ",\n";
+        out << "      \"height_cells\": " << result.heightInCells << ",\n";
+        out << "      \"peak_rss_kb\": " << result.peakRssKb << ",\n";
+        out << "      \"operations\": {";
+
+        for(std::size_t n = 0; n < result.operations.size(); ++n)
+        {
+            const operation_result_t& op = result.operations[n];
+            out << (n == 0 ? "\n" : ",\n");
+            out << "        \"" << op.name << "\": {\"samples\": " << op.stats.latencyUs.size()
+                << ", \"succeeded\": " << op.stats.numSucceeded
+                << ", \"latency_us\": ";
+            write_distribution(out, op.stats.latencyUs);
+            if(!op.stats.expandedNodes.empty())
+            {
+                out << ", \"expanded_nodes\": ";
+                write_distribution(out, op.stats.expandedNodes);
+            }
+            out << "}";
+        }
+
+        out << "\n      }\n";
+        out << "    }";
+    }
+
+    out << "\n  ]\n";
+    out << "}\n";
+}
@@ -0,0 +1,172 @@
+#include <slam/scan_simulator.hpp>
+#include <utils/geometric/angle_functions.hpp>
+#include <utils/geometric/interpolation.hpp>
+#include <cmath>
+#include <limits>
+
+
+ScanSimulator::ScanSimulator(const OccupancyGrid& map, const scan_simulator_params_t& params)
+: params_(params)
+, width_(map.widthInCells())
+, height_(map.heightInCells())
+, cellsPerMeter_(map.cellsPerMeter())
+, origin_(map.originInGlobalFrame())
+, walls_(map.widthInCells() * map.heightInCells())
+{
+    // A flat array of bytes is faster to test in the inner loop than the log-odds through the grid's bounds checks.
+    for(int y = 0; y < height_; ++y)
+    {
+        for(int x = 0; x < width_; ++x)
+        {
+            walls_[x + y * width_] = map.isCellOccupied(x, y);
+        }
+    }
+
+    // The rays are measured in order as the lidar spins clockwise. Each is in the middle of its share of the circle.
+    beamThetas_.resize(params_.numBeams);
+    for(int n = 0; n < params_.numBeams; ++n)
+    {
+        beamThetas_[n] = 2.0f * M_PI * (1.0f - (n + 0.5f) / params_.numBeams);
+    }
+}
+
+
+void ScanSimulator::simulateScan(const mbot_lcm_msgs::pose2D_t& beginPose,
+                                 const mbot_lcm_msgs::pose2D_t& endPose,
+                                 std::mt19937& rng,
+                                 mbot_lcm_msgs::lidar_t& scan) const
+{
+    std::normal_distribution<float> noise(0.0f, params_.rangeNoise);
+    int numBeams = params_.numBeams;
+    double rayDuration = static_cast<double>(endPose.utime - beginPose.utime) / numBeams;
+
+    scan.utime = endPose.utime;
+    scan.num_ranges = numBeams;
+    scan.ranges.resize(numBeams);
+    scan.thetas.resize(numBeams);
+    scan.times.resize(numBeams);
+    scan.intensities.resize(numBeams);
+
+    for(int n = 0; n < numBeams; ++n)
+    {
+        int64_t rayTime = beginPose.utime + static_cast<int64_t>(n * rayDuration);
+        mbot_lcm_msgs::pose2D_t rayPose = interpolate_pose_by_time(rayTime, beginPose, endPose);
+
+        float range = castRay(rayPose.x, rayPose.y, rayPose.theta + beamThetas_[n]);
+        if(range > 0.0f && params_.rangeNoise > 0.0f)
+        {
+            range = std::max(range + noise(rng), 0.0f);
+        }
+        if(range < params_.minRange)
+        {
+            range = 0.0f;
+        }
+
+        scan.ranges[n] = range;
+        scan.thetas[n] = beamThetas_[n];
+        scan.times[n] = rayTime;
+        scan.intensities[n] = range > 0.0f ? 47.0f : 0.0f;   // A typical quality for a wall in range
+    }
+}
+
+
+float ScanSimulator::castRay(float x, float y, float theta) const
+{
+    // Walk the cells the ray passes through in order (Amanatides and Woo), working in cells rather than meters.
+    double gridX = (x - origin_.x) * cellsPerMeter_;
+    double gridY = (y - origin_.y) * cellsPerMeter_;
+    int cellX = static_cast<int>(std::floor(gridX));
+    int cellY = static_cast<int>(std::floor(gridY));
+    if((cellX < 0) || (cellY < 0) || (cellX >= width_) || (cellY >= height_))
+    {
+        return 0.0f;
+    }
+
+    const double kInfinity = std::numeric_limits<double>::infinity();
+    double dirX = std::cos(theta);
+    double dirY = std::sin(theta);
+    int stepX = dirX > 0.0 ? 1 : -1;
+    int stepY = dirY > 0.0 ? 1 : -1;
+    // Distance along the ray to cross one cell in x or y, and to the first x or y boundary.
+    double deltaX = dirX != 0.0 ? std::abs(1.0 / dirX) : kInfinity;
+    double deltaY = dirY != 0.0 ? std::abs(1.0 / dirY) : kInfinity;
+    double nextX = dirX != 0.0 ? ((dirX > 0.0 ? cellX + 1 - gridX : gridX - cellX) * deltaX) : kInfinity;
+    double nextY = dirY != 0.0 ? ((dirY > 0.0 ? cellY + 1 - gridY : gridY - cellY) * deltaY) : kInfinity;
+    double maxDistance = params_.maxRange * cellsPerMeter_;
+
+    while(true)
+    {
+        double distance;
+        if(nextX < nextY)
+        {
+            distance = nextX;
+            nextX += deltaX;
+            cellX += stepX;
+        }
+        else
+        {
+            distance = nextY;
+            nextY += deltaY;
+            cellY += stepY;
+        }
+
+        if((distance > maxDistance) || (cellX < 0) || (cellY < 0) || (cellX >= width_) || (cellY >= height_))
+        {
+            return 0.0f;
+        }
+        if(walls_[cellX + cellY * width_])
+        {
+            return distance / cellsPerMeter_;
+        }
+    }
+}
+
+
+PoseTrace make_waypoint_trace(const std::vector<mbot_lcm_msgs::pose2D_t>& waypoints,
+                              float speed,
+                              float turnRate,
+                              int64_t startUtime)
+{
+    PoseTrace trace;
+    if(waypoints.empty())
+    {
+        return trace;
+    }
+
+    mbot_lcm_msgs::pose2D_t pose = waypoints.front();
+    pose.utime = startUtime;
+    if(waypoints.size() > 1)
+    {
+        pose.theta = std::atan2(waypoints[1].y - pose.y, waypoints[1].x - pose.x);
+    }
+    trace.addPose(pose);
+
+    for(std::size_t n = 1; n < waypoints.size(); ++n)
+    {
+        double dx = waypoints[n].x - pose.x;
+        double dy = waypoints[n].y - pose.y;
+        double distance = std::sqrt(dx*dx + dy*dy);
+        if(distance == 0.0)
+        {
+            continue;
+        }
+
+        // Turn in place to face the waypoint.
+        double heading = std::atan2(dy, dx);
+        double turn = angle_diff_abs(heading, pose.theta);
+        if(turn > 0.0)
+        {
+            pose.utime += static_cast<int64_t>(turn / turnRate * 1e6);
+            pose.theta = heading;
+            trace.addPose(pose);
+        }
+
+        // Then drive straight to it.
+        pose.utime += static_cast<int64_t>(distance / speed * 1e6);
+        pose.x = waypoints[n].x;
+        pose.y = waypoints[n].y;
+        trace.addPose(pose);
+    }
+
+    return trace;
+}
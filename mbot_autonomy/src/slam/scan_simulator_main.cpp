@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <lcm/lcm-cpp.hpp>
+
+#include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <mbot_lcm_msgs/twist2D_t.hpp>
+
+#include <utils/getopt.h>
+#include <utils/lcm_config.h>
+#include <utils/time_util.h>
+#include <utils/geometric/angle_functions.hpp>
+#include <mbot/mbot_channels.h>
+#include <slam/occupancy_grid.hpp>
+#include <slam/scan_simulator.hpp>
+
+/*
+* lidar_simulator stands in for the lidar and odometry of a robot driving around a saved map. It publishes lidar_t scans
+* on LIDAR and perfect odometry on MBOT_ODOMETRY, so slam and the rest of the stack run as they do on the robot.
+*
+* The robot either follows a path of waypoints, drives with the commands on MBOT_VEL_CMD (--drive), or sits still at
+* the start pose. With --log, the scans are written to an LCM log in simulated time instead, on as many threads as
+* there are cores, which runs many times faster than real time.
+*/
+
+std::atomic<bool> ctrl_c_pressed(false);
+void ctrlc(int)
+{
+    ctrl_c_pressed = true;
+}
+
+
+/*
+* VelocityCommandHandler keeps the latest velocity command for --drive.
+*/
+class VelocityCommandHandler
+{
+public:
+
+    mbot_lcm_msgs::twist2D_t command = {0, 0, 0, 0};
+
+    void handleCommand(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::twist2D_t* msg)
+    {
+        command = *msg;
+    }
+};
+
+
+bool load_waypoints(const std::string& file, std::vector<mbot_lcm_msgs::pose2D_t>& waypoints);
+mbot_lcm_msgs::pose2D_t pose_on_path(const PoseTrace& path, int64_t elapsedUtime);
+int run_live(ScanSimulator& simulator, const PoseTrace& path, bool drive, const mbot_lcm_msgs::pose2D_t& start,
+             double scanRate, double odomRate, double duration, int seed);
+int run_log(ScanSimulator& simulator, const PoseTrace& path, const std::string& logFile, double scanRate,
+            double odomRate, double duration, int numThreads, int seed);
+
+
+int main(int argc, char** argv)
+{
+    const char* mapArg = "map";
+    const char* pathArg = "path";
+    const char* driveArg = "drive";
+    const char* speedArg = "speed";
+    const char* turnRateArg = "turn-rate";
+    const char* startXArg = "start-x";
+    const char* startYArg = "start-y";
+    const char* startThetaArg = "start-theta";
+    const char* beamsArg = "beams";
+    const char* maxRangeArg = "max-range";
+    const char* minRangeArg = "min-range";
+    const char* noiseArg = "noise";
+    const char* rateArg = "rate";
+    const char* odomRateArg = "odom-rate";
+    const char* logArg = "log";
+    const char* durationArg = "duration";
+    const char* threadsArg = "threads";
+    const char* seedArg = "seed";
+
+    getopt_t *gopt = getopt_create();
+    getopt_add_bool(gopt, 'h', "help", 0, "Show this help message.");
+    getopt_add_string(gopt, 'm', mapArg, "", "Saved map to simulate scans of.");
+    getopt_add_string(gopt, 'p', pathArg, "", "File of waypoints to drive through, one \"x y\" per line. The robot starts"
+                    " at the first one and loops back to it at the end of the path.");
+    getopt_add_bool(gopt, 'd', driveArg, 0, "Drive with the velocity commands on " MBOT_MOTOR_COMMAND_CHANNEL " instead of"
+                    " following a path.");
+    getopt_add_double(gopt, '\0', speedArg, "0.25", "Driving speed along the path (m/s).");
+    getopt_add_double(gopt, '\0', turnRateArg, "1.0", "Turning speed at each waypoint on the path (rad/s).");
+    getopt_add_double(gopt, '\0', startXArg, "0", "Start x when there is no path (m).");
+    getopt_add_double(gopt, '\0', startYArg, "0", "Start y when there is no path (m).");
+    getopt_add_double(gopt, '\0', startThetaArg, "0", "Start heading when there is no path (rad).");
+    getopt_add_int(gopt, 'b', beamsArg, "720", "Rays in each scan.");
+    getopt_add_double(gopt, '\0', maxRangeArg, "12.0", "Longest range the lidar measures (m).");
+    getopt_add_double(gopt, '\0', minRangeArg, "0.15", "Shortest range the lidar measures (m).");
+    getopt_add_double(gopt, 'n', noiseArg, "0.01", "Standard deviation of the noise on each range (m).");
+    getopt_add_double(gopt, 'r', rateArg, "10", "Scans per second.");
+    getopt_add_double(gopt, '\0', odomRateArg, "50", "Odometry messages per second.");
+    getopt_add_string(gopt, 'l', logArg, "", "Write the scans and odometry to this LCM log as fast as possible instead of"
+                    " publishing them in real time.");
+    getopt_add_double(gopt, '\0', durationArg, "0", "Seconds of driving to simulate. 0 is forever when publishing, and one"
+                    " lap of the path when writing a log.");
+    getopt_add_int(gopt, 't', threadsArg, "0", "Threads to simulate scans on when writing a log. 0 is one per core.");
+    getopt_add_int(gopt, '\0', seedArg, "1", "Seed for the range noise.");
+
+    if(!getopt_parse(gopt, argc, argv, 1) || getopt_get_bool(gopt, "help"))
+    {
+        printf("Usage: %s --map saved.map [options]\n\n", argv[0]);
+        getopt_do_usage(gopt);
+        return 1;
+    }
+
+    std::string mapFile = getopt_get_string(gopt, mapArg);
+    std::string pathFile = getopt_get_string(gopt, pathArg);
+    std::string logFile = getopt_get_string(gopt, logArg);
+    bool drive = getopt_get_bool(gopt, driveArg);
+    double scanRate = getopt_get_double(gopt, rateArg);
+    double odomRate = getopt_get_double(gopt, odomRateArg);
+    double duration = getopt_get_double(gopt, durationArg);
+
+    if(drive && !logFile.empty())
+    {
+        fprintf(stderr, "ERROR: --drive needs velocity commands in real time, so it can't write a log.\n");
+        return 1;
+    }
+    if(drive && !pathFile.empty())
+    {
+        fprintf(stderr, "ERROR: Use either --drive or --path, not both.\n");
+        return 1;
+    }
+    if((scanRate <= 0.0) || (odomRate <= 0.0))
+    {
+        fprintf(stderr, "ERROR: --rate and --odom-rate must be positive.\n");
+        return 1;
+    }
+
+    OccupancyGrid map;
+    if(mapFile.empty() || !map.loadFromFile(mapFile))
+    {
+        fprintf(stderr, "ERROR: Failed to load map %s.\n", mapFile.c_str());
+        return 1;
+    }
+
+    std::vector<mbot_lcm_msgs::pose2D_t> waypoints;
+    if(!pathFile.empty())
+    {
+        if(!load_waypoints(pathFile, waypoints))
+        {
+            fprintf(stderr, "ERROR: Failed to load any waypoints from %s.\n", pathFile.c_str());
+            return 1;
+        }
+        // Drive back to the start, so the path can be followed around and around.
+        waypoints.push_back(waypoints.front());
+    }
+    else
+    {
+        mbot_lcm_msgs::pose2D_t start = {0, 0, 0, 0};
+        start.x = getopt_get_double(gopt, startXArg);
+        start.y = getopt_get_double(gopt, startYArg);
+        waypoints.push_back(start);
+    }
+
+    float turnRate = std::max(getopt_get_double(gopt, turnRateArg), 0.01);
+    PoseTrace path = make_waypoint_trace(waypoints,
+                                         std::max(getopt_get_double(gopt, speedArg), 0.01),
+                                         turnRate,
+                                         0);
+    if(pathFile.empty())
+    {
+        path.clear();
+        mbot_lcm_msgs::pose2D_t start = waypoints.front();
+        start.theta = getopt_get_double(gopt, startThetaArg);
+        path.addPose(start);
+    }
+    else
+    {
+        // Turn back to the starting heading, so the robot doesn't jump when it starts the next lap.
+        mbot_lcm_msgs::pose2D_t end = path.back();
+        end.utime += static_cast<int64_t>(angle_diff_abs(path.front().theta, end.theta) / turnRate * 1e6);
+        end.theta = path.front().theta;
+        if(end.utime > path.back().utime)
+        {
+            path.addPose(end);
+        }
+        printf("INFO: Following %d waypoints, %.1f s a lap.\n",
+               static_cast<int>(waypoints.size()) - 1,
+               (path.back().utime - path.front().utime) / 1e6);
+    }
+
+    scan_simulator_params_t params;
+    params.numBeams = std::max(getopt_get_int(gopt, beamsArg), 1);
+    params.maxRange = getopt_get_double(gopt, maxRangeArg);
+    params.minRange = getopt_get_double(gopt, minRangeArg);
+    params.rangeNoise = std::max(getopt_get_double(gopt, noiseArg), 0.0);
+    ScanSimulator simulator(map, params);
+
+    int seed = getopt_get_int(gopt, seedArg);
+
+    signal(SIGINT, ctrlc);
+    signal(SIGTERM, ctrlc);
+
+    if(!logFile.empty())
+    {
+        int numThreads = getopt_get_int(gopt, threadsArg);
+        if(numThreads <= 0)
+        {
+            numThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+        }
+        if(duration <= 0.0)
+        {
+            duration = (path.back().utime - path.front().utime) / 1e6;
+        }
+        if(duration <= 0.0)
+        {
+            fprintf(stderr, "ERROR: Set a --duration for a log when the robot isn't following a path.\n");
+            return 1;
+        }
+        return run_log(simulator, path, logFile, scanRate, odomRate, duration, numThreads, seed);
+    }
+
+    return run_live(simulator, path, drive, path.front(), scanRate, odomRate, duration, seed);
+}
+
+
+bool load_waypoints(const std::string& file, std::vector<mbot_lcm_msgs::pose2D_t>& waypoints)
+{
+    std::ifstream in(file);
+    for(std::string line; std::getline(in, line);)
+    {
+        if(line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream lineIn(line);
+        mbot_lcm_msgs::pose2D_t waypoint = {0, 0, 0, 0};
+        if(lineIn >> waypoint.x >> waypoint.y)
+        {
+            waypoints.push_back(waypoint);
+        }
+    }
+    return !waypoints.empty();
+}
+
+
+mbot_lcm_msgs::pose2D_t pose_on_path(const PoseTrace& path, int64_t elapsedUtime)
+{
+    // The path loops, so wrap the time around to the lap the robot is on.
+    int64_t lapUtime = path.back().utime - path.front().utime;
+    int64_t pathUtime = path.front().utime + ((lapUtime > 0) ? elapsedUtime % lapUtime : 0);
+    return path.poseAt(pathUtime);
+}
+
+
+int run_live(ScanSimulator& simulator, const PoseTrace& path, bool drive, const mbot_lcm_msgs::pose2D_t& start,
+             double scanRate, double odomRate, double duration, int seed)
+{
+    lcm::LCM lcmInstance(MULTICAST_URL);
+    if(!lcmInstance.good())
+    {
+        fprintf(stderr, "ERROR: Failed to start LCM.\n");
+        return 1;
+    }
+
+    VelocityCommandHandler commands;
+    if(drive)
+    {
+        lcmInstance.subscribe(MBOT_MOTOR_COMMAND_CHANNEL, &VelocityCommandHandler::handleCommand, &commands);
+    }
+
+    std::mt19937 rng(seed);
+    int64_t startUtime = utime_now();
+    int64_t odomPeriod = static_cast<int64_t>(1e6 / odomRate);
+    int64_t scanPeriod = static_cast<int64_t>(1e6 / scanRate);
+    int64_t nextScanUtime = startUtime + scanPeriod;
+
+    mbot_lcm_msgs::pose2D_t pose = start;
+    pose.utime = startUtime;
+    mbot_lcm_msgs::pose2D_t scanBeginPose = pose;
+    mbot_lcm_msgs::lidar_t scan;
+    int64_t numScans = 0;
+
+    while(!ctrl_c_pressed)
+    {
+        int64_t now = utime_now();
+        if((duration > 0.0) && (now - startUtime > duration * 1e6))
+        {
+            break;
+        }
+
+        if(drive)
+        {
+            // Handle any commands that arrived, then move with the latest for the time since the last pose.
+            while(lcmInstance.handleTimeout(0) > 0) {}
+
+            double dt = (now - pose.utime) / 1e6;
+            const mbot_lcm_msgs::twist2D_t& cmd = commands.command;
+            double theta = pose.theta + cmd.wz * dt / 2.0;
+            pose.x += (cmd.vx * std::cos(theta) - cmd.vy * std::sin(theta)) * dt;
+            pose.y += (cmd.vx * std::sin(theta) + cmd.vy * std::cos(theta)) * dt;
+            pose.theta = wrap_to_pi(pose.theta + cmd.wz * dt);
+            pose.utime = now;
+        }
+        else
+        {
+            pose = pose_on_path(path, now - startUtime);
+            pose.utime = now;
+        }
+        lcmInstance.publish(ODOMETRY_CHANNEL, &pose);
+
+        if(now >= nextScanUtime)
+        {
+            simulator.simulateScan(scanBeginPose, pose, rng, scan);
+            lcmInstance.publish(LIDAR_CHANNEL, &scan);
+            scanBeginPose = pose;
+            nextScanUtime += scanPeriod;
+            ++numScans;
+        }
+
+        int64_t sleepUtime = std::min(pose.utime + odomPeriod, nextScanUtime) - utime_now();
+        if(sleepUtime > 0)
+        {
+            usleep(sleepUtime);
+        }
+    }
+
+    printf("INFO: Published %ld scans.\n", static_cast<long>(numScans));
+    return 0;
+}
+
+
+template <class Message>
+void write_event(lcm::LogFile& log, const std::string& channel, const Message& msg, std::vector<uint8_t>& buffer)
+{
+    buffer.resize(msg.getEncodedSize());
+    msg.encode(buffer.data(), 0, buffer.size());
+
+    lcm::LogEvent event;
+    event.eventnum = 0;     // Numbered by the log
+    event.timestamp = msg.utime;
+    event.channel = channel;
+    event.datalen = buffer.size();
+    event.data = buffer.data();
+    log.writeEvent(&event);
+}
+
+
+int run_log(ScanSimulator& simulator, const PoseTrace& path, const std::string& logFile, double scanRate,
+            double odomRate, double duration, int numThreads, int seed)
+{
+    lcm::LogFile log(logFile, "w");
+    if(!log.good())
+    {
+        fprintf(stderr, "ERROR: Failed to open %s for writing.\n", logFile.c_str());
+        return 1;
+    }
+
+    // The log starts now, so it looks like one recorded on the robot.
+    int64_t startUtime = utime_now();
+    int64_t numScans = static_cast<int64_t>(duration * scanRate);
+    int64_t numOdoms = static_cast<int64_t>(duration * odomRate);
+    auto scanUtime = [&](int64_t n) { return static_cast<int64_t>(n * 1e6 / scanRate); };
+    auto odomUtime = [&](int64_t n) { return static_cast<int64_t>(n * 1e6 / odomRate); };
+
+    // Scans are simulated a batch at a time, split across the threads, then written in order. Each scan has its own
+    // random numbers, seeded by its number, so the log is the same however many threads simulate it.
+    std::vector<mbot_lcm_msgs::lidar_t> batch(numThreads * 16);
+    std::vector<uint8_t> buffer;
+    int64_t nextOdom = 0;
+    int64_t startClock = utime_now();
+
+    for(int64_t batchStart = 1; batchStart <= numScans; batchStart += batch.size())
+    {
+        int batchSize = std::min<int64_t>(batch.size(), numScans - batchStart + 1);
+
+        auto simulateScans = [&](int first) {
+            for(int n = first; n < batchSize; n += numThreads)
+            {
+                int64_t scanNum = batchStart + n;
+                mbot_lcm_msgs::pose2D_t beginPose = pose_on_path(path, scanUtime(scanNum - 1));
+                mbot_lcm_msgs::pose2D_t endPose = pose_on_path(path, scanUtime(scanNum));
+                beginPose.utime = startUtime + scanUtime(scanNum - 1);
+                endPose.utime = startUtime + scanUtime(scanNum);
+
+                std::mt19937 rng(seed + scanNum * 7919);
+                simulator.simulateScan(beginPose, endPose, rng, batch[n]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for(int n = 1; n < numThreads; ++n)
+        {
+            workers.emplace_back(simulateScans, n);
+        }
+        simulateScans(0);
+        for(auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        for(int n = 0; n < batchSize; ++n)
+        {
+            // Odometry up to the end of the scan comes first, as it would arrive on the robot.
+            while((nextOdom <= numOdoms) && (startUtime + odomUtime(nextOdom) <= batch[n].utime))
+            {
+                mbot_lcm_msgs::pose2D_t pose = pose_on_path(path, odomUtime(nextOdom));
+                pose.utime = startUtime + odomUtime(nextOdom);
+                write_event(log, ODOMETRY_CHANNEL, pose, buffer);
+                ++nextOdom;
+            }
+            write_event(log, LIDAR_CHANNEL, batch[n], buffer);
+        }
+
+        if(ctrl_c_pressed)
+        {
+            break;
+        }
+    }
+
+    for(; nextOdom <= numOdoms; ++nextOdom)
+    {
+        mbot_lcm_msgs::pose2D_t pose = pose_on_path(path, odomUtime(nextOdom));
+        pose.utime = startUtime + odomUtime(nextOdom);
+        write_event(log, ODOMETRY_CHANNEL, pose, buffer);
+    }
+
+    double elapsed = std::max(utime_now() - startClock, int64_t(1)) / 1e6;
+    printf("INFO: Wrote %ld scans and %ld odometry messages to %s on %d threads in %.2f s: %.0f scans/s, %.0fx real time.\n",
+           static_cast<long>(numScans), static_cast<long>(numOdoms + 1), logFile.c_str(), numThreads, elapsed,
+           numScans / elapsed, duration / elapsed);
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <chrono>
 
 #include <mbot_lcm_msgs/pose2D_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_utils.hpp>
 
 #include <slam/slam.hpp>
 #include <slam/slam_channels.h>
@@ -27,6 +28,7 @@ OccupancyGridSLAM::OccupancyGridSLAM(int numParticles,
 , waitingForOptitrack_(waitForOptitrack)
 , haveMap_(false)
 , running_(true)
+, haveCompactScans_(false)
 , numIgnoredScans_(0)
 , iters_(0)
 , filter_(numParticles)
@@ -65,6 +67,7 @@ OccupancyGridSLAM::OccupancyGridSLAM(int numParticles,
 
     // Laser and odometry data are always required
     lcm_subscriptions_.push_back(lcm_.subscribe(LIDAR_CHANNEL, &OccupancyGridSLAM::handleLaser, this));
+    lcm_subscriptions_.push_back(lcm_.subscribe(LIDAR_COMPACT_CHANNEL, &OccupancyGridSLAM::handleCompactLaser, this));
     lcm_subscriptions_.push_back(lcm_.subscribe(ODOMETRY_CHANNEL, &OccupancyGridSLAM::handleOdometry, this));
     // lcm_subscriptions_.push_back(lcm_.subscribe(TRUE_POSE_CHANNEL, &OccupancyGridSLAM::handleOptitrack, this));
 
@@ -132,21 +135,38 @@ void OccupancyGridSLAM::stopSLAM()
 
 // Handlers for LCM messages
 void OccupancyGridSLAM::handleLaser(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::lidar_t* scan)
+{
+    // The lidar driver can publish each revolution both ways. Only use one of them.
+    if (haveCompactScans_) return;
+    addScan(*scan);
+}
+
+
+void OccupancyGridSLAM::handleCompactLaser(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::lidar_compact_t* scan)
+{
+    if (!haveCompactScans_) std::cout << LOG_HEADER << "Using compact scans from " << channel << std::endl;
+    haveCompactScans_ = true;
+    mbot_lcm_msgs::expand_lidar_compact(*scan, expandedScan_);
+    addScan(expandedScan_);
+}
+
+
+void OccupancyGridSLAM::addScan(const mbot_lcm_msgs::lidar_t& scan)
 {
     const int kNumIgnoredForMessage = 10;   // number of scans to ignore before printing a message about odometry
     std::lock_guard<std::mutex> autoLock(dataMutex_);
     // Ignore scans until odometry data arrives -- need odometry before a scan to safely built the map
     bool haveOdom = (mode_ != mapping_only) // For full SLAM, odometry data is needed.
                     && !odometryPoses_.empty()
-                    && (odometryPoses_.front().utime <= scan->times.front());
+                    && (odometryPoses_.front().utime <= scan.times.front());
     bool havePose = (mode_ == mapping_only) // For mapping-only, ground-truth poses are needed
                     && !groundTruthPoses_.empty()
-                    && (groundTruthPoses_.front().utime <= scan->times.front());
+                    && (groundTruthPoses_.front().utime <= scan.times.front());
 
     // If there's appropriate odometry or pose data for this scan, then add it to the queue.
     if(haveOdom || havePose)
     {
-        incomingScans_.push_back(*scan);
+        incomingScans_.push_back(scan);
 
         // If we showed the laser error message, then provide another message indicating that laser scans are now
         // being saved
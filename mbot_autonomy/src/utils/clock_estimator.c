@@ -0,0 +1,186 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <utils/clock_estimator.h>
+
+// A round trip that disagrees with the estimate by this much more than its own uncertainty means the remote clock
+// jumped.
+#define CLOCK_ESTIMATOR_STEP_US 10000
+
+// Points with a round trip longer than twice the shortest, plus this, were delayed too much to use in the fit.
+#define CLOCK_ESTIMATOR_RTT_SLACK_US 200
+
+// The drift isn't fit until the points span this long, since the slope over a short span is mostly noise.
+#define CLOCK_ESTIMATOR_MIN_DRIFT_SPAN_US 2000000
+
+// Crystal oscillators are good to about 100 ppm, so a larger drift comes from bad round trips.
+#define CLOCK_ESTIMATOR_MAX_DRIFT 0.001
+
+clock_estimator_t *
+clock_estimator_create (int samples_per_point, int max_points)
+{
+    clock_estimator_t *est = calloc (1, sizeof(*est));
+    if (!est)
+        return NULL;
+
+    est->samples_per_point = samples_per_point < 1 ? 1 : samples_per_point;
+    est->max_points = max_points < 1 ? 1 : max_points;
+    if (est->max_points > CLOCK_ESTIMATOR_MAX_POINTS)
+        est->max_points = CLOCK_ESTIMATOR_MAX_POINTS;
+
+    clock_estimator_reset (est);
+    return est;
+}
+
+void
+clock_estimator_destroy (clock_estimator_t *est)
+{
+    free (est);
+}
+
+void
+clock_estimator_reset (clock_estimator_t *est)
+{
+    est->num_points = 0;
+    est->next_point = 0;
+    est->samples_in_group = 0;
+    est->ref_remote_utime = 0;
+    est->offset = 0;
+    est->drift = 0.0;
+    est->error = 0.0;
+    est->min_rtt = 0;
+    est->num_samples = 0;
+    est->is_valid = 0;
+}
+
+/* Fit a line to the offsets of the points with short enough round trips. */
+static void
+clock_estimator_fit (clock_estimator_t *est)
+{
+    // The group being collected counts as a point too, so the estimate follows each new round trip
+    clock_estimator_point_t points[CLOCK_ESTIMATOR_MAX_POINTS + 1];
+    int num_points = 0;
+    for (int i = 0; i < est->num_points; i++)
+        points[num_points++] = est->points[i];
+    if (est->samples_in_group > 0)
+        points[num_points++] = est->best_sample;
+    if (num_points == 0)
+        return;
+
+    int64_t min_rtt = points[0].rtt;
+    int newest = 0;
+    for (int i = 1; i < num_points; i++) {
+        if (points[i].rtt < min_rtt)
+            min_rtt = points[i].rtt;
+        if (points[i].remote_utime > points[newest].remote_utime)
+            newest = i;
+    }
+    int64_t max_rtt = 2 * min_rtt + CLOCK_ESTIMATOR_RTT_SLACK_US;
+
+    // Times and offsets are taken relative to the newest point, so the sums keep their precision
+    int64_t ref_remote_utime = points[newest].remote_utime;
+    int64_t base_offset = points[newest].offset;
+
+    double n = 0.0, sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0, min_x = 0.0;
+    for (int i = 0; i < num_points; i++) {
+        if (points[i].rtt > max_rtt)
+            continue;
+        double x = (double) (points[i].remote_utime - ref_remote_utime);
+        double y = (double) (points[i].offset - base_offset);
+        n += 1.0;
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+        if (x < min_x)
+            min_x = x;
+    }
+
+    double drift = 0.0;
+    double denom = n * sum_xx - sum_x * sum_x;
+    if (-min_x >= CLOCK_ESTIMATOR_MIN_DRIFT_SPAN_US && denom > 0.0) {
+        drift = (n * sum_xy - sum_x * sum_y) / denom;
+        if (drift > CLOCK_ESTIMATOR_MAX_DRIFT)
+            drift = CLOCK_ESTIMATOR_MAX_DRIFT;
+        if (drift < -CLOCK_ESTIMATOR_MAX_DRIFT)
+            drift = -CLOCK_ESTIMATOR_MAX_DRIFT;
+    }
+    double intercept = (sum_y - drift * sum_x) / n;
+
+    double sum_residual_sq = 0.0;
+    for (int i = 0; i < num_points; i++) {
+        if (points[i].rtt > max_rtt)
+            continue;
+        double x = (double) (points[i].remote_utime - ref_remote_utime);
+        double residual = (double) (points[i].offset - base_offset) - (intercept + drift * x);
+        sum_residual_sq += residual * residual;
+    }
+
+    est->ref_remote_utime = ref_remote_utime;
+    est->offset = base_offset + llround (intercept);
+    est->drift = drift;
+    est->min_rtt = min_rtt;
+    // Any asymmetry between the two directions of the round trip can't be seen, so it bounds the error
+    est->error = 0.5 * min_rtt + sqrt (sum_residual_sq / n);
+}
+
+int
+clock_estimator_add_sample (clock_estimator_t *est, int64_t request_utime, int64_t receive_utime,
+                            int64_t transmit_utime, int64_t response_utime)
+{
+    int64_t hold_time = transmit_utime - receive_utime;
+    int64_t rtt = (response_utime - request_utime) - hold_time;
+    if (hold_time < 0 || rtt < 0)
+        return 0;
+
+    clock_estimator_point_t sample;
+    sample.remote_utime = receive_utime + hold_time / 2;
+    sample.offset = ((request_utime - receive_utime) + (response_utime - transmit_utime)) / 2;
+    sample.rtt = rtt;
+
+    if (est->is_valid) {
+        int64_t predicted = clock_estimator_to_local (est, sample.remote_utime) - sample.remote_utime;
+        int64_t time_err = llabs (sample.offset - predicted);
+        if (time_err > rtt / 2 + (int64_t) est->error + CLOCK_ESTIMATOR_STEP_US) {
+            fprintf (stderr, "Warning: Remote clock jumped by %lld us. Restarting the clock estimate.\n",
+                     (long long) time_err);
+            clock_estimator_reset (est);
+            est->num_resets++;
+        }
+    }
+
+    // Min filter: only the shortest round trip of each group becomes a point
+    if (est->samples_in_group == 0 || sample.rtt < est->best_sample.rtt)
+        est->best_sample = sample;
+    est->samples_in_group++;
+    est->num_samples++;
+
+    if (est->samples_in_group >= est->samples_per_point) {
+        est->points[est->next_point] = est->best_sample;
+        est->next_point = (est->next_point + 1) % est->max_points;
+        if (est->num_points < est->max_points)
+            est->num_points++;
+        est->samples_in_group = 0;
+    }
+
+    clock_estimator_fit (est);
+    est->is_valid = 1;
+    return 1;
+}
+
+int64_t
+clock_estimator_to_local (const clock_estimator_t *est, int64_t remote_utime)
+{
+    double drift_offset = est->drift * (double) (remote_utime - est->ref_remote_utime);
+    return remote_utime + est->offset + llround (drift_offset);
+}
+
+int64_t
+clock_estimator_to_remote (const clock_estimator_t *est, int64_t local_utime)
+{
+    // The drift is tiny, so evaluating it at the remote time found without it is plenty accurate
+    int64_t remote_utime = local_utime - est->offset;
+    double drift_offset = est->drift * (double) (remote_utime - est->ref_remote_utime);
+    return remote_utime - llround (drift_offset);
+}
@@ -7,6 +7,7 @@
 #include <mbot_lcm_msgs/twist2D_t.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_t.hpp>
 #include <mbot_lcm_msgs/path2D_t.hpp>
 
 #include "json_utils.h"
@@ -16,6 +17,7 @@
 #define SLAM_POSE_CHANNEL "SLAM_POSE"
 #define SLAM_MAP_CHANNEL "SLAM_MAP"
 #define LIDAR_CHANNEL "LIDAR"
+#define LIDAR_COMPACT_CHANNEL "LIDAR_COMPACT"
 // Pubs.
 #define ODOMETRY_RESET_CHANNEL "MBOT_ODOMETRY_RESET"
 #define ODOMETRY_RESET_TYPE "pose2D_t"
@@ -127,6 +129,63 @@ static inline void stringToLCMType(const std::string& data, mbot_lcm_msgs::lidar
     }
 }
 
+
+static inline void stringToLCMType(const std::string& data, mbot_lcm_msgs::lidar_compact_t& out)
+{
+    if (data.find("num_ranges") != std::string::npos)
+    {
+        auto num_ranges = strip(fetchVal(data, "num_ranges"));
+        if (num_ranges.length() > 0) out.num_ranges = std::stoi(num_ranges);
+    }
+    if (data.find("ranges") != std::string::npos)
+    {
+        auto ranges_raw = strip(fetchList(data, "ranges"));
+        if (ranges_raw.length() > 0)
+        {
+            auto ranges_str = split(ranges_raw, ',');
+            std::vector<int16_t> ranges;
+            for (auto& ele : ranges_str) ranges.push_back(std::stoi(ele));
+            out.ranges = ranges;
+        }
+    }
+    if (data.find("intensities") != std::string::npos)
+    {
+        auto intensities_raw = strip(fetchList(data, "intensities"));
+        if (intensities_raw.length() > 0)
+        {
+            auto intensities_str = split(intensities_raw, ',');
+            std::vector<int8_t> intensities;
+            for (auto& ele : intensities_str) intensities.push_back(std::stoi(ele));
+            out.intensities = intensities;
+        }
+    }
+    if (data.find("start_theta") != std::string::npos)
+    {
+        auto start_theta = fetchVal(data, "start_theta");
+        if (start_theta.length() > 0) out.start_theta = std::stof(start_theta);
+    }
+    if (data.find("theta_step") != std::string::npos)
+    {
+        auto theta_step = fetchVal(data, "theta_step");
+        if (theta_step.length() > 0) out.theta_step = std::stof(theta_step);
+    }
+    if (data.find("start_time") != std::string::npos)
+    {
+        auto start_time = fetchVal(data, "start_time");
+        if (start_time.length() > 0) out.start_time = std::stol(start_time);
+    }
+    if (data.find("time_step") != std::string::npos)
+    {
+        auto time_step = fetchVal(data, "time_step");
+        if (time_step.length() > 0) out.time_step = std::stof(time_step);
+    }
+    if (data.find("utime") != std::string::npos)
+    {
+        auto utime = fetchVal(data, "utime");
+        if (utime.length() > 0) out.utime = std::stol(utime);
+    }
+}
+
 }   // namespace mbot_bridge
 
 #endif // MBOT_BRIDGE_LCM_UTILS_H
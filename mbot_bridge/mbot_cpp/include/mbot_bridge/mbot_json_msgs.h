@@ -2,6 +2,7 @@
 #define MBOT_BRIDGE_MBOT_JSON_MSGS_H
 
 #include <map>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -18,6 +19,8 @@ enum MBotMessageType
     REQUEST,
     PUBLISH,
     RESPONSE,
+    SUBSCRIBE,
+    UNSUBSCRIBE,
     ERROR,
     INVALID
 };
@@ -31,7 +34,8 @@ public:
         channel_(""),
         dtype_(""),
         rtype_(MBotMessageType::INVALID),
-        as_bytes_(false)
+        as_bytes_(false),
+        id_(-1)
     {};
 
     MBotJSONMessage(const std::string& data, const std::string& ch,
@@ -41,7 +45,8 @@ public:
         channel_(ch),
         dtype_(dtype),
         rtype_(rtype),
-        as_bytes_(as_bytes)
+        as_bytes_(as_bytes),
+        id_(-1)
     {};
 
     std::string encode() const
@@ -59,13 +64,19 @@ public:
         {
             oss << "," << keyStringToJSON("dtype", dtype_);
         }
+        if (id_ >= 0)
+        {
+            oss << "," << keyValToJSON("id", id_);
+        }
         if (data_.length() > 0)
         {
             oss << "," << "\"data\":{" << data_ << "}";
         }
-        if (rtype_ == MBotMessageType::REQUEST)
+        if (rtype_ == MBotMessageType::REQUEST || rtype_ == MBotMessageType::SUBSCRIBE ||
+            (rtype_ == MBotMessageType::PUBLISH && as_bytes_))
         {
-            // If we are requesting data, include whether or not it should be in byte form.
+            // If we are requesting data, include whether or not it should be in byte form. A publish in byte form is
+            // followed by the raw LCM message.
             oss << "," << keyValToJSON("as_bytes", as_bytes_);
         }
         oss << "}";  // Close msg.
@@ -90,6 +101,14 @@ public:
         }
         rtype_ = stringToType(fetchString(raw, "type"));
 
+        // The server puts the ID before the data, so it is found before any key in the data with the same name.
+        id_ = -1;
+        if (raw.find("\"id\"") != std::string::npos)
+        {
+            auto id = strip(fetchVal(raw, "id"));
+            if (id.length() > 0) id_ = std::stoll(id);
+        }
+
         data_ = "";
         if (raw.find("data") != std::string::npos)
         {
@@ -113,6 +132,10 @@ public:
     std::string channel() const { return channel_; }
     std::string dtype() const { return dtype_; }
     MBotMessageType type() const { return rtype_; }
+    int64_t id() const { return id_; }
+
+    // Sets the ID the server copies into its reply, so replies can be matched to requests. -1 means no ID.
+    void setId(const int64_t id) { id_ = id; }
 
 private:
     std::string data_;
@@ -120,6 +143,7 @@ private:
     std::string dtype_;
     MBotMessageType rtype_;
     bool as_bytes_;
+    int64_t id_;
 
     std::string typeToString(const MBotMessageType& t) const
     {
@@ -133,6 +157,10 @@ private:
                 return "publish";
             case RESPONSE:
                 return "response";
+            case SUBSCRIBE:
+                return "subscribe";
+            case UNSUBSCRIBE:
+                return "unsubscribe";
             case INVALID:
                 return "invalid";
             case ERROR:
@@ -147,6 +175,8 @@ private:
         else if (s == "request") return MBotMessageType::REQUEST;
         else if (s == "publish") return MBotMessageType::PUBLISH;
         else if (s == "response") return MBotMessageType::RESPONSE;
+        else if (s == "subscribe") return MBotMessageType::SUBSCRIBE;
+        else if (s == "unsubscribe") return MBotMessageType::UNSUBSCRIBE;
         else if (s == "error") return MBotMessageType::ERROR;
 
         // Default case.
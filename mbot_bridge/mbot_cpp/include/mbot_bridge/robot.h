@@ -1,35 +1,40 @@
 #ifndef MBOT_BRIDGE_ROBOT_H
 #define MBOT_BRIDGE_ROBOT_H
 
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
 
 #include <mbot_lcm_msgs/twist2D_t.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_t.hpp>
 
 #include "mbot_json_msgs.h"
 #include "lcm_utils.h"
 #include "comms.h"
+#include "session.h"
 
 namespace mbot_bridge {
 
 /**
  * Gets the current time in microseconds.
  */
-static inline int getTimeMicro()
+static inline int64_t getTimeMicro()
 {
     auto now = std::chrono::system_clock::now();
-    return now.time_since_epoch().count();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
 }
 
 class MBot
 {
 public:
-    MBot(const std::string& hostname = "localhost", const int port = 5005)
-    {
-        uri_ = "ws://" + hostname + ":" + std::to_string(port);
-    }
+    MBot(const std::string& hostname = "localhost", const int port = 5005) :
+        session_(std::make_shared<MBotBridgeSession>("ws://" + hostname + ":" + std::to_string(port))),
+        compact_lidar_(std::make_shared<std::atomic<bool> >(true))
+    {}
 
     // Pubs.
     void drive(const float vx, const float vy, const float wz) const;
@@ -37,13 +42,41 @@ public:
     void resetOdometry() const;
     void drivePath(const std::vector<std::array<float, 3> >& path) const;
 
-    // Subs.
+    // Subs. The lidar is read from the compact scans, or the full ones if the driver doesn't publish compact scans.
     void readLidarScan(std::vector<float>& ranges, std::vector<float>& thetas) const;
     std::vector<float> readOdometry() const;
     std::vector<float> readSlamPose() const;
 
+    // Streams. Each returns an ID to unsubscribe with. The lidar stream needs the driver to publish compact scans.
+    int64_t subscribeLidarScan(const std::function<void(const std::vector<float>& ranges,
+                                                        const std::vector<float>& thetas)>& callback,
+                               const SubscribeOptions& options = SubscribeOptions()) const;
+    int64_t subscribeOdometry(const std::function<void(const std::vector<float>& odom)>& callback,
+                              const SubscribeOptions& options = SubscribeOptions()) const;
+
+    /**
+     * Calls callback with each new message on a channel, on a thread of its own. See MBotBridgeSession::subscribe().
+     */
+    template <class T>
+    int64_t subscribe(const std::string& channel, const std::function<void(const T&)>& callback,
+                      const SubscribeOptions& options = SubscribeOptions()) const
+    {
+        return session_->subscribe(channel, callback, options);
+    }
+
+    void unsubscribe(const int64_t id) const { session_->unsubscribe(id); }
+
+    /**
+     * Whether to send and receive raw LCM messages rather than JSON. This is the default. Turn it off to use a server
+     * that doesn't accept raw LCM publishes.
+     */
+    void setAsBytes(const bool as_bytes) { session_->setAsBytes(as_bytes); }
+
 private:
-    std::string uri_;
+    // One connection for the life of the MBot, which copies of it share.
+    std::shared_ptr<MBotBridgeSession> session_;
+    // Whether the last lidar scan read was a compact one, so the next read tries that channel first.
+    std::shared_ptr<std::atomic<bool> > compact_lidar_;
 
 };
 
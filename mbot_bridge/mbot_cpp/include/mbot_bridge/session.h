@@ -0,0 +1,294 @@
+#ifndef MBOT_BRIDGE_SESSION_H
+#define MBOT_BRIDGE_SESSION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "comms.h"
+#include "lcm_utils.h"
+#include "mbot_json_msgs.h"
+
+namespace mbot_bridge {
+
+/**
+ * A reply from the server to a request.
+ */
+struct MBotBridgeResponse
+{
+    MBotMessageType type;   // RESPONSE, or ERROR if the read failed.
+    bool binary;            // Whether the payload is a raw LCM message rather than JSON data.
+    std::string payload;    // The raw LCM message, the data from a JSON reply, or the error message.
+};
+
+
+/**
+ * Which message a subscription drops when its queue is full.
+ */
+enum DropPolicy
+{
+    DROP_OLDEST,    // Keep the newest messages. Best for state, like odometry.
+    DROP_NEWEST     // Keep the messages already waiting, so none in the queue are skipped.
+};
+
+
+/**
+ * How messages on a subscription are delivered. The server does the rate limiting and decimation, so the messages
+ * skipped are never sent.
+ */
+struct SubscribeOptions
+{
+    double max_rate = 0;                    // Most messages a second, or 0 for every message.
+    int decimate = 1;                       // Only send every nth message on the channel.
+    size_t queue_size = 10;                 // Most messages waiting for the callback, on the client and the server.
+    DropPolicy drop_policy = DROP_OLDEST;   // Which message the client drops when its queue is full.
+};
+
+
+/**
+ * A subscription's queue of messages and the thread that hands them to its callback.
+ *
+ * Messages are pushed by the websocket thread, which never waits on the callback: when the queue is full, a message is
+ * dropped instead. A slow callback only falls behind on its own subscription.
+ */
+class MBotSubscription : public std::enable_shared_from_this<MBotSubscription>
+{
+public:
+    typedef std::function<void(const MBotBridgeResponse&)> Handler;
+
+    MBotSubscription(const std::string& channel, const SubscribeOptions& options, const Handler& handler);
+
+    MBotSubscription(const MBotSubscription&) = delete;
+    MBotSubscription& operator=(const MBotSubscription&) = delete;
+
+    // Starts the callback thread. It keeps the subscription alive until it stops.
+    void start();
+    // Stops the callback thread once the callback in progress, if any, returns. It may be called from the callback.
+    void stop();
+
+    void push(MBotBridgeResponse&& msg);
+
+    const std::string& channel() const { return channel_; }
+    const SubscribeOptions& options() const { return options_; }
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    std::string channel_;
+    SubscribeOptions options_;
+    Handler handler_;
+    std::atomic<uint64_t> dropped_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<MBotBridgeResponse> queue_;
+    bool running_;
+    std::thread worker_;
+
+    void run();
+};
+
+
+/**
+ * One websocket connection to the MBot Bridge, kept open for the life of the object.
+ *
+ * The websocket runs on a background thread, so publishing doesn't wait for anything and several requests can be in
+ * flight at once. Each request carries an ID which the server copies into its reply. The server answers requests in
+ * the order they arrive, so a raw LCM reply, which has no room for an ID, goes to the oldest request still waiting.
+ *
+ * Subscriptions share the connection. The messages the server sends for them carry the ID of the message that started
+ * the subscription, and binary ones start with a JSON header, which a raw LCM reply never does.
+ *
+ * If the connection drops, the requests waiting on it fail and the next call reconnects. Subscriptions are renewed
+ * once it is back.
+ */
+class MBotBridgeSession
+{
+public:
+    MBotBridgeSession(const std::string& uri = "ws://localhost:5005");
+    ~MBotBridgeSession();
+
+    MBotBridgeSession(const MBotBridgeSession&) = delete;
+    MBotBridgeSession& operator=(const MBotBridgeSession&) = delete;
+
+    /**
+     * Publishes data on a channel. Returns once the message is queued to send.
+     */
+    template <class T>
+    void publish(const std::string& channel, const T& data)
+    {
+        if (!as_bytes_)
+        {
+            MBotJSONMessage msg(lcmTypeToString(data), channel, data.getTypeName(), MBotMessageType::PUBLISH);
+            send(msg, nullptr, nullptr);
+            return;
+        }
+
+        MBotJSONMessage msg("", channel, data.getTypeName(), MBotMessageType::PUBLISH, true);
+        std::string lcm_data(data.getEncodedSize(), '\0');
+        data.encode(&lcm_data[0], 0, lcm_data.size());
+        send(msg, &lcm_data, nullptr);
+    }
+
+    /**
+     * Requests the latest data on a channel. The reply can be waited on later, so several requests can be sent before
+     * waiting for any of them.
+     */
+    std::future<MBotBridgeResponse> request(const std::string& channel);
+
+    /**
+     * Requests the latest data on a channel and waits for it. Returns false if the read failed or timed out.
+     */
+    template <class T>
+    bool read(const std::string& channel, T& data)
+    {
+        return decode(channel, request(channel), data);
+    }
+
+    /**
+     * Waits for the reply to a request and decodes it. Returns false if the read failed or timed out.
+     */
+    template <class T>
+    bool decode(const std::string& channel, std::future<MBotBridgeResponse> reply, T& data) const
+    {
+        if (reply.wait_for(timeout_) != std::future_status::ready)
+        {
+            std::cout << "[MBot API] WARNING: Read of " << channel << " timed out." << std::endl;
+            return false;
+        }
+
+        MBotBridgeResponse res = reply.get();
+        if (res.type != MBotMessageType::RESPONSE)
+        {
+            std::cout << "[MBot API] WARNING: Read failed. " << res.payload << std::endl;
+            return false;
+        }
+
+        return decodeResponse(res, data);
+    }
+
+    /**
+     * Calls callback with each new message on a channel until unsubscribed. The server sends messages as they are
+     * published, so none are missed unless the options skip them or the callback falls behind. The callback runs on a
+     * thread of its own, one per subscription.
+     *
+     * Returns an ID for the subscription, to unsubscribe with. The subscription is renewed if the connection drops.
+     */
+    template <class T>
+    int64_t subscribe(const std::string& channel, const std::function<void(const T&)>& callback,
+                      const SubscribeOptions& options = SubscribeOptions())
+    {
+        return addSubscription(channel, options, [channel, callback](const MBotBridgeResponse& res) {
+            if (res.type != MBotMessageType::RESPONSE)
+            {
+                std::cout << "[MBot API] WARNING: Subscription to " << channel << " failed. " << res.payload
+                          << std::endl;
+                return;
+            }
+
+            T data;
+            if (decodeResponse(res, data)) callback(data);
+        });
+    }
+
+    /**
+     * Ends a subscription. Its callback is not called again once this returns, unless it is called from the callback.
+     */
+    void unsubscribe(const int64_t id);
+
+    /**
+     * How many messages a subscription's queue has dropped because its callback fell behind.
+     */
+    uint64_t dropped(const int64_t id);
+
+    /**
+     * Decodes a reply from the server into data. Returns false if it can't be decoded.
+     */
+    template <class T>
+    static bool decodeResponse(const MBotBridgeResponse& res, T& data)
+    {
+        if (res.binary)
+        {
+            if (data.decode(res.payload.data(), 0, res.payload.size()) < 0)
+            {
+                std::cout << "[MBot API] WARNING: Read of binary data failed." << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        stringToLCMType(res.payload, data);
+        return true;
+    }
+
+    bool connected();
+
+    // How long to wait for a reply before giving up on a read.
+    void setTimeout(const std::chrono::milliseconds& timeout) { timeout_ = timeout; }
+
+    // Whether to send and receive raw LCM messages rather than JSON. JSON is the same protocol as before, so it works
+    // with servers that don't take raw LCM publishes.
+    void setAsBytes(const bool as_bytes) { as_bytes_ = as_bytes; }
+
+private:
+    enum ConnectionState
+    {
+        DISCONNECTED,
+        CONNECTING,
+        OPEN
+    };
+
+    typedef std::pair<int64_t, std::promise<MBotBridgeResponse> > PendingRequest;
+
+    WSClient c_;
+    std::string uri_;
+    std::thread io_thread_;
+    std::chrono::milliseconds timeout_;
+    std::atomic<bool> as_bytes_;
+
+    // Everything below is guarded by mtx_. Messages are sent with it held, so the order of pending_ is the order the
+    // requests went out.
+    std::mutex mtx_;
+    ConnectionState state_;
+    websocketpp::connection_hdl hdl_;
+    std::chrono::steady_clock::time_point last_connect_;
+    int64_t next_id_;
+    // Messages sent while connecting, which go out once the connection opens.
+    std::deque<std::pair<std::string, websocketpp::frame::opcode::value> > outbox_;
+    std::deque<PendingRequest> pending_;    // Requests waiting for a reply, oldest first.
+    // Subscriptions by the ID of the message that started them, which the server copies into each message it sends.
+    std::map<int64_t, std::shared_ptr<MBotSubscription> > subs_;
+
+    // Sends a message, or queues it if the connection is still opening. If lcm_data is not null, the message is sent
+    // in a binary frame followed by a zero byte and lcm_data. If reply is not null, the message is a request and reply
+    // is fulfilled when its reply arrives.
+    void send(MBotJSONMessage& msg, const std::string* lcm_data, std::promise<MBotBridgeResponse>* reply);
+
+    int64_t addSubscription(const std::string& channel, const SubscribeOptions& options,
+                            const MBotSubscription::Handler& handler);
+
+    // These must be called with mtx_ held.
+    bool connect();
+    void failPending(const std::string& reason);
+    void sendSubscribe(const int64_t id, const MBotSubscription& sub);
+    // Tries to reconnect later, so subscriptions are renewed even if nothing is sent.
+    void scheduleReconnect();
+
+    void on_open(websocketpp::connection_hdl hdl);
+    void on_fail(websocketpp::connection_hdl hdl);
+    void on_close(websocketpp::connection_hdl hdl);
+    void on_message(websocketpp::connection_hdl hdl, WSClient::message_ptr msg);
+};
+
+}   // namespace mbot_bridge
+
+#endif // MBOT_BRIDGE_SESSION_H
@@ -7,6 +7,8 @@
 #include <mbot_lcm_msgs/twist2D_t.hpp>
 #include <mbot_lcm_msgs/pose2D_t.hpp>
 #include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_utils.hpp>
 #include <mbot_lcm_msgs/path2D_t.hpp>
 
 namespace mbot_bridge {
@@ -19,8 +21,7 @@ void MBot::drive(const float vx, const float vy, const float wz) const
     msg.vy = vy;
     msg.wz = wz;
 
-    MBotBridgePublisher<mbot_lcm_msgs::twist2D_t> pub(MBOT_VEL_CMD_CHANNEL, msg, uri_);
-    pub.run();
+    session_->publish(MBOT_VEL_CMD_CHANNEL, msg);
 }
 
 void MBot::stop() const
@@ -36,8 +37,7 @@ void MBot::resetOdometry() const
     msg.y = 0;
     msg.theta = 0;
 
-    MBotBridgePublisher<mbot_lcm_msgs::pose2D_t> pub(ODOMETRY_RESET_CHANNEL, msg, uri_);
-    pub.run();
+    session_->publish(ODOMETRY_RESET_CHANNEL, msg);
 }
 
 void MBot::drivePath(const std::vector<std::array<float, 3> >& path) const
@@ -58,8 +58,7 @@ void MBot::drivePath(const std::vector<std::array<float, 3> >& path) const
 
     msg.path_length = path.size();
 
-    MBotBridgePublisher<mbot_lcm_msgs::path2D_t> pub(CONTROLLER_PATH_CHANNEL, msg, uri_);
-    pub.run();
+    session_->publish(CONTROLLER_PATH_CHANNEL, msg);
 }
 
 void MBot::readLidarScan(std::vector<float>& ranges, std::vector<float>& thetas) const
@@ -68,28 +67,37 @@ void MBot::readLidarScan(std::vector<float>& ranges, std::vector<float>& thetas)
     ranges.clear();
     thetas.clear();
 
-    MBotBridgeReader<mbot_lcm_msgs::lidar_t> reader(LIDAR_CHANNEL);
-    reader.run();
-
     // Only populate the lidar vectors if the read was successful.
-    if (reader.success())
+    mbot_lcm_msgs::lidar_t data;
+    auto readCompact = [this, &data]() {
+        mbot_lcm_msgs::lidar_compact_t compact;
+        if (!session_->read(LIDAR_COMPACT_CHANNEL, compact)) return false;
+        mbot_lcm_msgs::expand_lidar_compact(compact, data);
+        return true;
+    };
+
+    // The driver may publish compact scans, full scans, or both. Try the channel that worked last, then the other, so
+    // a read that fails while the driver starts up doesn't rule either out.
+    bool compact_first = *compact_lidar_;
+    for (const bool compact : { compact_first, !compact_first })
     {
-        mbot_lcm_msgs::lidar_t data = reader.getData();
-        ranges = data.ranges;
-        thetas = data.thetas;
+        if (compact ? readCompact() : session_->read(LIDAR_CHANNEL, data))
+        {
+            *compact_lidar_ = compact;
+            ranges = data.ranges;
+            thetas = data.thetas;
+            return;
+        }
     }
 }
 
 std::vector<float> MBot::readOdometry() const
 {
-    MBotBridgeReader<mbot_lcm_msgs::pose2D_t> reader(ODOMETRY_CHANNEL);
-    reader.run();
-
     std::vector<float> odom;
     // Only populate the odometry vector if the read was successful.
-    if (reader.success())
+    mbot_lcm_msgs::pose2D_t data;
+    if (session_->read(ODOMETRY_CHANNEL, data))
     {
-        mbot_lcm_msgs::pose2D_t data = reader.getData();
         odom = {data.x, data.y, data.theta};
     }
 
@@ -98,18 +106,38 @@ std::vector<float> MBot::readOdometry() const
 
 std::vector<float> MBot::readSlamPose() const
 {
-    MBotBridgeReader<mbot_lcm_msgs::pose2D_t> reader(SLAM_POSE_CHANNEL);
-    reader.run();
-
     std::vector<float> pose;
     // Only populate the odometry vector if the read was successful.
-    if (reader.success())
+    mbot_lcm_msgs::pose2D_t data;
+    if (session_->read(SLAM_POSE_CHANNEL, data))
     {
-        mbot_lcm_msgs::pose2D_t data = reader.getData();
         pose = {data.x, data.y, data.theta};
     }
 
     return pose;
 }
 
+int64_t MBot::subscribeLidarScan(const std::function<void(const std::vector<float>& ranges,
+                                                         const std::vector<float>& thetas)>& callback,
+                                const SubscribeOptions& options) const
+{
+    // Each message is expanded on the subscription's own thread, so the scan can be reused.
+    auto scan = std::make_shared<mbot_lcm_msgs::lidar_t>();
+    std::function<void(const mbot_lcm_msgs::lidar_compact_t&)> cb =
+        [callback, scan](const mbot_lcm_msgs::lidar_compact_t& data) {
+            mbot_lcm_msgs::expand_lidar_compact(data, *scan);
+            callback(scan->ranges, scan->thetas);
+        };
+    return session_->subscribe(LIDAR_COMPACT_CHANNEL, cb, options);
+}
+
+int64_t MBot::subscribeOdometry(const std::function<void(const std::vector<float>& odom)>& callback,
+                                const SubscribeOptions& options) const
+{
+    std::function<void(const mbot_lcm_msgs::pose2D_t&)> cb = [callback](const mbot_lcm_msgs::pose2D_t& data) {
+        callback({data.x, data.y, data.theta});
+    };
+    return session_->subscribe(ODOMETRY_CHANNEL, cb, options);
+}
+
 }   // namespace mbot_bridge
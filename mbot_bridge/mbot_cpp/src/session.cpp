@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include <mbot_bridge/session.h>
+
+namespace mbot_bridge {
+
+// How long a read waits for its reply by default.
+static const std::chrono::milliseconds DEFAULT_TIMEOUT(1000);
+// How often to try to reconnect while the server is down, so calls fail quickly rather than each waiting to connect.
+static const std::chrono::milliseconds RECONNECT_PERIOD(1000);
+
+MBotSubscription::MBotSubscription(const std::string& channel, const SubscribeOptions& options,
+                                   const Handler& handler) :
+    channel_(channel),
+    options_(options),
+    handler_(handler),
+    dropped_(0),
+    running_(false)
+{
+    options_.queue_size = std::max(options_.queue_size, size_t(1));
+}
+
+void MBotSubscription::start()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    running_ = true;
+    std::shared_ptr<MBotSubscription> self = shared_from_this();
+    worker_ = std::thread([self]() { self->run(); });
+}
+
+void MBotSubscription::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        running_ = false;
+        queue_.clear();
+    }
+    cv_.notify_all();
+
+    if (!worker_.joinable()) return;
+    if (worker_.get_id() == std::this_thread::get_id())
+    {
+        // Unsubscribed from its own callback. The thread exits when the callback returns.
+        worker_.detach();
+    }
+    else
+    {
+        worker_.join();
+    }
+}
+
+void MBotSubscription::push(MBotBridgeResponse&& msg)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!running_) return;
+
+        if (queue_.size() >= options_.queue_size)
+        {
+            if (++dropped_ == 1)
+            {
+                std::cout << "[MBot API] WARNING: Subscription to " << channel_
+                          << " is falling behind. Dropping messages." << std::endl;
+            }
+            if (options_.drop_policy == DROP_NEWEST) return;
+            queue_.pop_front();
+        }
+        queue_.push_back(std::move(msg));
+    }
+    cv_.notify_one();
+}
+
+void MBotSubscription::run()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true)
+    {
+        cv_.wait(lock, [this]() { return !running_ || !queue_.empty(); });
+        if (!running_) return;
+
+        MBotBridgeResponse msg = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        handler_(msg);
+        lock.lock();
+    }
+}
+
+MBotBridgeSession::MBotBridgeSession(const std::string& uri) :
+    uri_(uri),
+    timeout_(DEFAULT_TIMEOUT),
+    as_bytes_(true),
+    state_(DISCONNECTED),
+    last_connect_(),
+    next_id_(0)
+{
+    c_.clear_access_channels(websocketpp::log::alevel::all);
+    c_.clear_error_channels(websocketpp::log::elevel::all);
+
+    c_.set_open_handler(websocketpp::lib::bind(&MBotBridgeSession::on_open, this, ::_1));
+    c_.set_fail_handler(websocketpp::lib::bind(&MBotBridgeSession::on_fail, this, ::_1));
+    c_.set_close_handler(websocketpp::lib::bind(&MBotBridgeSession::on_close, this, ::_1));
+    c_.set_message_handler(websocketpp::lib::bind(&MBotBridgeSession::on_message, this, ::_1, ::_2));
+    // The messages are small and each one is waited on, so send them right away instead of batching them.
+    c_.set_socket_init_handler([](websocketpp::connection_hdl hdl, websocketpp::lib::asio::ip::tcp::socket& s) {
+        s.set_option(websocketpp::lib::asio::ip::tcp::no_delay(true));
+    });
+
+    c_.init_asio();
+    // Keep the event loop running while there is no connection, so it can reconnect.
+    c_.start_perpetual();
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        connect();
+    }
+
+    io_thread_ = std::thread([this]() {
+        try {
+            c_.run();
+        } catch (websocketpp::exception const & e) {
+            std::cout << "[MBot API] ERROR: " << e.what() << std::endl;
+        }
+    });
+}
+
+MBotBridgeSession::~MBotBridgeSession()
+{
+    ConnectionState state;
+    websocketpp::connection_hdl hdl;
+    std::map<int64_t, std::shared_ptr<MBotSubscription> > subs;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        state = state_;
+        hdl = hdl_;
+        subs.swap(subs_);
+    }
+
+    // Stop the callbacks first. They might still be reading, which needs the connection.
+    for (auto& sub : subs)
+    {
+        sub.second->stop();
+    }
+
+    // The event loop returns once the connection is closed.
+    c_.stop_perpetual();
+    websocketpp::lib::error_code ec;
+    if (state == OPEN)
+    {
+        c_.close(hdl, websocketpp::close::status::normal, "", ec);
+    }
+    if (state != OPEN || ec)
+    {
+        c_.stop();
+    }
+    io_thread_.join();
+}
+
+std::future<MBotBridgeResponse> MBotBridgeSession::request(const std::string& channel)
+{
+    MBotJSONMessage msg("", channel, "", MBotMessageType::REQUEST, as_bytes_);
+    std::promise<MBotBridgeResponse> reply;
+    std::future<MBotBridgeResponse> res = reply.get_future();
+    send(msg, nullptr, &reply);
+    return res;
+}
+
+void MBotBridgeSession::unsubscribe(const int64_t id)
+{
+    std::shared_ptr<MBotSubscription> sub;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = subs_.find(id);
+        if (it == subs_.end()) return;
+        sub = it->second;
+        subs_.erase(it);
+
+        if (state_ == OPEN)
+        {
+            // The message carries the subscription's ID, so other subscriptions to the channel carry on.
+            MBotJSONMessage msg("", sub->channel(), "", MBotMessageType::UNSUBSCRIBE);
+            msg.setId(id);
+            websocketpp::lib::error_code ec;
+            c_.send(hdl_, msg.encode(), websocketpp::frame::opcode::text, ec);
+        }
+    }
+    sub->stop();
+}
+
+uint64_t MBotBridgeSession::dropped(const int64_t id)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = subs_.find(id);
+    return it == subs_.end() ? 0 : it->second->dropped();
+}
+
+bool MBotBridgeSession::connected()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return state_ == OPEN;
+}
+
+void MBotBridgeSession::send(MBotJSONMessage& msg, const std::string* lcm_data,
+                             std::promise<MBotBridgeResponse>* reply)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (state_ == DISCONNECTED && !connect())
+    {
+        if (reply != nullptr)
+        {
+            reply->set_value({MBotMessageType::ERROR, false, "Not connected to the MBot Bridge at " + uri_});
+        }
+        return;
+    }
+
+    int64_t id = next_id_++;
+    msg.setId(id);
+    std::string payload = msg.encode();
+    websocketpp::frame::opcode::value opcode = websocketpp::frame::opcode::text;
+    if (lcm_data != nullptr)
+    {
+        payload.push_back('\0');
+        payload.append(*lcm_data);
+        opcode = websocketpp::frame::opcode::binary;
+    }
+
+    if (state_ == CONNECTING)
+    {
+        outbox_.emplace_back(payload, opcode);
+    }
+    else
+    {
+        websocketpp::lib::error_code ec;
+        c_.send(hdl_, payload, opcode, ec);
+        if (ec)
+        {
+            std::cout << "[MBot API] WARNING: Send failed: " << ec.message() << std::endl;
+            if (reply != nullptr)
+            {
+                reply->set_value({MBotMessageType::ERROR, false, "Send failed: " + ec.message()});
+            }
+            return;
+        }
+    }
+
+    if (reply != nullptr)
+    {
+        pending_.emplace_back(id, std::move(*reply));
+    }
+}
+
+int64_t MBotBridgeSession::addSubscription(const std::string& channel, const SubscribeOptions& options,
+                                           const MBotSubscription::Handler& handler)
+{
+    auto sub = std::make_shared<MBotSubscription>(channel, options, handler);
+    sub->start();
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    int64_t id = next_id_++;
+    subs_[id] = sub;
+
+    // Subscriptions are sent when the connection opens, rather than from the outbox, so they are renewed after the
+    // connection drops.
+    if (state_ == OPEN)
+    {
+        sendSubscribe(id, *sub);
+    }
+    else if (state_ == DISCONNECTED && !connect())
+    {
+        scheduleReconnect();
+    }
+    return id;
+}
+
+bool MBotBridgeSession::connect()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_connect_ < RECONNECT_PERIOD) return false;
+    last_connect_ = now;
+
+    websocketpp::lib::error_code ec;
+    WSClient::connection_ptr con = c_.get_connection(uri_, ec);
+    if (ec) {
+        std::cout << "[MBot API] ERROR: Could not create connection: " << ec.message() << std::endl;
+        return false;
+    }
+
+    // This only requests the connection. It opens on the event loop, which calls on_open().
+    c_.connect(con);
+    state_ = CONNECTING;
+    return true;
+}
+
+void MBotBridgeSession::failPending(const std::string& reason)
+{
+    outbox_.clear();
+    for (auto& req : pending_)
+    {
+        req.second.set_value({MBotMessageType::ERROR, false, reason});
+    }
+    pending_.clear();
+}
+
+void MBotBridgeSession::sendSubscribe(const int64_t id, const MBotSubscription& sub)
+{
+    const SubscribeOptions& options = sub.options();
+    std::ostringstream data;
+    data << keyValToJSON("decimate", options.decimate) << "," << keyValToJSON("queue_size", options.queue_size);
+    if (options.max_rate > 0)
+    {
+        data << "," << keyValToJSON("max_rate", options.max_rate);
+    }
+
+    MBotJSONMessage msg(data.str(), sub.channel(), "", MBotMessageType::SUBSCRIBE, as_bytes_);
+    msg.setId(id);
+    websocketpp::lib::error_code ec;
+    c_.send(hdl_, msg.encode(), websocketpp::frame::opcode::text, ec);
+    if (ec)
+    {
+        std::cout << "[MBot API] WARNING: Subscribe to " << sub.channel() << " failed: " << ec.message() << std::endl;
+    }
+}
+
+void MBotBridgeSession::scheduleReconnect()
+{
+    if (subs_.empty()) return;
+
+    c_.set_timer(RECONNECT_PERIOD.count(), [this](const websocketpp::lib::error_code& ec) {
+        if (ec) return;
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (state_ != DISCONNECTED) return;
+        if (!connect()) scheduleReconnect();
+    });
+}
+
+void MBotBridgeSession::on_open(websocketpp::connection_hdl hdl)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    state_ = OPEN;
+    hdl_ = hdl;
+
+    for (auto& sub : subs_)
+    {
+        sendSubscribe(sub.first, *sub.second);
+    }
+
+    for (auto& msg : outbox_)
+    {
+        websocketpp::lib::error_code ec;
+        c_.send(hdl_, msg.first, msg.second, ec);
+    }
+    outbox_.clear();
+}
+
+void MBotBridgeSession::on_fail(websocketpp::connection_hdl hdl)
+{
+    std::cout << "[MBot API] WARNING: Connection to MBot Bridge failed." << std::endl;
+    std::lock_guard<std::mutex> lock(mtx_);
+    state_ = DISCONNECTED;
+    failPending("Connection to the MBot Bridge failed.");
+    scheduleReconnect();
+}
+
+void MBotBridgeSession::on_close(websocketpp::connection_hdl hdl)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    state_ = DISCONNECTED;
+    failPending("Connection to the MBot Bridge closed.");
+    scheduleReconnect();
+}
+
+void MBotBridgeSession::on_message(websocketpp::connection_hdl hdl, WSClient::message_ptr msg)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (msg->get_opcode() != websocketpp::frame::opcode::text)
+    {
+        // Messages for a subscription start with a JSON header, then a zero byte. Raw LCM data starts with the type's
+        // fingerprint instead.
+        const std::string& payload = msg->get_payload();
+        size_t header_end = payload.find('\0');
+        if (payload.compare(0, 7, "{\"type\"") == 0 && header_end != std::string::npos)
+        {
+            MBotJSONMessage header;
+            header.decode(payload.substr(0, header_end));
+            auto sub = subs_.find(header.id());
+            if (sub != subs_.end())
+            {
+                sub->second->push({MBotMessageType::RESPONSE, true, payload.substr(header_end + 1)});
+            }
+            return;
+        }
+
+        // Raw LCM data has no ID, but the server replies in order, so it answers the oldest request.
+        if (pending_.empty()) return;
+        pending_.front().second.set_value({MBotMessageType::RESPONSE, true, msg->get_payload()});
+        pending_.pop_front();
+        return;
+    }
+
+    MBotJSONMessage in_msg;
+    in_msg.decode(msg->get_payload());
+
+    // A message for a subscription, or an error if the subscribe failed.
+    auto sub = subs_.find(in_msg.id());
+    if (in_msg.id() >= 0 && sub != subs_.end())
+    {
+        sub->second->push({in_msg.type(), false, in_msg.data()});
+        return;
+    }
+
+    // A reply without an ID is from a server that doesn't copy them, which also answers the oldest request.
+    auto it = pending_.begin();
+    if (in_msg.id() >= 0)
+    {
+        while (it != pending_.end() && it->first != in_msg.id()) ++it;
+    }
+
+    if (it == pending_.end())
+    {
+        // Publishes only get a reply if they failed.
+        if (in_msg.type() == MBotMessageType::ERROR)
+        {
+            std::cout << "[MBot API] WARNING: Publish failed. " << in_msg.data() << std::endl;
+        }
+        return;
+    }
+
+    it->second.set_value({in_msg.type(), false, in_msg.data()});
+    pending_.erase(it);
+}
+
+}   // namespace mbot_bridge
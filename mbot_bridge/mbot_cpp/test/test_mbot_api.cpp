@@ -1,3 +1,7 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <mbot_bridge/robot.h>
 
 
@@ -26,4 +30,24 @@ int main(int argc, char* argv[])
     path.push_back({1,2,0.3});
     path.push_back({4,5,0.6});
     mbot.drivePath(path);
+
+    // A control loop: read the odometry and send a command, as fast as the bridge allows.
+    const int num_loops = 500;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_loops; ++i)
+    {
+        odom = mbot.readOdometry();
+        mbot.drive(0, 0, 0);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Control loop rate: " << num_loops / elapsed.count() << " Hz" << std::endl;
+
+    // Stream the lidar for a second instead of polling it.
+    std::atomic<int> num_scans(0);
+    auto sub = mbot.subscribeLidarScan([&num_scans](const std::vector<float>& ranges, const std::vector<float>& thetas) {
+        num_scans++;
+    });
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    mbot.unsubscribe(sub);
+    std::cout << "Lidar scans streamed in 1 s: " << num_scans << std::endl;
 }
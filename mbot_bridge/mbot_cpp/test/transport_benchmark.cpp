@@ -0,0 +1,197 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <mbot_bridge/lcm_utils.h>
+#include <mbot_bridge/mbot_json_msgs.h>
+
+/**
+ * Compares sending messages as JSON with sending them as raw LCM messages. For each message, it reports how many bytes
+ * go over the websocket and how many messages a second the API can build (for publishes) or read (for replies from
+ * the server). It doesn't need a server: the replies are built the way the server builds them.
+ *
+ * The binary rates time the decode() generated by lcm-gen, so they only mean something when built against the real
+ * mbot_lcm_msgs. Each decode starts from a cleared message and the last one is checked against the original, so a
+ * decode() that does no work is reported rather than timed.
+ */
+
+using namespace mbot_bridge;
+
+static const int NUM_RAYS = 360;
+static const int PATH_LENGTH = 20;
+
+// Written with each result, so the work isn't optimized away.
+static volatile size_t sink;
+
+/**
+ * A reply from the server in JSON, formatted the way Python's json module formats it.
+ */
+static std::string serverResponse(const std::string& channel, const std::string& dtype, const std::string& data)
+{
+    return "{\"type\": \"response\", \"channel\": \"" + channel + "\", \"dtype\": \"" + dtype +
+           "\", \"id\": 1, \"data\": {" + data + "}}";
+}
+
+/**
+ * The messages each form handles per second, running f for a fixed number of messages.
+ */
+template <class F>
+static double rate(const int num_msgs, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_msgs; ++i) f();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return num_msgs / elapsed.count();
+}
+
+static void report(const std::string& name, const size_t json_bytes, const double json_rate,
+                   const size_t binary_bytes, const double binary_rate)
+{
+    printf("%-22s %-7s %10zu %12.0f\n", name.c_str(), "JSON", json_bytes, json_rate);
+    printf("%-22s %-7s %10zu %12.0f\n", "", "binary", binary_bytes, binary_rate);
+}
+
+template <class T>
+static std::string encode(const T& data)
+{
+    std::string buf(data.getEncodedSize(), '\0');
+    data.encode(&buf[0], 0, buf.size());
+    return buf;
+}
+
+/**
+ * A publish as the API sends it: JSON, or a JSON header, a zero byte, and the raw LCM message.
+ */
+template <class T>
+static std::string publishJSON(const std::string& channel, const T& data)
+{
+    MBotJSONMessage msg(lcmTypeToString(data), channel, data.getTypeName(), MBotMessageType::PUBLISH);
+    msg.setId(1);
+    return msg.encode();
+}
+
+template <class T>
+static std::string publishBinary(const std::string& channel, const T& data)
+{
+    MBotJSONMessage msg("", channel, data.getTypeName(), MBotMessageType::PUBLISH, true);
+    msg.setId(1);
+    std::string payload = msg.encode();
+    payload.push_back('\0');
+    payload.append(encode(data));
+    return payload;
+}
+
+int main(int argc, char* argv[])
+{
+    int num_msgs = 2000;
+    if (argc > 1) num_msgs = std::stoi(argv[1]);
+
+    printf("%-22s %-7s %10s %12s\n", "message", "form", "bytes/msg", "msgs/s");
+
+    // Odometry, the message most read in a control loop.
+    mbot_lcm_msgs::pose2D_t pose;
+    pose.utime = 1700000000000000;
+    pose.x = 1.2345;
+    pose.y = -0.5432;
+    pose.theta = 0.7854;
+    std::string pose_json = serverResponse(ODOMETRY_CHANNEL, "pose2D_t", lcmTypeToString(pose));
+    std::string pose_binary = encode(pose);
+    mbot_lcm_msgs::pose2D_t pose_out;
+    double pose_json_rate = rate(num_msgs, [&]() {
+        MBotJSONMessage in_msg;
+        in_msg.decode(pose_json);
+        stringToLCMType(in_msg.data(), pose_out);
+        sink = pose_out.utime;
+    });
+    double pose_binary_rate = rate(num_msgs, [&]() {
+        pose_out = mbot_lcm_msgs::pose2D_t();
+        pose_out.decode(pose_binary.data(), 0, pose_binary.size());
+        sink = pose_out.utime;
+    });
+    if (pose_out.utime != pose.utime || pose_out.x != pose.x || pose_out.y != pose.y || pose_out.theta != pose.theta)
+    {
+        printf("ERROR: pose2D_t::decode() didn't reproduce the message. Build against the lcm-gen types.\n");
+        return 1;
+    }
+    report("read pose2D_t", pose_json.size(), pose_json_rate, pose_binary.size(), pose_binary_rate);
+
+    // A full lidar scan. The server's JSON leaves out the times and intensities and rounds to 4 places.
+    mbot_lcm_msgs::lidar_t scan;
+    scan.utime = 1700000000000000;
+    scan.num_ranges = NUM_RAYS;
+    std::ostringstream ranges, thetas;
+    ranges << std::setprecision(5);
+    thetas << std::setprecision(5);
+    for (int i = 0; i < NUM_RAYS; ++i)
+    {
+        float theta = 2 * M_PI * i / NUM_RAYS;
+        float range = 1.5 + std::sin(3 * theta);
+        scan.ranges.push_back(range);
+        scan.thetas.push_back(theta);
+        scan.times.push_back(scan.utime + i * 200);
+        scan.intensities.push_back(47);
+        ranges << (i > 0 ? ", " : "") << std::round(range * 1e4) / 1e4;
+        thetas << (i > 0 ? ", " : "") << std::round(theta * 1e4) / 1e4;
+    }
+    std::string scan_json = serverResponse(LIDAR_CHANNEL, "lidar_t",
+                                           "\"utime\": " + std::to_string(scan.utime) + ", \"num_ranges\": " +
+                                           std::to_string(NUM_RAYS) + ", \"ranges\": [" + ranges.str() +
+                                           "], \"thetas\": [" + thetas.str() + "]");
+    std::string scan_binary = encode(scan);
+    mbot_lcm_msgs::lidar_t scan_out;
+    int num_scans = std::max(num_msgs / 20, 1);
+    double scan_json_rate = rate(num_scans, [&]() {
+        MBotJSONMessage in_msg;
+        in_msg.decode(scan_json);
+        stringToLCMType(in_msg.data(), scan_out);
+        sink = scan_out.ranges.size();
+    });
+    double scan_binary_rate = rate(num_msgs, [&]() {
+        scan_out = mbot_lcm_msgs::lidar_t();
+        scan_out.decode(scan_binary.data(), 0, scan_binary.size());
+        sink = scan_out.ranges.size();
+    });
+    if (scan_out.utime != scan.utime || scan_out.ranges != scan.ranges || scan_out.thetas != scan.thetas ||
+        scan_out.times != scan.times || scan_out.intensities != scan.intensities)
+    {
+        printf("ERROR: lidar_t::decode() didn't reproduce the message. Build against the lcm-gen types.\n");
+        return 1;
+    }
+    report("read lidar_t", scan_json.size(), scan_json_rate, scan_binary.size(), scan_binary_rate);
+
+    // A drive command.
+    mbot_lcm_msgs::twist2D_t cmd;
+    cmd.utime = 1700000000000000;
+    cmd.vx = 0.25;
+    cmd.vy = 0;
+    cmd.wz = -0.5;
+    size_t cmd_json_size = publishJSON(MBOT_VEL_CMD_CHANNEL, cmd).size();
+    size_t cmd_binary_size = publishBinary(MBOT_VEL_CMD_CHANNEL, cmd).size();
+    double cmd_json_rate = rate(num_msgs, [&]() { sink = publishJSON(MBOT_VEL_CMD_CHANNEL, cmd).size(); });
+    double cmd_binary_rate = rate(num_msgs, [&]() { sink = publishBinary(MBOT_VEL_CMD_CHANNEL, cmd).size(); });
+    report("publish twist2D_t", cmd_json_size, cmd_json_rate, cmd_binary_size, cmd_binary_rate);
+
+    // A path for the motion controller.
+    mbot_lcm_msgs::path2D_t path;
+    path.utime = 1700000000000000;
+    path.path_length = PATH_LENGTH;
+    for (int i = 0; i < PATH_LENGTH; ++i)
+    {
+        mbot_lcm_msgs::pose2D_t p;
+        p.utime = 0;
+        p.x = 0.1 * i;
+        p.y = 0.05 * i;
+        p.theta = 0.01 * i;
+        path.path.push_back(p);
+    }
+    size_t path_json_size = publishJSON(CONTROLLER_PATH_CHANNEL, path).size();
+    size_t path_binary_size = publishBinary(CONTROLLER_PATH_CHANNEL, path).size();
+    double path_json_rate = rate(num_msgs, [&]() { sink = publishJSON(CONTROLLER_PATH_CHANNEL, path).size(); });
+    double path_binary_rate = rate(num_msgs, [&]() { sink = publishBinary(CONTROLLER_PATH_CHANNEL, path).size(); });
+    report("publish path2D_t", path_json_size, path_json_rate, path_binary_size, path_binary_rate);
+
+    return 0;
+}
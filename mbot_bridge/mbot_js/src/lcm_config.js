@@ -8,6 +8,7 @@ let config = {
   CONTROLLER_PATH: {channel: "CONTROLLER_PATH", dtype: "path2D_t"},
   MOTOR_VEL_CMD: {channel: "MBOT_VEL_CMD", dtype: "twist2D_t"},
   LIDAR: {channel: "LIDAR", dtype: "lidar_t"},
+  LIDAR_COMPACT: {channel: "LIDAR_COMPACT", dtype: "lidar_compact_t"},
   SLAM_MAP: {channel: "SLAM_MAP", dtype: "occupancy_grid_t"},
   SLAM_POSE: {channel: "SLAM_POSE", dtype: "pose2D_t"},
   MBOT_SYSTEM_RESET: {channel: "MBOT_SYSTEM_RESET", dtype: "mbot_slam_reset_t"}
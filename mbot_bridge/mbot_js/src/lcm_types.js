@@ -0,0 +1,117 @@
+/**
+ * Decoders for raw LCM messages, so the MBot Bridge can send data as bytes instead of JSON.
+ *
+ * Each type lists its fields in the order LCM encodes them. A variable length array names the field holding its
+ * length. These must match the type definitions in mbot_lcm_msgs.
+ */
+const LCM_TYPES = {
+  pose2D_t: [
+    ["utime", "int64_t"], ["x", "float"], ["y", "float"], ["theta", "float"]
+  ],
+  twist2D_t: [
+    ["utime", "int64_t"], ["vx", "float"], ["vy", "float"], ["wz", "float"]
+  ],
+  path2D_t: [
+    ["utime", "int64_t"], ["path_length", "int32_t"], ["path", "pose2D_t", "path_length"]
+  ],
+  lidar_t: [
+    ["utime", "int64_t"], ["num_ranges", "int32_t"], ["ranges", "float", "num_ranges"],
+    ["thetas", "float", "num_ranges"], ["times", "int64_t", "num_ranges"], ["intensities", "float", "num_ranges"]
+  ],
+  lidar_compact_t: [
+    ["utime", "int64_t"], ["start_time", "int64_t"], ["time_step", "float"], ["start_theta", "float"],
+    ["theta_step", "float"], ["num_ranges", "int32_t"], ["ranges", "int16_t", "num_ranges"],
+    ["intensities", "int8_t", "num_ranges"]
+  ],
+  occupancy_grid_t: [
+    ["utime", "int64_t"], ["origin_x", "float"], ["origin_y", "float"], ["meters_per_cell", "float"],
+    ["width", "int32_t"], ["height", "int32_t"], ["num_cells", "int32_t"], ["cells", "int8_t", "num_cells"]
+  ],
+  mbot_slam_reset_t: [
+    ["utime", "int64_t"], ["slam_mode", "int32_t"], ["slam_map_location", "string"], ["retain_pose", "boolean"]
+  ]
+};
+
+// Readers for the primitive types, which return the value and advance the offset. LCM is big-endian.
+const PRIMITIVES = {
+  int8_t: (view, pos) => [view.getInt8(pos), pos + 1],
+  byte: (view, pos) => [view.getUint8(pos), pos + 1],
+  boolean: (view, pos) => [view.getInt8(pos) !== 0, pos + 1],
+  int16_t: (view, pos) => [view.getInt16(pos), pos + 2],
+  int32_t: (view, pos) => [view.getInt32(pos), pos + 4],
+  int64_t: (view, pos) => [Number(view.getBigInt64(pos)), pos + 8],
+  float: (view, pos) => [view.getFloat32(pos), pos + 4],
+  double: (view, pos) => [view.getFloat64(pos), pos + 8],
+  string: (view, pos) => {
+    // The length includes the terminating zero, which isn't part of the string.
+    const len = view.getInt32(pos);
+    const bytes = new Uint8Array(view.buffer, view.byteOffset + pos + 4, len - 1);
+    return [new TextDecoder().decode(bytes), pos + 4 + len];
+  }
+};
+
+/**
+ * Strips the package from a type name, e.g. "mbot_lcm_msgs.pose2D_t" becomes "pose2D_t".
+ */
+function baseTypeName(dtype) {
+  return dtype.split(".").pop();
+}
+
+function decodeFields(dtype, view, pos) {
+  let msg = {};
+  for (const [name, type, len_field] of LCM_TYPES[dtype]) {
+    const read = PRIMITIVES[type];
+
+    if (len_field === undefined) {
+      [msg[name], pos] = read === undefined ? decodeFields(type, view, pos) : read(view, pos);
+      continue;
+    }
+
+    const len = msg[len_field];
+    if (type === "int8_t" || type === "byte") {
+      // Byte arrays are copied out whole, e.g. the cells of a map.
+      const start = view.byteOffset + pos;
+      const bytes = view.buffer.slice(start, start + len);
+      msg[name] = type === "int8_t" ? new Int8Array(bytes) : new Uint8Array(bytes);
+      pos += len;
+      continue;
+    }
+
+    let vals = new Array(len);
+    for (let i = 0; i < len; i++) {
+      [vals[i], pos] = read === undefined ? decodeFields(type, view, pos) : read(view, pos);
+    }
+    msg[name] = vals;
+  }
+  return [msg, pos];
+}
+
+/**
+ * Whether raw LCM messages of the given type can be decoded.
+ *
+ * @param {string} dtype - The LCM type name.
+ * @returns {boolean}
+ */
+function canDecodeLCM(dtype) {
+  return dtype !== null && dtype !== undefined && LCM_TYPES[baseTypeName(dtype)] !== undefined;
+}
+
+/**
+ * Decodes a raw LCM message into an object with the same fields as the JSON the MBot Bridge sends.
+ *
+ * The message's type fingerprint isn't checked. The server knows the type on each channel and says so, so the data is
+ * decoded as the type given.
+ *
+ * @param {string} dtype - The LCM type name.
+ * @param {ArrayBuffer} buffer - The data.
+ * @param {number} [offset=0] - Where the LCM message starts in the buffer.
+ * @returns {Object} - The decoded message.
+ */
+function decodeLCM(dtype, buffer, offset = 0) {
+  const view = new DataView(buffer, offset);
+  // Skip the fingerprint.
+  const [msg, ] = decodeFields(baseTypeName(dtype), view, 8);
+  return msg;
+}
+
+export { LCM_TYPES, canDecodeLCM, decodeLCM };
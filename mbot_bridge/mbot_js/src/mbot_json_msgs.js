@@ -12,11 +12,12 @@ const MBotMessageType = {
 
 
 class MBotJSONMessage {
-  constructor(data=null, ch=null, dtype=null, rtype=null) {
+  constructor(data=null, ch=null, dtype=null, rtype=null, as_bytes=false) {
     this.data = data;
     this.channel = ch;
     this.dtype = dtype;
     this.rtype = rtype;
+    this.as_bytes = as_bytes;
   }
 
   encode() {
@@ -42,6 +43,9 @@ class MBotJSONMessage {
     if (this.channel !== null) msg.channel = this.channel;
     if (this.dtype !== null) msg.dtype = this.dtype;
     if (this.data !== null) msg.data = this.data;
+    // Whether to send the data as a raw LCM message rather than JSON.
+    if (this.rtype === MBotMessageType.REQUEST || this.rtype === MBotMessageType.SUBSCRIBE)
+      msg.as_bytes = this.as_bytes;
 
     return JSON.stringify(msg);
   }
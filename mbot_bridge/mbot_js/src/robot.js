@@ -1,4 +1,5 @@
 import { MBotMessageType, MBotJSONMessage } from "./mbot_json_msgs.js";
+import { canDecodeLCM, decodeLCM } from "./lcm_types.js";
 import config from "./lcm_config.js";
 
 /**
@@ -18,26 +19,61 @@ class MBot {
     this.ws_subs = {};
   }
 
+  /**
+   * Private method to decode a message from the server. Binary messages are raw LCM data, decoded as the given type.
+   * If hasHeader is true, the data follows a JSON message describing it and a zero byte.
+   *
+   * @param {string|ArrayBuffer} data - The message from the server.
+   * @param {string} ch - The channel the message is on.
+   * @param {string} dtype - The LCM type of the data, if it is sent as bytes.
+   * @param {boolean} [hasHeader=false] - Whether binary data starts with a JSON message.
+   * @returns {MBotJSONMessage} - The decoded message.
+   * @private
+   */
+  _decode(data, ch, dtype, hasHeader = false) {
+    let res = new MBotJSONMessage();
+    if (!(data instanceof ArrayBuffer)) {
+      res.decode(data);
+      return res;
+    }
+
+    let offset = 0;
+    if (hasHeader) {
+      const bytes = new Uint8Array(data);
+      offset = bytes.indexOf(0);
+      res.decode(new TextDecoder().decode(bytes.subarray(0, offset)));
+      offset += 1;
+    }
+    else {
+      res = new MBotJSONMessage(null, ch, dtype, MBotMessageType.RESPONSE);
+    }
+
+    res.data = decodeLCM(res.dtype !== null ? res.dtype : dtype, data, offset);
+    return res;
+  }
+
   /**
    * Private method to send a data request to a specified channel and receive the response.
    *
    * @param {string} ch - The channel to read data from.
+   * @param {string} [dtype=null] - The LCM type on the channel. If it's known, the data is sent as a raw LCM
+   *                                message, which is faster than JSON.
    * @returns {Promise} - A Promise that resolves with the received data or rejects if there is an error.
    * @private
    */
-  _read(ch) {
-    let msg = new MBotJSONMessage(null, ch, null, MBotMessageType.REQUEST);
+  _read(ch, dtype = null) {
+    let msg = new MBotJSONMessage(null, ch, null, MBotMessageType.REQUEST, canDecodeLCM(dtype));
 
     let promise = new Promise((resolve, reject) => {
       const websocket = new WebSocket(this.address);
+      websocket.binaryType = "arraybuffer";
 
       websocket.onopen = (event) => {
         websocket.send(msg.encode());
       };
 
       websocket.onmessage = (event) => {
-        let res = new MBotJSONMessage();
-        res.decode(event.data);
+        let res = this._decode(event.data, ch, dtype);
         websocket.close(1000);  // 1000 indicates a normal close.
 
         // Check for error from the server.
@@ -85,26 +121,28 @@ class MBot {
    *
    * @param {string} ch - The channel to subscribe to.
    * @param {function} cb - The callback function to handle incoming messages from the specified channel.
+   * @param {string} [dtype=null] - The LCM type on the channel. If it's known, the data is sent as raw LCM messages,
+   *                                which is faster than JSON.
    * @returns {Promise} - A Promise that resolves when the connection to the MBot Bridge is successfully opened and the
    *                      subscription message is sent. It rejects if there is an error in establishing the connection
    *                      or sending the subscription message.
    */
-  subscribe(ch, cb) {
-    let msg = new MBotJSONMessage(null, ch, null, MBotMessageType.SUBSCRIBE);
+  subscribe(ch, cb, dtype = null) {
+    let msg = new MBotJSONMessage(null, ch, null, MBotMessageType.SUBSCRIBE, canDecodeLCM(dtype));
     if (this.ws_subs[ch]) {
       return Promise.resolve();
     }
 
     let promise = new Promise((resolve, reject) => {
       this.ws_subs[ch] = new WebSocket(this.address);
+      this.ws_subs[ch].binaryType = "arraybuffer";
 
       this.ws_subs[ch].onopen = (event) => {
         this.ws_subs[ch].send(msg.encode());
       };
 
       this.ws_subs[ch].onmessage = (event) => {
-        let res = new MBotJSONMessage();
-        res.decode(event.data);
+        let res = this._decode(event.data, ch, dtype, true);
 
         if (res.rtype === MBotMessageType.ERROR) {
           // This promise fails if there was an error on the first response.
@@ -168,11 +206,12 @@ class MBot {
    * Reads the latest data from a specified channel.
    *
    * @param {string} ch - The channel to read data from.
+   * @param {string} [dtype=null] - The LCM type on the channel, if known, to read it as a raw LCM message.
    * @returns {Promise<*>} - A Promise that resolves with the latest data from the specified channel.
    */
-  readData(ch) {
+  readData(ch, dtype = null) {
     let promise = new Promise((resolve, reject) => {
-      this._read(ch).then((val) => {
+      this._read(ch, dtype).then((val) => {
         resolve(val.data);
       }).catch((error) => {
         reject(error);
@@ -207,7 +246,7 @@ class MBot {
    */
   readOdometry() {
     let promise = new Promise((resolve, reject) => {
-      this._read(config.ODOMETRY.channel).then((val) => {
+      this._read(config.ODOMETRY.channel, config.ODOMETRY.dtype).then((val) => {
         const odom = [val.data.x, val.data.y, val.data.theta];
         resolve(odom)
       }).catch((error) => {
@@ -220,15 +259,18 @@ class MBot {
 
   readMap() {
     let promise = new Promise((resolve, reject) => {
-      this._read(config.SLAM_MAP.channel).then((msg) => {
+      this._read(config.SLAM_MAP.channel, config.SLAM_MAP.dtype).then((msg) => {
         const data = msg.data;
-        // Read the cells as a byte array.
-        let binaryString = atob(data.cells);
-        let len = binaryString.length;
-        let cells = new Int8Array(len);
-
-        for (let i = 0; i < len; i++) {
-          cells[i] = binaryString.charCodeAt(i) << 24 >> 24;
+        // A raw LCM message has the cells as a byte array already. In JSON, they are base64 encoded.
+        let cells = data.cells;
+        if (typeof cells === "string") {
+          let binaryString = atob(data.cells);
+          let len = binaryString.length;
+          cells = new Int8Array(len);
+
+          for (let i = 0; i < len; i++) {
+            cells[i] = binaryString.charCodeAt(i) << 24 >> 24;
+          }
         }
         // Collect all the map data.
         const map_data = {
@@ -15,5 +15,6 @@ class LCMConfig(object):
     CONTROLLER_PATH = MBotChannel("CONTROLLER_PATH", "path2D_t")
     MOTOR_VEL_CMD = MBotChannel("MBOT_VEL_CMD", "twist2D_t")
     LIDAR = MBotChannel("LIDAR", "lidar_t")
+    LIDAR_COMPACT = MBotChannel("LIDAR_COMPACT", "lidar_compact_t")
     SLAM_MAP = MBotChannel("SLAM_MAP", "occupancy_grid_t")
     SLAM_POSE = MBotChannel("SLAM_POSE", "pose2D_t")
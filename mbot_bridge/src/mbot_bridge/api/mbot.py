@@ -14,6 +14,8 @@ class MBot(object):
         self.uri = f"ws://{host}:{port}"
         self.connect_timeout = connect_timeout
         self.lcm_config = LCMConfig()
+        # Whether the last lidar scan read was a compact one, so the next read tries that channel first.
+        self._compact_lidar = True
 
     """PUBLISHERS"""
 
@@ -135,11 +137,25 @@ class MBot(object):
         return []
 
     def read_lidar(self):
-        res = asyncio.run(self._request(self.lcm_config.LIDAR.channel,
-                                        self.lcm_config.LIDAR.dtype,
-                                        as_bytes=False, request_as_bytes=True))
-        if res is not None:
-            return res.ranges, res.thetas
+        # The driver may publish compact scans, full scans, or both. Try the channel that worked last, then the other,
+        # so a read that fails while the driver starts up doesn't rule either out.
+        for compact in (self._compact_lidar, not self._compact_lidar):
+            if compact:
+                res = asyncio.run(self._request(self.lcm_config.LIDAR_COMPACT.channel,
+                                                self.lcm_config.LIDAR_COMPACT.dtype,
+                                                as_bytes=False, request_as_bytes=True))
+                if res is not None:
+                    self._compact_lidar = True
+                    ranges = [r / 1000. for r in res.ranges]
+                    thetas = [res.start_theta + i * res.theta_step for i in range(res.num_ranges)]
+                    return ranges, thetas
+            else:
+                res = asyncio.run(self._request(self.lcm_config.LIDAR.channel,
+                                                self.lcm_config.LIDAR.dtype,
+                                                as_bytes=False, request_as_bytes=True))
+                if res is not None:
+                    self._compact_lidar = False
+                    return res.ranges, res.thetas
 
         return [], []
 
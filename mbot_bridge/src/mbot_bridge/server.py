@@ -8,6 +8,7 @@ import logging
 import threading
 import websockets
 import time
+import collections
 
 import lcm
 from mbot_bridge.utils import type_utils
@@ -102,13 +103,78 @@ class LCMMessageQueue(object):
         return active
 
 
+class LCMSubscription(object):
+    """A websocket's subscription to a channel.
+
+    The LCM thread queues each message for the subscription and a task on the websocket's event loop sends them, so a
+    slow client only fills its own queue and never holds up LCM. When the queue is full, the oldest message is dropped.
+    """
+    def __init__(self, ws, as_bytes=False, sub_id=None, max_rate=None, decimate=1, queue_size=10):
+        self.ws = ws
+        self.as_bytes = as_bytes
+        self.sub_id = sub_id
+
+        # Only every nth message is sent, and no more than max_rate a second.
+        self._decimate = max(int(decimate), 1)
+        self._min_period = 1. / max_rate if max_rate else 0
+        self._count = 0
+        self._last_sent = None
+
+        self._queue = collections.deque(maxlen=max(int(queue_size), 1))
+        self._dropped = 0
+        self._loop = asyncio.get_running_loop()
+        self._ready = asyncio.Event()
+        self._task = self._loop.create_task(self._run())
+
+    def wants(self, now):
+        # Whether to send a message which arrived at the given time, after decimation and rate limiting.
+        self._count += 1
+        if (self._count - 1) % self._decimate != 0:
+            return False
+        if self._last_sent is not None and now - self._last_sent < self._min_period:
+            return False
+        self._last_sent = now
+        return True
+
+    def push(self, msg):
+        # Called from the LCM thread. This never waits on the websocket.
+        if len(self._queue) == self._queue.maxlen:
+            self._dropped += 1
+            if self._dropped == 1:
+                logging.warning(f"Websocket ID {self.ws.id} - Falling behind, dropping old messages.")
+        self._queue.append(msg)
+        try:
+            self._loop.call_soon_threadsafe(self._ready.set)
+        except RuntimeError:
+            # The event loop has stopped, so there is no one to send to.
+            pass
+
+    def cancel(self):
+        # Safe to call from any thread.
+        try:
+            self._loop.call_soon_threadsafe(self._task.cancel)
+        except RuntimeError:
+            pass
+
+    async def _run(self):
+        try:
+            while True:
+                await self._ready.wait()
+                self._ready.clear()
+                while len(self._queue) > 0:
+                    await self.ws.send(self._queue.popleft())
+        except (websockets.exceptions.ConnectionClosedOK,
+                websockets.exceptions.ConnectionClosedError):
+            # The websocket's subscriptions are removed when its handler returns.
+            pass
+
+
 class MBotBridgeServer(object):
     def __init__(self, lcm_address, subs,
                  ignore_channels=[], map_channel="SLAM_MAP",
                  lcm_type_modules=["mbot_lcm_msgs"], lcm_timeout=1000,
                  hostfile="/etc/hostname", discard_msgs=-1, stale_channel_timeout=10):
         self._hostname = self._read_hostname(hostfile)
-        self._loop = None
         self._map_channel = map_channel
         self.lcm_type_modules = lcm_type_modules
         self.discard_msgs = discard_msgs
@@ -123,6 +189,7 @@ class MBotBridgeServer(object):
 
         self._msg_managers = {}
         self._subs = {}
+        self._subs_lock = threading.Lock()  # The subscriptions are changed by both the LCM thread and the event loop.
         self._ignore_channels = ignore_channels
 
         if isinstance(subs, list):
@@ -151,10 +218,10 @@ class MBotBridgeServer(object):
         self._lock.release()
 
         # Stop any websockets that might still be there.
-        for _, connections in self._subs.items():
-            for ws in connections:
-                if ws.open:
-                    await ws.close()
+        for _, subs in self._subs.items():
+            for sub in subs:
+                if sub.ws.open:
+                    await sub.ws.close()
 
     def running(self):
         self._lock.acquire()
@@ -228,22 +295,28 @@ class MBotBridgeServer(object):
 
         self._msg_managers[channel].push(data)
 
-        # If there are subscribers, send them the data.
-        if len(self._subs[channel]) > 0:
-            res = self._latest_as_msg(channel, decode=True)
-            for ws_sub in self._subs[channel]:
-                if not ws_sub.open:
-                    self._subs[channel].remove(ws_sub)
+        # If there are subscribers, queue the data for them. Each form is only built if someone wants it.
+        with self._subs_lock:
+            subs = list(self._subs[channel])
+        if len(subs) > 0:
+            now = time.monotonic()
+            res = None
+            for sub in subs:
+                if not sub.ws.open:
+                    self._remove_subs(sub.ws)
+                    continue
+                if not sub.wants(now):
                     continue
 
-                try:
-                    self._loop.run_until_complete(ws_sub.send(res.encode()))
-                except (websockets.exceptions.ConnectionClosedOK,
-                        websockets.exceptions.ConnectionClosedError,
-                        RuntimeError):
-                    # If this websocket is closed, remove it.
-                    logging.debug(f"Websocket ID {ws_sub.id} - Disconnected and unsubscribed from {channel}")
-                    self._subs[channel].remove(ws_sub)
+                if sub.as_bytes:
+                    out = self._framed_bytes(channel, data, sub.sub_id)
+                else:
+                    if res is None:
+                        res = self._latest_as_msg(channel, decode=True)
+                    res.set_request_id(sub.sub_id)
+                    out = res.encode()
+
+                sub.push(out)
 
     def handleOnce(self):
         # This is a non-blocking handle, which only calls handle if a message is ready.
@@ -252,21 +325,49 @@ class MBotBridgeServer(object):
             self._lcm.handle()
 
     def lcm_loop(self):
-        self._loop = asyncio.new_event_loop()
         while self.running():
             # This will block for a maximum of _lcm_timeout milliseconds, so it
             # might slow stopping the server, but it's less expensive than using
             # the non-blocking handleOnce.
             self._lcm.handle_timeout(self._lcm_timeout)
 
-    def _subscribe(self, ws, channel):
-        self._subs[channel].append(ws)
-
-    async def _unsubscribe(self, ws, channel=None):
-        await ws.close()
-        self._subs[channel].remove(ws)
+    def _framed_bytes(self, channel, data, sub_id=None):
+        # A binary message is a JSON message saying what the data is, a zero byte, then the raw LCM message.
+        header = MBotJSONResponse(None, channel, self._msg_managers[channel].dtype)
+        header.set_request_id(sub_id)
+        return header.encode().encode() + b"\0" + data
+
+    def _subscribe(self, ws, request):
+        # The data holds options for the subscription, if any.
+        opts = request.data() if isinstance(request.data(), dict) else {}
+        sub = LCMSubscription(ws, request.as_bytes(), request.request_id(),
+                              max_rate=opts.get("max_rate"), decimate=opts.get("decimate", 1),
+                              queue_size=opts.get("queue_size", 10))
+        with self._subs_lock:
+            self._subs[request.channel()].append(sub)
+
+    def _unsubscribe(self, ws, channel, sub_id=None):
+        # Ends the websocket's subscriptions to the channel, or only the one with the given ID.
+        with self._subs_lock:
+            keep = []
+            for sub in self._subs[channel]:
+                if sub.ws is ws and (sub_id is None or sub.sub_id == sub_id):
+                    sub.cancel()
+                else:
+                    keep.append(sub)
+            self._subs[channel] = keep
+
+    def _remove_subs(self, ws):
+        # Ends all the websocket's subscriptions.
+        for channel in list(self._subs.keys()):
+            self._unsubscribe(ws, channel)
 
     async def process_msg(self, websocket, message):
+        payload = None
+        if isinstance(message, bytes):
+            # A binary message is a JSON message, a zero byte, then a raw LCM message.
+            message, _, payload = message.partition(b"\0")
+
         try:
             request = MBotJSONMessage(message, from_json=True)
         except BadMBotRequestError as e:
@@ -281,20 +382,29 @@ class MBotBridgeServer(object):
             res = self.handle_request(request, websocket.id)
             if not isinstance(res, bytes):
                 # If the result is in bytes, skip the encoding and send it directly.
+                res.set_request_id(request.request_id())
                 res = res.encode()
             await websocket.send(res)
         elif request.type() == MBotMessageType.PUBLISH:
             try:
-                # Publish the data sent over the websocket.
-                pub_msg = type_utils.dict_to_lcm_type(request.data(), request.dtype())
-                pub_msg.utime = time.time_ns() // 1000
-                self._lcm.publish(request.channel(), pub_msg.encode())
+                if request.as_bytes():
+                    # Publish the raw LCM message as it is, once it's known to be the type it claims to be.
+                    if payload is None:
+                        raise type_utils.BadMessageError("No LCM message follows the request.")
+                    type_utils.check_fingerprint(payload, request.dtype())
+                    self._lcm.publish(request.channel(), payload)
+                else:
+                    # Publish the data sent over the websocket.
+                    pub_msg = type_utils.dict_to_lcm_type(request.data(), request.dtype())
+                    pub_msg.utime = time.time_ns() // 1000
+                    self._lcm.publish(request.channel(), pub_msg.encode())
             except type_utils.BadMessageError as e:
                 # If the type or data is bad, send back an error message.
                 msg = (f"Bad MBot publish. Bad message type ({request.dtype()}) or data (\"{request.data()}\"). "
                        f"AttributeError: {e}")
                 logging.warning(f"{websocket.id} - {msg}")
                 err = MBotJSONError(msg)
+                err.set_request_id(request.request_id())
                 await websocket.send(err.encode())
         elif request.type() == MBotMessageType.SUBSCRIBE:
             ch = request.channel()
@@ -303,10 +413,18 @@ class MBotBridgeServer(object):
                 msg = f"Bad subscribe request. No channel: {ch}"
                 logging.warning(f"{websocket.id} - {msg}")
                 err = MBotJSONError(msg)
+                err.set_request_id(request.request_id())
                 await websocket.send(err.encode())
             else:
-                logging.debug(f"Websocket ID {websocket.id} - Subscribed to channel {request.channel()}")
-                self._subscribe(websocket, request.channel())
+                try:
+                    self._subscribe(websocket, request)
+                    logging.debug(f"Websocket ID {websocket.id} - Subscribed to channel {request.channel()}")
+                except (TypeError, ValueError) as e:
+                    msg = f"Bad subscribe request. Bad options (\"{request.data()}\"): {e}"
+                    logging.warning(f"{websocket.id} - {msg}")
+                    err = MBotJSONError(msg)
+                    err.set_request_id(request.request_id())
+                    await websocket.send(err.encode())
         elif request.type() == MBotMessageType.UNSUBSCRIBE:
             ch = request.channel()
             if ch not in self._msg_managers:
@@ -314,10 +432,11 @@ class MBotBridgeServer(object):
                 msg = f"Bad unsubscribe request. No channel: {ch}"
                 logging.warning(f"{websocket.id} - {msg}")
                 err = MBotJSONError(msg)
+                err.set_request_id(request.request_id())
                 await websocket.send(err.encode())
             else:
                 logging.debug(f"Websocket ID {websocket.id} - Unsubscribed from channel {request.channel()}")
-                await self._unsubscribe(websocket, request.channel())
+                self._unsubscribe(websocket, request.channel(), request.request_id())
 
     def handle_request(self, request, ws_id):
         ch = request.channel()
@@ -383,6 +502,8 @@ class MBotBridgeServer(object):
             logging.debug(f"Websocket connection closed: {websocket.id}")
         except websockets.exceptions.ConnectionClosedError as e:
             logging.warning(f"Websocket ID {websocket.id} - Closed with error: {e}")
+        finally:
+            self._remove_subs(websocket)
 
 
 async def main(args):
@@ -18,7 +18,8 @@ class BadMBotRequestError(Exception):
 
 
 class MBotJSONMessage(object):
-    def __init__(self, data=None, channel=None, dtype=None, rtype=None, as_bytes=False, from_json=False):
+    def __init__(self, data=None, channel=None, dtype=None, rtype=None, as_bytes=False, from_json=False,
+                 request_id=None):
         if from_json:
             self.decode(data)
         else:
@@ -32,6 +33,7 @@ class MBotJSONMessage(object):
             self._channel = channel
             self._dtype = dtype
             self._as_bytes = as_bytes
+            self._request_id = request_id
 
     def data(self):
         return self._data
@@ -48,6 +50,13 @@ class MBotJSONMessage(object):
     def as_bytes(self):
         return self._as_bytes
 
+    def request_id(self):
+        return self._request_id
+
+    def set_request_id(self, request_id):
+        # The ID of the request this message replies to, so the client can match them up.
+        self._request_id = request_id
+
     def encode(self):
         if self._request_type == MBotMessageType.INIT:
             rtype = "init"
@@ -72,8 +81,12 @@ class MBotJSONMessage(object):
             msg.update({"channel": self._channel})
         if self._dtype is not None:
             msg.update({"dtype": self._dtype})
-        if self._request_type in [MBotMessageType.REQUEST, MBotMessageType.SUBSCRIBE]:
+        if self._request_type in [MBotMessageType.REQUEST, MBotMessageType.SUBSCRIBE] or \
+                (self._request_type == MBotMessageType.PUBLISH and self._as_bytes):
             msg.update({"as_bytes": self._as_bytes})
+        if self._request_id is not None:
+            # Before the data, so a client searching the message for the key finds this one first.
+            msg.update({"id": self._request_id})
         if self._data is not None:
             # Special consideration for the lidar data because it's so big.
             if self._dtype == "lidar_t":
@@ -130,9 +143,12 @@ class MBotJSONMessage(object):
 
         # Whether the data should be returned in raw bytes.
         as_bytes = data["as_bytes"] if "as_bytes" in data else False
+        # An ID the client gave the request, which is copied into the reply.
+        request_id = data["id"] if "id" in data else None
 
-        # If this was a publish request, data is required.
-        if request_type == MBotMessageType.PUBLISH and (msg_data is None or dtype is None):
+        # If this was a publish request, data is required. If as_bytes is set, the data follows the message as a raw
+        # LCM message instead.
+        if request_type == MBotMessageType.PUBLISH and ((msg_data is None and not as_bytes) or dtype is None):
             raise BadMBotRequestError("Publish was requested but data or data type is missing.")
 
         self._channel = channel
@@ -140,6 +156,7 @@ class MBotJSONMessage(object):
         self._dtype = dtype
         self._request_type = request_type
         self._as_bytes = as_bytes
+        self._request_id = request_id
 
 
 class MBotJSONRequest(MBotJSONMessage):
@@ -60,6 +60,17 @@ def decode(data, dtype):
     return lcm_obj.decode(data)
 
 
+def check_fingerprint(data, dtype):
+    """Checks that raw data is an LCM message of the type named by dtype, without decoding it. Raises
+    BadMessageError if it isn't."""
+    try:
+        lcm_obj = str_to_lcm_type(dtype)
+    except (ValueError, AttributeError, ModuleNotFoundError) as e:
+        raise BadMessageError(f"Could not parse dtype {dtype}: {e}")
+    if data[:8] != lcm_obj._get_packed_fingerprint():
+        raise BadMessageError(f"Data is not of type {dtype}")
+
+
 def occupancy_grid_to_byte_dict(data):
     """A special case utility for decoding the occupancy grid, but keeping the
     cell data as bytes."""
@@ -11,7 +11,8 @@ window.addEventListener("DOMContentLoaded", () => {
   let sub = false;
   document.getElementById('subscribeButton').addEventListener('click', function () {
     if (!sub) {
-      mbot.subscribe(MBotAPI.config.ODOMETRY.channel, (odom) => { console.log("SUB:", odom); });
+      mbot.subscribe(MBotAPI.config.ODOMETRY.channel, (odom) => { console.log("SUB:", odom); },
+                     MBotAPI.config.ODOMETRY.dtype);
       sub = true;
     }
     else {
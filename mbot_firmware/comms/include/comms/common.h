@@ -33,6 +33,15 @@
 #define ROS_FOOTER_LENGTH 1
 #define ROS_PKG_LENGTH  (ROS_HEADER_LENGTH + ROS_FOOTER_LENGTH) //length (in bytes) of ros packaging (header and footer)
 
+// a bundle frame carries several topics that share one timestamp, see comms_bundle_t
+#define BUNDLE_TOPIC 240
+#define BUNDLE_UTIME_LENGTH 8 //every bundled topic starts with an int64 utime, which is sent once for the whole bundle
+#define BUNDLE_HEADER_LENGTH (BUNDLE_UTIME_LENGTH + 1) //utime and the number of topics
+#define BUNDLE_ENTRY_HEADER_LENGTH 3 //uint16 topic id and uint8 length of each bundled topic
+#define BUNDLE_MAX_MSG_LEN 512
+
+#define MAX_TOPICS 256 //topic ids index the registry and topic data tables directly, so they must be below this
+
 // specific checksum method as defined by http://wiki.ros.org/rosserial/Overview/Protocol
 uint8_t checksum(uint8_t* addends, int len);
 
@@ -48,4 +57,10 @@ int decode_rospkt(uint8_t* ROSPKT, int rospkt_len, uint16_t* TOPIC, uint8_t* MSG
 // encodes a message and topic into a bytes array 'ROSPKT' as defined by http://wiki.ros.org/rosserial/Overview/Protocol
 int encode_msg(uint8_t* MSG, int msg_len, uint16_t TOPIC, uint8_t* ROSPKT, int rospkt_len);
 
+// writes the header of a packet for a msg_len byte message on TOPIC, the message goes at ROSPKT + ROS_HEADER_LENGTH
+void encode_header(uint16_t TOPIC, int msg_len, uint8_t* ROSPKT);
+
+// writes the checksum over the topic and message of a packet whose header and message are already in ROSPKT
+void encode_footer(uint8_t* ROSPKT, int msg_len);
+
 #endif
\ No newline at end of file
@@ -21,8 +21,6 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
-#define MAX_RADIX_TOPICS 16
-
 typedef int (*Deserialize)(uint8_t* src, void* dest);
 typedef int (*Serialize)(void* src, uint8_t* dest);
 typedef void (*MsgCb)(void* data);
@@ -35,24 +33,86 @@ typedef struct topic_registry_val{
     MsgCb cb_fn;
 }topic_registry_val_t;
 
+/**
+ * @brief A registered topic. topic_registry is indexed by topic id, so finding a topic is one array lookup, and
+ * unregistered ids are NULL.
+ *
+ * Each topic has its own packet, allocated and given its header when the topic is registered. Writing the topic
+ * serializes it straight into the packet and only fills in the footer, so it doesn't allocate or copy. Topics are
+ * only written from core 0, so the packets aren't locked.
+ */
 typedef struct topic_registry_entry{
-    struct topic_registry_entry* left;
-    struct topic_registry_entry* right;
-    struct topic_registry_val* value;
+    topic_registry_val_t value;
+    uint8_t* packet;    ///< ROS_PKG_LENGTH + topic_data_len bytes
 }topic_registry_entry_t;
 
-extern topic_registry_entry_t* topic_registry_root_node;
+/**
+ * @brief A frame on BUNDLE_TOPIC carrying several topics with one timestamp.
+ *
+ * The message is the int64 utime shared by every topic and the number of topics, then for each topic its uint16 id,
+ * its uint8 length, and its serialized data without the leading utime. Only topics whose serialized data starts with an
+ * int64 utime can be bundled. Everything is built in place, so writing a bundle doesn't allocate.
+ */
+typedef struct comms_bundle{
+    uint8_t msg[BUNDLE_MAX_MSG_LEN];
+    uint16_t msg_len;
+    uint8_t packet[BUNDLE_MAX_MSG_LEN + ROS_PKG_LENGTH];
+}comms_bundle_t;
+
+extern topic_registry_entry_t* topic_registry[MAX_TOPICS];
 
 int comms_init_protocol(void);
+
+/**
+ * @brief Register a topic and allocate its packet.
+ *
+ * @return 1 if the topic was registered, 0 if topic_id isn't below MAX_TOPICS or the packet can't be allocated.
+ */
 int comms_register_topic(uint16_t topic_id,
     uint32_t topic_data_len,
     Deserialize deserialize_fn,
     Serialize serialize_fn,
     MsgCb callback_fn);
 int comms_get_topic_serializers(uint16_t topic_id, topic_registry_val_t* topic_reg_val);
+
+/**
+ * @brief Serialize the topic into its own packet without sending it.
+ *
+ * @param packet_out Set to the topic's packet, which is reused by the next write of the topic and must not be freed.
+ * @return 1 on success, 0 if the topic isn't registered.
+ */
 int comms_generate_packet(uint16_t topic_id, void* topic_struct, uint8_t** packet_out, uint32_t* packet_len_out);
 int comms_send_serial(uint8_t* packet_out, uint32_t packet_len);
 int comms_write_topic_test(uint16_t topic_id, void* topic_struct);
 int comms_write_topic(uint16_t topic_id, void* topic_struct);
 
+/**
+ * @brief Start a new bundle, dropping any topics already in it.
+ *
+ * @param bundle Bundle to fill in.
+ * @param utime Timestamp for every topic in the bundle, which replaces their own.
+ */
+void comms_bundle_start(comms_bundle_t* bundle, int64_t utime);
+
+/**
+ * @brief Serialize a registered topic into the bundle.
+ *
+ * @return 1 if the topic was added, 0 if it isn't registered, is too short to start with a utime, or doesn't fit.
+ */
+int comms_bundle_add_topic(comms_bundle_t* bundle, uint16_t topic_id, void* topic_struct);
+
+/**
+ * @brief Send the bundle as a single frame.
+ *
+ * @return 1 if the bundle was sent, 0 otherwise.
+ */
+int comms_write_bundle(comms_bundle_t* bundle);
+
+/**
+ * @brief Frame the bundle in place without sending it.
+ *
+ * @return Length of bundle->packet, or 0 on failure.
+ */
+uint32_t comms_bundle_generate_packet(comms_bundle_t* bundle);
+
 #endif
@@ -21,8 +21,6 @@
 #ifndef TOPIC_DATA_H
 #define TOPIC_DATA_H
 
-#define MAX_RADIX_DATA 16
-
 typedef struct topic_data_val{
     uint16_t topic_id;
     void* topic_data;
@@ -30,13 +28,8 @@ typedef struct topic_data_val{
     mutex_t topic_mutex;
 }topic_data_val_t;
 
-typedef struct topic_data_entry{
-    struct topic_data_entry* left;
-    struct topic_data_entry* right;
-    struct topic_data_val* value;
-}topic_data_entry_t;
-
-extern topic_data_entry_t* topic_data_root_node;
+// latest data received on each topic, indexed by topic id. NULL until the topic's first message.
+extern topic_data_val_t* topic_data_table[MAX_TOPICS];
 
 int comms_init_topic_data(void);
 int comms_get_topic_data(uint16_t topic_id, void* msg_struct);
@@ -68,44 +68,39 @@ int decode_rospkt(uint8_t* ROSPKT, int rospkt_len, uint16_t* TOPIC, uint8_t* MSG
     for (int i=0;i<msg_len;i++) {
         MSG[i] = ROSPKT[i+7];
     }
-    *TOPIC = (uint16_t) (ROSPKT[5]+(ROSPKT[6]*255));
+    *TOPIC = (uint16_t) (ROSPKT[5]+(ROSPKT[6]<<8));
     
     return 0;
 }
 
 int encode_msg(uint8_t* MSG, int msg_len, uint16_t TOPIC, uint8_t* ROSPKT, int rospkt_len) {
-    
+
     // SANITY CHECKS
-    if (msg_len+ROS_PKG_LENGTH != rospkt_len) { 
+    if (msg_len+ROS_PKG_LENGTH != rospkt_len) {
         printf("Error: The length of the ROSPKT array does not match the length of the MSG array plus packaging.\n");
         return 0;
     }
 
-
     // CREATE ROS PACKET
+    encode_header(TOPIC, msg_len, ROSPKT);
+    memcpy(&ROSPKT[ROS_HEADER_LENGTH], MSG, msg_len); //write message bytes
+    encode_footer(ROSPKT, msg_len);
+
+    return 1;
+}
+
+void encode_header(uint16_t TOPIC, int msg_len, uint8_t* ROSPKT) {
     //for ROS protocol and packet format see link: http://wiki.ros.org/rosserial/Overview/Protocol
     ROSPKT[0] = SYNC_FLAG;
     ROSPKT[1] = VERSION_FLAG;
-    ROSPKT[2] = (uint8_t) (msg_len%255); //message length lower 8/16b via modulus and cast
+    ROSPKT[2] = (uint8_t) (msg_len & 0xff); //message length lower 8/16b via mask and cast
     ROSPKT[3] = (uint8_t) (msg_len>>8); //message length higher 8/16b via bitshift and cast
+    ROSPKT[4] = checksum(&ROSPKT[2], 2); //checksum over message length
+    ROSPKT[5] = (uint8_t) (TOPIC & 0xff); //message topic lower 8/16b via mask and cast
+    ROSPKT[6] = (uint8_t) (TOPIC>>8); //message topic higher 8/16b via bitshift and cast
+}
 
-    uint8_t cs1_addends[2] = {ROSPKT[2], ROSPKT[3]};
-    ROSPKT[4] = checksum(cs1_addends, 2); //checksum over message length
-    ROSPKT[5] = (uint8_t) (TOPIC%255); //message topic lower 8/16b via modulus and cast
-    ROSPKT[6] = (uint8_t) (TOPIC>>8); //message length higher 8/16b via bitshift and cast
-
-    for (int i = 0; i<msg_len; i++) { //write message bytes
-        ROSPKT[i+7] = MSG[i];
-    }
-    
-    uint8_t cs2_addends[msg_len+2]; //create array for the checksum over topic and message content
-    cs2_addends[0] = ROSPKT[5];
-    cs2_addends[1] = ROSPKT[6];
-    for (int i = 0; i<msg_len; i++) {
-        cs2_addends[i+2] = MSG[i];
-    }
-
-    ROSPKT[rospkt_len-1] = checksum(cs2_addends, msg_len+2); //checksum over message data and topic
-
-    return 1;
+void encode_footer(uint8_t* ROSPKT, int msg_len) {
+    //the topic is right before the message, so the checksum over both is one pass over the packet
+    ROSPKT[ROS_HEADER_LENGTH+msg_len] = checksum(&ROSPKT[5], msg_len+2);
 }
\ No newline at end of file
@@ -1,35 +1,30 @@
 #include <comms/protocol.h>
 
-topic_registry_entry_t* topic_registry_root_node;
+topic_registry_entry_t* topic_registry[MAX_TOPICS];
 
 int comms_init_protocol(void)
 {
-    topic_registry_root_node = (topic_registry_entry_t*)calloc(1, sizeof(topic_registry_entry_t));
     return 1;
 }
 
-// TODO: make the tree traversal here shared between the get and register functions
-int comms_get_topic_serializers(uint16_t topic_id, topic_registry_val_t* topic_reg_val)
+static topic_registry_entry_t* comms_find_topic(uint16_t topic_id)
 {
-    int cur_radix = 0;
-    topic_registry_entry_t* cur_node = topic_registry_root_node;
+    if(topic_id >= MAX_TOPICS)
+    {
+        return NULL;
+    }
+    return topic_registry[topic_id];
+}
 
-    // find the proper node in the data structure
-    while(cur_radix < MAX_RADIX_TOPICS)
+int comms_get_topic_serializers(uint16_t topic_id, topic_registry_val_t* topic_reg_val)
+{
+    topic_registry_entry_t* entry = comms_find_topic(topic_id);
+    if(entry == NULL)
     {
-        // if the current bit is 1, go right
-        // otherwise go left
-        if((1 << cur_radix++) & topic_id)
-        {
-            cur_node = cur_node->right;
-        }
-        else
-        {
-            cur_node = cur_node->left;
-        }
+        return 0;
     }
-    memcpy(topic_reg_val, cur_node->value, sizeof(topic_registry_val_t));
-    return cur_node->value != NULL;
+    memcpy(topic_reg_val, &entry->value, sizeof(topic_registry_val_t));
+    return 1;
 }
 
 int comms_register_topic(uint16_t topic_id,
@@ -38,67 +33,62 @@ int comms_register_topic(uint16_t topic_id,
     Serialize serialize_fn,
     MsgCb callback_fn)
 {
-    int cur_radix = 0;
-    topic_registry_entry_t* cur_node = topic_registry_root_node;
+    if(topic_id >= MAX_TOPICS)
+    {
+        return 0;
+    }
 
-    // find the proper node in the data structure
-    while(cur_radix < MAX_RADIX_TOPICS)
+    uint8_t* packet = (uint8_t*)calloc(topic_data_len + ROS_PKG_LENGTH, sizeof(uint8_t));
+    if(packet == NULL)
     {
-        // if the current bit is 1, go right
-        // otherwise go left
-        if((1 << cur_radix++) & topic_id)
-        {
-            if(cur_node->right == NULL)
-            {
-                cur_node->right = (topic_registry_entry_t*)calloc(1, sizeof(topic_registry_entry_t));
-            }
-            cur_node = cur_node->right;
-        }
-        else
+        return 0;
+    }
+    // the header only depends on the topic and its length, so it's written once here
+    encode_header(topic_id, topic_data_len, packet);
+
+    topic_registry_entry_t* entry = topic_registry[topic_id];
+    if(entry == NULL)
+    {
+        entry = (topic_registry_entry_t*)calloc(1, sizeof(topic_registry_entry_t));
+        if(entry == NULL)
         {
-            if(cur_node->left == NULL)
-            {
-                cur_node->left = (topic_registry_entry_t*)calloc(1, sizeof(topic_registry_entry_t));
-            }
-            cur_node = cur_node->left;
+            free(packet);
+            return 0;
         }
+        topic_registry[topic_id] = entry;
     }
 
-    // assign this topic's values to the node
-    cur_node->value = (topic_registry_val_t*)calloc(1, sizeof(topic_registry_val_t));
-
-    topic_registry_val_t to_copy;
-    to_copy.topic_id = topic_id;
-    to_copy.topic_data_len = topic_data_len;
-    to_copy.deserialize_fn = deserialize_fn;
-    to_copy.serialize_fn = serialize_fn;
-    to_copy.cb_fn = callback_fn;
-
-    memcpy(cur_node->value, &to_copy, sizeof(topic_registry_val_t));
+    // registering a topic again replaces it
+    free(entry->packet);
+    entry->packet = packet;
+    entry->value.topic_id = topic_id;
+    entry->value.topic_data_len = topic_data_len;
+    entry->value.deserialize_fn = deserialize_fn;
+    entry->value.serialize_fn = serialize_fn;
+    entry->value.cb_fn = callback_fn;
 
     return 1;
 }
 
+// serializes the topic between the header and footer of its packet
+static uint32_t comms_fill_packet(topic_registry_entry_t* entry, void* topic_struct)
+{
+    entry->value.serialize_fn(topic_struct, &entry->packet[ROS_HEADER_LENGTH]);
+    encode_footer(entry->packet, entry->value.topic_data_len);
+    return entry->value.topic_data_len + ROS_PKG_LENGTH;
+}
+
 int comms_generate_packet(uint16_t topic_id, void* topic_struct, uint8_t** packet_out, uint32_t* packet_len_out)
 {
-    topic_registry_val_t topic_val;
-    // 0 indicates failure on lookup - return if we get it
-    if(comms_get_topic_serializers(topic_id, &topic_val) == 0) 
+    topic_registry_entry_t* entry = comms_find_topic(topic_id);
+    // NULL indicates failure on lookup - return if we get it
+    if(entry == NULL)
     {
         return 0;
     }
-    // create the byte array destination and serialize the topic
-    uint32_t msg_data_len = topic_val.topic_data_len;
-    uint8_t msg_data[msg_data_len];
-    topic_val.serialize_fn(topic_struct, msg_data);
-    *packet_len_out = (ROS_PKG_LENGTH) + msg_data_len;
-    *packet_out = (uint8_t*)calloc(*packet_len_out, sizeof(uint8_t));
-    int encode_result =  encode_msg(msg_data, msg_data_len, topic_id, *packet_out, *packet_len_out);
-    if(encode_result == 0)
-    {
-        free(*packet_out);
-    }
-    return encode_result;
+    *packet_len_out = comms_fill_packet(entry, topic_struct);
+    *packet_out = entry->packet;
+    return 1;
 }
 
 int comms_send_serial(uint8_t* packet_out, uint32_t packet_len)
@@ -110,7 +100,7 @@ int comms_send_serial(uint8_t* packet_out, uint32_t packet_len)
 
 int comms_write_topic_test(uint16_t topic_id, void* topic_struct)
 {
-    uint8_t* packet_data; // will be populated/allocated by generate_packet
+    uint8_t* packet_data; // points at the topic's own packet, see comms_generate_packet
     uint32_t packet_len = 0;
     if(comms_generate_packet(topic_id, topic_struct, &packet_data, &packet_len))
     {
@@ -119,9 +109,6 @@ int comms_write_topic_test(uint16_t topic_id, void* topic_struct)
             printf("%x,", packet_data[i]);
         }
         printf("\n");
-        // we call calloc(..) during the comms_generate_packet function
-        // so make sure we free that memory here to avoid a leak
-        free(packet_data);
     }
     else
     {
@@ -132,18 +119,72 @@ int comms_write_topic_test(uint16_t topic_id, void* topic_struct)
 
 int comms_write_topic(uint16_t topic_id, void* topic_struct)
 {
-    uint8_t* packet_data; // will be populated/allocated by generate_packet
-    uint32_t packet_len = 0;
-    if(comms_generate_packet(topic_id, topic_struct, &packet_data, &packet_len))
+    topic_registry_entry_t* entry = comms_find_topic(topic_id);
+    if(entry == NULL)
     {
-        comms_send_serial(packet_data, packet_len);
-        // we call calloc(..) during the comms_generate_packet function
-        // so make sure we free that memory here to avoid a leak
-        free(packet_data);
+        return 0;
     }
-    else
+    uint32_t packet_len = comms_fill_packet(entry, topic_struct);
+    comms_send_serial(entry->packet, packet_len);
+    return 1;
+}
+
+void comms_bundle_start(comms_bundle_t* bundle, int64_t utime)
+{
+    memcpy(bundle->msg, &utime, BUNDLE_UTIME_LENGTH);
+    bundle->msg[BUNDLE_UTIME_LENGTH] = 0; // number of topics
+    bundle->msg_len = BUNDLE_HEADER_LENGTH;
+}
+
+int comms_bundle_add_topic(comms_bundle_t* bundle, uint16_t topic_id, void* topic_struct)
+{
+    topic_registry_entry_t* entry = comms_find_topic(topic_id);
+    if(entry == NULL)
+    {
+        return 0;
+    }
+
+    // the topic's utime is replaced by the bundle's, so only the rest of it is sent
+    int32_t entry_len = entry->value.topic_data_len - BUNDLE_UTIME_LENGTH;
+    if(entry_len < 0 || entry_len > UINT8_MAX
+        || bundle->msg_len + BUNDLE_ENTRY_HEADER_LENGTH + entry_len > BUNDLE_MAX_MSG_LEN
+        || bundle->msg[BUNDLE_UTIME_LENGTH] == UINT8_MAX)
+    {
+        return 0;
+    }
+
+    uint8_t* bundle_entry = &bundle->msg[bundle->msg_len];
+    bundle_entry[0] = (uint8_t)(topic_id & 0xff);
+    bundle_entry[1] = (uint8_t)(topic_id >> 8);
+    bundle_entry[2] = (uint8_t)entry_len;
+
+    // serialize into the topic's packet, which isn't being sent, rather than a copy on the stack
+    uint8_t* msg_data = &entry->packet[ROS_HEADER_LENGTH];
+    entry->value.serialize_fn(topic_struct, msg_data);
+    memcpy(&bundle_entry[BUNDLE_ENTRY_HEADER_LENGTH], &msg_data[BUNDLE_UTIME_LENGTH], entry_len);
+
+    bundle->msg_len += BUNDLE_ENTRY_HEADER_LENGTH + entry_len;
+    bundle->msg[BUNDLE_UTIME_LENGTH]++;
+    return 1;
+}
+
+uint32_t comms_bundle_generate_packet(comms_bundle_t* bundle)
+{
+    uint32_t packet_len = bundle->msg_len + ROS_PKG_LENGTH;
+    if(encode_msg(bundle->msg, bundle->msg_len, BUNDLE_TOPIC, bundle->packet, packet_len) == 0)
     {
         return 0;
     }
+    return packet_len;
+}
+
+int comms_write_bundle(comms_bundle_t* bundle)
+{
+    uint32_t packet_len = comms_bundle_generate_packet(bundle);
+    if(packet_len == 0)
+    {
+        return 0;
+    }
+    comms_send_serial(bundle->packet, packet_len);
     return 1;
-}
\ No newline at end of file
+}
@@ -0,0 +1,23 @@
+/**
+ * <hardware/adc.h>
+ *
+ * @brief Host stand-in for the Pico SDK's ADC. Readings come from the simulated robot.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_HARDWARE_ADC_H
+#define SIM_HARDWARE_ADC_H
+
+#include <stdint.h>
+
+void adc_init(void);
+void adc_gpio_init(unsigned int gpio);
+void adc_select_input(unsigned int input);
+
+/**
+ * @brief Reads the selected input, 12 bits over 0-3 V.
+ */
+uint16_t adc_read(void);
+
+#endif /* SIM_HARDWARE_ADC_H */
@@ -0,0 +1,15 @@
+/**
+ * <hardware/flash.h>
+ *
+ * @brief Host stand-in for the Pico SDK's flash constants.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_HARDWARE_FLASH_H
+#define SIM_HARDWARE_FLASH_H
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+
+#endif /* SIM_HARDWARE_FLASH_H */
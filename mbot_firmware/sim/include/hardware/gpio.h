@@ -0,0 +1,37 @@
+/**
+ * <hardware/gpio.h>
+ *
+ * @brief Host stand-in for the Pico SDK's GPIO. Pins only remember their output level.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_HARDWARE_GPIO_H
+#define SIM_HARDWARE_GPIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define GPIO_IN false
+#define GPIO_OUT true
+#define NUM_BANK0_GPIOS 30
+
+enum gpio_function {
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+    GPIO_FUNC_NULL = 0x1f,
+};
+
+void gpio_init(unsigned int gpio);
+void gpio_set_dir(unsigned int gpio, bool out);
+void gpio_set_function(unsigned int gpio, enum gpio_function fn);
+void gpio_pull_up(unsigned int gpio);
+void gpio_put(unsigned int gpio, bool value);
+bool gpio_get(unsigned int gpio);
+
+#endif /* SIM_HARDWARE_GPIO_H */
@@ -0,0 +1,30 @@
+/**
+ * <hardware/i2c.h>
+ *
+ * @brief Host stand-in for the Pico SDK's I2C. Nothing is on the bus, the simulated IMU and FRAM replace the drivers
+ * that would use it.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_HARDWARE_I2C_H
+#define SIM_HARDWARE_I2C_H
+
+#include <stdint.h>
+
+typedef struct i2c_inst {
+    unsigned int index;
+} i2c_inst_t;
+
+extern i2c_inst_t sim_i2c0_inst;
+extern i2c_inst_t sim_i2c1_inst;
+#define i2c0 (&sim_i2c0_inst)
+#define i2c1 (&sim_i2c1_inst)
+
+// the controllers' registers read as zero, so they are never enabled
+extern uint32_t sim_i2c0_regs[64];
+#define I2C0_BASE ((uintptr_t)sim_i2c0_regs)
+
+unsigned int i2c_init(i2c_inst_t *i2c, unsigned int baudrate);
+
+#endif /* SIM_HARDWARE_I2C_H */
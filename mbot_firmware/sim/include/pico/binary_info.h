@@ -0,0 +1,15 @@
+/**
+ * <pico/binary_info.h>
+ *
+ * @brief Host stand-in for the Pico SDK's binary info, which only matters in a flashed image.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_PICO_BINARY_INFO_H
+#define SIM_PICO_BINARY_INFO_H
+
+#define bi_decl(_decl)
+#define bi_program_description(_str)
+
+#endif /* SIM_PICO_BINARY_INFO_H */
@@ -0,0 +1,17 @@
+/**
+ * <pico/multicore.h>
+ *
+ * @brief Host stand-in for the Pico SDK's pico_multicore. Core 1 is a thread.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_PICO_MULTICORE_H
+#define SIM_PICO_MULTICORE_H
+
+/**
+ * @brief Runs entry on a new thread, standing in for core 1.
+ */
+void multicore_launch_core1(void (*entry)(void));
+
+#endif /* SIM_PICO_MULTICORE_H */
@@ -0,0 +1,36 @@
+/**
+ * <pico/mutex.h>
+ *
+ * @brief Host stand-in for the Pico SDK's mutexes, on pthreads.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_PICO_MUTEX_H
+#define SIM_PICO_MUTEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct mutex {
+    pthread_mutex_t lock;
+} mutex_t;
+
+static inline void mutex_init(mutex_t *mtx) {
+    pthread_mutex_init(&mtx->lock, NULL);
+}
+
+static inline void mutex_enter_blocking(mutex_t *mtx) {
+    pthread_mutex_lock(&mtx->lock);
+}
+
+static inline bool mutex_try_enter(mutex_t *mtx, uint32_t *owner_out) {
+    return pthread_mutex_trylock(&mtx->lock) == 0;
+}
+
+static inline void mutex_exit(mutex_t *mtx) {
+    pthread_mutex_unlock(&mtx->lock);
+}
+
+#endif /* SIM_PICO_MUTEX_H */
@@ -0,0 +1,36 @@
+/**
+ * <pico/stdio_usb.h>
+ *
+ * @brief Host stand-in for the Pico SDK's USB serial. Interface 1, which the comms use, is the master side of a
+ * pseudo-terminal opened by the simulator, and interface 0 is stdout.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_PICO_STDIO_USB_H
+#define SIM_PICO_STDIO_USB_H
+
+#include <stdint.h>
+
+// how long a write may wait for room before the rest is dropped, as on the Pico when the host stops reading
+#define PICO_STDIO_USB_STDOUT_TIMEOUT_US 500000
+
+/**
+ * @brief Reads what is available, up to length bytes. Unlike the Pico it waits a little for the first byte, so the
+ * listener's read loop doesn't spin a host CPU.
+ *
+ * @return The number of bytes read, or PICO_ERROR_NO_DATA
+ */
+int stdio_usb_in_chars_itf(int itf, char *buf, int length);
+
+/**
+ * @brief Writes length bytes. If none can be written for PICO_STDIO_USB_STDOUT_TIMEOUT_US the rest are dropped.
+ */
+void stdio_usb_out_chars_itf(int itf, const char *buf, int length);
+
+/**
+ * @brief The number of bytes waiting to be read on the interface.
+ */
+uint32_t tud_cdc_n_available(uint8_t itf);
+
+#endif /* SIM_PICO_STDIO_USB_H */
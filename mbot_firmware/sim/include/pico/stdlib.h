@@ -0,0 +1,49 @@
+/**
+ * <pico/stdlib.h>
+ *
+ * @brief Host stand-in for the Pico SDK's pico_stdlib, enough to build the firmware against the simulator.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/time.h>
+#include <hardware/gpio.h>
+
+typedef unsigned int uint;
+
+#define PICO_OK 0
+#define PICO_ERROR_NONE 0
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_ERROR_GENERIC -2
+#define PICO_ERROR_NO_DATA -3
+
+#define PICO_DEFAULT_I2C_SDA_PIN 4
+#define PICO_DEFAULT_I2C_SCL_PIN 5
+#define PICO_DEFAULT_LED_PIN 25
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+/**
+ * @brief Does nothing, the host's clock is already running.
+ *
+ * @return true
+ */
+bool set_sys_clock_khz(uint32_t freq_khz, bool required);
+
+/**
+ * @brief Does nothing, stdout is already the console and the USB serial port is opened by the simulator.
+ *
+ * @return true
+ */
+bool stdio_init_all(void);
+
+static inline void tight_loop_contents(void) {}
+
+#endif /* SIM_PICO_STDLIB_H */
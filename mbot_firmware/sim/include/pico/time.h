@@ -0,0 +1,74 @@
+/**
+ * <pico/time.h>
+ *
+ * @brief Host stand-in for the Pico SDK's pico_time. Time is microseconds since the simulator started, and each
+ * repeating timer runs its callback on its own thread, as the alarm interrupt would on the Pico.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef uint64_t absolute_time_t;
+
+typedef struct repeating_timer repeating_timer_t;
+
+/**
+ * @brief Called by a repeating timer, returns false to stop the timer.
+ */
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer {
+    int64_t delay_us;   ///< >0 is the delay from the end of one callback to the start of the next, <0 from start to start
+    repeating_timer_callback_t callback;
+    void *user_data;
+    pthread_t thread;
+    volatile bool running;
+};
+
+/**
+ * @brief Microseconds since the simulator started.
+ */
+uint64_t time_us_64(void);
+
+static inline absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) {
+    return t;
+}
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+/**
+ * @brief Starts calling callback every delay_us on a thread of its own.
+ *
+ * @param delay_us >0 for the delay from the end of one callback to the start of the next, <0 from start to start
+ * @param callback Called with out, returns false to stop
+ * @param user_data Stored in out->user_data
+ * @param out The timer, which must stay valid until it is cancelled
+ * @return true if the timer started
+ */
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+
+static inline bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                                          repeating_timer_t *out) {
+    return add_repeating_timer_us(delay_ms * (int64_t)1000, callback, user_data, out);
+}
+
+/**
+ * @brief Stops the timer and waits for a callback in progress to return.
+ *
+ * @return true if the timer was running
+ */
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+#endif /* SIM_PICO_TIME_H */
@@ -0,0 +1,50 @@
+/**
+ * <sim/pico_sim.h>
+ *
+ * @brief Controls the host stand-ins for the Pico SDK that aren't part of the SDK's own API.
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_PICO_SIM_H
+#define SIM_PICO_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief What has gone through USB interface 1 since it was opened.
+ */
+typedef struct pico_sim_usb_stats {
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t bytes_dropped;     ///< written by the firmware while nothing was reading the other end
+} pico_sim_usb_stats_t;
+
+/**
+ * @brief Starts the clock that time_us_64() counts from. Call it before anything else.
+ */
+void pico_sim_boot(void);
+
+/**
+ * @brief Opens a pseudo-terminal for USB interface 1, the one mbot_lcm_serial talks to, and symlinks link_path to the
+ * end a host program opens.
+ *
+ * @param link_path Where to link the serial port, or NULL to only print its name
+ * @return 0 on success, -1 on failure
+ */
+int pico_sim_open_usb(const char *link_path);
+
+/**
+ * @brief Closes USB interface 1 and removes its link. Safe to call from a signal handler.
+ */
+void pico_sim_close_usb(void);
+
+/**
+ * @brief The name of the end of the pseudo-terminal a host program opens.
+ */
+const char *pico_sim_usb_port(void);
+
+void pico_sim_get_usb_stats(pico_sim_usb_stats_t *stats);
+
+#endif /* SIM_PICO_SIM_H */
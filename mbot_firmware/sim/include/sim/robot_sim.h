@@ -0,0 +1,66 @@
+/**
+ * <sim/robot_sim.h>
+ *
+ * @brief A simple model of the MBot's wheels and body, behind the same driver API as the motors, encoders, IMU and
+ * FRAM on the control board.
+ *
+ * Each motor's speed follows its steady state speed for the duty cycle with a first order lag. The steady state speed
+ * is the inverse of the calibration the firmware reads from FRAM: nothing below the intercept, then linear in the
+ * slope. The wheels' rotation is integrated exactly between the times the firmware touches the hardware, which is when
+ * the model is stepped, so the duty cycle is constant over each step as it is on the robot. The encoders count the
+ * integrated rotation, and the IMU reports the body's yaw rate and heading without noise or drift.
+ *
+ * @addtogroup Sim
+ * @{
+ */
+
+#ifndef SIM_ROBOT_SIM_H
+#define SIM_ROBOT_SIM_H
+
+#include <stdint.h>
+#include <mbot/defs/mbot_params.h>
+
+#define ROBOT_SIM_NUM_WHEELS 3
+
+/**
+ * @brief The robot being simulated.
+ */
+typedef struct robot_sim_config {
+    mbot_params_t calibration;      ///< the motors' response, and what the firmware reads from FRAM
+    float motor_time_constant;      ///< seconds for a motor to reach 63% of a change in steady state speed
+    float battery_volts;
+} robot_sim_config_t;
+
+/**
+ * @brief The simulated robot's pose and speeds, in the world frame it started in.
+ */
+typedef struct robot_sim_state {
+    uint64_t utime;                             ///< time of the last step, microseconds since boot
+    double x;
+    double y;
+    double theta;
+    float vx;                                   ///< body velocity
+    float vy;
+    float wz;
+    float wheel_vel[ROBOT_SIM_NUM_WHEELS];      ///< rad/s, positive as the firmware's wheel velocities are
+    double wheel_angle[ROBOT_SIM_NUM_WHEELS];   ///< rad, in the same sense as wheel_vel
+} robot_sim_state_t;
+
+/**
+ * @brief A robot with the usual calibration for the type being built.
+ */
+robot_sim_config_t robot_sim_default_config(void);
+
+/**
+ * @brief Resets the robot to rest at the origin. The calibration is written to the simulated FRAM.
+ */
+void robot_sim_init(const robot_sim_config_t *config);
+
+/**
+ * @brief Advances the model to now, with the duty cycles set since the last step.
+ */
+void robot_sim_step(uint64_t now_us);
+
+void robot_sim_get_state(robot_sim_state_t *state);
+
+#endif /* SIM_ROBOT_SIM_H */
@@ -0,0 +1,346 @@
+#define _GNU_SOURCE  // posix_openpt() and friends
+#include <pico/stdlib.h>
+#include <pico/time.h>
+#include <pico/multicore.h>
+#include <pico/stdio_usb.h>
+#include <hardware/gpio.h>
+#include <hardware/i2c.h>
+#include <sim/pico_sim.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sched.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+// how long stdio_usb_in_chars_itf() waits for the first byte before returning PICO_ERROR_NO_DATA
+#define USB_IN_POLL_TIMEOUT_MS 10
+
+static uint64_t boot_us = 0;
+
+static int usb_master_fd = -1;
+static int usb_slave_fd = -1;  // held open, so the port stays usable while no host program has it open
+static char usb_port[64] = "";
+static char usb_link[PATH_MAX] = "";
+static uint64_t usb_last_avail_us = 0;
+// each count is only written by one core: core 1 reads the port and core 0 writes it
+static pico_sim_usb_stats_t usb_stats = {0};
+
+static bool gpio_levels[NUM_BANK0_GPIOS] = {0};
+
+i2c_inst_t sim_i2c0_inst = {0};
+i2c_inst_t sim_i2c1_inst = {1};
+uint32_t sim_i2c0_regs[64] = {0};
+
+static void (*core1_entry)(void) = NULL;
+
+static uint64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void pico_sim_boot(void)
+{
+    boot_us = monotonic_us();
+}
+
+uint64_t time_us_64(void)
+{
+    return monotonic_us() - boot_us;
+}
+
+static void sleep_until_us(uint64_t t)
+{
+    uint64_t target = boot_us + t;
+    struct timespec ts = {(time_t)(target / 1000000), (long)(target % 1000000) * 1000};
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+void sleep_us(uint64_t us)
+{
+    sleep_until_us(time_us_64() + us);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sleep_us((uint64_t)ms * 1000);
+}
+
+// The threads started here stand in for interrupts and core 1, so they get normal priority even when they're started
+// from core 0's main, which the sim runs at the lowest.
+static int start_thread(pthread_t* thread, void* (*fn)(void*), void* arg)
+{
+    pthread_attr_t attr;
+    struct sched_param param = {0};
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+    int rc = pthread_create(thread, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return rc;
+}
+
+static void* repeating_timer_thread(void* arg)
+{
+    repeating_timer_t* rt = (repeating_timer_t*)arg;
+    uint64_t next = time_us_64() + (rt->delay_us < 0 ? -rt->delay_us : rt->delay_us);
+    while(rt->running)
+    {
+        sleep_until_us(next);
+        if(!rt->running)
+        {
+            break;
+        }
+        if(!rt->callback(rt))
+        {
+            rt->running = false;
+            break;
+        }
+        // like the SDK, a negative delay is from start to start and a positive one from the end of the callback
+        next = (rt->delay_us < 0) ? next - rt->delay_us : time_us_64() + rt->delay_us;
+    }
+    return NULL;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void* user_data,
+                            repeating_timer_t* out)
+{
+    if(delay_us == 0)
+    {
+        return false;
+    }
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->running = true;
+    if(start_thread(&out->thread, &repeating_timer_thread, out) != 0)
+    {
+        out->running = false;
+        return false;
+    }
+    return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t* timer)
+{
+    bool was_running = timer->running;
+    timer->running = false;
+    // a callback can cancel its own timer, which then ends when the callback returns
+    if(!pthread_equal(pthread_self(), timer->thread))
+    {
+        pthread_join(timer->thread, NULL);
+    }
+    return was_running;
+}
+
+static void* core1_thread(void* arg)
+{
+    core1_entry();
+    return NULL;
+}
+
+void multicore_launch_core1(void (*entry)(void))
+{
+    pthread_t thread;
+    core1_entry = entry;
+    if(start_thread(&thread, &core1_thread, NULL) == 0)
+    {
+        pthread_detach(thread);
+    }
+}
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required)
+{
+    return true;
+}
+
+bool stdio_init_all(void)
+{
+    return true;
+}
+
+int pico_sim_open_usb(const char* link_path)
+{
+    usb_master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(usb_master_fd < 0 || grantpt(usb_master_fd) != 0 || unlockpt(usb_master_fd) != 0
+       || ptsname_r(usb_master_fd, usb_port, sizeof(usb_port)) != 0)
+    {
+        fprintf(stderr, "Error %i opening a pseudo-terminal: %s\n", errno, strerror(errno));
+        pico_sim_close_usb();
+        return -1;
+    }
+
+    // raw from the start, so nothing written before a host program configures the port is echoed back
+    usb_slave_fd = open(usb_port, O_RDWR | O_NOCTTY);
+    struct termios options;
+    if(usb_slave_fd < 0 || tcgetattr(usb_slave_fd, &options) != 0)
+    {
+        fprintf(stderr, "Error %i opening %s: %s\n", errno, usb_port, strerror(errno));
+        pico_sim_close_usb();
+        return -1;
+    }
+    cfmakeraw(&options);
+    tcsetattr(usb_slave_fd, TCSANOW, &options);
+    fcntl(usb_master_fd, F_SETFL, fcntl(usb_master_fd, F_GETFL) | O_NONBLOCK);
+
+    if(link_path != NULL)
+    {
+        // only replace an old link, never a file or a real device
+        struct stat st;
+        if(lstat(link_path, &st) == 0 && S_ISLNK(st.st_mode))
+        {
+            unlink(link_path);
+        }
+        if(symlink(usb_port, link_path) != 0)
+        {
+            fprintf(stderr, "Error %i linking %s to %s: %s\n", errno, link_path, usb_port, strerror(errno));
+            pico_sim_close_usb();
+            return -1;
+        }
+        snprintf(usb_link, sizeof(usb_link), "%s", link_path);
+    }
+    return 0;
+}
+
+void pico_sim_close_usb(void)
+{
+    if(usb_link[0] != '\0')
+    {
+        unlink(usb_link);
+        usb_link[0] = '\0';
+    }
+    if(usb_slave_fd >= 0)
+    {
+        close(usb_slave_fd);
+        usb_slave_fd = -1;
+    }
+    if(usb_master_fd >= 0)
+    {
+        close(usb_master_fd);
+        usb_master_fd = -1;
+    }
+}
+
+const char* pico_sim_usb_port(void)
+{
+    return usb_port;
+}
+
+void pico_sim_get_usb_stats(pico_sim_usb_stats_t* stats)
+{
+    memcpy(stats, &usb_stats, sizeof(pico_sim_usb_stats_t));
+}
+
+int stdio_usb_in_chars_itf(int itf, char* buf, int length)
+{
+    if(itf != 1 || usb_master_fd < 0)
+    {
+        return PICO_ERROR_NO_DATA;
+    }
+    struct pollfd usb_poll = {usb_master_fd, POLLIN, 0};
+    if(poll(&usb_poll, 1, USB_IN_POLL_TIMEOUT_MS) <= 0 || !(usb_poll.revents & POLLIN))
+    {
+        return PICO_ERROR_NO_DATA;
+    }
+    ssize_t rc = read(usb_master_fd, buf, length);
+    if(rc <= 0)
+    {
+        return PICO_ERROR_NO_DATA;
+    }
+    usb_stats.bytes_in += rc;
+    return (int)rc;
+}
+
+void stdio_usb_out_chars_itf(int itf, const char* buf, int length)
+{
+    if(itf == 0)
+    {
+        fwrite(buf, 1, length, stdout);
+        return;
+    }
+    if(itf != 1 || usb_master_fd < 0)
+    {
+        return;
+    }
+
+    int written = 0;
+    while(written < length)
+    {
+        ssize_t rc = write(usb_master_fd, buf + written, length - written);
+        if(rc > 0)
+        {
+            written += rc;
+            usb_last_avail_us = time_us_64();
+            continue;
+        }
+        if(rc < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            break;
+        }
+        // like the SDK, give up once there's been no room for the timeout, and after that don't wait at all
+        uint64_t now = time_us_64();
+        if(now > usb_last_avail_us + PICO_STDIO_USB_STDOUT_TIMEOUT_US)
+        {
+            break;
+        }
+        struct pollfd usb_poll = {usb_master_fd, POLLOUT, 0};
+        poll(&usb_poll, 1, (int)((usb_last_avail_us + PICO_STDIO_USB_STDOUT_TIMEOUT_US - now) / 1000) + 1);
+    }
+    usb_stats.bytes_out += written;
+    usb_stats.bytes_dropped += length - written;
+}
+
+uint32_t tud_cdc_n_available(uint8_t itf)
+{
+    int available = 0;
+    if(itf != 1 || usb_master_fd < 0 || ioctl(usb_master_fd, FIONREAD, &available) != 0)
+    {
+        return 0;
+    }
+    return (uint32_t)available;
+}
+
+void gpio_init(unsigned int gpio)
+{
+    gpio_put(gpio, false);
+}
+
+void gpio_set_dir(unsigned int gpio, bool out)
+{
+}
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn)
+{
+}
+
+void gpio_pull_up(unsigned int gpio)
+{
+}
+
+void gpio_put(unsigned int gpio, bool value)
+{
+    if(gpio < NUM_BANK0_GPIOS)
+    {
+        gpio_levels[gpio] = value;
+    }
+}
+
+bool gpio_get(unsigned int gpio)
+{
+    return (gpio < NUM_BANK0_GPIOS) ? gpio_levels[gpio] : false;
+}
+
+unsigned int i2c_init(i2c_inst_t* i2c, unsigned int baudrate)
+{
+    return baudrate;
+}
@@ -0,0 +1,396 @@
+#include <sim/robot_sim.h>
+#include <pico/stdlib.h>
+#include <hardware/adc.h>
+#include <mbot/motor/motor.h>
+#include <mbot/encoder/encoder.h>
+#include <mbot/imu/imu.h>
+#include <mbot/fram/fram.h>
+#include <math.h>
+#include <pthread.h>
+
+#ifdef MBOT_TYPE_CLASSIC
+#include "config/mbot_classic_config.h"
+#elif defined(MBOT_TYPE_OMNI)
+#include "config/mbot_omni_config.h"
+#endif
+
+#define NUM_MOTOR_CHANNELS 4
+#define MAX_DUTY 0.995f         // the motor driver's limit
+#define GRAVITY 9.81f
+#define ADC_VREF 3.0f
+#define ADC_BATTERY_INPUT 3     // through a 1/5 divider
+#define TICKS_PER_RAD (GEAR_RATIO * ENCODER_RES / (2.0 * M_PI))
+
+static pthread_mutex_t robot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static robot_sim_config_t robot_config;
+static robot_sim_state_t robot_state;
+static float motor_duty[NUM_MOTOR_CHANNELS] = {0};
+static int32_t encoder_offset[ROBOT_SIM_NUM_WHEELS] = {0};     // makes the count what mbot_encoder_write() set
+static int32_t encoder_last_count[ROBOT_SIM_NUM_WHEELS] = {0};     // at the last mbot_encoder_read_delta()
+static mbot_bhy_data_t* imu_data = NULL;
+static uint8_t fram[MAXADDRESS] = {0};
+static unsigned int adc_input = 0;
+
+robot_sim_config_t robot_sim_default_config(void)
+{
+    robot_sim_config_t config = {0};
+    for(int i = 0; i < ROBOT_SIM_NUM_WHEELS; i++)
+    {
+        config.calibration.motor_polarity[i] = 1;
+        config.calibration.encoder_polarity[i] = 1;
+        config.calibration.slope_pos[i] = 0.06f;
+        config.calibration.itrcpt_pos[i] = 0.05f;
+        config.calibration.slope_neg[i] = 0.06f;
+        config.calibration.itrcpt_neg[i] = -0.05f;
+    }
+#ifdef MBOT_TYPE_CLASSIC
+    // the right motor is mounted the other way round
+    config.calibration.motor_polarity[MOT_R] = -1;
+    config.calibration.encoder_polarity[MOT_R] = -1;
+#endif
+    config.motor_time_constant = 0.1f;
+    config.battery_volts = 12.0f;
+    return config;
+}
+
+void robot_sim_init(const robot_sim_config_t* config)
+{
+    pthread_mutex_lock(&robot_mutex);
+    memcpy(&robot_config, config, sizeof(robot_sim_config_t));
+    memset(&robot_state, 0, sizeof(robot_sim_state_t));
+    memset(motor_duty, 0, sizeof(motor_duty));
+    memset(encoder_offset, 0, sizeof(encoder_offset));
+    memset(encoder_last_count, 0, sizeof(encoder_last_count));
+    memset(fram, 0, sizeof(fram));
+    memcpy(fram, &config->calibration, sizeof(mbot_params_t));
+    pthread_mutex_unlock(&robot_mutex);
+}
+
+// the motor's speed once it settles at duty, the inverse of the firmware's calibrated PWM
+static float motor_steady_state_vel(int ch, float duty)
+{
+    const mbot_params_t* cal = &robot_config.calibration;
+    if(duty > cal->itrcpt_pos[ch] && cal->slope_pos[ch] > 0.0f)
+    {
+        return (duty - cal->itrcpt_pos[ch]) / cal->slope_pos[ch];
+    }
+    if(duty < cal->itrcpt_neg[ch] && cal->slope_neg[ch] > 0.0f)
+    {
+        return (duty - cal->itrcpt_neg[ch]) / cal->slope_neg[ch];
+    }
+    return 0.0f;
+}
+
+// the body's motion for a motion of the wheels, the same kinematics the firmware inverts
+static void body_from_wheels(const double* wheel, double* x, double* y, double* theta)
+{
+#ifdef MBOT_TYPE_CLASSIC
+    *x = DIFF_WHEEL_RADIUS * (wheel[MOT_L] - wheel[MOT_R]) / 2.0;
+    *y = 0.0;
+    *theta = DIFF_WHEEL_RADIUS * (-wheel[MOT_L] - wheel[MOT_R]) / (2.0 * DIFF_BASE_RADIUS);
+#elif defined(MBOT_TYPE_OMNI)
+    *x = OMNI_WHEEL_RADIUS * (wheel[MOT_L] - wheel[MOT_R]) / sqrt(3.0);
+    *y = OMNI_WHEEL_RADIUS * (-wheel[MOT_L] - wheel[MOT_R] + 2.0 * wheel[MOT_B]) / 3.0;
+    *theta = -OMNI_WHEEL_RADIUS * (wheel[MOT_L] + wheel[MOT_R] + wheel[MOT_B]) / (3.0 * OMNI_BASE_RADIUS);
+#endif
+}
+
+static void update_imu(void)
+{
+    if(imu_data == NULL)
+    {
+        return;
+    }
+    memset(imu_data->gyro, 0, sizeof(imu_data->gyro));
+    memset(imu_data->accel, 0, sizeof(imu_data->accel));
+    memset(imu_data->rpy, 0, sizeof(imu_data->rpy));
+    imu_data->gyro[2] = robot_state.wz;
+    imu_data->accel[2] = GRAVITY;
+    imu_data->rpy[2] = robot_state.theta;
+    imu_data->quat[0] = cos(robot_state.theta / 2.0);
+    imu_data->quat[1] = 0.0f;
+    imu_data->quat[2] = 0.0f;
+    imu_data->quat[3] = sin(robot_state.theta / 2.0);
+}
+
+// steps the model to now, called with robot_mutex held
+static void step_locked(uint64_t now_us)
+{
+    if(now_us <= robot_state.utime)
+    {
+        return;
+    }
+    double dt = (now_us - robot_state.utime) * 1e-6;
+    double tau = robot_config.motor_time_constant;
+    double decay = (tau > 0.0) ? exp(-dt / tau) : 0.0;
+
+    double wheel_vel[ROBOT_SIM_NUM_WHEELS];
+    double wheel_delta[ROBOT_SIM_NUM_WHEELS];
+    for(int i = 0; i < ROBOT_SIM_NUM_WHEELS; i++)
+    {
+        // the firmware's wheel velocities are the motor's times its polarity
+        double target = robot_config.calibration.motor_polarity[i] * motor_steady_state_vel(i, motor_duty[i]);
+        double start = robot_state.wheel_vel[i];
+        wheel_vel[i] = target + (start - target) * decay;
+        wheel_delta[i] = target * dt + (start - target) * tau * (1.0 - decay);
+        robot_state.wheel_vel[i] = wheel_vel[i];
+        robot_state.wheel_angle[i] += wheel_delta[i];
+    }
+
+    double dx, dy, dtheta;
+    body_from_wheels(wheel_delta, &dx, &dy, &dtheta);
+    double heading = robot_state.theta + dtheta / 2.0;
+    robot_state.x += dx * cos(heading) - dy * sin(heading);
+    robot_state.y += dx * sin(heading) + dy * cos(heading);
+    robot_state.theta = remainder(robot_state.theta + dtheta, 2.0 * M_PI);
+
+    double vx, vy, wz;
+    body_from_wheels(wheel_vel, &vx, &vy, &wz);
+    robot_state.vx = vx;
+    robot_state.vy = vy;
+    robot_state.wz = wz;
+    robot_state.utime = now_us;
+    update_imu();
+}
+
+void robot_sim_step(uint64_t now_us)
+{
+    pthread_mutex_lock(&robot_mutex);
+    step_locked(now_us);
+    pthread_mutex_unlock(&robot_mutex);
+}
+
+void robot_sim_get_state(robot_sim_state_t* state)
+{
+    pthread_mutex_lock(&robot_mutex);
+    memcpy(state, &robot_state, sizeof(robot_sim_state_t));
+    pthread_mutex_unlock(&robot_mutex);
+}
+
+/*
+ * Motors
+ */
+int mbot_motor_init_freq(uint8_t ch, uint16_t freq)
+{
+    return mbot_motor_set_duty(ch, 0.0f);
+}
+
+int mbot_motor_init(uint8_t ch)
+{
+    return mbot_motor_init_freq(ch, PWM_FREQ);
+}
+
+int mbot_motor_cleanup(uint8_t ch)
+{
+    return mbot_motor_set_duty(ch, 0.0f);
+}
+
+int mbot_motor_set_duty(uint8_t ch, float duty)
+{
+    if(ch >= NUM_MOTOR_CHANNELS)
+    {
+        fprintf(stderr, "Error: Invalid channel in mbot_motor_set\n");
+        return MBOT_ERROR;
+    }
+    duty = fminf(fmaxf(duty, -MAX_DUTY), MAX_DUTY);
+    pthread_mutex_lock(&robot_mutex);
+    // the old duty cycle applied until now
+    step_locked(time_us_64());
+    motor_duty[ch] = duty;
+    pthread_mutex_unlock(&robot_mutex);
+    return MBOT_OK;
+}
+
+void mbot_motor_adc_init()
+{
+    adc_init();
+    adc_gpio_init(29);
+    adc_select_input(ADC_BATTERY_INPUT);
+}
+
+float mbot_motor_read_voltage()
+{
+    return adc_read() * ADC_VREF * 5 / (1 << 12);
+}
+
+/*
+ * Encoders
+ */
+static int32_t encoder_count_locked(uint8_t ch)
+{
+    // the encoders count the motor, whose polarity to the wheel the firmware undoes with encoder_polarity
+    double motor_angle = robot_config.calibration.encoder_polarity[ch] * robot_state.wheel_angle[ch];
+    return (int32_t)floor(motor_angle * TICKS_PER_RAD) + encoder_offset[ch];
+}
+
+int mbot_encoder_init()
+{
+    pthread_mutex_lock(&robot_mutex);
+    for(int i = 0; i < ROBOT_SIM_NUM_WHEELS; i++)
+    {
+        encoder_offset[i] -= encoder_count_locked(i);
+        encoder_last_count[i] = 0;
+    }
+    pthread_mutex_unlock(&robot_mutex);
+    return 0;
+}
+
+int mbot_encoder_cleanup()
+{
+    return 0;
+}
+
+int mbot_encoder_read_delta(uint8_t ch)
+{
+    if(ch >= ROBOT_SIM_NUM_WHEELS)
+    {
+        fprintf(stderr, "Invalid channel!\n");
+        return -1;
+    }
+    pthread_mutex_lock(&robot_mutex);
+    step_locked(time_us_64());
+    int32_t count = encoder_count_locked(ch);
+    int32_t delta = count - encoder_last_count[ch];
+    encoder_last_count[ch] = count;
+    pthread_mutex_unlock(&robot_mutex);
+    return delta;
+}
+
+int mbot_encoder_read_count(uint8_t ch)
+{
+    if(ch >= ROBOT_SIM_NUM_WHEELS)
+    {
+        fprintf(stderr, "Invalid channel!\n");
+        return -1;
+    }
+    pthread_mutex_lock(&robot_mutex);
+    step_locked(time_us_64());
+    int32_t count = encoder_count_locked(ch);
+    pthread_mutex_unlock(&robot_mutex);
+    return count;
+}
+
+int mbot_encoder_write(uint8_t ch, int pos)
+{
+    if(ch >= ROBOT_SIM_NUM_WHEELS)
+    {
+        fprintf(stderr, "Invalid channel!\n");
+        return -1;
+    }
+    pthread_mutex_lock(&robot_mutex);
+    step_locked(time_us_64());
+    encoder_offset[ch] += pos - encoder_count_locked(ch);
+    pthread_mutex_unlock(&robot_mutex);
+    return 0;
+}
+
+/*
+ * IMU, updated every time the model steps rather than at its sample rate
+ */
+mbot_bhy_config_t mbot_imu_default_config(void)
+{
+    mbot_bhy_config_t config = {
+        .sample_rate = 100,
+        .accel_range =  4,
+        .gyro_range = 250,
+        .enable_mag = 1,
+        .enable_quat = 1,
+        .enable_rpy = 1
+    };
+    return config;
+}
+
+int mbot_imu_init(mbot_bhy_data_t* data, mbot_bhy_config_t config)
+{
+    pthread_mutex_lock(&robot_mutex);
+    memset(data, 0, sizeof(mbot_bhy_data_t));
+    data->accel_to_ms2 = ACCEL_2_MS2;
+    data->gyro_to_rads = GYRO_2_RADS;
+    data->mag_to_uT = MAG_2_UT;
+    data->quat_to_norm = QUAT_2_NORM;
+    data->rpy_to_rad = RPY_2_RAD;
+    imu_data = data;
+    update_imu();
+    pthread_mutex_unlock(&robot_mutex);
+    return 0;
+}
+
+void mbot_imu_print(mbot_bhy_data_t data)
+{
+    printf("ACCEL MS2| X: %f | Y: %f | Z: %f \n", data.accel[0], data.accel[1], data.accel[2]);
+    printf("GYRO RADS| X: %-3.4f | Y: %-3.4f | Z: %-3.4f \n", data.gyro[0], data.gyro[1], data.gyro[2]);
+    printf("  RPY RAD| X: %-3.3f | Y: %-3.3f | Z: %-3.3f |\n", data.rpy[0], data.rpy[1], data.rpy[2]);
+}
+
+/*
+ * FRAM, holding the calibration from the config
+ */
+int mbot_init_fram()
+{
+    return 0;
+}
+
+int mbot_read_fram(uint16_t addr, size_t length, uint8_t* data)
+{
+    if(addr + length > MAXADDRESS)
+    {
+        return -1;
+    }
+    pthread_mutex_lock(&robot_mutex);
+    memcpy(data, &fram[addr], length);
+    pthread_mutex_unlock(&robot_mutex);
+    return 0;
+}
+
+int mbot_write_fram(uint16_t addr, size_t length, uint8_t* data)
+{
+    if(addr + length > MAXADDRESS)
+    {
+        return -1;
+    }
+    pthread_mutex_lock(&robot_mutex);
+    memcpy(&fram[addr], data, length);
+    pthread_mutex_unlock(&robot_mutex);
+    return 0;
+}
+
+int mbot_read_word_fram(uint16_t addr, uint16_t* data)
+{
+    return mbot_read_fram(addr, sizeof(uint16_t), (uint8_t*)data);
+}
+
+int mbot_write_word_fram(uint16_t addr, uint16_t data)
+{
+    return mbot_write_fram(addr, sizeof(uint16_t), (uint8_t*)&data);
+}
+
+int mbot_erase_fram(void)
+{
+    pthread_mutex_lock(&robot_mutex);
+    memset(fram, 0, sizeof(fram));
+    pthread_mutex_unlock(&robot_mutex);
+    return 0;
+}
+
+/*
+ * ADC, only the battery is connected
+ */
+void adc_init(void)
+{
+}
+
+void adc_gpio_init(unsigned int gpio)
+{
+}
+
+void adc_select_input(unsigned int input)
+{
+    adc_input = input;
+}
+
+uint16_t adc_read(void)
+{
+    float volts = (adc_input == ADC_BATTERY_INPUT) ? robot_config.battery_volts / 5.0f : 0.0f;
+    float raw = volts / ADC_VREF * (1 << 12);
+    return (uint16_t)fminf(fmaxf(raw, 0.0f), (1 << 12) - 1);
+}
@@ -0,0 +1,138 @@
+/*
+* Runs the MBot firmware's main() on a Linux host, against a model of the robot instead of the control board, so the
+* comms and control path can be tested and profiled without hardware.
+*
+* The firmware is built unchanged against host stand-ins for the Pico SDK: the main loop's repeating timer and core 1
+* are threads, and the USB serial port mbot_lcm_serial talks to is a pseudo-terminal, linked from --link so
+* `lcm_serial_server --port` can open it. The motors, encoders, IMU and FRAM are the simulated robot in robot_sim.c.
+*/
+#define _GNU_SOURCE  // SCHED_IDLE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+
+#include <pico/stdlib.h>
+#include <sim/pico_sim.h>
+#include <sim/robot_sim.h>
+
+#define DEFAULT_LINK_PATH "/tmp/mbot_lcm"
+
+// the firmware's main(), which is renamed when it's built for the sim
+int mbot_firmware_main(void);
+
+static volatile sig_atomic_t stop_requested = 0;
+static volatile bool firmware_exited = false;
+static int firmware_rc = 0;
+
+static void signal_handler(int signum)
+{
+    stop_requested = 1;
+}
+
+static void* core0_thread(void* arg)
+{
+    firmware_rc = mbot_firmware_main();
+    firmware_exited = true;
+    return NULL;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [--link PATH] [--duration SECONDS] [--time-constant SECONDS]\n"
+                    "  --link PATH              where to link the serial port (default %s)\n"
+                    "  --duration SECONDS       stop after this long (default: run until interrupted)\n"
+                    "  --time-constant SECONDS  the motors' time constant (default %.2f)\n",
+            name, DEFAULT_LINK_PATH, robot_sim_default_config().motor_time_constant);
+}
+
+int main(int argc, char** argv)
+{
+    const char* link_path = DEFAULT_LINK_PATH;
+    double duration = 0.0;
+    robot_sim_config_t config = robot_sim_default_config();
+
+    static const struct option long_options[] = {
+        {"link", required_argument, NULL, 'l'},
+        {"duration", required_argument, NULL, 'd'},
+        {"time-constant", required_argument, NULL, 't'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while((opt = getopt_long(argc, argv, "l:d:t:h", long_options, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 'l':
+                link_path = optarg;
+                break;
+            case 'd':
+                duration = atof(optarg);
+                break;
+            case 't':
+                config.motor_time_constant = atof(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    pico_sim_boot();
+    robot_sim_init(&config);
+    if(pico_sim_open_usb(link_path) != 0)
+    {
+        return 1;
+    }
+    fprintf(stderr, "Serial port %s, linked from %s\n", pico_sim_usb_port(), link_path);
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    // On the Pico, main() idles once the loop timer is started, and the timer's interrupt preempts it. Running it at
+    // the lowest priority does the same here, so it only gets the CPU the timer and core 1 leave.
+    pthread_t core0;
+    pthread_attr_t attr;
+    struct sched_param param = {0};
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_IDLE);
+    pthread_attr_setschedparam(&attr, &param);
+    int rc = pthread_create(&core0, &attr, &core0_thread, NULL);
+    pthread_attr_destroy(&attr);
+    if(rc != 0)
+    {
+        fprintf(stderr, "Error %i starting the firmware: %s\n", rc, strerror(rc));
+        pico_sim_close_usb();
+        return 1;
+    }
+
+    uint64_t stop_time = time_us_64() + (uint64_t)(duration * 1e6);
+    while(!stop_requested && !firmware_exited && (duration <= 0.0 || time_us_64() < stop_time))
+    {
+        sleep_ms(100);
+    }
+
+    pico_sim_usb_stats_t usb_stats;
+    robot_sim_state_t state;
+    pico_sim_get_usb_stats(&usb_stats);
+    robot_sim_get_state(&state);
+    pico_sim_close_usb();
+
+    if(firmware_exited)
+    {
+        fprintf(stderr, "The firmware exited with %d\n", firmware_rc);
+    }
+    fprintf(stderr, "Serial: %llu bytes in, %llu bytes out, %llu bytes dropped\n",
+            (unsigned long long)usb_stats.bytes_in, (unsigned long long)usb_stats.bytes_out,
+            (unsigned long long)usb_stats.bytes_dropped);
+    fprintf(stderr, "Robot: x %.3f m, y %.3f m, theta %.3f rad after %.1f s\n", state.x, state.y, state.theta,
+            time_us_64() * 1e-6);
+    // the other threads never return, so the process ends here
+    return firmware_exited ? firmware_rc : 0;
+}
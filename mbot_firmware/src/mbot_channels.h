@@ -10,6 +10,8 @@
 // These must match the channels also defined for mbot_lcm_serial in mbot_lcm_base
 enum message_topics{
     MBOT_TIMESYNC = 201, 
+    MBOT_TIMESYNC_RESPONSE = 202,
+    MBOT_CLOCK_OFFSET = 203,
     MBOT_ODOMETRY = 210, 
     MBOT_ODOMETRY_RESET = 211,
     MBOT_VEL_CMD = 214,
@@ -22,6 +24,7 @@ enum message_topics{
     MBOT_MOTOR_VEL = 232,
     MBOT_MOTOR_PWM = 233,
     MBOT_VEL = 234
+    // 240 is BUNDLE_TOPIC, reserved by comms for frames carrying several topics
 };
 
 #endif
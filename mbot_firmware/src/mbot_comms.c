@@ -12,10 +12,21 @@ serial_mbot_motor_pwm_t mbot_motor_pwm_cmd = {0};
 serial_mbot_motor_vel_t mbot_motor_vel_cmd = {0};
 serial_timestamp_t mbot_received_time = {0};
 
+// Reply to the latest timesync request, filled in on core 1 and sent by the main loop on core 0
+static serial_timesync_t timesync_response = {0};
+static volatile bool timesync_response_pending = false;
+
+// Clock estimates from the RPi. Core 1 writes the one not in use, then switches clock_offset_index to it. New
+// estimates come about twice a second, so core 0 is done copying long before the buffer is written again.
+static serial_clock_offset_t clock_offsets[2] = {0};
+static volatile int clock_offset_index = 0;
+static volatile bool clock_offset_received = false;
+
 void register_topics()
 {
     // Subscriptions
     comms_register_topic(MBOT_TIMESYNC, sizeof(serial_timestamp_t), (Deserialize)&timestamp_t_deserialize, (Serialize)&timestamp_t_serialize, (MsgCb)&timestamp_cb);
+    comms_register_topic(MBOT_CLOCK_OFFSET, sizeof(serial_clock_offset_t), (Deserialize)&clock_offset_t_deserialize, (Serialize)&clock_offset_t_serialize, (MsgCb)&clock_offset_cb);
     comms_register_topic(MBOT_ODOMETRY_RESET,  sizeof(serial_pose2D_t), (Deserialize)&pose2D_t_deserialize, (Serialize)&pose2D_t_serialize, (MsgCb)&reset_odometry_cb);
     comms_register_topic(MBOT_ENCODERS_RESET, sizeof(serial_mbot_encoders_t), (Deserialize)&mbot_encoders_t_deserialize, (Serialize)&mbot_encoders_t_serialize, (MsgCb)&reset_encoders_cb);
     comms_register_topic(MBOT_MOTOR_PWM_CMD, sizeof(serial_mbot_motor_pwm_t), (Deserialize)&mbot_motor_pwm_t_deserialize, (Serialize)&mbot_motor_pwm_t_serialize, (MsgCb)mbot_motor_pwm_cmd_cb);
@@ -23,6 +34,7 @@ void register_topics()
     comms_register_topic(MBOT_VEL_CMD, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize, (MsgCb)mbot_vel_cmd_cb);
 
     // Published Topics
+    comms_register_topic(MBOT_TIMESYNC_RESPONSE, sizeof(serial_timesync_t), (Deserialize)&timesync_t_deserialize, (Serialize)&timesync_t_serialize, NULL);
     comms_register_topic(MBOT_ODOMETRY, sizeof(serial_pose2D_t), (Deserialize)&pose2D_t_deserialize, (Serialize)&pose2D_t_serialize, NULL);
     comms_register_topic(MBOT_IMU, sizeof(serial_mbot_imu_t), (Deserialize)&mbot_imu_t_deserialize, (Serialize)&mbot_imu_t_serialize, NULL);
     comms_register_topic(MBOT_ANALOG_IN, sizeof(serial_mbot_analog_t), (Deserialize)&mbot_analog_t_deserialize, (Serialize)&mbot_analog_t_serialize, NULL);
@@ -50,12 +62,57 @@ int mbot_init_comms(void){
 
 void timestamp_cb(serial_timestamp_t *msg)
 {
-    // msg->utime: current time in microseconds since the Unix epoch
+    // msg->utime: time in microseconds since the Unix epoch when the RPi sent the request
     global_pico_time = to_us_since_boot(get_absolute_time());
-    timestamp_offset = msg->utime - global_pico_time;
+
+    // Only core 0 writes to serial, so the reply waits for the main loop. Requests that arrive while one is waiting
+    // are dropped.
+    if(!timesync_response_pending)
+    {
+        timesync_response.request_utime = msg->utime;
+        timesync_response.receive_utime = global_pico_time;
+        timesync_response_pending = true;
+    }
+
+    // Until the RPi has estimated our clock, the request time is close enough
+    if(!clock_offset_received)
+    {
+        timestamp_offset = msg->utime - global_pico_time;
+    }
     global_comms_status = COMMS_OK;
 }
 
+void clock_offset_cb(serial_clock_offset_t *msg)
+{
+    int next_index = 1 - clock_offset_index;
+    memcpy(&clock_offsets[next_index], msg, sizeof(serial_clock_offset_t));
+    clock_offset_index = next_index;
+    clock_offset_received = true;
+}
+
+uint64_t mbot_global_utime(uint64_t pico_time)
+{
+    if(!clock_offset_received)
+    {
+        return pico_time + timestamp_offset;
+    }
+
+    serial_clock_offset_t clock = clock_offsets[clock_offset_index];
+    float since_reference = (float)((int64_t)pico_time - clock.reference_utime);
+    return pico_time + clock.offset + (int64_t)(clock.drift_ppm * 1e-6f * since_reference);
+}
+
+void mbot_send_timesync_response(void)
+{
+    if(!timesync_response_pending)
+    {
+        return;
+    }
+    timesync_response.transmit_utime = to_us_since_boot(get_absolute_time());
+    comms_write_topic(MBOT_TIMESYNC_RESPONSE, &timesync_response);
+    timesync_response_pending = false;
+}
+
 void reset_encoders_cb(serial_mbot_encoders_t *msg)
 {
     //memcpy(&encoders, msg, sizeof(serial_mbot_encoders_t));
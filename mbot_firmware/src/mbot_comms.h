@@ -46,6 +46,7 @@ extern int drive_mode;
 
 // callback functions
 void timestamp_cb(serial_timestamp_t *msg);
+void clock_offset_cb(serial_clock_offset_t *msg);
 void reset_encoders_cb(serial_mbot_encoders_t *msg);
 void reset_odometry_cb(serial_pose2D_t *msg);
 void mbot_vel_cmd_cb(serial_twist2D_t *msg);
@@ -56,4 +57,19 @@ void mbot_motor_pwm_cmd_cb(serial_mbot_motor_pwm_t *msg);
 void register_topics();
 int mbot_init_comms(void);
 
+/**
+ * @brief Converts a time on the Pico's clock to the RPi's clock, using the latest estimate of the offset and drift
+ * between the clocks sent by the RPi.
+ *
+ * @param pico_time Microseconds since the Pico booted
+ * @return Microseconds since the Unix epoch on the RPi's clock
+ */
+uint64_t mbot_global_utime(uint64_t pico_time);
+
+/**
+ * @brief Replies to the latest timesync request from the RPi, if there is one waiting. Call it from the main loop
+ * before writing any other topics, so the reply isn't queued behind them.
+ */
+void mbot_send_timesync_response(void);
+
 #endif /* MBOT_COMMS_H */
\ No newline at end of file
@@ -10,6 +10,7 @@ mbot_params_t params;
 uint64_t timestamp_offset = 0;
 uint64_t global_utime = 0;
 uint64_t global_pico_time = 0;
+static comms_bundle_t mbot_bundle;     // built in place every loop, too big for the timer callback's stack
 bool global_comms_status = COMMS_ERROR;
 int drive_mode = 0;
 mbot_bhy_config_t mbot_imu_config;
@@ -39,7 +40,7 @@ void print_mbot_params(const mbot_params_t* params);
 bool mbot_loop(repeating_timer_t *rt)
 {
     // Update mbot_vel
-    global_utime = to_us_since_boot(get_absolute_time()) + timestamp_offset;
+    global_utime = mbot_global_utime(to_us_since_boot(get_absolute_time()));
     mbot_vel.utime = global_utime;
     mbot_read_encoders(&mbot_encoders);
     mbot_read_imu(&mbot_imu);
@@ -105,18 +106,17 @@ bool mbot_loop(repeating_timer_t *rt)
         mbot_motor_set_duty(MOT_B, tmp_pwm_back);
         mbot_motor_pwm.pwm[MOT_B] = tmp_pwm_back;
 
-        // write the encoders to serial
-        comms_write_topic(MBOT_ENCODERS, &mbot_encoders);
-        // send odom on wire
-        comms_write_topic(MBOT_ODOMETRY, &mbot_odometry);
-        // write the IMU to serial
-        comms_write_topic(MBOT_IMU, &mbot_imu);
-        // write the Body velocity to serial
-        comms_write_topic(MBOT_VEL, &mbot_vel);
-        // write the Motor velocity to serial
-        comms_write_topic(MBOT_MOTOR_VEL, &mbot_motor_vel);
-        // write the PWMs to serial
-        comms_write_topic(MBOT_MOTOR_PWM, &mbot_motor_pwm);
+        // answer the RPi's clock sync request first, so the reply isn't delayed by the other topics
+        mbot_send_timesync_response();
+        // send this loop's sensor topics in one frame, stamped once with the loop's time
+        comms_bundle_start(&mbot_bundle, global_utime);
+        comms_bundle_add_topic(&mbot_bundle, MBOT_ENCODERS, &mbot_encoders);
+        comms_bundle_add_topic(&mbot_bundle, MBOT_ODOMETRY, &mbot_odometry);
+        comms_bundle_add_topic(&mbot_bundle, MBOT_IMU, &mbot_imu);
+        comms_bundle_add_topic(&mbot_bundle, MBOT_VEL, &mbot_vel);
+        comms_bundle_add_topic(&mbot_bundle, MBOT_MOTOR_VEL, &mbot_motor_vel);
+        comms_bundle_add_topic(&mbot_bundle, MBOT_MOTOR_PWM, &mbot_motor_pwm);
+        comms_write_bundle(&mbot_bundle);
     }
     // comparing current pico time against the last successful communication timestamp(global_pico_time)
     uint64_t timeout = to_us_since_boot(get_absolute_time()) - global_pico_time;
@@ -11,6 +11,7 @@
 #include <mbot_lcm_msgs/particles_t.hpp>
 #include <mbot_lcm_msgs/path2D_t.hpp>
 #include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_t.hpp>
 
 #include <common_utils/frontiers.hpp>
 #include <common_utils/obstacle_distance_grid.hpp>
@@ -67,6 +68,7 @@ public:
     void handlePose(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::pose2D_t* pose);
     void handleOdometry(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::pose2D_t* odom);
     void handleLaser(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::lidar_t* laser);
+    void handleCompactLaser(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::lidar_compact_t* laser);
     void handlePath(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::path2D_t* path);
 
 private:
@@ -93,6 +95,7 @@ private:
     double rightTrim_;                              // Trim value to apply to the right wheel (%)
 
     bool haveLaser_;
+    bool haveCompactLaser_;                         // Once compact scans arrive, full scans are ignored
     bool havePath_;
     bool haveTruePose_;
     mbot_lcm_msgs::pose2D_t initialTruePose_;
@@ -7,6 +7,7 @@
 #define MBOT_IMU_CHANNEL "MBOT_IMU"
 #define MBOT_ENCODERS_CHANNEL "MBOT_ENCODERS"
 #define LIDAR_CHANNEL "LIDAR"
+#define LIDAR_COMPACT_CHANNEL "LIDAR_COMPACT"
 #define WIFI_READINGS_CHANNEL "WIFI"
 #define PATH_REQUEST_CHANNEL "PATH_REQUEST"
 
@@ -7,6 +7,7 @@
 // #include <planning/planning_channels.h>
 // #include <planning/motion_planner.hpp>
 #include <mbot_lcm_msgs/planner_request_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_utils.hpp>
 #include <vx/gtk/vx_gtk_display_source.h>
 #include <vx/vx_colors.h>
 #include <gdk/gdk.h>
@@ -25,6 +26,7 @@ void reset_state_pressed(GtkWidget* button, gpointer gui);
 BotGui::BotGui(lcm::LCM* lcmInstance, int argc, char** argv, int widthInPixels, int heightInPixels, int framesPerSecond)
 : VxGtkWindowBase(argc, argv, widthInPixels, heightInPixels, framesPerSecond)
 , haveLaser_(false)
+, haveCompactLaser_(false)
 , havePath_(false)
 , haveTruePose_(false)
 , shouldResetStateLabels_(false)
@@ -185,6 +187,7 @@ void BotGui::onDisplayStart(vx_display_t* display)
     lcmInstance_->subscribe(SLAM_PARTICLES_CHANNEL, &BotGui::handleParticles, this);
     lcmInstance_->subscribe(CONTROLLER_PATH_CHANNEL, &BotGui::handlePath, this);
     lcmInstance_->subscribe(LIDAR_CHANNEL, &BotGui::handleLaser, this);
+    lcmInstance_->subscribe(LIDAR_COMPACT_CHANNEL, &BotGui::handleCompactLaser, this);
     lcmInstance_->subscribe(".*_POSE", &BotGui::handlePose, this);  // NOTE: Subscribe to ALL _POSE channels!
     lcmInstance_->subscribe(".*ODOMETRY", &BotGui::handleOdometry, this); // NOTE: Subscribe to all channels with odometry in the name
 }
@@ -331,11 +334,21 @@ void BotGui::handleOdometry(const lcm::ReceiveBuffer* rbuf, const std::string& c
 void BotGui::handleLaser(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::lidar_t* laser)
 {
     std::lock_guard<std::mutex> autoLock(vxLock_);
+    if(haveCompactLaser_) return;
     laser_ = *laser;
     haveLaser_ = true;
 }
 
 
+void BotGui::handleCompactLaser(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::lidar_compact_t* laser)
+{
+    std::lock_guard<std::mutex> autoLock(vxLock_);
+    mbot_lcm_msgs::expand_lidar_compact(*laser, laser_);
+    haveLaser_ = true;
+    haveCompactLaser_ = true;
+}
+
+
 void BotGui::handlePath(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const mbot_lcm_msgs::path2D_t* path)
 {
     std::lock_guard<std::mutex> autoLock(vxLock_);
@@ -0,0 +1,67 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "comms_common.h"
+
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+// size of the receive ring buffer, must be a power of two. Frames can be up to this long, including packaging.
+#define FRAME_PARSER_BUFFER_SIZE 4096
+#define FRAME_PARSER_MAX_MSG_LEN (FRAME_PARSER_BUFFER_SIZE - ROS_PKG_LENGTH)
+
+// called with each valid frame. data is only valid until the callback returns.
+typedef void (*FrameCb)(uint16_t topic_id, uint8_t* data, uint16_t msg_len, void* arg);
+
+typedef struct frame_parser_stats{
+    uint64_t bytes;             // bytes added to the buffer
+    uint64_t frames;            // valid frames, a bundle counts once
+    uint64_t bad_bundles;       // bundles whose topics don't add up to the bundle's length
+    uint64_t bad_headers;       // sync flags followed by an invalid header
+    uint64_t bad_checksums;     // frames with a valid header but a bad checksum over the topic and message
+    uint64_t resyncs;           // runs of skipped bytes, each one a time the parser lost track of the frames
+    uint64_t skipped_bytes;     // bytes thrown away while looking for the next frame
+    uint64_t topic_bad_checksums[MAX_TOPICS];   // bad_checksums by the topic in the header, if it's below MAX_TOPICS
+}frame_parser_stats_t;
+
+/*
+* frame_parser_t holds the bytes read from the serial port until a whole frame is available. Bytes are read into the
+* ring buffer in large chunks with frame_parser_write_ptr() and frame_parser_commit(), then frame_parser_parse() hands
+* every complete frame to a callback.
+*
+* Bundles (frames on BUNDLE_TOPIC) are unpacked, so the callback gets each topic in them separately, with the bundle's
+* utime put back in front of it.
+*
+* If a header or checksum is bad, the parser skips only the sync flag it started from and looks for the next one in
+* the bytes it already has, so a frame that follows a corrupt one is not lost.
+*/
+typedef struct frame_parser{
+    uint8_t buffer[FRAME_PARSER_BUFFER_SIZE];
+    uint32_t head;  // total bytes written, the write index is head % FRAME_PARSER_BUFFER_SIZE
+    uint32_t tail;  // total bytes consumed
+    uint8_t msg[FRAME_PARSER_MAX_MSG_LEN];  // message of the current frame, copied out so it's contiguous
+    bool resyncing; // bytes have been skipped since the last valid frame
+    frame_parser_stats_t stats;
+}frame_parser_t;
+
+void frame_parser_init(frame_parser_t* parser);
+
+// finds where the next read should go. *space is the number of bytes that can be read there, always at least 1
+// after frame_parser_parse() has been called.
+uint8_t* frame_parser_write_ptr(frame_parser_t* parser, size_t* space);
+
+// adds len bytes that were read into the space from frame_parser_write_ptr() to the buffer
+void frame_parser_commit(frame_parser_t* parser, size_t len);
+
+// copies len bytes into the buffer, returns how many fit
+size_t frame_parser_push(frame_parser_t* parser, const uint8_t* data, size_t len);
+
+// calls frame_cb with every complete frame in the buffer, returns the number of frames found
+int frame_parser_parse(frame_parser_t* parser, FrameCb frame_cb, void* arg);
+
+// calls frame_cb with each topic in the message of a bundle frame. Returns the number of topics, or -1 if the bundle
+// is malformed, in which case none of its topics are handled.
+int frame_parser_unpack_bundle(uint8_t* bundle_msg, uint16_t bundle_len, FrameCb frame_cb, void* arg);
+
+#endif
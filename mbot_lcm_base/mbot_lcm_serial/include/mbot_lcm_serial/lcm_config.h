@@ -6,6 +6,9 @@
 
 /////// LCM channels //////
 #define MBOT_TIMESYNC_CHANNEL "MBOT_TIMESYNC"
+#define MBOT_TIMESYNC_REQUEST_CHANNEL "MBOT_TIMESYNC_REQUEST"
+#define MBOT_TIMESYNC_RESPONSE_CHANNEL "MBOT_TIMESYNC_RESPONSE"
+#define MBOT_CLOCK_OFFSET_CHANNEL "MBOT_CLOCK_OFFSET"
 #define MBOT_ODOMETRY_CHANNEL "MBOT_ODOMETRY"
 #define MBOT_ODOMETRY_RESET_CHANNEL "MBOT_ODOMETRY_RESET"
 #define MBOT_MOTOR_PWM_CMD_CHANNEL "MBOT_MOTOR_PWM_CMD"
@@ -19,10 +22,13 @@
 #define MBOT_ENCODERS_CHANNEL "MBOT_ENCODERS"
 #define MBOT_ENCODERS_RESET_CHANNEL "MBOT_ENCODERS_RESET"
 #define MBOT_APRILTAG_ARRAY_CHANNEL "MBOT_APRILTAG_ARRAY"
+#define MBOT_LINK_STATS_CHANNEL "MBOT_LINK_STATS"
 
 /////// serial channels //////
 enum message_topics{
     MBOT_TIMESYNC = 201, 
+    MBOT_TIMESYNC_RESPONSE = 202,
+    MBOT_CLOCK_OFFSET = 203,
     MBOT_ODOMETRY = 210, 
     MBOT_ODOMETRY_RESET = 211,
     MBOT_VEL_CMD = 214,
@@ -36,6 +42,7 @@ enum message_topics{
     MBOT_MOTOR_PWM = 233,
     MBOT_VEL = 234,
     MBOT_APRILTAG_ARRAY = 235
+    // 240 is BUNDLE_TOPIC, reserved for frames carrying several topics, see comms_common.h
 };
 
 #endif // LCM_CONFIG_H
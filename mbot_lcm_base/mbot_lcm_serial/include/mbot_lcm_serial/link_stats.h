@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "comms_common.h"
+#include "frame_parser.h"
+#include "protocol.h"
+
+#include <mbot_lcm_msgs_link_stats_t.h>
+
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#define LINK_STATS_PERIOD_US 1000000  // 1 Hz
+
+// a topic to report on
+typedef struct link_stats_topic{
+    uint16_t topic_id;
+    const char* channel;
+    bool stamped;   // the message starts with an int64 utime on the RPi's clock, so its latency can be measured
+}link_stats_topic_t;
+
+// called with the stats at the end of each period. msg is only valid until the callback returns.
+typedef void (*LinkStatsCb)(mbot_lcm_msgs_link_stats_t* msg, void* arg);
+
+// what was received on a topic during the current period
+typedef struct link_rx_stats{
+    uint32_t packets;
+    uint32_t bytes;
+    int64_t last_utime;     // when the last message arrived, kept from one period to the next
+    uint32_t num_intervals;
+    double interval_sum;
+    double interval_sq_sum;
+    int64_t interval_max;
+    uint32_t num_latencies;
+    double latency_sum;
+    int64_t latency_min;
+    int64_t latency_max;
+}link_rx_stats_t;
+
+/*
+* link_stats_t collects the health of the serial link on the listener thread. The listener records every message it
+* receives and calls link_stats_update() each time it wakes up, which hands the stats to a callback once a period.
+*
+* The frame parser and the protocol keep running totals, so the stats for a period are the difference from their
+* totals at the start of it. Latency is the time a message was received minus its utime, which the control board
+* stamps on the RPi's clock through its clock estimate, so it's only as good as that estimate.
+*/
+typedef struct link_stats{
+    const link_stats_topic_t* topics;
+    int num_topics;
+    bool stamped[MAX_TOPICS];
+    link_rx_stats_t rx[MAX_TOPICS];             // indexed by topic id
+    comms_tx_stats_t tx_at_start[MAX_TOPICS];
+    frame_parser_stats_t parser_at_start;
+    int64_t period_start_utime;
+
+    uint32_t num_queue_samples;
+    double queue_sum;
+    int32_t queue_max;
+
+    mbot_lcm_msgs_link_topic_stats_t* topic_msgs;   // one per topic, so building the message doesn't allocate
+    LinkStatsCb publish_cb;
+    void* publish_arg;
+}link_stats_t;
+
+// the RPi's clock, which the control board stamps its messages with
+int64_t link_stats_utime_now(void);
+
+// topics must outlive the stats. Returns NULL if num_topics is negative or topics has an id that isn't below MAX_TOPICS.
+link_stats_t* link_stats_create(const link_stats_topic_t* topics, int num_topics, LinkStatsCb publish_cb,
+                                void* publish_arg);
+void link_stats_destroy(link_stats_t* stats);
+
+// starts over with a new parser, e.g. after the serial port was reopened
+void link_stats_start(link_stats_t* stats, const frame_parser_stats_t* parser_stats, int64_t now);
+
+// records a message received at rx_utime
+void link_stats_record_rx(link_stats_t* stats, uint16_t topic_id, const uint8_t* msg, uint16_t msg_len,
+                          int64_t rx_utime);
+
+// records the bytes waiting to be sent, or -1 if they can't be read, and calls the callback if the period is over
+void link_stats_update(link_stats_t* stats, const frame_parser_stats_t* parser_stats, int32_t tx_queue_bytes,
+                       int64_t now);
+
+#endif
@@ -9,11 +9,22 @@
 
 #include "comms_common.h"
 #include "protocol.h"
+#include "frame_parser.h"
 #include "topic_data.h"
+#include "link_stats.h"
 
 #ifndef LISTENER_H
 #define LISTENER_H
+// how long the listener waits for data before checking listener_running again
+#define LISTENER_POLL_TIMEOUT_MS 100
+
 extern bool listener_running;
+extern FILE* listener_capture_file;   // if set, every byte read from the serial port is also written here
+// reads from the serial port until it goes away. arg is a link_stats_t* to record the link's health in, or NULL.
 void* comms_listener_loop(void* arg);
 
+// waits up to LISTENER_POLL_TIMEOUT_MS for data, reads everything available into the parser and calls frame_cb with
+// each complete frame. Returns -1 if the device is gone, 0 otherwise.
+int comms_listener_poll(int serial_device, frame_parser_t* parser, FrameCb frame_cb, void* arg);
+
 #endif
@@ -4,17 +4,18 @@
 #include <string.h>
 #include <search.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "comms_common.h"
 
 #ifndef COMMS_PROTOCOL_H
 #define COMMS_PROTOCOL_H
 
-#define MAX_RADIX_TOPICS 16
-
 typedef int (*Deserialize)(uint8_t* src, void* dest);
 typedef int (*Serialize)(void* src, uint8_t* dest);
 typedef void (*MsgCb)(void* data);
+// a callback that's given what it was registered with, so one function can handle several topics
+typedef void (*MsgArgCb)(void* data, void* arg);
 
 typedef struct topic_registry_val{
     uint16_t topic_id;
@@ -22,27 +23,77 @@ typedef struct topic_registry_val{
     Deserialize deserialize_fn;
     Serialize serialize_fn;
     MsgCb cb_fn;
+    MsgArgCb arg_cb_fn;
+    void* cb_arg;
 }topic_registry_val_t;
 
+// what has been written on a topic since it was registered
+typedef struct comms_tx_stats{
+    uint64_t packets;
+    uint64_t bytes;     // including framing
+    uint64_t errors;    // writes that failed or were cut short
+}comms_tx_stats_t;
+
+/*
+* topic_registry_entry_t is a registered topic. topic_registry is indexed by topic id, so finding a topic is one array
+* lookup, and unregistered ids are NULL.
+*
+* Each topic has its own packet, allocated and given its header when the topic is registered. Writing the topic
+* serializes it straight into the packet and only fills in the footer, so it doesn't allocate or copy.
+*/
 typedef struct topic_registry_entry{
-    struct topic_registry_entry* left;
-    struct topic_registry_entry* right;
-    struct topic_registry_val* value;
+    topic_registry_val_t value;
+    uint8_t* packet;                // ROS_PKG_LENGTH + topic_data_len bytes
+    pthread_mutex_t packet_mutex;   // held while the packet is filled in and sent
+    comms_tx_stats_t tx_stats;      // updated while packet_mutex is held
 }topic_registry_entry_t;
 
-extern topic_registry_entry_t* topic_registry_root_node;
+/*
+* comms_bundle_t is a frame on BUNDLE_TOPIC carrying several topics with one timestamp.
+*
+* The message is the int64 utime shared by every topic and the number of topics, then for each topic its uint16 id,
+* its uint8 length, and its serialized data without the leading utime. Only topics whose serialized data starts with an
+* int64 utime can be bundled. Everything is built in place, so writing a bundle doesn't allocate.
+*/
+typedef struct comms_bundle{
+    uint8_t msg[BUNDLE_MAX_MSG_LEN];
+    uint16_t msg_len;
+    uint8_t packet[BUNDLE_MAX_MSG_LEN + ROS_PKG_LENGTH];
+}comms_bundle_t;
+
+extern topic_registry_entry_t* topic_registry[MAX_TOPICS];
 extern int* serial_device_ptr;
 
 int comms_init_protocol(int* ser_dev);
+// returns 0 if topic_id isn't below MAX_TOPICS or the packet can't be allocated
 int comms_register_topic(uint16_t topic_id,
     uint32_t topic_data_len,
     Deserialize deserialize_fn,
     Serialize serialize_fn,
     MsgCb callback_fn);
+// like comms_register_topic, with a callback that's passed cb_arg
+int comms_register_topic_arg(uint16_t topic_id,
+    uint32_t topic_data_len,
+    Deserialize deserialize_fn,
+    Serialize serialize_fn,
+    MsgArgCb callback_fn,
+    void* cb_arg);
 int comms_get_topic_serializers(uint16_t topic_id, topic_registry_val_t* topic_reg_val);
+// copies what has been written on the topic, returns 0 if it isn't registered
+int comms_get_topic_tx_stats(uint16_t topic_id, comms_tx_stats_t* tx_stats);
+// serializes the topic into its own packet and points packet_out at it. The packet is reused by the next write of the
+// topic, so it must not be freed, and the caller must not write the same topic from another thread until it's sent.
 int comms_generate_packet(uint16_t topic_id, void* topic_struct, uint8_t** packet_out, uint32_t* packet_len_out);
 int comms_send_serial(uint8_t* packet_out, uint32_t packet_len);
 int comms_write_topic_test(uint16_t topic_id, void* topic_struct);
 int comms_write_topic(uint16_t topic_id, void* topic_struct);
 
+// starts a new bundle with the timestamp for all its topics, see comms_bundle_t
+void comms_bundle_start(comms_bundle_t* bundle, int64_t utime);
+// serializes a registered topic into the bundle, returns 0 if it isn't registered, can't be bundled, or doesn't fit
+int comms_bundle_add_topic(comms_bundle_t* bundle, uint16_t topic_id, void* topic_struct);
+// frames the bundle in place and returns the packet length, or 0 on failure
+uint32_t comms_bundle_generate_packet(comms_bundle_t* bundle);
+int comms_write_bundle(comms_bundle_t* bundle);
+
 #endif
@@ -0,0 +1,386 @@
+/*
+* bundle_test checks that bundles written the way the firmware writes them come out of the frame parser as the same
+* topics the firmware put in, and prints how many bytes a bundle saves over a frame per topic. It also checks that
+* topics framed in place in their own packets match encode_msg().
+*
+* The bundle encoder here is the same as the firmware's (comms/src/protocol.c), so the whole path from the Pico's
+* mbot_loop to the topic callbacks of lcm_serial_server is covered without a Pico.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <mbot_lcm_serial/lcm_config.h>
+#include <mbot_lcm_serial/comms_common.h>
+#include <mbot_lcm_serial/frame_parser.h>
+#include <mbot_lcm_serial/protocol.h>
+
+#include <mbot_lcm_msgs_serial.h>
+
+#define MAX_RECEIVED 64
+#define NUM_LOOP_TOPICS 7
+
+typedef struct received_topic{
+    uint16_t topic_id;
+    uint16_t msg_len;
+    uint8_t msg[BUNDLE_UTIME_LENGTH + UINT8_MAX];
+}received_topic_t;
+
+typedef struct received_topics{
+    received_topic_t topics[MAX_RECEIVED];
+    int num_topics;
+}received_topics_t;
+
+// the topics the Pico sends every loop
+typedef struct loop_topics{
+    serial_mbot_encoders_t encoders;
+    serial_pose2D_t odometry;
+    serial_mbot_imu_t imu;
+    serial_twist2D_t vel;
+    serial_mbot_motor_vel_t motor_vel;
+    serial_mbot_analog_t analog;
+    serial_mbot_motor_pwm_t motor_pwm;
+}loop_topics_t;
+
+static const uint16_t loop_topic_ids[NUM_LOOP_TOPICS] = {MBOT_ENCODERS, MBOT_ODOMETRY, MBOT_IMU, MBOT_VEL,
+                                                         MBOT_MOTOR_VEL, MBOT_ANALOG_IN, MBOT_MOTOR_PWM};
+
+static int num_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if(!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        num_failures++; \
+    } \
+} while(0)
+
+
+static void record_topic(uint16_t topic_id, uint8_t* data, uint16_t msg_len, void* arg)
+{
+    received_topics_t* received = (received_topics_t*)arg;
+    if(received->num_topics == MAX_RECEIVED || msg_len > sizeof(received->topics[0].msg))
+    {
+        return;
+    }
+    received_topic_t* topic = &received->topics[received->num_topics++];
+    topic->topic_id = topic_id;
+    topic->msg_len = msg_len;
+    memcpy(topic->msg, data, msg_len);
+}
+
+static void register_loop_topics(void)
+{
+    comms_register_topic(MBOT_ODOMETRY, sizeof(serial_pose2D_t), (Deserialize)&pose2D_t_deserialize, (Serialize)&pose2D_t_serialize, NULL);
+    comms_register_topic(MBOT_IMU, sizeof(serial_mbot_imu_t), (Deserialize)&mbot_imu_t_deserialize, (Serialize)&mbot_imu_t_serialize, NULL);
+    comms_register_topic(MBOT_ENCODERS, sizeof(serial_mbot_encoders_t), (Deserialize)&mbot_encoders_t_deserialize, (Serialize)&mbot_encoders_t_serialize, NULL);
+    comms_register_topic(MBOT_VEL, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize, NULL);
+    comms_register_topic(MBOT_MOTOR_VEL, sizeof(serial_mbot_motor_vel_t), (Deserialize)&mbot_motor_vel_t_deserialize, (Serialize)&mbot_motor_vel_t_serialize, NULL);
+    comms_register_topic(MBOT_MOTOR_PWM, sizeof(serial_mbot_motor_pwm_t), (Deserialize)&mbot_motor_pwm_t_deserialize, (Serialize)&mbot_motor_pwm_t_serialize, NULL);
+    comms_register_topic(MBOT_ANALOG_IN, sizeof(serial_mbot_analog_t), (Deserialize)&mbot_analog_t_deserialize, (Serialize)&mbot_analog_t_serialize, NULL);
+    // too short to start with a utime, so it can't be bundled
+    comms_register_topic(MBOT_TIMESYNC, 4, NULL, NULL, NULL);
+}
+
+static void fill_loop_topics(loop_topics_t* topics)
+{
+    // every byte different, and every utime different from the bundle's
+    uint8_t* bytes = (uint8_t*)topics;
+    for(size_t i = 0; i < sizeof(loop_topics_t); i++)
+    {
+        bytes[i] = (uint8_t)(rand() & 0xff);
+    }
+}
+
+static void* loop_topic_struct(loop_topics_t* topics, int index)
+{
+    void* structs[NUM_LOOP_TOPICS] = {&topics->encoders, &topics->odometry, &topics->imu, &topics->vel,
+                                      &topics->motor_vel, &topics->analog, &topics->motor_pwm};
+    return structs[index];
+}
+
+static uint32_t loop_topic_len(int index)
+{
+    topic_registry_val_t topic_val;
+    comms_get_topic_serializers(loop_topic_ids[index], &topic_val);
+    return topic_val.topic_data_len;
+}
+
+static void build_loop_bundle(comms_bundle_t* bundle, loop_topics_t* topics, int64_t utime)
+{
+    comms_bundle_start(bundle, utime);
+    for(int i = 0; i < NUM_LOOP_TOPICS; i++)
+    {
+        CHECK(comms_bundle_add_topic(bundle, loop_topic_ids[i], loop_topic_struct(topics, i)), "adding topic %d",
+              loop_topic_ids[i]);
+    }
+}
+
+// checks that the received topics are the loop's topics, with the bundle's utime in place of their own
+static void check_loop_topics(const received_topics_t* received, int first, loop_topics_t* topics, int64_t utime)
+{
+    for(int i = 0; i < NUM_LOOP_TOPICS; i++)
+    {
+        const received_topic_t* topic = &received->topics[first + i];
+        uint32_t expected_len = loop_topic_len(i);
+        CHECK(topic->topic_id == loop_topic_ids[i], "topic %d is %d, expected %d", i, topic->topic_id,
+              loop_topic_ids[i]);
+        CHECK(topic->msg_len == expected_len, "topic %d is %d bytes, expected %d", topic->topic_id, topic->msg_len,
+              expected_len);
+
+        int64_t topic_utime;
+        memcpy(&topic_utime, topic->msg, sizeof(int64_t));
+        CHECK(topic_utime == utime, "topic %d has utime %lld, expected %lld", topic->topic_id, (long long)topic_utime,
+              (long long)utime);
+
+        uint8_t* original = (uint8_t*)loop_topic_struct(topics, i);
+        CHECK(memcmp(&topic->msg[BUNDLE_UTIME_LENGTH], &original[BUNDLE_UTIME_LENGTH],
+                     expected_len - BUNDLE_UTIME_LENGTH) == 0, "topic %d data doesn't match", topic->topic_id);
+    }
+}
+
+static int parse_bytes(frame_parser_t* parser, const uint8_t* bytes, size_t len, size_t chunk,
+                       received_topics_t* received)
+{
+    int num_frames = 0;
+    for(size_t pushed = 0; pushed < len; )
+    {
+        size_t to_push = (len - pushed < chunk) ? len - pushed : chunk;
+        pushed += frame_parser_push(parser, &bytes[pushed], to_push);
+        num_frames += frame_parser_parse(parser, record_topic, received);
+    }
+    return num_frames;
+}
+
+
+static void test_round_trip(void)
+{
+    loop_topics_t topics;
+    fill_loop_topics(&topics);
+    static comms_bundle_t bundle;
+    int64_t utime = 1712345678901234LL;
+    build_loop_bundle(&bundle, &topics, utime);
+    uint32_t packet_len = comms_bundle_generate_packet(&bundle);
+    CHECK(packet_len > 0, "encoding the bundle");
+
+    static frame_parser_t parser;
+    frame_parser_init(&parser);
+    static received_topics_t received;
+    received.num_topics = 0;
+    int num_frames = parse_bytes(&parser, bundle.packet, packet_len, packet_len, &received);
+
+    CHECK(num_frames == 1, "%d frames, expected 1", num_frames);
+    CHECK(received.num_topics == NUM_LOOP_TOPICS, "%d topics, expected %d", received.num_topics, NUM_LOOP_TOPICS);
+    if(received.num_topics == NUM_LOOP_TOPICS)
+    {
+        check_loop_topics(&received, 0, &topics, utime);
+    }
+}
+
+static void test_stream_in_pieces(void)
+{
+    // bundles between separate frames, fed to the parser a few bytes at a time
+    static uint8_t stream[8192];
+    size_t stream_len = 0;
+    loop_topics_t topics[3];
+    static comms_bundle_t bundle;
+
+    for(int i = 0; i < 3; i++)
+    {
+        fill_loop_topics(&topics[i]);
+        build_loop_bundle(&bundle, &topics[i], 1000 * (i + 1));
+        uint32_t packet_len = comms_bundle_generate_packet(&bundle);
+        memcpy(&stream[stream_len], bundle.packet, packet_len);
+        stream_len += packet_len;
+
+        uint8_t* packet = NULL;
+        uint32_t single_len = 0;
+        comms_generate_packet(MBOT_ODOMETRY, &topics[i].odometry, &packet, &single_len);
+        memcpy(&stream[stream_len], packet, single_len);
+        stream_len += single_len;
+    }
+
+    for(size_t chunk = 1; chunk <= 64; chunk *= 2)
+    {
+        static frame_parser_t parser;
+        frame_parser_init(&parser);
+        static received_topics_t received;
+        received.num_topics = 0;
+        parse_bytes(&parser, stream, stream_len, chunk, &received);
+
+        CHECK(received.num_topics == 3 * (NUM_LOOP_TOPICS + 1), "%d topics with %zu byte reads, expected %d",
+              received.num_topics, chunk, 3 * (NUM_LOOP_TOPICS + 1));
+        if(received.num_topics != 3 * (NUM_LOOP_TOPICS + 1))
+        {
+            continue;
+        }
+        for(int i = 0; i < 3; i++)
+        {
+            int first = i * (NUM_LOOP_TOPICS + 1);
+            check_loop_topics(&received, first, &topics[i], 1000 * (i + 1));
+            const received_topic_t* single = &received.topics[first + NUM_LOOP_TOPICS];
+            CHECK(single->topic_id == MBOT_ODOMETRY && memcmp(single->msg, &topics[i].odometry,
+                                                              sizeof(serial_pose2D_t)) == 0,
+                  "separate odometry frame after bundle %d", i);
+        }
+    }
+}
+
+static void test_long_bundle(void)
+{
+    // more than 255 bytes of message, so both bytes of the length are used
+    loop_topics_t topics;
+    fill_loop_topics(&topics);
+    static comms_bundle_t bundle;
+    comms_bundle_start(&bundle, 42);
+    int num_added = 0;
+    while(comms_bundle_add_topic(&bundle, MBOT_IMU, &topics.imu))
+    {
+        num_added++;
+    }
+    CHECK(bundle.msg_len > 255, "bundle is only %d bytes", bundle.msg_len);
+    CHECK(bundle.msg_len <= BUNDLE_MAX_MSG_LEN, "bundle is %d bytes, more than the max", bundle.msg_len);
+
+    uint32_t packet_len = comms_bundle_generate_packet(&bundle);
+    static frame_parser_t parser;
+    frame_parser_init(&parser);
+    static received_topics_t received;
+    received.num_topics = 0;
+    parse_bytes(&parser, bundle.packet, packet_len, packet_len, &received);
+    CHECK(received.num_topics == num_added, "%d topics from a full bundle, expected %d", received.num_topics,
+          num_added);
+}
+
+// a topic framed in its own packet is the same as one framed by encode_msg
+static void test_topic_packets(void)
+{
+    loop_topics_t topics;
+    fill_loop_topics(&topics);
+    for(int i = 0; i < NUM_LOOP_TOPICS; i++)
+    {
+        topic_registry_val_t topic_val;
+        comms_get_topic_serializers(loop_topic_ids[i], &topic_val);
+        uint8_t msg[topic_val.topic_data_len];
+        topic_val.serialize_fn(loop_topic_struct(&topics, i), msg);
+        uint8_t expected[topic_val.topic_data_len + ROS_PKG_LENGTH];
+        encode_msg(msg, topic_val.topic_data_len, loop_topic_ids[i], expected, sizeof(expected));
+
+        // twice, so the second write reuses the packet
+        for(int write = 0; write < 2; write++)
+        {
+            uint8_t* packet = NULL;
+            uint32_t packet_len = 0;
+            CHECK(comms_generate_packet(loop_topic_ids[i], loop_topic_struct(&topics, i), &packet, &packet_len),
+                  "generating topic %d", loop_topic_ids[i]);
+            CHECK(packet_len == sizeof(expected) && memcmp(packet, expected, packet_len) == 0,
+                  "topic %d packet differs from encode_msg", loop_topic_ids[i]);
+        }
+    }
+
+    topic_registry_val_t topic_val;
+    uint8_t* packet = NULL;
+    uint32_t packet_len = 0;
+    CHECK(comms_get_topic_serializers(MBOT_VEL_CMD, &topic_val) == 0, "found an unregistered topic");
+    CHECK(comms_generate_packet(MBOT_VEL_CMD, &topics.vel, &packet, &packet_len) == 0,
+          "generated an unregistered topic");
+    CHECK(comms_register_topic(MAX_TOPICS, sizeof(serial_twist2D_t), NULL, NULL, NULL) == 0,
+          "registered a topic id past the table");
+    CHECK(comms_get_topic_serializers(MAX_TOPICS, &topic_val) == 0, "found a topic id past the table");
+}
+
+static void test_rejects_bad_topics(void)
+{
+    static comms_bundle_t bundle;
+    comms_bundle_start(&bundle, 0);
+    uint8_t short_topic[4] = {0};
+    CHECK(comms_bundle_add_topic(&bundle, MBOT_TIMESYNC, short_topic) == 0, "added a topic without a utime");
+    CHECK(bundle.msg_len == BUNDLE_HEADER_LENGTH && bundle.msg[BUNDLE_UTIME_LENGTH] == 0,
+          "a rejected topic changed the bundle");
+}
+
+static void test_corrupt_bundles(void)
+{
+    loop_topics_t topics;
+    fill_loop_topics(&topics);
+    static comms_bundle_t bundle;
+    build_loop_bundle(&bundle, &topics, 7);
+    uint32_t packet_len = comms_bundle_generate_packet(&bundle);
+
+    // a flipped bit fails the checksum, and the frame after it is still found
+    static uint8_t stream[2 * (BUNDLE_MAX_MSG_LEN + ROS_PKG_LENGTH)];
+    memcpy(stream, bundle.packet, packet_len);
+    memcpy(&stream[packet_len], bundle.packet, packet_len);
+    stream[ROS_HEADER_LENGTH + 20] ^= 0x01;
+
+    static frame_parser_t parser;
+    frame_parser_init(&parser);
+    static received_topics_t received;
+    received.num_topics = 0;
+    parse_bytes(&parser, stream, 2 * packet_len, 2 * packet_len, &received);
+    CHECK(received.num_topics == NUM_LOOP_TOPICS, "%d topics after a corrupt bundle, expected %d",
+          received.num_topics, NUM_LOOP_TOPICS);
+    CHECK(parser.stats.bad_checksums == 1, "%llu bad checksums, expected 1",
+          (unsigned long long)parser.stats.bad_checksums);
+
+    // a bundle with a good checksum whose topics run past its end is dropped whole
+    bundle.msg[BUNDLE_HEADER_LENGTH + 2] += 1;
+    packet_len = comms_bundle_generate_packet(&bundle);
+    frame_parser_init(&parser);
+    received.num_topics = 0;
+    parse_bytes(&parser, bundle.packet, packet_len, packet_len, &received);
+    CHECK(received.num_topics == 0, "%d topics from a malformed bundle, expected 0", received.num_topics);
+    CHECK(parser.stats.bad_bundles == 1, "%llu bad bundles, expected 1", (unsigned long long)parser.stats.bad_bundles);
+}
+
+static void print_overhead(void)
+{
+    loop_topics_t topics;
+    fill_loop_topics(&topics);
+    static comms_bundle_t bundle;
+    build_loop_bundle(&bundle, &topics, 0);
+    uint32_t bundle_len = comms_bundle_generate_packet(&bundle);
+
+    uint32_t separate_len = 0;
+    uint32_t data_len = 0;
+    for(int i = 0; i < NUM_LOOP_TOPICS; i++)
+    {
+        separate_len += loop_topic_len(i) + ROS_PKG_LENGTH;
+        data_len += loop_topic_len(i) - BUNDLE_UTIME_LENGTH;
+    }
+
+    printf("\nBytes per loop for the %d topics the Pico sends (%u bytes of data besides the utimes):\n",
+           NUM_LOOP_TOPICS, data_len);
+    printf("  separate frames: %4u bytes, %u of framing and utimes\n", separate_len, separate_len - data_len);
+    printf("  bundle:          %4u bytes, %u of framing and utimes\n", bundle_len, bundle_len - data_len);
+    printf("  at 115200 baud:  %.1f ms vs %.1f ms of a 40 ms loop\n", separate_len * 10.0 / 115.2,
+           bundle_len * 10.0 / 115.2);
+}
+
+int main(int argc, char** argv)
+{
+    int ser_dev = -1;
+    comms_init_protocol(&ser_dev);
+    register_loop_topics();
+    srand(1);
+
+    test_round_trip();
+    test_stream_in_pieces();
+    test_long_bundle();
+    test_topic_packets();
+    test_rejects_bad_topics();
+    test_corrupt_bundles();
+
+    if(num_failures == 0)
+    {
+        printf("All bundle tests passed.\n");
+    }
+    else
+    {
+        printf("%d checks failed.\n", num_failures);
+    }
+    print_overhead();
+    return num_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,378 @@
+/*
+* command_latency_benchmark measures how long a velocity command takes to show up in what the control board sends back,
+* through the same listener and protocol as lcm_serial_server but without LCM. Run it against the control board, or
+* against the firmware running on this computer with mbot_firmware/sim, whose pty is given with --port.
+*
+* Each trial stops the robot, waits for it to settle, then steps MBOT_VEL_CMD to --speed, alternating forwards and
+* backwards so the robot stays where it started. Two latencies are recorded from the write of the command:
+*   - pwm: until MBOT_MOTOR_PWM changes on any motor, the firmware's next control loop plus the trip back.
+*   - odometry: until MBOT_ODOMETRY has moved more than ODOMETRY_MOVED_M, which adds the wheels spinning up.
+* The throughput of the link over the whole run is printed with them.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <mbot_lcm_serial/lcm_config.h>
+#include <mbot_lcm_serial/comms_common.h>
+#include <mbot_lcm_serial/link_stats.h>
+#include <mbot_lcm_serial/listener.h>
+#include <mbot_lcm_serial/protocol.h>
+#include <mbot_lcm_serial/topic_data.h>
+
+#include <mbot_lcm_msgs_serial.h>
+
+#define MBOT_LCM_SERIAL_PORT "/dev/mbot_lcm"
+
+#define PWM_CHANGED 0.01f       // a change in duty cycle bigger than this is the firmware acting on the command
+#define ODOMETRY_MOVED_M 0.001  // 1 mm
+#define TRIAL_TIMEOUT_S 2.0     // a trial that sees neither change by then is counted as missed
+#define CONNECT_TIMEOUT_S 10.0  // the firmware takes a few seconds to boot
+#define LOOP_PERIOD_US 40000    // the firmware's main loop
+
+// the listener checks this to know when to stop
+bool listener_running = true;
+static volatile bool timesync_running = true;
+
+// the latest feedback from the control board, written by the listener thread
+typedef struct feedback{
+    pthread_mutex_t mutex;
+    serial_pose2D_t odometry;
+    double odometry_time;       // when it arrived, 0 until the first one
+    serial_mbot_motor_pwm_t pwm;
+    double pwm_time;
+}feedback_t;
+
+static feedback_t feedback = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+// what the link carried over the whole run, added up from the link stats at the end of each period
+typedef struct link_totals{
+    double seconds;
+    uint64_t rx_bytes;
+    uint64_t rx_frames;
+    uint64_t bad_checksums;
+    uint64_t tx_bytes;
+    uint64_t tx_packets;
+}link_totals_t;
+
+static link_totals_t link_totals = {0};
+
+static const link_stats_topic_t link_stats_topics[] = {
+    {MBOT_TIMESYNC, MBOT_TIMESYNC_CHANNEL, false},
+    {MBOT_TIMESYNC_RESPONSE, MBOT_TIMESYNC_RESPONSE_CHANNEL, false},
+    {MBOT_VEL_CMD, MBOT_VEL_CMD_CHANNEL, false},
+    {MBOT_ODOMETRY, MBOT_ODOMETRY_CHANNEL, false},
+    {MBOT_IMU, MBOT_IMU_CHANNEL, false},
+    {MBOT_ENCODERS, MBOT_ENCODERS_CHANNEL, false},
+    {MBOT_ANALOG_IN, MBOT_ANALOG_CHANNEL, false},
+    {MBOT_MOTOR_VEL, MBOT_MOTOR_VEL_CHANNEL, false},
+    {MBOT_MOTOR_PWM, MBOT_MOTOR_PWM_CHANNEL, false},
+    {MBOT_VEL, MBOT_VEL_CHANNEL, false}
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void odometry_cb(serial_pose2D_t* msg)
+{
+    pthread_mutex_lock(&feedback.mutex);
+    memcpy(&feedback.odometry, msg, sizeof(serial_pose2D_t));
+    feedback.odometry_time = now_seconds();
+    pthread_mutex_unlock(&feedback.mutex);
+}
+
+static void motor_pwm_cb(serial_mbot_motor_pwm_t* msg)
+{
+    pthread_mutex_lock(&feedback.mutex);
+    memcpy(&feedback.pwm, msg, sizeof(serial_mbot_motor_pwm_t));
+    feedback.pwm_time = now_seconds();
+    pthread_mutex_unlock(&feedback.mutex);
+}
+
+static void get_feedback(feedback_t* copy)
+{
+    pthread_mutex_lock(&feedback.mutex);
+    copy->odometry = feedback.odometry;
+    copy->odometry_time = feedback.odometry_time;
+    copy->pwm = feedback.pwm;
+    copy->pwm_time = feedback.pwm_time;
+    pthread_mutex_unlock(&feedback.mutex);
+}
+
+// called on the listener thread once a period
+static void add_link_stats(mbot_lcm_msgs_link_stats_t* msg, void* arg)
+{
+    link_totals.seconds += msg->period_s;
+    link_totals.rx_bytes += msg->rx_bytes;
+    link_totals.rx_frames += msg->rx_frames;
+    link_totals.bad_checksums += msg->bad_checksums;
+    link_totals.tx_bytes += msg->tx_bytes;
+    link_totals.tx_packets += msg->tx_packets;
+}
+
+// the same topics as lcm_serial_server, with callbacks only for the feedback that's timed
+static void register_topics(void)
+{
+    comms_register_topic(MBOT_TIMESYNC, sizeof(serial_timestamp_t), (Deserialize)&timestamp_t_deserialize, (Serialize)&timestamp_t_serialize, NULL);
+    comms_register_topic(MBOT_VEL_CMD, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize, NULL);
+
+    comms_register_topic(MBOT_TIMESYNC_RESPONSE, sizeof(serial_timesync_t), (Deserialize)&timesync_t_deserialize, (Serialize)&timesync_t_serialize, NULL);
+    comms_register_topic(MBOT_ODOMETRY, sizeof(serial_pose2D_t), (Deserialize)&pose2D_t_deserialize, (Serialize)&pose2D_t_serialize, (MsgCb)odometry_cb);
+    comms_register_topic(MBOT_IMU, sizeof(serial_mbot_imu_t), (Deserialize)&mbot_imu_t_deserialize, (Serialize)&mbot_imu_t_serialize, NULL);
+    comms_register_topic(MBOT_ENCODERS, sizeof(serial_mbot_encoders_t), (Deserialize)&mbot_encoders_t_deserialize, (Serialize)&mbot_encoders_t_serialize, NULL);
+    comms_register_topic(MBOT_VEL, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize, NULL);
+    comms_register_topic(MBOT_MOTOR_VEL, sizeof(serial_mbot_motor_vel_t), (Deserialize)&mbot_motor_vel_t_deserialize, (Serialize)&mbot_motor_vel_t_serialize, NULL);
+    comms_register_topic(MBOT_MOTOR_PWM, sizeof(serial_mbot_motor_pwm_t), (Deserialize)&mbot_motor_pwm_t_deserialize, (Serialize)&mbot_motor_pwm_t_serialize, (MsgCb)motor_pwm_cb);
+    comms_register_topic(MBOT_ANALOG_IN, sizeof(serial_mbot_analog_t), (Deserialize)&mbot_analog_t_deserialize, (Serialize)&mbot_analog_t_serialize, NULL);
+}
+
+// the control board only drives while it hears from us, like the timesync thread of lcm_serial_server
+static void* timesync_sender(void* arg)
+{
+    while(timesync_running)
+    {
+        serial_timestamp_t request = {0};
+        request.utime = link_stats_utime_now();
+        comms_write_topic(MBOT_TIMESYNC, &request);
+        usleep(TIMESYNC_PERIOD_US);
+    }
+    return NULL;
+}
+
+static int open_serial(const char* port)
+{
+    int ser_dev = open(port, O_RDWR | O_NOCTTY);
+    if(ser_dev < 0)
+    {
+        fprintf(stderr, "Error %i opening %s: %s\n", errno, port, strerror(errno));
+        return -1;
+    }
+    struct termios options;
+    tcgetattr(ser_dev, &options);
+    cfmakeraw(&options);
+    cfsetspeed(&options, B115200);
+    options.c_cc[VTIME] = 1;
+    options.c_cc[VMIN] = 0;
+    tcflush(ser_dev, TCIFLUSH);
+    if(tcsetattr(ser_dev, TCSANOW, &options) != 0)
+    {
+        fprintf(stderr, "Error %i configuring %s: %s\n", errno, port, strerror(errno));
+        close(ser_dev);
+        return -1;
+    }
+    return ser_dev;
+}
+
+static void send_vel_cmd(float vx)
+{
+    serial_twist2D_t cmd = {0};
+    cmd.utime = link_stats_utime_now();
+    cmd.vx = vx;
+    comms_write_topic(MBOT_VEL_CMD, &cmd);
+}
+
+static bool pwm_changed(const serial_mbot_motor_pwm_t* a, const serial_mbot_motor_pwm_t* b)
+{
+    for(int i = 0; i < 3; i++)
+    {
+        if(fabsf(a->pwm[i] - b->pwm[i]) > PWM_CHANGED)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static double distance(const serial_pose2D_t* a, const serial_pose2D_t* b)
+{
+    return hypot(a->x - b->x, a->y - b->y);
+}
+
+// steps the command and times the feedback, a negative latency is a miss
+static void run_trial(float vx, double* pwm_latency, double* odometry_latency)
+{
+    feedback_t before;
+    get_feedback(&before);
+
+    double start = now_seconds();
+    send_vel_cmd(vx);
+    *pwm_latency = -1.0;
+    *odometry_latency = -1.0;
+    while((*pwm_latency < 0.0 || *odometry_latency < 0.0) && now_seconds() - start < TRIAL_TIMEOUT_S)
+    {
+        feedback_t now;
+        get_feedback(&now);
+        if(*pwm_latency < 0.0 && now.pwm_time > start && pwm_changed(&now.pwm, &before.pwm))
+        {
+            *pwm_latency = now.pwm_time - start;
+        }
+        if(*odometry_latency < 0.0 && now.odometry_time > start
+            && distance(&now.odometry, &before.odometry) > ODOMETRY_MOVED_M)
+        {
+            *odometry_latency = now.odometry_time - start;
+        }
+        usleep(100);
+    }
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double diff = *(const double*)a - *(const double*)b;
+    return (diff > 0) - (diff < 0);
+}
+
+static void print_latencies(const char* name, double* latencies, int num_trials)
+{
+    int num = 0;
+    for(int i = 0; i < num_trials; i++)
+    {
+        if(latencies[i] >= 0.0)
+        {
+            latencies[num++] = latencies[i];
+        }
+    }
+    if(num == 0)
+    {
+        printf("%-10s %5d/%-5d\n", name, 0, num_trials);
+        return;
+    }
+    qsort(latencies, num, sizeof(double), compare_doubles);
+    double mean = 0.0;
+    for(int i = 0; i < num; i++)
+    {
+        mean += latencies[i] / num;
+    }
+    printf("%-10s %5d/%-5d %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, num, num_trials,
+           latencies[0] * 1e3, mean * 1e3, latencies[(int)(0.5 * (num - 1))] * 1e3,
+           latencies[(int)(0.9 * (num - 1))] * 1e3, latencies[(int)(0.99 * (num - 1))] * 1e3,
+           latencies[num - 1] * 1e3);
+}
+
+static void print_usage(const char* name)
+{
+    printf("Usage: %s [options]\n", name);
+    printf("  --port DEVICE   serial port of the control board or the firmware sim (default %s)\n", MBOT_LCM_SERIAL_PORT);
+    printf("  --trials N      velocity steps to time (default 20)\n");
+    printf("  --speed V       size of each step in m/s (default 0.25)\n");
+    printf("  --settle S      time the robot is stopped before each step (default 1)\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* port = MBOT_LCM_SERIAL_PORT;
+    int num_trials = 20;
+    float speed = 0.25f;
+    double settle_s = 1.0;
+
+    static struct option long_options[] = {
+        {"port", required_argument, NULL, 'p'},
+        {"trials", required_argument, NULL, 'n'},
+        {"speed", required_argument, NULL, 'v'},
+        {"settle", required_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 'p': port = optarg; break;
+            case 'n': num_trials = atoi(optarg); break;
+            case 'v': speed = atof(optarg); break;
+            case 's': settle_s = atof(optarg); break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if(num_trials <= 0)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    srand(1);
+    int ser_dev = open_serial(port);
+    if(ser_dev < 0)
+    {
+        return 1;
+    }
+    comms_init_protocol(&ser_dev);
+    comms_init_topic_data();
+    register_topics();
+    link_stats_t* link_stats = link_stats_create(link_stats_topics,
+                                                 sizeof(link_stats_topics) / sizeof(link_stats_topics[0]),
+                                                 &add_link_stats, NULL);
+
+    pthread_t listener_thread;
+    pthread_t timesync_thread;
+    pthread_create(&listener_thread, NULL, comms_listener_loop, link_stats);
+    pthread_create(&timesync_thread, NULL, timesync_sender, NULL);
+
+    // odometry only comes once the control board has heard a timesync
+    double connect_start = now_seconds();
+    feedback_t latest;
+    do
+    {
+        usleep(10000);
+        get_feedback(&latest);
+    } while(latest.odometry_time == 0.0 && now_seconds() - connect_start < CONNECT_TIMEOUT_S);
+    if(latest.odometry_time == 0.0)
+    {
+        fprintf(stderr, "No odometry from %s after %.0f s. Is the control board running?\n", port, CONNECT_TIMEOUT_S);
+        return 1;
+    }
+
+    printf("%d steps of %.2f m/s on %s\n\n", num_trials, speed, port);
+    double* pwm_latencies = (double*)calloc(num_trials, sizeof(double));
+    double* odometry_latencies = (double*)calloc(num_trials, sizeof(double));
+    for(int i = 0; i < num_trials; i++)
+    {
+        send_vel_cmd(0.0f);
+        // a random part of a loop, so the commands land all through the firmware's loop rather than at one point in it
+        usleep(settle_s * 1e6 + rand() % LOOP_PERIOD_US);
+        run_trial((i % 2 == 0) ? speed : -speed, &pwm_latencies[i], &odometry_latencies[i]);
+    }
+    send_vel_cmd(0.0f);
+    usleep(100000);
+
+    listener_running = false;
+    timesync_running = false;
+    pthread_join(listener_thread, NULL);
+    pthread_join(timesync_thread, NULL);
+
+    printf("%-10s %11s %10s %10s %10s %10s %10s %10s\n", "latency", "trials", "min(ms)", "mean(ms)", "p50(ms)",
+           "p90(ms)", "p99(ms)", "max(ms)");
+    print_latencies("pwm", pwm_latencies, num_trials);
+    print_latencies("odometry", odometry_latencies, num_trials);
+
+    if(link_totals.seconds > 0.0)
+    {
+        printf("\nlink over %.0f s: rx %.0f bytes/s, %.1f frames/s, %llu bad checksums, tx %.0f bytes/s, %.1f packets/s\n",
+               link_totals.seconds, link_totals.rx_bytes / link_totals.seconds,
+               link_totals.rx_frames / link_totals.seconds, (unsigned long long)link_totals.bad_checksums,
+               link_totals.tx_bytes / link_totals.seconds, link_totals.tx_packets / link_totals.seconds);
+    }
+
+    free(pwm_latencies);
+    free(odometry_latencies);
+    link_stats_destroy(link_stats);
+    close(ser_dev);
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <mbot_lcm_serial/frame_parser.h>
+#include <string.h>
+
+#define FRAME_PARSER_MASK (FRAME_PARSER_BUFFER_SIZE - 1)
+
+static inline uint8_t byte_at(const frame_parser_t* parser, uint32_t index)
+{
+    return parser->buffer[index & FRAME_PARSER_MASK];
+}
+
+// skip the sync flag at the tail after a bad header or checksum, so the search for the next frame starts after it
+static inline void skip_byte(frame_parser_t* parser)
+{
+    if(!parser->resyncing)
+    {
+        parser->stats.resyncs++;
+        parser->resyncing = true;
+    }
+    parser->tail++;
+    parser->stats.skipped_bytes++;
+}
+
+void frame_parser_init(frame_parser_t* parser)
+{
+    parser->head = 0;
+    parser->tail = 0;
+    parser->resyncing = false;
+    memset(&parser->stats, 0, sizeof(frame_parser_stats_t));
+}
+
+uint8_t* frame_parser_write_ptr(frame_parser_t* parser, size_t* space)
+{
+    uint32_t write_index = parser->head & FRAME_PARSER_MASK;
+    size_t free_space = FRAME_PARSER_BUFFER_SIZE - (parser->head - parser->tail);
+    size_t until_wrap = FRAME_PARSER_BUFFER_SIZE - write_index;
+    *space = (free_space < until_wrap) ? free_space : until_wrap;
+    return &parser->buffer[write_index];
+}
+
+void frame_parser_commit(frame_parser_t* parser, size_t len)
+{
+    parser->head += len;
+    parser->stats.bytes += len;
+}
+
+size_t frame_parser_push(frame_parser_t* parser, const uint8_t* data, size_t len)
+{
+    size_t pushed = 0;
+    while(pushed < len)
+    {
+        size_t space = 0;
+        uint8_t* dest = frame_parser_write_ptr(parser, &space);
+        if(space == 0)
+        {
+            break;
+        }
+        size_t to_copy = (len - pushed < space) ? len - pushed : space;
+        memcpy(dest, &data[pushed], to_copy);
+        frame_parser_commit(parser, to_copy);
+        pushed += to_copy;
+    }
+    return pushed;
+}
+
+int frame_parser_parse(frame_parser_t* parser, FrameCb frame_cb, void* arg)
+{
+    int num_frames = 0;
+
+    while(1)
+    {
+        // find the next sync flag
+        while(parser->tail != parser->head && byte_at(parser, parser->tail) != SYNC_FLAG)
+        {
+            skip_byte(parser);
+        }
+
+        uint32_t available = parser->head - parser->tail;
+        if(available < ROS_HEADER_LENGTH)
+        {
+            break;
+        }
+
+        uint8_t header[ROS_HEADER_LENGTH];
+        for(int i = 0; i < ROS_HEADER_LENGTH; i++)
+        {
+            header[i] = byte_at(parser, parser->tail + i);
+        }
+
+        // same checks as the rosserial protocol, see comms_common.h
+        uint16_t msg_len = ((uint16_t)header[3] << 8) + (uint16_t)header[2];
+        bool valid_header = (header[1] == VERSION_FLAG)
+            && (checksum(&header[2], 2) == header[4])
+            && (msg_len <= FRAME_PARSER_MAX_MSG_LEN);
+        if(!valid_header)
+        {
+            parser->stats.bad_headers++;
+            skip_byte(parser);
+            continue;
+        }
+
+        // wait for the rest of the frame
+        if(available < (uint32_t)msg_len + ROS_PKG_LENGTH)
+        {
+            break;
+        }
+
+        // the checksum covers the topic and the message, see encode_msg()
+        int sum = header[5] + header[6];
+        uint32_t msg_start = parser->tail + ROS_HEADER_LENGTH;
+        for(uint16_t i = 0; i < msg_len; i++)
+        {
+            parser->msg[i] = byte_at(parser, msg_start + i);
+            sum += parser->msg[i];
+        }
+        uint8_t msg_checksum = byte_at(parser, msg_start + msg_len);
+
+        if((uint8_t)(255 - (sum % 256)) != msg_checksum)
+        {
+            parser->stats.bad_checksums++;
+            uint16_t header_topic = ((uint16_t)header[6] << 8) + (uint16_t)header[5];
+            if(header_topic < MAX_TOPICS)
+            {
+                parser->stats.topic_bad_checksums[header_topic]++;
+            }
+            skip_byte(parser);
+            continue;
+        }
+
+        parser->tail += msg_len + ROS_PKG_LENGTH;
+        parser->resyncing = false;
+        parser->stats.frames++;
+        num_frames++;
+
+        uint16_t topic_id = ((uint16_t)header[6] << 8) + (uint16_t)header[5];
+        if(topic_id == BUNDLE_TOPIC)
+        {
+            if(frame_parser_unpack_bundle(parser->msg, msg_len, frame_cb, arg) < 0)
+            {
+                parser->stats.bad_bundles++;
+            }
+        }
+        else
+        {
+            frame_cb(topic_id, parser->msg, msg_len, arg);
+        }
+    }
+
+    return num_frames;
+}
+
+int frame_parser_unpack_bundle(uint8_t* bundle_msg, uint16_t bundle_len, FrameCb frame_cb, void* arg)
+{
+    if(bundle_len < BUNDLE_HEADER_LENGTH)
+    {
+        return -1;
+    }
+
+    // check the whole bundle before handling any of it
+    uint8_t num_topics = bundle_msg[BUNDLE_UTIME_LENGTH];
+    uint32_t offset = BUNDLE_HEADER_LENGTH;
+    for(int i = 0; i < num_topics; i++)
+    {
+        if(offset + BUNDLE_ENTRY_HEADER_LENGTH > bundle_len)
+        {
+            return -1;
+        }
+        offset += BUNDLE_ENTRY_HEADER_LENGTH + bundle_msg[offset + 2];
+    }
+    if(offset != bundle_len)
+    {
+        return -1;
+    }
+
+    // each topic gets the bundle's utime back in front of it
+    uint8_t msg[BUNDLE_UTIME_LENGTH + UINT8_MAX];
+    memcpy(msg, bundle_msg, BUNDLE_UTIME_LENGTH);
+
+    offset = BUNDLE_HEADER_LENGTH;
+    for(int i = 0; i < num_topics; i++)
+    {
+        uint16_t topic_id = ((uint16_t)bundle_msg[offset + 1] << 8) + (uint16_t)bundle_msg[offset];
+        uint8_t entry_len = bundle_msg[offset + 2];
+        memcpy(&msg[BUNDLE_UTIME_LENGTH], &bundle_msg[offset + BUNDLE_ENTRY_HEADER_LENGTH], entry_len);
+        frame_cb(topic_id, msg, BUNDLE_UTIME_LENGTH + entry_len, arg);
+        offset += BUNDLE_ENTRY_HEADER_LENGTH + entry_len;
+    }
+    return num_topics;
+}
@@ -12,21 +12,19 @@
 
 #include <mbot_lcm_serial/lcm_config.h>
 
-#include <mbot_lcm_msgs_pose2D_t.h>
-#include <mbot_lcm_msgs_mbot_imu_t.h>
-#include <mbot_lcm_msgs_mbot_encoders_t.h>
-#include <mbot_lcm_msgs_mbot_motor_vel_t.h>
-#include <mbot_lcm_msgs_mbot_motor_pwm_t.h>
-#include <mbot_lcm_msgs_mbot_analog_t.h>
-#include <mbot_lcm_msgs_twist2D_t.h>
-#include <mbot_lcm_msgs_timestamp_t.h>
+#include <mbot_lcm_msgs_timesync_t.h>
+#include <mbot_lcm_msgs_link_stats_t.h>
 
 #include <mbot_lcm_msgs_serial.h>
+#include <mbot_lcm_msgs_serial_lcm.h>
 
 #include <mbot_lcm_serial/protocol.h>
 #include <mbot_lcm_serial/topic_data.h>
 #include <mbot_lcm_serial/comms_common.h>
 #include <mbot_lcm_serial/listener.h>
+#include <mbot_lcm_serial/link_stats.h>
+
+#include <timesync/clock_estimator.h>
 
 #define MBOT_LCM_SERIAL_PORT "/dev/mbot_lcm"
 
@@ -34,81 +32,28 @@ struct termios options;
 
 bool running = true;
 bool listener_running = true;
+bool serial_connected = false;
 
 lcm_t* lcmInstance;
 
-static void mbot_vel_cmd_lcm_handler(const lcm_recv_buf_t* rbuf, const char* channel,
-                                   const mbot_lcm_msgs_twist2D_t* msg, void* _user)
-{
-    mbot_lcm_msgs_twist2D_t to_send;
-    to_send.utime = msg->utime;
-    to_send.vx = msg->vx;
-    to_send.vy = msg->vy;
-    to_send.wz = msg->wz;
-    comms_set_topic_data(MBOT_VEL_CMD, &to_send, sizeof(serial_twist2D_t));
-    comms_write_topic(MBOT_VEL_CMD, &to_send);
-}
-
-static void reset_encoders_lcm_handler(const lcm_recv_buf_t* rbuf, const char* channel,
-                                       const mbot_lcm_msgs_mbot_encoders_t* msg, void* _user)
-{
-    serial_mbot_encoders_t to_send = {0};
-    to_send.utime = msg->utime;
-    to_send.ticks[0] = msg->ticks[0];
-    to_send.ticks[1] = msg->ticks[1];
-    to_send.ticks[2] = msg->ticks[2];
-    to_send.delta_ticks[0] = msg->delta_ticks[0];
-    to_send.delta_ticks[1] = msg->delta_ticks[1];
-    to_send.delta_ticks[2] = msg->delta_ticks[2];
-    to_send.delta_time = msg->delta_time;
-    comms_set_topic_data(MBOT_ENCODERS_RESET, &to_send, sizeof(serial_mbot_encoders_t));
-    comms_write_topic(MBOT_ENCODERS_RESET, &to_send);
-}
-
-static void timestamp_lcm_handler(const lcm_recv_buf_t* rbuf, const char* channel,
-                                  const mbot_lcm_msgs_timestamp_t* msg, void* _user)
-{
-    //fprintf(stderr,"got timestamp!\r\n");
-    serial_timestamp_t to_send = {0};
-    to_send.utime = msg->utime;
-    comms_set_topic_data(MBOT_TIMESYNC, &to_send, sizeof(serial_timestamp_t));
-    comms_write_topic(MBOT_TIMESYNC, &to_send);
-    //fprintf(stderr,"sent timestamp!\r\n");
-}
-
-static void reset_odom_lcm_handler(const lcm_recv_buf_t* rbuf, const char* channel,
-                                   const mbot_lcm_msgs_pose2D_t* msg, void* _user)
-{
-    serial_pose2D_t to_send = {0};
-    to_send.theta = msg->theta;
-    to_send.x = msg->x;
-    to_send.y = msg->y;
-    comms_set_topic_data(MBOT_ODOMETRY_RESET, &to_send, sizeof(serial_pose2D_t));
-    comms_write_topic(MBOT_ODOMETRY_RESET, &to_send);
-}
+// Estimates the Pico's clock from round trips over serial. Only used by the serial thread.
+clock_estimator_t* pico_clock;
 
-static void mbot_motor_pwm_cmd_lcm_handler(const lcm_recv_buf_t* rbuf, const char* channel,
-                                   const mbot_lcm_msgs_mbot_motor_pwm_t* msg, void* _user)
+static int64_t utime_now(void)
 {
-    serial_mbot_motor_pwm_t to_send = {0};
-    to_send.utime = msg->utime;
-    to_send.pwm[0] = msg->pwm[0];
-    to_send.pwm[1] = msg->pwm[1];
-    to_send.pwm[2] = msg->pwm[2];
-    comms_set_topic_data(MBOT_MOTOR_PWM_CMD, &to_send, sizeof(serial_mbot_motor_pwm_t));
-    comms_write_topic(MBOT_MOTOR_PWM_CMD, &to_send);
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-static void mbot_motor_vel_cmd_lcm_handler(const lcm_recv_buf_t* rbuf, const char* channel,
-                                   const mbot_lcm_msgs_mbot_motor_vel_t* msg, void* _user)
+static void timesync_request_lcm_handler(const lcm_recv_buf_t* rbuf, const char* channel,
+                                         const mbot_lcm_msgs_timesync_t* msg, void* _user)
 {
-    serial_mbot_motor_vel_t to_send = {0};
-    to_send.utime = msg->utime;
-    to_send.velocity[0] = msg->velocity[0];
-    to_send.velocity[1] = msg->velocity[1];
-    to_send.velocity[2] = msg->velocity[2];
-    comms_set_topic_data(MBOT_MOTOR_VEL_CMD, &to_send, sizeof(serial_mbot_motor_vel_t));
-    comms_write_topic(MBOT_MOTOR_VEL_CMD, &to_send);
+    // Answer round trips from other processes, so they can estimate their offset from this computer's clock
+    mbot_lcm_msgs_timesync_t response = *msg;
+    response.receive_utime = rbuf->recv_utime;
+    response.transmit_utime = utime_now();
+    mbot_lcm_msgs_timesync_t_publish(lcmInstance, MBOT_TIMESYNC_RESPONSE_CHANNEL, &response);
 }
 
 void signal_callback_handler(int signum)
@@ -118,123 +63,151 @@ void signal_callback_handler(int signum)
     listener_running = false;
 }
 
-void serial_encoders_cb(serial_mbot_encoders_t* msg)
-{
-    mbot_lcm_msgs_mbot_encoders_t to_send = {0};
-    to_send.utime = msg->utime;
-    to_send.ticks[0] = msg->ticks[0];
-    to_send.ticks[1] = msg->ticks[1];
-    to_send.ticks[2] = msg->ticks[2];
-    to_send.delta_ticks[0] = msg->delta_ticks[0];
-    to_send.delta_ticks[1] = msg->delta_ticks[1];
-    to_send.delta_ticks[2] = msg->delta_ticks[2];
-    to_send.delta_time = msg->delta_time;
-    mbot_lcm_msgs_mbot_encoders_t_publish(lcmInstance, MBOT_ENCODERS_CHANNEL, &to_send);
-}
+void serial_timesync_cb(serial_timesync_t* data);
 
-void serial_motor_vel_cb(serial_mbot_motor_vel_t* data)
-{
-    mbot_lcm_msgs_mbot_motor_vel_t to_send = {0};
-    to_send.utime = data->utime;
-    to_send.velocity[0] = data->velocity[0];
-    to_send.velocity[1] = data->velocity[1];
-    to_send.velocity[2] = data->velocity[2];
-    mbot_lcm_msgs_mbot_motor_vel_t_publish(lcmInstance, MBOT_MOTOR_VEL_CHANNEL, &to_send);
-}
+// How a topic is bridged between serial and LCM
+typedef enum bridge_direction{
+    BRIDGE_NONE,        // only used on serial, by the code here
+    BRIDGE_TO_LCM,      // what arrives from the Pico is published on the channel
+    BRIDGE_TO_SERIAL    // what's published on the channel is sent to the Pico
+}bridge_direction_t;
 
-void serial_motor_pwm_cb(serial_mbot_motor_pwm_t* data)
+typedef struct bridged_topic{
+    uint16_t topic_id;
+    const char* channel;
+    const serial_lcm_type_t* type;
+    bridge_direction_t direction;
+    bool stamped;   // the Pico stamps it with our clock, see link_stats_topic_t
+    MsgCb cb_fn;    // handles it when it arrives, for topics that aren't simply published
+}bridged_topic_t;
+
+/*
+* Each topic that is sent to or from the Pico needs to be in this table, with its LCM channel and type. Messages are
+* translated between their serial bytes and LCM encoding by the functions generated in mbot_lcm_msgs_serial_lcm.h,
+* without a struct in between.
+*/
+static const bridged_topic_t bridged_topics[] = {
+    // Topics written to serial
+    {MBOT_TIMESYNC, MBOT_TIMESYNC_CHANNEL, &timestamp_t_serial_lcm, BRIDGE_NONE, false, NULL},
+    {MBOT_CLOCK_OFFSET, MBOT_CLOCK_OFFSET_CHANNEL, &clock_offset_t_serial_lcm, BRIDGE_NONE, false, NULL},
+    {MBOT_ODOMETRY_RESET, MBOT_ODOMETRY_RESET_CHANNEL, &pose2D_t_serial_lcm, BRIDGE_TO_SERIAL, false, NULL},
+    {MBOT_ENCODERS_RESET, MBOT_ENCODERS_RESET_CHANNEL, &mbot_encoders_t_serial_lcm, BRIDGE_TO_SERIAL, false, NULL},
+    {MBOT_MOTOR_PWM_CMD, MBOT_MOTOR_PWM_CMD_CHANNEL, &mbot_motor_pwm_t_serial_lcm, BRIDGE_TO_SERIAL, false, NULL},
+    {MBOT_MOTOR_VEL_CMD, MBOT_MOTOR_VEL_CMD_CHANNEL, &mbot_motor_vel_t_serial_lcm, BRIDGE_TO_SERIAL, false, NULL},
+    {MBOT_VEL_CMD, MBOT_VEL_CMD_CHANNEL, &twist2D_t_serial_lcm, BRIDGE_TO_SERIAL, false, NULL},
+    // Topics read from serial
+    {MBOT_TIMESYNC_RESPONSE, MBOT_TIMESYNC_RESPONSE_CHANNEL, &timesync_t_serial_lcm, BRIDGE_NONE, false,
+     (MsgCb)serial_timesync_cb},
+    {MBOT_ODOMETRY, MBOT_ODOMETRY_CHANNEL, &pose2D_t_serial_lcm, BRIDGE_TO_LCM, true, NULL},
+    {MBOT_IMU, MBOT_IMU_CHANNEL, &mbot_imu_t_serial_lcm, BRIDGE_TO_LCM, true, NULL},
+    {MBOT_ENCODERS, MBOT_ENCODERS_CHANNEL, &mbot_encoders_t_serial_lcm, BRIDGE_TO_LCM, true, NULL},
+    {MBOT_VEL, MBOT_VEL_CHANNEL, &twist2D_t_serial_lcm, BRIDGE_TO_LCM, true, NULL},
+    {MBOT_MOTOR_VEL, MBOT_MOTOR_VEL_CHANNEL, &mbot_motor_vel_t_serial_lcm, BRIDGE_TO_LCM, true, NULL},
+    {MBOT_MOTOR_PWM, MBOT_MOTOR_PWM_CHANNEL, &mbot_motor_pwm_t_serial_lcm, BRIDGE_TO_LCM, true, NULL},
+    {MBOT_ANALOG_IN, MBOT_ANALOG_CHANNEL, &mbot_analog_t_serial_lcm, BRIDGE_TO_LCM, true, NULL}
+};
+
+#define NUM_BRIDGED_TOPICS (int)(sizeof(bridged_topics) / sizeof(bridged_topics[0]))
+
+// Topics reported on MBOT_LINK_STATS_CHANNEL, filled in from bridged_topics
+static link_stats_topic_t link_stats_topics[NUM_BRIDGED_TOPICS];
+
+// LCM-encodes a message straight from its serial bytes and publishes it
+static void publish_serial(const char* channel, const serial_lcm_type_t* type, const void* serial_msg)
 {
-    mbot_lcm_msgs_mbot_motor_pwm_t to_send = {0};
-    to_send.utime = data->utime;
-    to_send.pwm[0] = data->pwm[0];
-    to_send.pwm[1] = data->pwm[1];
-    to_send.pwm[2] = data->pwm[2];
-    mbot_lcm_msgs_mbot_motor_pwm_t_publish(lcmInstance, MBOT_MOTOR_PWM_CHANNEL, &to_send);
+    uint8_t buf[MBOT_LCM_MSGS_SERIAL_LCM_MAX_SIZE];
+    int len = type->serial_to_lcm((const uint8_t*)serial_msg, buf, sizeof(buf));
+    if(len > 0)
+    {
+        lcm_publish(lcmInstance, channel, buf, len);
+    }
 }
 
-void serial_odometry_cb(serial_pose2D_t* data)
+// Called on the serial thread with each message of a BRIDGE_TO_LCM topic
+static void serial_to_lcm_cb(void* data, void* arg)
 {
-    mbot_lcm_msgs_pose2D_t to_send = {0};
-    to_send.utime = data->utime;
-    to_send.theta = data->theta;
-    to_send.x = data->x;
-    to_send.y = data->y;
-    mbot_lcm_msgs_pose2D_t_publish(lcmInstance, MBOT_ODOMETRY_CHANNEL, &to_send);
+    const bridged_topic_t* topic = (const bridged_topic_t*)arg;
+    publish_serial(topic->channel, topic->type, data);
 }
 
-void serial_mbot_vel_cb(serial_twist2D_t* data)
+// Called on the LCM thread with each message of a BRIDGE_TO_SERIAL topic
+static void lcm_to_serial_handler(const lcm_recv_buf_t* rbuf, const char* channel, void* user)
 {
-    mbot_lcm_msgs_twist2D_t to_send = {0};
-    to_send.utime = data->utime;
-    to_send.vx = data->vx;
-    to_send.vy = data->vy;
-    to_send.wz = data->wz;
-    mbot_lcm_msgs_twist2D_t_publish(lcmInstance, MBOT_VEL_CHANNEL, &to_send);
+    const bridged_topic_t* topic = (const bridged_topic_t*)user;
+    uint8_t msg[MBOT_LCM_MSGS_SERIAL_MAX_SIZE];
+    if(topic->type->lcm_to_serial((const uint8_t*)rbuf->data, rbuf->data_size, msg) < 0)
+    {
+        fprintf(stderr,"Dropped a message on %s that isn't of its type\r\n", channel);
+        return;
+    }
+    comms_set_topic_data(topic->topic_id, msg, topic->type->serial_size);
+    comms_write_topic(topic->topic_id, msg);
 }
 
-void serial_imu_cb(serial_mbot_imu_t* data)
+void serial_timesync_cb(serial_timesync_t* data)
 {
-    mbot_lcm_msgs_mbot_imu_t to_send = {0};
-    to_send.utime = data->utime;
-    to_send.accel[0] = data->accel[0];
-    to_send.accel[1] = data->accel[1];
-    to_send.accel[2] = data->accel[2];
-    to_send.gyro[0] = data->gyro[0];
-    to_send.gyro[1] = data->gyro[1];
-    to_send.gyro[2] = data->gyro[2];
-    to_send.mag[0] = data->mag[0];
-    to_send.mag[1] = data->mag[1];
-    to_send.mag[2] = data->mag[2];
-    to_send.angles_rpy[0] = data->angles_rpy[0];
-    to_send.angles_rpy[1] = data->angles_rpy[1];
-    to_send.angles_rpy[2] = data->angles_rpy[2];
-    to_send.angles_quat[0] = data->angles_quat[0];
-    to_send.angles_quat[1] = data->angles_quat[1];
-    to_send.angles_quat[2] = data->angles_quat[2];
-    to_send.angles_quat[3] = data->angles_quat[3];
-    to_send.temp = data->temp;
-    mbot_lcm_msgs_mbot_imu_t_publish(lcmInstance, MBOT_IMU_CHANNEL, &to_send);
+    int64_t response_utime = utime_now();
+    if(!clock_estimator_add_sample(pico_clock, data->request_utime, data->receive_utime, data->transmit_utime,
+                                   response_utime))
+    {
+        return;
+    }
+
+    // The estimate only changes much when a new fit point is finished, so it's sent then
+    if(pico_clock->samples_in_group != 0)
+    {
+        return;
+    }
+
+    serial_clock_offset_t to_pico = {0};
+    to_pico.utime = response_utime;
+    to_pico.reference_utime = pico_clock->ref_remote_utime;
+    to_pico.offset = pico_clock->offset;
+    to_pico.drift_ppm = pico_clock->drift * 1e6;
+    to_pico.error_us = pico_clock->error;
+    to_pico.min_rtt_us = pico_clock->min_rtt;
+    to_pico.num_samples = pico_clock->num_samples;
+    to_pico.num_resets = pico_clock->num_resets;
+    comms_write_topic(MBOT_CLOCK_OFFSET, &to_pico);
+    publish_serial(MBOT_CLOCK_OFFSET_CHANNEL, &clock_offset_t_serial_lcm, &to_pico);
 }
 
-void serial_analog_in_cb(serial_mbot_analog_t* data)
+// Called on the serial thread once a second
+void publish_link_stats(mbot_lcm_msgs_link_stats_t* msg, void* arg)
 {
-    mbot_lcm_msgs_mbot_analog_t to_send = {0};
-    to_send.utime = data->utime;
-    to_send.raw[0] = data->raw[0];
-    to_send.raw[1] = data->raw[1];
-    to_send.raw[2] = data->raw[2];
-    to_send.raw[3] = data->raw[3];
-    to_send.volts[0] = data->volts[0];
-    to_send.volts[1] = data->volts[1];
-    to_send.volts[2] = data->volts[2];
-    to_send.volts[3] = data->volts[3];
-    mbot_lcm_msgs_mbot_analog_t_publish(lcmInstance, MBOT_ANALOG_CHANNEL, &to_send);
+    msg->clock_error_us = pico_clock->error;
+    mbot_lcm_msgs_link_stats_t_publish(lcmInstance, MBOT_LINK_STATS_CHANNEL, msg);
 }
 
-/*
-* Each topic that gets sent to the pico needs to be registered here
-* It must know the LCM channel, size of the serial message, serialize & deserialize functions
-* and if it originates on the pico, there must be a callback function to copy and publish the LCM message
-*/
+// Registers every topic in bridged_topics with the serial protocol
 void register_topics()
-{   
-    // Topics written to serial
-    comms_register_topic(MBOT_TIMESYNC, sizeof(serial_timestamp_t), (Deserialize)&timestamp_t_deserialize, (Serialize)&timestamp_t_serialize, NULL);
-    comms_register_topic(MBOT_ODOMETRY_RESET,  sizeof(serial_pose2D_t), (Deserialize)&pose2D_t_deserialize, (Serialize)&pose2D_t_serialize, NULL);
-    comms_register_topic(MBOT_ENCODERS_RESET, sizeof(serial_mbot_encoders_t), (Deserialize)&mbot_encoders_t_deserialize, (Serialize)&mbot_encoders_t_serialize, NULL);
-    comms_register_topic(MBOT_MOTOR_PWM_CMD, sizeof(serial_mbot_motor_pwm_t), (Deserialize)&mbot_motor_pwm_t_deserialize, (Serialize)&mbot_motor_pwm_t_serialize, NULL);
-    comms_register_topic(MBOT_MOTOR_VEL_CMD, sizeof(serial_mbot_motor_vel_t), (Deserialize)&mbot_motor_vel_t_deserialize, (Serialize)&mbot_motor_vel_t_serialize, NULL);
-    comms_register_topic(MBOT_VEL_CMD, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize, NULL);
-
-    // Topics read from serial (require callback)
-    comms_register_topic(MBOT_ODOMETRY, sizeof(serial_pose2D_t), (Deserialize)&pose2D_t_deserialize, (Serialize)&pose2D_t_serialize, (MsgCb)serial_odometry_cb);
-    comms_register_topic(MBOT_IMU, sizeof(serial_mbot_imu_t), (Deserialize)&mbot_imu_t_deserialize, (Serialize)&mbot_imu_t_serialize, (MsgCb)serial_imu_cb);
-    comms_register_topic(MBOT_ENCODERS, sizeof(serial_mbot_encoders_t), (Deserialize)&mbot_encoders_t_deserialize, (Serialize)&mbot_encoders_t_serialize, (MsgCb)serial_encoders_cb);
-    comms_register_topic(MBOT_VEL, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize, (MsgCb)serial_mbot_vel_cb);
-    comms_register_topic(MBOT_MOTOR_VEL, sizeof(serial_mbot_motor_vel_t), (Deserialize)&mbot_motor_vel_t_deserialize, (Serialize)&mbot_motor_vel_t_serialize, (MsgCb)serial_motor_vel_cb);
-    comms_register_topic(MBOT_MOTOR_PWM, sizeof(serial_mbot_motor_pwm_t), (Deserialize)&mbot_motor_pwm_t_deserialize, (Serialize)&mbot_motor_pwm_t_serialize, (MsgCb)serial_motor_pwm_cb);
-    comms_register_topic(MBOT_ANALOG_IN, sizeof(serial_mbot_analog_t), (Deserialize)&mbot_analog_t_deserialize, (Serialize)&mbot_analog_t_serialize, (MsgCb)serial_analog_in_cb);
+{
+    for(int i = 0; i < NUM_BRIDGED_TOPICS; i++)
+    {
+        const bridged_topic_t* topic = &bridged_topics[i];
+        if(topic->direction == BRIDGE_TO_LCM)
+        {
+            comms_register_topic_arg(topic->topic_id, topic->type->serial_size, (Deserialize)topic->type->deserialize,
+                                     (Serialize)topic->type->serialize, &serial_to_lcm_cb, (void*)topic);
+        }
+        else
+        {
+            comms_register_topic(topic->topic_id, topic->type->serial_size, (Deserialize)topic->type->deserialize,
+                                 (Serialize)topic->type->serialize, topic->cb_fn);
+        }
+    }
+}
 
+void subscribe_lcm(lcm_t* lcm)
+{
+    mbot_lcm_msgs_timesync_t_subscribe(lcm, MBOT_TIMESYNC_REQUEST_CHANNEL, &timesync_request_lcm_handler, NULL);
+    for(int i = 0; i < NUM_BRIDGED_TOPICS; i++)
+    {
+        if(bridged_topics[i].direction == BRIDGE_TO_SERIAL)
+        {
+            lcm_subscribe(lcm, bridged_topics[i].channel, &lcm_to_serial_handler, (void*)&bridged_topics[i]);
+        }
+    }
 }
 
 void* handle_lcm(void* data)
@@ -248,29 +221,26 @@ void* handle_lcm(void* data)
 }
 
 void* timesync_sender(void* data){
-    lcm_t* lcmInstance = data;
-    mbot_lcm_msgs_timestamp_t timestamp;
+    serial_timestamp_t timestamp;
     while(running)
     {
-        struct timeval tv;
-        gettimeofday (&tv, NULL);
-        timestamp.utime = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
-        mbot_lcm_msgs_timestamp_t_publish(lcmInstance, MBOT_TIMESYNC_CHANNEL, &timestamp);
-        usleep(TIMESYNC_PERIOD_US);                                                                                                                       
+        // The request goes straight to the Pico, rather than through LCM, so it's stamped as close to the write as
+        // possible. The Pico replies with its own receive and transmit times.
+        if(serial_connected)
+        {
+            serial_timestamp_t request = {0};
+            request.utime = utime_now();
+            comms_write_topic(MBOT_TIMESYNC, &request);
+        }
+
+        // Still published for programs that only need a rough time
+        timestamp.utime = utime_now();
+        publish_serial(MBOT_TIMESYNC_CHANNEL, &timestamp_t_serial_lcm, &timestamp);
+        usleep(TIMESYNC_PERIOD_US);
     }
     return NULL;
 }
 
-void subscribe_lcm(lcm_t* lcm)
-{
-    mbot_lcm_msgs_timestamp_t_subscribe(lcm, MBOT_TIMESYNC_CHANNEL, &timestamp_lcm_handler, NULL);
-    mbot_lcm_msgs_pose2D_t_subscribe(lcm, MBOT_ODOMETRY_RESET_CHANNEL, &reset_odom_lcm_handler, NULL);
-    mbot_lcm_msgs_mbot_encoders_t_subscribe(lcm, MBOT_ENCODERS_RESET_CHANNEL, &reset_encoders_lcm_handler, NULL);
-    mbot_lcm_msgs_mbot_motor_pwm_t_subscribe(lcm, MBOT_MOTOR_PWM_CMD_CHANNEL, &mbot_motor_pwm_cmd_lcm_handler, NULL);
-    mbot_lcm_msgs_mbot_motor_vel_t_subscribe(lcm, MBOT_MOTOR_VEL_CMD_CHANNEL, &mbot_motor_vel_cmd_lcm_handler, NULL);
-    mbot_lcm_msgs_twist2D_t_subscribe(lcm, MBOT_VEL_CMD_CHANNEL, &mbot_vel_cmd_lcm_handler, NULL);
-}
-
 int configure_serial(int ser_dev){
     tcgetattr(ser_dev, &options);
     cfsetspeed(&options, B115200);
@@ -295,6 +265,27 @@ int configure_serial(int ser_dev){
 int main(int argc, char** argv)
 {
     fprintf(stderr,"Starting the serial/lcm shim...\r\n");
+
+    // --port DEVICE opens another serial port, e.g. the pty of the firmware sim
+    // --capture FILE saves every byte read from the Pico, to replay with serial_parser_benchmark
+    const char* serial_port = MBOT_LCM_SERIAL_PORT;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--port") == 0 && i + 1 < argc){
+            serial_port = argv[++i];
+        }
+        else if(strcmp(argv[i], "--capture") == 0 && i + 1 < argc){
+            listener_capture_file = fopen(argv[++i], "wb");
+            if(listener_capture_file == NULL){
+                fprintf(stderr,"Error %i opening capture file %s: %s\r\n", errno, argv[i], strerror(errno));
+                return -1;
+            }
+            fprintf(stderr,"Capturing serial traffic to %s\r\n", argv[i]);
+        }
+        else{
+            fprintf(stderr,"Usage: %s [--port DEVICE] [--capture FILE]\r\n", argv[0]);
+            return -1;
+        }
+    }
     // Register signal and signal handler
     signal(SIGINT, signal_callback_handler);
     signal(SIGTERM, signal_callback_handler);
@@ -306,6 +297,16 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    // Round trips come back at the Pico's loop rate of 25 Hz. The fit uses the best of every 10 over the last 24 s.
+    pico_clock = clock_estimator_create(10, 60);
+    for(int i = 0; i < NUM_BRIDGED_TOPICS; i++)
+    {
+        link_stats_topics[i].topic_id = bridged_topics[i].topic_id;
+        link_stats_topics[i].channel = bridged_topics[i].channel;
+        link_stats_topics[i].stamped = bridged_topics[i].stamped;
+    }
+    link_stats_t* link_stats = link_stats_create(link_stats_topics, NUM_BRIDGED_TOPICS, &publish_link_stats, NULL);
+
     fprintf(stderr,"Starting the timesync thread...\r\n");
     pthread_t timesyncThread;
     pthread_create(&timesyncThread, NULL, timesync_sender, lcmInstance);
@@ -319,7 +320,7 @@ int main(int argc, char** argv)
 
     while(running){
         while(ser_dev < 0 && running){
-            ser_dev = open(MBOT_LCM_SERIAL_PORT, O_RDWR);
+            ser_dev = open(serial_port, O_RDWR);
             if(ser_dev < 0){
                 fprintf(stderr,"Error %i from open: %s. Is the MBot Control Board plugged in?\n", errno, strerror(errno));
                 sleep(1);
@@ -338,14 +339,17 @@ int main(int argc, char** argv)
         comms_init_protocol(&ser_dev);
         comms_init_topic_data();
         register_topics();
+        clock_estimator_reset(pico_clock);
+        serial_connected = true;
 
         fprintf(stderr,"Starting the serial thread...\r\n");
-        pthread_create(&serialThread, NULL, comms_listener_loop, NULL);
+        pthread_create(&serialThread, NULL, comms_listener_loop, link_stats);
         fprintf(stderr,"Starting the lcm handle thread...\r\n");
         pthread_create(&lcmThread, NULL, handle_lcm, lcmInstance);
 
         fprintf(stderr,"running!\r\n");
         pthread_join(serialThread, NULL);
+        serial_connected = false;
         fprintf(stderr,"stopped the lcm thread...\r\n");
         pthread_join(lcmThread, NULL);
 
@@ -357,6 +361,11 @@ int main(int argc, char** argv)
 
     
     pthread_join(timesyncThread, NULL);
+    clock_estimator_destroy(pico_clock);
+    link_stats_destroy(link_stats);
+    if(listener_capture_file != NULL){
+        fclose(listener_capture_file);
+    }
     fprintf(stderr,"exiting!\r\n");
     return 0;
 }
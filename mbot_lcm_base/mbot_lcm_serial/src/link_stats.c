@@ -0,0 +1,223 @@
+#include <mbot_lcm_serial/link_stats.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+int64_t link_stats_utime_now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+link_stats_t* link_stats_create(const link_stats_topic_t* topics, int num_topics, LinkStatsCb publish_cb,
+                                void* publish_arg)
+{
+    if(num_topics < 0)
+    {
+        return NULL;
+    }
+    for(int i = 0; i < num_topics; i++)
+    {
+        if(topics[i].topic_id >= MAX_TOPICS)
+        {
+            return NULL;
+        }
+    }
+
+    link_stats_t* stats = (link_stats_t*)calloc(1, sizeof(link_stats_t));
+    if(stats == NULL)
+    {
+        return NULL;
+    }
+    stats->topic_msgs = (mbot_lcm_msgs_link_topic_stats_t*)calloc((size_t)num_topics,
+                                                                  sizeof(mbot_lcm_msgs_link_topic_stats_t));
+    if(stats->topic_msgs == NULL && num_topics > 0)
+    {
+        free(stats);
+        return NULL;
+    }
+
+    stats->topics = topics;
+    stats->num_topics = num_topics;
+    for(int i = 0; i < num_topics; i++)
+    {
+        stats->stamped[topics[i].topic_id] = topics[i].stamped;
+    }
+    stats->publish_cb = publish_cb;
+    stats->publish_arg = publish_arg;
+    return stats;
+}
+
+void link_stats_destroy(link_stats_t* stats)
+{
+    free(stats->topic_msgs);
+    free(stats);
+}
+
+// starts a new period, keeping when each topic was last received. The protocol's totals are kept by the caller.
+static void link_stats_start_period(link_stats_t* stats, const frame_parser_stats_t* parser_stats, int64_t now)
+{
+    for(int i = 0; i < stats->num_topics; i++)
+    {
+        uint16_t topic_id = stats->topics[i].topic_id;
+        int64_t last_utime = stats->rx[topic_id].last_utime;
+        memset(&stats->rx[topic_id], 0, sizeof(link_rx_stats_t));
+        stats->rx[topic_id].last_utime = last_utime;
+    }
+    memcpy(&stats->parser_at_start, parser_stats, sizeof(frame_parser_stats_t));
+    stats->period_start_utime = now;
+    stats->num_queue_samples = 0;
+    stats->queue_sum = 0.0;
+    stats->queue_max = 0;
+}
+
+void link_stats_start(link_stats_t* stats, const frame_parser_stats_t* parser_stats, int64_t now)
+{
+    for(int i = 0; i < stats->num_topics; i++)
+    {
+        uint16_t topic_id = stats->topics[i].topic_id;
+        stats->rx[topic_id].last_utime = 0;
+        // topics that aren't registered have written nothing
+        if(comms_get_topic_tx_stats(topic_id, &stats->tx_at_start[topic_id]) == 0)
+        {
+            memset(&stats->tx_at_start[topic_id], 0, sizeof(comms_tx_stats_t));
+        }
+    }
+    link_stats_start_period(stats, parser_stats, now);
+}
+
+void link_stats_record_rx(link_stats_t* stats, uint16_t topic_id, const uint8_t* msg, uint16_t msg_len,
+                          int64_t rx_utime)
+{
+    if(topic_id >= MAX_TOPICS)
+    {
+        return;
+    }
+    link_rx_stats_t* rx = &stats->rx[topic_id];
+    rx->packets++;
+    rx->bytes += msg_len;
+
+    if(rx->last_utime != 0)
+    {
+        int64_t interval = rx_utime - rx->last_utime;
+        rx->num_intervals++;
+        rx->interval_sum += interval;
+        rx->interval_sq_sum += (double)interval * interval;
+        rx->interval_max = (interval > rx->interval_max) ? interval : rx->interval_max;
+    }
+    rx->last_utime = rx_utime;
+
+    if(stats->stamped[topic_id] && msg_len >= sizeof(int64_t))
+    {
+        int64_t msg_utime;
+        memcpy(&msg_utime, msg, sizeof(int64_t));
+        int64_t latency = rx_utime - msg_utime;
+        if(rx->num_latencies == 0 || latency < rx->latency_min)
+        {
+            rx->latency_min = latency;
+        }
+        if(rx->num_latencies == 0 || latency > rx->latency_max)
+        {
+            rx->latency_max = latency;
+        }
+        rx->num_latencies++;
+        rx->latency_sum += latency;
+    }
+}
+
+static void link_stats_fill_topic(link_stats_t* stats, const link_stats_topic_t* topic,
+                                  const frame_parser_stats_t* parser_stats, const comms_tx_stats_t* tx,
+                                  float period_s, mbot_lcm_msgs_link_topic_stats_t* topic_msg)
+{
+    const link_rx_stats_t* rx = &stats->rx[topic->topic_id];
+    const comms_tx_stats_t* tx_at_start = &stats->tx_at_start[topic->topic_id];
+
+    memset(topic_msg, 0, sizeof(mbot_lcm_msgs_link_topic_stats_t));
+    topic_msg->topic_id = topic->topic_id;
+    topic_msg->channel = (char*)topic->channel;
+    topic_msg->rx_packets = rx->packets;
+    topic_msg->rx_bytes = rx->bytes;
+    topic_msg->bad_checksums = parser_stats->topic_bad_checksums[topic->topic_id]
+                               - stats->parser_at_start.topic_bad_checksums[topic->topic_id];
+    topic_msg->tx_packets = tx->packets - tx_at_start->packets;
+    topic_msg->tx_bytes = tx->bytes - tx_at_start->bytes;
+    topic_msg->rx_rate_hz = (period_s > 0.0f) ? rx->packets / period_s : 0.0f;
+
+    if(rx->num_intervals > 0)
+    {
+        double mean = rx->interval_sum / rx->num_intervals;
+        double variance = rx->interval_sq_sum / rx->num_intervals - mean * mean;
+        topic_msg->interval_mean_us = mean;
+        topic_msg->interval_jitter_us = (variance > 0.0) ? sqrt(variance) : 0.0;
+        topic_msg->interval_max_us = rx->interval_max;
+    }
+
+    topic_msg->num_latencies = rx->num_latencies;
+    if(rx->num_latencies > 0)
+    {
+        topic_msg->latency_mean_us = rx->latency_sum / rx->num_latencies;
+        topic_msg->latency_min_us = rx->latency_min;
+        topic_msg->latency_max_us = rx->latency_max;
+    }
+}
+
+void link_stats_update(link_stats_t* stats, const frame_parser_stats_t* parser_stats, int32_t tx_queue_bytes,
+                       int64_t now)
+{
+    if(tx_queue_bytes >= 0)
+    {
+        stats->num_queue_samples++;
+        stats->queue_sum += tx_queue_bytes;
+        stats->queue_max = (tx_queue_bytes > stats->queue_max) ? tx_queue_bytes : stats->queue_max;
+    }
+
+    if(now - stats->period_start_utime < LINK_STATS_PERIOD_US)
+    {
+        return;
+    }
+
+    const frame_parser_stats_t* at_start = &stats->parser_at_start;
+    mbot_lcm_msgs_link_stats_t msg = {0};
+    msg.utime = now;
+    msg.period_s = (now - stats->period_start_utime) * 1e-6f;
+    msg.rx_bytes = parser_stats->bytes - at_start->bytes;
+    msg.rx_frames = parser_stats->frames - at_start->frames;
+    msg.bad_headers = parser_stats->bad_headers - at_start->bad_headers;
+    msg.bad_checksums = parser_stats->bad_checksums - at_start->bad_checksums;
+    msg.bad_bundles = parser_stats->bad_bundles - at_start->bad_bundles;
+    msg.resyncs = parser_stats->resyncs - at_start->resyncs;
+    msg.skipped_bytes = parser_stats->skipped_bytes - at_start->skipped_bytes;
+    if(stats->num_queue_samples > 0)
+    {
+        msg.tx_queue_mean_bytes = stats->queue_sum / stats->num_queue_samples;
+    }
+    msg.tx_queue_max_bytes = stats->queue_max;
+
+    for(int i = 0; i < stats->num_topics; i++)
+    {
+        const link_stats_topic_t* topic = &stats->topics[i];
+        comms_tx_stats_t* tx_at_start = &stats->tx_at_start[topic->topic_id];
+        // the totals are read once, so they end this period and start the next without missing a write
+        comms_tx_stats_t tx;
+        if(comms_get_topic_tx_stats(topic->topic_id, &tx) == 0)
+        {
+            memcpy(&tx, tx_at_start, sizeof(comms_tx_stats_t));
+        }
+
+        link_stats_fill_topic(stats, topic, parser_stats, &tx, msg.period_s, &stats->topic_msgs[i]);
+        msg.tx_packets += stats->topic_msgs[i].tx_packets;
+        msg.tx_bytes += stats->topic_msgs[i].tx_bytes;
+        msg.tx_errors += tx.errors - tx_at_start->errors;
+        memcpy(tx_at_start, &tx, sizeof(comms_tx_stats_t));
+    }
+    msg.num_topics = stats->num_topics;
+    msg.topics = stats->topic_msgs;
+
+    if(stats->publish_cb != NULL)
+    {
+        stats->publish_cb(&msg, stats->publish_arg);
+    }
+    link_stats_start_period(stats, parser_stats, now);
+}
@@ -0,0 +1,345 @@
+/*
+* protocol_benchmark measures how many packets per second the protocol layer can frame and dispatch, comparing the old
+* radix-tree registry with the table indexed by topic id.
+*
+* Two paths are timed for the topics the Pico and the RPi send each other:
+*   - encode: serializing a topic and framing it into a packet, everything comms_write_topic() does except the write.
+*       The old path looked the topic up in the tree, serialized onto the stack, calloc()ed the packet, copied the
+*       message into it and again into a VLA for the checksum, then freed the packet.
+*   - decode: what the listener does with a frame once the parser has found it, looking up the topic's serializers
+*       and storing its data with comms_set_topic_data().
+*
+* The firmware's comms/src/protocol.c and topic_data.c are the same code as here apart from sending and locking, so
+* the difference carries over to the Pico, where the tree walk costs relatively more without a cache.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <mbot_lcm_serial/lcm_config.h>
+#include <mbot_lcm_serial/comms_common.h>
+#include <mbot_lcm_serial/protocol.h>
+#include <mbot_lcm_serial/topic_data.h>
+
+#include <mbot_lcm_msgs_serial.h>
+
+#define NUM_TOPICS 10
+#define DEFAULT_PACKETS 2000000
+
+typedef struct benchmark_topic{
+    uint16_t topic_id;
+    uint32_t len;
+    Deserialize deserialize_fn;
+    Serialize serialize_fn;
+}benchmark_topic_t;
+
+// what the Pico sends every loop, and the commands the RPi sends it
+static const benchmark_topic_t topics[NUM_TOPICS] = {
+    {MBOT_TIMESYNC_RESPONSE, sizeof(serial_timesync_t), (Deserialize)&timesync_t_deserialize, (Serialize)&timesync_t_serialize},
+    {MBOT_ENCODERS, sizeof(serial_mbot_encoders_t), (Deserialize)&mbot_encoders_t_deserialize, (Serialize)&mbot_encoders_t_serialize},
+    {MBOT_ODOMETRY, sizeof(serial_pose2D_t), (Deserialize)&pose2D_t_deserialize, (Serialize)&pose2D_t_serialize},
+    {MBOT_IMU, sizeof(serial_mbot_imu_t), (Deserialize)&mbot_imu_t_deserialize, (Serialize)&mbot_imu_t_serialize},
+    {MBOT_VEL, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize},
+    {MBOT_MOTOR_VEL, sizeof(serial_mbot_motor_vel_t), (Deserialize)&mbot_motor_vel_t_deserialize, (Serialize)&mbot_motor_vel_t_serialize},
+    {MBOT_ANALOG_IN, sizeof(serial_mbot_analog_t), (Deserialize)&mbot_analog_t_deserialize, (Serialize)&mbot_analog_t_serialize},
+    {MBOT_MOTOR_PWM, sizeof(serial_mbot_motor_pwm_t), (Deserialize)&mbot_motor_pwm_t_deserialize, (Serialize)&mbot_motor_pwm_t_serialize},
+    {MBOT_VEL_CMD, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize},
+    {MBOT_MOTOR_PWM_CMD, sizeof(serial_mbot_motor_pwm_t), (Deserialize)&mbot_motor_pwm_t_deserialize, (Serialize)&mbot_motor_pwm_t_serialize}
+};
+
+// big enough for any of the topics
+static uint8_t topic_structs[NUM_TOPICS][256];
+
+// keeps the compiler from dropping work whose result isn't otherwise used
+static volatile uint32_t sink;
+
+
+/*
+* The old registry, topic data and encoder, as they were before the tables, so there is something to compare against.
+*/
+#define LEGACY_MAX_RADIX 16
+
+// both trees had the same shape, a registry value or topic data at each leaf
+typedef struct legacy_node{
+    struct legacy_node* left;
+    struct legacy_node* right;
+    void* value;
+}legacy_node_t;
+
+static legacy_node_t* legacy_registry_root;
+static legacy_node_t* legacy_data_root;
+
+// walks the 16 levels of the tree, making the nodes on the way if make_nodes is set
+static legacy_node_t* legacy_find_node(legacy_node_t* root, uint16_t topic_id, bool make_nodes)
+{
+    legacy_node_t* cur_node = root;
+    for(int cur_radix = 0; cur_radix < LEGACY_MAX_RADIX; cur_radix++)
+    {
+        legacy_node_t** next = ((1 << cur_radix) & topic_id) ? &cur_node->right : &cur_node->left;
+        if(*next == NULL)
+        {
+            if(!make_nodes)
+            {
+                return NULL;
+            }
+            *next = (legacy_node_t*)calloc(1, sizeof(legacy_node_t));
+        }
+        cur_node = *next;
+    }
+    return cur_node;
+}
+
+static void legacy_register_topic(const benchmark_topic_t* topic)
+{
+    legacy_node_t* node = legacy_find_node(legacy_registry_root, topic->topic_id, true);
+    topic_registry_val_t* value = (topic_registry_val_t*)calloc(1, sizeof(topic_registry_val_t));
+    value->topic_id = topic->topic_id;
+    value->topic_data_len = topic->len;
+    value->deserialize_fn = topic->deserialize_fn;
+    value->serialize_fn = topic->serialize_fn;
+    node->value = value;
+}
+
+static int legacy_get_topic_serializers(uint16_t topic_id, topic_registry_val_t* topic_reg_val)
+{
+    legacy_node_t* node = legacy_find_node(legacy_registry_root, topic_id, false);
+    if(node == NULL || node->value == NULL)
+    {
+        return 0;
+    }
+    memcpy(topic_reg_val, node->value, sizeof(topic_registry_val_t));
+    return 1;
+}
+
+static void legacy_set_topic_data(uint16_t topic_id, void* msg_struct, uint16_t message_len)
+{
+    legacy_node_t* node = legacy_find_node(legacy_data_root, topic_id, true);
+    if(node->value == NULL)
+    {
+        topic_data_val_t* value = (topic_data_val_t*)calloc(1, sizeof(topic_data_val_t));
+        value->topic_id = topic_id;
+        value->topic_len = message_len;
+        value->topic_data = calloc(message_len, sizeof(uint8_t));
+        node->value = value;
+    }
+    memcpy(((topic_data_val_t*)node->value)->topic_data, msg_struct, message_len);
+}
+
+static int legacy_encode_msg(uint8_t* MSG, int msg_len, uint16_t TOPIC, uint8_t* ROSPKT, int rospkt_len)
+{
+    if(msg_len + ROS_PKG_LENGTH != rospkt_len)
+    {
+        return 0;
+    }
+    ROSPKT[0] = SYNC_FLAG;
+    ROSPKT[1] = VERSION_FLAG;
+    ROSPKT[2] = (uint8_t)(msg_len & 0xff);
+    ROSPKT[3] = (uint8_t)(msg_len >> 8);
+    uint8_t cs1_addends[2] = {ROSPKT[2], ROSPKT[3]};
+    ROSPKT[4] = checksum(cs1_addends, 2);
+    ROSPKT[5] = (uint8_t)(TOPIC & 0xff);
+    ROSPKT[6] = (uint8_t)(TOPIC >> 8);
+    for(int i = 0; i < msg_len; i++)
+    {
+        ROSPKT[i + 7] = MSG[i];
+    }
+    uint8_t cs2_addends[msg_len + 2];
+    cs2_addends[0] = ROSPKT[5];
+    cs2_addends[1] = ROSPKT[6];
+    for(int i = 0; i < msg_len; i++)
+    {
+        cs2_addends[i + 2] = MSG[i];
+    }
+    ROSPKT[rospkt_len - 1] = checksum(cs2_addends, msg_len + 2);
+    return 1;
+}
+
+static int legacy_generate_packet(uint16_t topic_id, void* topic_struct, uint8_t** packet_out, uint32_t* packet_len_out)
+{
+    topic_registry_val_t topic_val;
+    if(legacy_get_topic_serializers(topic_id, &topic_val) == 0)
+    {
+        return 0;
+    }
+    uint32_t msg_data_len = topic_val.topic_data_len;
+    uint8_t msg_data[msg_data_len];
+    topic_val.serialize_fn(topic_struct, msg_data);
+    *packet_len_out = ROS_PKG_LENGTH + msg_data_len;
+    *packet_out = (uint8_t*)calloc(*packet_len_out, sizeof(uint8_t));
+    int encode_result = legacy_encode_msg(msg_data, msg_data_len, topic_id, *packet_out, *packet_len_out);
+    if(encode_result == 0)
+    {
+        free(*packet_out);
+    }
+    return encode_result;
+}
+
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double run_legacy_encode(long num_packets)
+{
+    double start = now_seconds();
+    for(long i = 0; i < num_packets; i++)
+    {
+        int index = i % NUM_TOPICS;
+        uint8_t* packet = NULL;
+        uint32_t packet_len = 0;
+        legacy_generate_packet(topics[index].topic_id, topic_structs[index], &packet, &packet_len);
+        sink += packet[packet_len - 1];
+        free(packet);
+    }
+    return now_seconds() - start;
+}
+
+static double run_table_encode(long num_packets)
+{
+    double start = now_seconds();
+    for(long i = 0; i < num_packets; i++)
+    {
+        int index = i % NUM_TOPICS;
+        uint8_t* packet = NULL;
+        uint32_t packet_len = 0;
+        comms_generate_packet(topics[index].topic_id, topic_structs[index], &packet, &packet_len);
+        sink += packet[packet_len - 1];
+    }
+    return now_seconds() - start;
+}
+
+static double run_legacy_decode(long num_packets)
+{
+    double start = now_seconds();
+    for(long i = 0; i < num_packets; i++)
+    {
+        int index = i % NUM_TOPICS;
+        topic_registry_val_t topic_val;
+        if(legacy_get_topic_serializers(topics[index].topic_id, &topic_val))
+        {
+            legacy_set_topic_data(topics[index].topic_id, topic_structs[index], topic_val.topic_data_len);
+            sink += topic_val.topic_data_len;
+        }
+    }
+    return now_seconds() - start;
+}
+
+static double run_table_decode(long num_packets)
+{
+    double start = now_seconds();
+    for(long i = 0; i < num_packets; i++)
+    {
+        int index = i % NUM_TOPICS;
+        topic_registry_val_t topic_val;
+        if(comms_get_topic_serializers(topics[index].topic_id, &topic_val))
+        {
+            comms_set_topic_data(topics[index].topic_id, topic_structs[index], topic_val.topic_data_len);
+            sink += topic_val.topic_data_len;
+        }
+    }
+    return now_seconds() - start;
+}
+
+static void print_result(const char* name, long num_packets, double legacy_seconds, double table_seconds)
+{
+    printf("  %-8s %12.0f %12.0f %10.1f %10.1f %8.1fx\n", name, num_packets / legacy_seconds,
+           num_packets / table_seconds, 1e9 * legacy_seconds / num_packets, 1e9 * table_seconds / num_packets,
+           legacy_seconds / table_seconds);
+}
+
+static void print_usage(const char* name)
+{
+    printf("Usage: %s [--packets N]\n", name);
+    printf("  --packets N   packets per run, default %d\n", DEFAULT_PACKETS);
+}
+
+int main(int argc, char** argv)
+{
+    long num_packets = DEFAULT_PACKETS;
+
+    static struct option long_options[] = {
+        {"packets", required_argument, 0, 'n'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int opt;
+    while((opt = getopt_long(argc, argv, "n:h", long_options, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 'n':
+                num_packets = atol(optarg);
+                break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(num_packets <= 0)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int ser_dev = -1;
+    comms_init_protocol(&ser_dev);
+    comms_init_topic_data();
+    legacy_registry_root = (legacy_node_t*)calloc(1, sizeof(legacy_node_t));
+    legacy_data_root = (legacy_node_t*)calloc(1, sizeof(legacy_node_t));
+    for(int i = 0; i < NUM_TOPICS; i++)
+    {
+        comms_register_topic(topics[i].topic_id, topics[i].len, topics[i].deserialize_fn, topics[i].serialize_fn, NULL);
+        legacy_register_topic(&topics[i]);
+        for(size_t j = 0; j < sizeof(topic_structs[i]); j++)
+        {
+            topic_structs[i][j] = (uint8_t)rand();
+        }
+    }
+
+    // both encoders have to agree before their speed means anything
+    for(int i = 0; i < NUM_TOPICS; i++)
+    {
+        uint8_t* legacy_packet = NULL;
+        uint8_t* table_packet = NULL;
+        uint32_t legacy_len = 0;
+        uint32_t table_len = 0;
+        legacy_generate_packet(topics[i].topic_id, topic_structs[i], &legacy_packet, &legacy_len);
+        comms_generate_packet(topics[i].topic_id, topic_structs[i], &table_packet, &table_len);
+        if(legacy_len != table_len || memcmp(legacy_packet, table_packet, table_len) != 0)
+        {
+            printf("Packets for topic %d differ between the old and new encoders.\n", topics[i].topic_id);
+            return 1;
+        }
+        free(legacy_packet);
+    }
+
+    // warm up the caches and the allocator, then time each path
+    run_legacy_encode(num_packets / 10);
+    run_table_encode(num_packets / 10);
+    double legacy_encode = run_legacy_encode(num_packets);
+    double table_encode = run_table_encode(num_packets);
+    run_legacy_decode(num_packets / 10);
+    run_table_decode(num_packets / 10);
+    double legacy_decode = run_legacy_decode(num_packets);
+    double table_decode = run_table_decode(num_packets);
+
+    uint32_t min_len = topics[0].len;
+    uint32_t max_len = topics[0].len;
+    for(int i = 1; i < NUM_TOPICS; i++)
+    {
+        min_len = (topics[i].len < min_len) ? topics[i].len : min_len;
+        max_len = (topics[i].len > max_len) ? topics[i].len : max_len;
+    }
+    printf("%ld packets over %d topics of %u to %u bytes\n", num_packets, NUM_TOPICS, min_len, max_len);
+    printf("  %-8s %12s %12s %10s %10s %9s\n", "path", "tree pkt/s", "table pkt/s", "tree ns", "table ns", "speedup");
+    print_result("encode", num_packets, legacy_encode, table_encode);
+    print_result("decode", num_packets, legacy_decode, table_decode);
+    return 0;
+}
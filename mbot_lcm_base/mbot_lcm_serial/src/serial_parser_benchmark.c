@@ -0,0 +1,718 @@
+/*
+* serial_parser_benchmark replays serial traffic from the Pico through a pseudo-terminal and measures how fast and how
+* soon frames come out of the listener, comparing the old byte-at-a-time reader with the buffered one.
+*
+* The traffic is either a capture recorded with `lcm_serial_server --capture FILE`, or a synthetic stream with the same
+* topics and sizes as the Pico sends every 40 ms, bundled like the firmware does or with --separate, a frame per topic.
+* --noise corrupts a fraction of the frames, to check that frames after a corrupt one are still found.
+*
+* Each reader runs twice:
+*   - throughput: the whole stream is written as fast as the pty takes it.
+*   - latency: the frames are written one at a time, a burst per Pico loop, and the time from the write to the frame
+*       coming out of the reader is recorded. The second half of each frame is written a little after the first, as
+*       happens when a frame spans two USB packets.
+*/
+#define _GNU_SOURCE  // posix_openpt() and friends
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+
+#include <mbot_lcm_serial/lcm_config.h>
+#include <mbot_lcm_serial/comms_common.h>
+#include <mbot_lcm_serial/frame_parser.h>
+#include <mbot_lcm_serial/listener.h>
+#include <mbot_lcm_serial/protocol.h>
+
+#include <mbot_lcm_msgs_serial.h>
+
+// the listener checks this to know when to stop
+bool listener_running = true;
+
+#define LOOP_PERIOD_US 40000    // the Pico's main loop
+#define TOPICS_PER_LOOP 8    // the timesync reply and the 7 sensor topics
+
+typedef struct expected_frame{
+    uint16_t topic_id;
+    uint16_t msg_len;
+    uint32_t data_offset;   // where a copy of the message is in expected_data
+    uint32_t end_offset;    // where the frame carrying it ends in the traffic, bundled topics share a frame
+}expected_frame_t;
+
+typedef struct traffic{
+    uint8_t* bytes;
+    size_t len;
+    expected_frame_t* frames;   // every topic in the valid frames of the traffic, in order
+    size_t num_frames;
+    uint8_t* expected_data;
+    size_t expected_data_len;
+}traffic_t;
+
+typedef enum reader_type{
+    LEGACY_READER,
+    BUFFERED_READER
+}reader_type_t;
+
+typedef struct run_state{
+    const traffic_t* traffic;
+    int master_fd;
+    int slave_fd;
+    bool paced;
+    volatile bool reading;
+
+    // filled in by the writer
+    double* write_times;        // when each expected frame was written, for latency runs
+
+    // filled in by the reader
+    size_t next_expected;
+    size_t frames_received;
+    double* latencies;
+    size_t num_latencies;
+    double last_frame_time;
+    uint64_t syscalls;
+}run_state_t;
+
+typedef struct run_result{
+    bool stalled;               // the reader stopped reading before all the traffic was written
+    double seconds;
+    size_t frames_received;
+    uint64_t syscalls;
+    double mean_latency_us;
+    double p99_latency_us;
+    double max_latency_us;
+}run_result_t;
+
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void append_frame(uint8_t** bytes, size_t* len, size_t* capacity, uint16_t topic_id, uint16_t msg_len)
+{
+    if(*len + msg_len + ROS_PKG_LENGTH > *capacity)
+    {
+        *capacity = 2 * (*capacity) + msg_len + ROS_PKG_LENGTH;
+        *bytes = (uint8_t*)realloc(*bytes, *capacity);
+    }
+    uint8_t msg[msg_len];
+    for(int i = 0; i < msg_len; i++)
+    {
+        msg[i] = (uint8_t)rand();
+    }
+    encode_msg(msg, msg_len, topic_id, &(*bytes)[*len], msg_len + ROS_PKG_LENGTH);
+    *len += msg_len + ROS_PKG_LENGTH;
+}
+
+static const uint16_t loop_topics[TOPICS_PER_LOOP] = {MBOT_TIMESYNC_RESPONSE, MBOT_ENCODERS, MBOT_ODOMETRY, MBOT_IMU,
+                                                      MBOT_VEL, MBOT_MOTOR_VEL, MBOT_ANALOG_IN, MBOT_MOTOR_PWM};
+static const uint16_t loop_sizes[TOPICS_PER_LOOP] = {sizeof(serial_timesync_t), sizeof(serial_mbot_encoders_t),
+                                                     sizeof(serial_pose2D_t), sizeof(serial_mbot_imu_t),
+                                                     sizeof(serial_twist2D_t), sizeof(serial_mbot_motor_vel_t),
+                                                     sizeof(serial_mbot_analog_t), sizeof(serial_mbot_motor_pwm_t)};
+
+// the sensor topics are registered so they can be bundled
+static void register_loop_topics(void)
+{
+    int ser_dev = -1;
+    comms_init_protocol(&ser_dev);
+    comms_register_topic(MBOT_ODOMETRY, sizeof(serial_pose2D_t), (Deserialize)&pose2D_t_deserialize, (Serialize)&pose2D_t_serialize, NULL);
+    comms_register_topic(MBOT_IMU, sizeof(serial_mbot_imu_t), (Deserialize)&mbot_imu_t_deserialize, (Serialize)&mbot_imu_t_serialize, NULL);
+    comms_register_topic(MBOT_ENCODERS, sizeof(serial_mbot_encoders_t), (Deserialize)&mbot_encoders_t_deserialize, (Serialize)&mbot_encoders_t_serialize, NULL);
+    comms_register_topic(MBOT_VEL, sizeof(serial_twist2D_t), (Deserialize)&twist2D_t_deserialize, (Serialize)&twist2D_t_serialize, NULL);
+    comms_register_topic(MBOT_MOTOR_VEL, sizeof(serial_mbot_motor_vel_t), (Deserialize)&mbot_motor_vel_t_deserialize, (Serialize)&mbot_motor_vel_t_serialize, NULL);
+    comms_register_topic(MBOT_MOTOR_PWM, sizeof(serial_mbot_motor_pwm_t), (Deserialize)&mbot_motor_pwm_t_deserialize, (Serialize)&mbot_motor_pwm_t_serialize, NULL);
+    comms_register_topic(MBOT_ANALOG_IN, sizeof(serial_mbot_analog_t), (Deserialize)&mbot_analog_t_deserialize, (Serialize)&mbot_analog_t_serialize, NULL);
+}
+
+// makes traffic with the same topics, sizes and rate as the Pico sends
+static void synthesize_traffic(traffic_t* traffic, double seconds, bool bundle_topics)
+{
+    size_t capacity = 0;
+    traffic->bytes = NULL;
+    traffic->len = 0;
+    static comms_bundle_t bundle;
+    int num_loops = (int)(seconds * 1e6 / LOOP_PERIOD_US);
+    for(int loop = 0; loop < num_loops; loop++)
+    {
+        if(!bundle_topics)
+        {
+            for(int i = 0; i < TOPICS_PER_LOOP; i++)
+            {
+                append_frame(&traffic->bytes, &traffic->len, &capacity, loop_topics[i], loop_sizes[i]);
+            }
+            continue;
+        }
+
+        // the timesync reply goes first on its own, then a bundle of the rest like mbot_loop sends
+        append_frame(&traffic->bytes, &traffic->len, &capacity, loop_topics[0], loop_sizes[0]);
+        comms_bundle_start(&bundle, (int64_t)loop * LOOP_PERIOD_US);
+        for(int i = 1; i < TOPICS_PER_LOOP; i++)
+        {
+            uint8_t msg[loop_sizes[i]];
+            for(int j = 0; j < loop_sizes[i]; j++)
+            {
+                msg[j] = (uint8_t)rand();
+            }
+            comms_bundle_add_topic(&bundle, loop_topics[i], msg);
+        }
+        uint32_t packet_len = comms_bundle_generate_packet(&bundle);
+        if(traffic->len + packet_len > capacity)
+        {
+            capacity = 2 * capacity + packet_len;
+            traffic->bytes = (uint8_t*)realloc(traffic->bytes, capacity);
+        }
+        memcpy(&traffic->bytes[traffic->len], bundle.packet, packet_len);
+        traffic->len += packet_len;
+    }
+}
+
+static int load_capture(traffic_t* traffic, const char* path)
+{
+    FILE* capture = fopen(path, "rb");
+    if(capture == NULL)
+    {
+        fprintf(stderr, "Error %i opening %s: %s\n", errno, path, strerror(errno));
+        return -1;
+    }
+    fseek(capture, 0, SEEK_END);
+    traffic->len = ftell(capture);
+    fseek(capture, 0, SEEK_SET);
+    traffic->bytes = (uint8_t*)malloc(traffic->len);
+    traffic->len = fread(traffic->bytes, 1, traffic->len, capture);
+    fclose(capture);
+    return 0;
+}
+
+// corrupts a fraction of the frames with a flipped bit, a dropped byte, or junk with a fake sync flag in front
+static void add_noise(traffic_t* traffic, double noise)
+{
+    uint8_t* noisy = (uint8_t*)malloc(2 * traffic->len);
+    size_t noisy_len = 0;
+    size_t start = 0;
+    while(start < traffic->len)
+    {
+        // find the end of this frame, the next sync and version flags
+        size_t end = start + 1;
+        while(end < traffic->len && !(traffic->bytes[end] == SYNC_FLAG && end + 1 < traffic->len
+                                      && traffic->bytes[end + 1] == VERSION_FLAG))
+        {
+            end++;
+        }
+        size_t frame_len = end - start;
+        memcpy(&noisy[noisy_len], &traffic->bytes[start], frame_len);
+
+        if((double)rand() / RAND_MAX < noise && frame_len > ROS_HEADER_LENGTH)
+        {
+            size_t index = ROS_HEADER_LENGTH + rand() % (frame_len - ROS_HEADER_LENGTH);
+            switch(rand() % 3)
+            {
+                case 0:
+                    noisy[noisy_len + index] ^= 0x10;
+                    break;
+                case 1:
+                    memmove(&noisy[noisy_len + index], &noisy[noisy_len + index + 1], frame_len - index - 1);
+                    frame_len--;
+                    break;
+                default:
+                    memmove(&noisy[noisy_len + 2], &noisy[noisy_len], frame_len);
+                    noisy[noisy_len] = SYNC_FLAG;
+                    noisy[noisy_len + 1] = VERSION_FLAG;
+                    frame_len += 2;
+                    break;
+            }
+        }
+        noisy_len += frame_len;
+        start = end;
+    }
+    free(traffic->bytes);
+    traffic->bytes = noisy;
+    traffic->len = noisy_len;
+}
+
+typedef struct expected_frame_search{
+    frame_parser_t* parser;
+    traffic_t* traffic;
+    size_t capacity;
+    size_t data_capacity;
+}expected_frame_search_t;
+
+static void record_expected_frame(uint16_t topic_id, uint8_t* data, uint16_t msg_len, void* arg)
+{
+    expected_frame_search_t* search = (expected_frame_search_t*)arg;
+    traffic_t* traffic = search->traffic;
+    if(traffic->num_frames == search->capacity)
+    {
+        search->capacity = 2 * search->capacity + 64;
+        traffic->frames = (expected_frame_t*)realloc(traffic->frames, search->capacity * sizeof(expected_frame_t));
+    }
+
+    if(traffic->expected_data_len + msg_len > search->data_capacity)
+    {
+        search->data_capacity = 2 * search->data_capacity + msg_len;
+        traffic->expected_data = (uint8_t*)realloc(traffic->expected_data, search->data_capacity);
+    }
+
+    // the tail has just moved past the frame
+    expected_frame_t* frame = &traffic->frames[traffic->num_frames++];
+    frame->topic_id = topic_id;
+    frame->msg_len = msg_len;
+    frame->end_offset = search->parser->tail;
+    frame->data_offset = traffic->expected_data_len;
+    memcpy(&traffic->expected_data[traffic->expected_data_len], data, msg_len);
+    traffic->expected_data_len += msg_len;
+}
+
+// finds every valid frame in the traffic, which is what each reader should deliver
+static void find_expected_frames(traffic_t* traffic)
+{
+    frame_parser_t* parser = (frame_parser_t*)malloc(sizeof(frame_parser_t));
+    frame_parser_init(parser);
+
+    expected_frame_search_t search = {parser, traffic, 0, 0};
+    traffic->frames = NULL;
+    traffic->num_frames = 0;
+    traffic->expected_data = NULL;
+    traffic->expected_data_len = 0;
+
+    size_t pushed = 0;
+    while(pushed < traffic->len)
+    {
+        pushed += frame_parser_push(parser, &traffic->bytes[pushed], traffic->len - pushed);
+        frame_parser_parse(parser, record_expected_frame, &search);
+    }
+    free(parser);
+}
+
+// matches a frame from a reader with the next expected frames. A reader may miss frames, so it looks a little ahead.
+static void handle_frame(uint16_t topic_id, uint8_t* data, uint16_t msg_len, void* arg)
+{
+    run_state_t* state = (run_state_t*)arg;
+    const traffic_t* traffic = state->traffic;
+    double receive_time = now_seconds();
+
+    for(size_t i = state->next_expected; i < traffic->num_frames && i < state->next_expected + 64; i++)
+    {
+        const expected_frame_t* frame = &traffic->frames[i];
+        if(frame->topic_id == topic_id && frame->msg_len == msg_len
+            && memcmp(&traffic->expected_data[frame->data_offset], data, msg_len) == 0)
+        {
+            if(state->paced)
+            {
+                state->latencies[state->num_latencies++] = (receive_time - state->write_times[i]) * 1e6;
+            }
+            state->frames_received++;
+            state->last_frame_time = receive_time;
+            state->next_expected = i + 1;
+            return;
+        }
+    }
+}
+
+/////// The listener before the buffered parser, reading a byte at a time ///////
+
+static bool legacy_read_header(run_state_t* state, uint8_t* header_data)
+{
+    unsigned char trigger_val = 0x00;
+    int rc = 0x00;
+    while(trigger_val != 0xff && state->reading && rc != 1)
+    {
+        rc = read(state->slave_fd, &trigger_val, 1);
+        state->syscalls++;
+        if(rc < 0){return false;}
+    }
+    header_data[0] = trigger_val;
+
+    rc = read(state->slave_fd, &header_data[1], ROS_HEADER_LENGTH - 1);
+    state->syscalls++;
+    return (rc == ROS_HEADER_LENGTH - 1);
+}
+
+static void legacy_listener(run_state_t* state)
+{
+    uint8_t header_data[ROS_HEADER_LENGTH];
+
+    while(state->reading)
+    {
+        if(!legacy_read_header(state, header_data))
+        {
+            continue;
+        }
+        uint8_t cs1_addends[2] = {header_data[2], header_data[3]};
+        if(header_data[1] != 0xfe || checksum(cs1_addends, 2) != header_data[4])
+        {
+            continue;
+        }
+
+        uint16_t message_len = ((uint16_t)header_data[3] << 8) + (uint16_t)header_data[2];
+        uint16_t topic_id = ((uint16_t)header_data[6] << 8) + (uint16_t)header_data[5];
+        uint8_t msg_data_serialized[message_len];
+
+        int avail = 0;
+        ioctl(state->slave_fd, FIONREAD, &avail);
+        state->syscalls++;
+        while(avail < (message_len + 1) && state->reading)
+        {
+            usleep(1000);
+            ioctl(state->slave_fd, FIONREAD, &avail);
+            state->syscalls += 2;
+        }
+
+        uint8_t topic_msg_data_checksum = 0;
+        int rc = read(state->slave_fd, msg_data_serialized, message_len);
+        int rc_checksum = read(state->slave_fd, &topic_msg_data_checksum, 1);
+        state->syscalls += 2;
+        if(rc != message_len || rc_checksum != 1)
+        {
+            continue;
+        }
+
+        uint8_t cs2_addends[message_len + 2];
+        cs2_addends[0] = header_data[5];
+        cs2_addends[1] = header_data[6];
+        memcpy(&cs2_addends[2], msg_data_serialized, message_len);
+        if(checksum(cs2_addends, message_len + 2) != topic_msg_data_checksum)
+        {
+            continue;
+        }
+        // unpacked the same way as by the buffered parser, so both deliver the same topics
+        if(topic_id == BUNDLE_TOPIC)
+        {
+            frame_parser_unpack_bundle(msg_data_serialized, message_len, handle_frame, state);
+        }
+        else
+        {
+            handle_frame(topic_id, msg_data_serialized, message_len, state);
+        }
+    }
+}
+
+static void buffered_listener(run_state_t* state)
+{
+    frame_parser_t* parser = (frame_parser_t*)malloc(sizeof(frame_parser_t));
+    frame_parser_init(parser);
+    while(state->reading)
+    {
+        comms_listener_poll(state->slave_fd, parser, handle_frame, state);
+        state->syscalls += 2;   // poll and read
+    }
+    free(parser);
+}
+
+static reader_type_t reader_under_test;
+
+static void* reader_thread(void* arg)
+{
+    run_state_t* state = (run_state_t*)arg;
+    if(reader_under_test == LEGACY_READER)
+    {
+        legacy_listener(state);
+    }
+    else
+    {
+        buffered_listener(state);
+    }
+    return NULL;
+}
+
+// writes to the non-blocking pty, returns false if the reader stopped taking bytes for a second
+static bool write_all(int fd, const uint8_t* bytes, size_t len)
+{
+    size_t written = 0;
+    while(written < len)
+    {
+        ssize_t rc = write(fd, &bytes[written], len - written);
+        if(rc > 0)
+        {
+            written += rc;
+            continue;
+        }
+        if(rc < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            fprintf(stderr, "Error %i writing to the pty: %s\n", errno, strerror(errno));
+            return false;
+        }
+
+        struct pollfd pty_poll = {fd, POLLOUT, 0};
+        if(errno == EAGAIN && poll(&pty_poll, 1, 1000) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// writes the first num_frames frames of the traffic, either all at once or a loop's worth of frames at a time.
+// Returns false if the reader stalled.
+static bool write_traffic(run_state_t* state, size_t num_frames, int period_us, int split_us)
+{
+    const traffic_t* traffic = state->traffic;
+    size_t end = (num_frames == traffic->num_frames) ? traffic->len : traffic->frames[num_frames - 1].end_offset;
+
+    if(!state->paced)
+    {
+        for(size_t written = 0; written < end; written += 4096)
+        {
+            if(!write_all(state->master_fd, &traffic->bytes[written], (end - written < 4096) ? end - written : 4096))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // like the Pico, each frame is a separate write. Over USB, a frame can span two packets, so the second half of
+    // it is written split_us after the first.
+    size_t written = 0;
+    for(size_t i = 0; i < num_frames; i++)
+    {
+        size_t frame_end = traffic->frames[i].end_offset;
+        if(frame_end > written)
+        {
+            // every topic in the frame is stamped before the write, since the reader may get them before it returns
+            double write_time = now_seconds();
+            for(size_t j = i; j < num_frames && traffic->frames[j].end_offset == frame_end; j++)
+            {
+                state->write_times[j] = write_time;
+            }
+
+            size_t split = written + (frame_end - written) / 2;
+            if(!write_all(state->master_fd, &traffic->bytes[written], split - written))
+            {
+                return false;
+            }
+            if(split_us > 0)
+            {
+                usleep(split_us);
+            }
+            if(!write_all(state->master_fd, &traffic->bytes[split], frame_end - split))
+            {
+                return false;
+            }
+            written = frame_end;
+        }
+
+        if((i + 1) % TOPICS_PER_LOOP == 0)
+        {
+            usleep(period_us);
+        }
+    }
+    return true;
+}
+
+static int open_pty(run_state_t* state)
+{
+    state->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(state->master_fd < 0 || grantpt(state->master_fd) != 0 || unlockpt(state->master_fd) != 0)
+    {
+        fprintf(stderr, "Error %i opening a pty: %s\n", errno, strerror(errno));
+        return -1;
+    }
+    // the writer doesn't block, so a reader that stops reading can't hang the benchmark
+    fcntl(state->master_fd, F_SETFL, fcntl(state->master_fd, F_GETFL) | O_NONBLOCK);
+    state->slave_fd = open(ptsname(state->master_fd), O_RDWR | O_NOCTTY);
+    if(state->slave_fd < 0)
+    {
+        fprintf(stderr, "Error %i opening %s: %s\n", errno, ptsname(state->master_fd), strerror(errno));
+        return -1;
+    }
+
+    // same settings as lcm_serial_server uses for the Pico. Both ends of the pty share them.
+    struct termios options;
+    tcgetattr(state->slave_fd, &options);
+    cfmakeraw(&options);
+    options.c_cc[VTIME] = 1;
+    options.c_cc[VMIN] = 0;
+    tcsetattr(state->slave_fd, TCSANOW, &options);
+    return 0;
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double diff = *(const double*)a - *(const double*)b;
+    return (diff > 0) - (diff < 0);
+}
+
+static int run_reader(const traffic_t* traffic, reader_type_t reader, bool paced, size_t num_frames, int period_us,
+                      int split_us, run_result_t* result)
+{
+    run_state_t state;
+    memset(&state, 0, sizeof(run_state_t));
+    state.traffic = traffic;
+    state.paced = paced;
+    state.reading = true;
+    state.write_times = (double*)calloc(traffic->num_frames, sizeof(double));
+    state.latencies = (double*)calloc(traffic->num_frames, sizeof(double));
+    if(open_pty(&state) != 0)
+    {
+        return -1;
+    }
+
+    reader_under_test = reader;
+    pthread_t thread;
+    pthread_create(&thread, NULL, reader_thread, &state);
+
+    double start = now_seconds();
+    result->stalled = !write_traffic(&state, num_frames, period_us, split_us);
+
+    // give the reader up to a second to catch up after the last write
+    double write_end = now_seconds();
+    while(state.next_expected < num_frames && now_seconds() - write_end < 1.0)
+    {
+        usleep(1000);
+    }
+    state.reading = false;
+    pthread_join(thread, NULL);
+
+    result->seconds = state.last_frame_time - start;
+    result->frames_received = state.frames_received;
+    result->syscalls = state.syscalls;
+    result->mean_latency_us = 0.0;
+    result->p99_latency_us = 0.0;
+    result->max_latency_us = 0.0;
+    if(state.num_latencies > 0)
+    {
+        qsort(state.latencies, state.num_latencies, sizeof(double), compare_doubles);
+        for(size_t i = 0; i < state.num_latencies; i++)
+        {
+            result->mean_latency_us += state.latencies[i] / state.num_latencies;
+        }
+        result->p99_latency_us = state.latencies[(size_t)(0.99 * (state.num_latencies - 1))];
+        result->max_latency_us = state.latencies[state.num_latencies - 1];
+    }
+
+    close(state.slave_fd);
+    close(state.master_fd);
+    free(state.write_times);
+    free(state.latencies);
+    return 0;
+}
+
+static void print_usage(const char* name)
+{
+    printf("Usage: %s [options]\n", name);
+    printf("  --capture FILE     replay bytes recorded with lcm_serial_server --capture, instead of synthetic traffic\n");
+    printf("  --seconds S        length of the synthetic traffic (default 60)\n");
+    printf("  --separate         synthesize a frame per topic, as the firmware sent before bundles\n");
+    printf("  --noise P          fraction of frames to corrupt (default 0)\n");
+    printf("  --latency-loops N  Pico loops to send in the latency runs (default 100)\n");
+    printf("  --period US        time between loops in the latency runs (default 40000)\n");
+    printf("  --split US         time between a frame's header and message in the latency runs (default 200)\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* capture_path = NULL;
+    double seconds = 60.0;
+    double noise = 0.0;
+    int latency_loops = 100;
+    int period_us = LOOP_PERIOD_US;
+    int split_us = 200;
+    bool bundle_topics = true;
+
+    static struct option long_options[] = {
+        {"capture", required_argument, NULL, 'c'},
+        {"seconds", required_argument, NULL, 's'},
+        {"separate", no_argument, NULL, 'b'},
+        {"noise", required_argument, NULL, 'n'},
+        {"latency-loops", required_argument, NULL, 'l'},
+        {"period", required_argument, NULL, 'p'},
+        {"split", required_argument, NULL, 'd'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 'c': capture_path = optarg; break;
+            case 's': seconds = atof(optarg); break;
+            case 'b': bundle_topics = false; break;
+            case 'n': noise = atof(optarg); break;
+            case 'l': latency_loops = atoi(optarg); break;
+            case 'p': period_us = atoi(optarg); break;
+            case 'd': split_us = atoi(optarg); break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    srand(1);
+    traffic_t traffic;
+    if(capture_path != NULL)
+    {
+        if(load_capture(&traffic, capture_path) != 0)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        register_loop_topics();
+        synthesize_traffic(&traffic, seconds, bundle_topics);
+    }
+    if(noise > 0.0)
+    {
+        add_noise(&traffic, noise);
+    }
+    find_expected_frames(&traffic);
+    if(traffic.num_frames == 0)
+    {
+        fprintf(stderr, "No valid topics in the traffic.\n");
+        return 1;
+    }
+
+    size_t latency_frames = (size_t)latency_loops * TOPICS_PER_LOOP;
+    if(latency_frames > traffic.num_frames)
+    {
+        latency_frames = traffic.num_frames;
+    }
+
+    printf("%zu bytes, %zu valid topics\n\n", traffic.len, traffic.num_frames);
+    printf("%-10s %12s %12s %12s %14s %12s %12s %12s\n", "reader", "topics", "topics/s", "MB/s", "syscalls/topic",
+           "mean(us)", "p99(us)", "max(us)");
+
+    const char* names[2] = {"legacy", "buffered"};
+    for(int reader = LEGACY_READER; reader <= BUFFERED_READER; reader++)
+    {
+        run_result_t throughput;
+        run_result_t latency;
+        if(run_reader(&traffic, reader, false, traffic.num_frames, period_us, split_us, &throughput) != 0
+            || run_reader(&traffic, reader, true, latency_frames, period_us, split_us, &latency) != 0)
+        {
+            return 1;
+        }
+
+        printf("%-10s %5zu/%-6zu %12.0f %12.2f %14.2f %12.0f %12.0f %12.0f\n", names[reader],
+               throughput.frames_received, traffic.num_frames, throughput.frames_received / throughput.seconds,
+               traffic.len / throughput.seconds / 1e6,
+               (double)latency.syscalls / (latency.frames_received > 0 ? latency.frames_received : 1),
+               latency.mean_latency_us, latency.p99_latency_us, latency.max_latency_us);
+        if(throughput.stalled || latency.stalled)
+        {
+            // the old reader waits for as many bytes as a header says, even a false one, before reading more
+            printf("%-10s stalled in the %s run, waiting for a message longer than the data sent\n", names[reader],
+                   throughput.stalled ? "throughput" : "latency");
+        }
+    }
+
+    free(traffic.bytes);
+    free(traffic.frames);
+    free(traffic.expected_data);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef MBOT_LCM_MSGS_LIDAR_COMPACT_UTILS_HPP
+#define MBOT_LCM_MSGS_LIDAR_COMPACT_UTILS_HPP
+
+#include <cstdint>
+
+#include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_t.hpp>
+
+namespace mbot_lcm_msgs {
+
+/**
+ * Expands a compact scan into a lidar_t with the same rays. Rays with no return have a range of 0. The vectors in out
+ * are reused, so expanding scans into the same lidar_t doesn't allocate once it has held the largest scan.
+ */
+inline void expand_lidar_compact(const lidar_compact_t& in, lidar_t& out)
+{
+    out.utime = in.utime;
+    out.num_ranges = in.num_ranges;
+    out.ranges.resize(in.num_ranges);
+    out.thetas.resize(in.num_ranges);
+    out.times.resize(in.num_ranges);
+    out.intensities.resize(in.num_ranges);
+
+    for (int i = 0; i < in.num_ranges; ++i)
+    {
+        out.ranges[i] = in.ranges[i] * 0.001f;
+        out.thetas[i] = in.start_theta + i * in.theta_step;
+        out.times[i] = in.start_time + static_cast<int64_t>(i * in.time_step);
+        out.intensities[i] = in.intensities[i];
+    }
+}
+
+}   // namespace mbot_lcm_msgs
+
+#endif // MBOT_LCM_MSGS_LIDAR_COMPACT_UTILS_HPP
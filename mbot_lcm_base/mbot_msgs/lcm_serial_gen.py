@@ -120,6 +120,227 @@ def generate_serialize_deserialize_functions(struct_name):
     return deserialize + serialize
 
 
+# Sizes of the LCM primitive types, which are the same in the serial structs. Strings are handled separately.
+lcm_primitive_sizes = {'int8_t': 1, 'int16_t': 2, 'int32_t': 4, 'int64_t': 8, 'float': 4, 'double': 8,
+                       'boolean': 1, 'byte': 1}
+
+
+def flatten_fields(fields, parsed_types, max_string_length=256):
+    """
+    \brief Flatten LCM fields, including those of nested types, into the order their values are encoded in.
+
+    Both LCM and the packed serial structs lay out the values of a message one after the other in field order, nested
+    types inline, so a message is a sequence of runs of same-sized values plus strings. Consecutive runs of the same
+    size are merged.
+
+    \param[in] fields The list of fields in the LCM struct.
+    \param[in] parsed_types Dictionary from struct name to its fields, for nested types.
+    \param[in] max_string_length The size of the character arrays that hold strings in the serial structs.
+
+    \return A list of ('values', size, count) and ('string', max_length) tuples, or None if a nested type isn't known.
+    """
+    runs = []
+    for field_type, field_name, array_size, comment in fields:
+        count = int(array_size.strip('[]')) if array_size else 1
+        if field_type == 'string':
+            runs.extend([('string', max_string_length)] * count)
+        elif field_type in lcm_primitive_sizes:
+            size = lcm_primitive_sizes[field_type]
+            if runs and runs[-1][0] == 'values' and runs[-1][1] == size:
+                runs[-1] = ('values', size, runs[-1][2] + count)
+            else:
+                runs.append(('values', size, count))
+        elif field_type in parsed_types:
+            nested = flatten_fields(parsed_types[field_type], parsed_types, max_string_length)
+            if nested is None:
+                return None
+            for _ in range(count):
+                for run in nested:
+                    if run[0] == 'values' and runs and runs[-1][0] == 'values' and runs[-1][1] == run[1]:
+                        runs[-1] = ('values', run[1], runs[-1][2] + run[2])
+                    else:
+                        runs.append(run)
+        else:
+            return None
+    return runs
+
+
+def generate_lcm_translators(package_name, struct_name, runs):
+    """
+    \brief Generate C functions that translate between a serial message and its LCM encoding without a struct in
+    between.
+
+    \param[in] package_name The package name.
+    \param[in] struct_name The struct name.
+    \param[in] runs The flattened fields of the struct, from flatten_fields().
+
+    \return A tuple of the C code and the largest size of the LCM encoding.
+    """
+    lcm_type = f'{package_name}_{struct_name}'
+    lcm_max_size = 8 + sum(run[1] * run[2] if run[0] == 'values' else 4 + run[1] for run in runs)
+
+    to_lcm = f'static inline int {struct_name}_serial_to_lcm(const uint8_t* src, uint8_t* dest, int maxlen) {{\n'
+    to_lcm += f'    if(maxlen < {lcm_max_size}) {{\n'
+    to_lcm += f'        return -1;\n'
+    to_lcm += f'    }}\n'
+    to_lcm += f'    int pos = serial_lcm_put_hash(dest, __{lcm_type}_get_hash());\n'
+    from_lcm = f'static inline int {struct_name}_lcm_to_serial(const uint8_t* src, int len, uint8_t* dest) {{\n'
+    from_lcm += f'    if(len < 8 || !serial_lcm_check_hash(src, __{lcm_type}_get_hash())) {{\n'
+    from_lcm += f'        return -1;\n'
+    from_lcm += f'    }}\n'
+    from_lcm += f'    int pos = 8;\n'
+
+    offset = 0
+    fixed_size = 0
+    for run in runs:
+        if run[0] == 'values':
+            _, size, count = run
+            to_lcm += f'    serial_lcm_swap(&dest[pos], &src[{offset}], {size}, {count});\n'
+            to_lcm += f'    pos += {size * count};\n'
+            fixed_size += size * count
+            from_lcm += f'    if(len < pos + {size * count}) {{\n'
+            from_lcm += f'        return -1;\n'
+            from_lcm += f'    }}\n'
+            from_lcm += f'    serial_lcm_swap(&dest[{offset}], &src[pos], {size}, {count});\n'
+            from_lcm += f'    pos += {size * count};\n'
+            offset += size * count
+        else:
+            _, max_length = run
+            to_lcm += f'    pos += serial_lcm_put_string(&dest[pos], (const char*)&src[{offset}], {max_length});\n'
+            from_lcm += f'    int {f"string_len_{offset}"} = serial_lcm_get_string((char*)&dest[{offset}], {max_length}, &src[pos], len - pos);\n'
+            from_lcm += f'    if(string_len_{offset} < 0) {{\n'
+            from_lcm += f'        return -1;\n'
+            from_lcm += f'    }}\n'
+            from_lcm += f'    pos += string_len_{offset};\n'
+            offset += max_length
+
+    to_lcm += f'    return pos;\n'
+    to_lcm += f'}}\n\n'
+    from_lcm += f'    return {offset};\n'
+    from_lcm += f'}}\n\n'
+
+    descriptor = f'_Static_assert(sizeof(serial_{struct_name}) == {offset}, "serial_{struct_name} isn\'t packed");\n'
+    descriptor += f'static const serial_lcm_type_t {struct_name}_serial_lcm = {{\n'
+    descriptor += f'    sizeof(serial_{struct_name}),\n'
+    descriptor += f'    {lcm_max_size},\n'
+    descriptor += f'    (int (*)(uint8_t*, void*))&{struct_name}_deserialize,\n'
+    descriptor += f'    (int (*)(void*, uint8_t*))&{struct_name}_serialize,\n'
+    descriptor += f'    &{struct_name}_serial_to_lcm,\n'
+    descriptor += f'    &{struct_name}_lcm_to_serial\n'
+    descriptor += f'}};\n'
+
+    return to_lcm + from_lcm + descriptor, lcm_max_size
+
+
+def write_lcm_translator_header(package_name, struct_names, translators, max_serial_size, max_lcm_size):
+    """
+    \brief Write {package_name}_serial_lcm.h, with the LCM translators of the serial structs in the package.
+
+    It's separate from {package_name}_serial.h because it needs LCM, which the firmware doesn't have.
+    """
+    package_upper = package_name.upper()
+    type_list = '\n *   '.join(struct_names)
+    with open(f'{package_name}_serial_lcm.h', 'w') as f:
+        f.write(f"""/*
+ * This header file was autogenerated by the LCM to C header file generator.
+ *
+ * Each type has {{type}}_serial_to_lcm(), which LCM-encodes a message straight from its serial bytes, and
+ * {{type}}_lcm_to_serial(), which decodes an LCM-encoded message straight into its serial bytes. Both return the
+ * number of bytes written, or -1 if the destination is too small or the message isn't of the type. The serial bytes
+ * are little-endian, as on the Pico and the Raspberry Pi, and LCM is big-endian.
+ *
+ * {{type}}_serial_lcm describes each type, so a bridge can be driven by a table of topics.
+ * Included LCM types:
+ *   {type_list}
+ */
+
+#ifndef {package_upper}_SERIAL_LCM_H
+#define {package_upper}_SERIAL_LCM_H
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "{package_name}_serial.h"
+""")
+        for struct_name in struct_names:
+            f.write(f'#include "{package_name}_{struct_name}.h"\n')
+        f.write(f"""
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The serial structs are little-endian"
+#endif
+
+// the largest serial message and LCM encoding of the types here
+#define {package_upper}_SERIAL_MAX_SIZE {max_serial_size}
+#define {package_upper}_SERIAL_LCM_MAX_SIZE {max_lcm_size}
+
+typedef struct serial_lcm_type {{
+    uint16_t serial_size;
+    int lcm_max_size;
+    int (*deserialize)(uint8_t* src, void* dest);
+    int (*serialize)(void* src, uint8_t* dest);
+    int (*serial_to_lcm)(const uint8_t* src, uint8_t* dest, int maxlen);
+    int (*lcm_to_serial)(const uint8_t* src, int len, uint8_t* dest);
+}} serial_lcm_type_t;
+
+// copies count values of size bytes, reversing the bytes of each
+static inline void serial_lcm_swap(uint8_t* dest, const uint8_t* src, int size, int count) {{
+    if(size == 1) {{
+        memcpy(dest, src, count);
+        return;
+    }}
+    for(int i = 0; i < count; i++) {{
+        for(int j = 0; j < size; j++) {{
+            dest[j] = src[size - 1 - j];
+        }}
+        dest += size;
+        src += size;
+    }}
+}}
+
+static inline int serial_lcm_put_hash(uint8_t* dest, int64_t hash) {{
+    serial_lcm_swap(dest, (const uint8_t*)&hash, 8, 1);
+    return 8;
+}}
+
+static inline bool serial_lcm_check_hash(const uint8_t* src, int64_t hash) {{
+    int64_t msg_hash;
+    serial_lcm_swap((uint8_t*)&msg_hash, src, 8, 1);
+    return msg_hash == hash;
+}}
+
+// LCM strings are an int32 length, including the terminating null, then the characters and the null
+static inline int serial_lcm_put_string(uint8_t* dest, const char* src, int max_length) {{
+    int32_t len = (int32_t)strnlen(src, max_length - 1) + 1;
+    serial_lcm_swap(dest, (const uint8_t*)&len, 4, 1);
+    memcpy(&dest[4], src, len - 1);
+    dest[4 + len - 1] = 0;
+    return 4 + len;
+}}
+
+// returns the bytes read from src, or -1 if the string is cut short or doesn't fit in max_length
+static inline int serial_lcm_get_string(char* dest, int max_length, const uint8_t* src, int len) {{
+    int32_t str_len;
+    if(len < 4) {{
+        return -1;
+    }}
+    serial_lcm_swap((uint8_t*)&str_len, src, 4, 1);
+    if(str_len < 1 || str_len > max_length || len < 4 + str_len) {{
+        return -1;
+    }}
+    memcpy(dest, &src[4], str_len);
+    dest[str_len - 1] = 0;
+    memset(&dest[str_len], 0, max_length - str_len);
+    return 4 + str_len;
+}}
+
+""")
+        for translator in translators:
+            f.write(translator)
+            f.write("\n\n")
+        f.write("#endif\n")
+
+
 def process_lcm_files(folder_path, ordered_lcm_files):
     """
     \brief Process LCM files in a folder, generate C structs and functions, and save them in header files.
@@ -129,7 +350,8 @@ def process_lcm_files(folder_path, ordered_lcm_files):
 
     The function will create one header file and one C file for each unique package name found in the LCM files. The header
     files will be named {package_name}_serial.h and will contain the C structs and serialize/deserialize
-    function prototypes for each LCM struct in the package. The C files will be named {package_name}_serial.c and will
+    function prototypes for each LCM struct in the package. The LCM translators of the structs are written to
+    {package_name}_serial_lcm.h. The C files will be named {package_name}_serial.c and will
     contain the serialize/deserialize function implementations.
     """
     lcm_files = ordered_lcm_files   
@@ -137,6 +359,11 @@ def process_lcm_files(folder_path, ordered_lcm_files):
     package_structs = defaultdict(list)
     package_types = defaultdict(list)
     package_funcs = defaultdict(list)
+    package_translators = defaultdict(list)
+    package_translated_types = defaultdict(list)
+    package_max_serial_size = defaultdict(int)
+    package_max_lcm_size = defaultdict(int)
+    parsed_types = {}
 
     for lcm_file in lcm_files:
         c_struct = None
@@ -146,6 +373,7 @@ def process_lcm_files(folder_path, ordered_lcm_files):
         if(has_vla):
             print(f"skipping {struct_name} from {package_name}, contains variable length array")
             continue
+        parsed_types[struct_name] = fields
         
         c_struct = generate_c_struct(package_name, struct_name, fields)
         c_funcs = generate_serialize_deserialize_functions(struct_name)
@@ -156,6 +384,18 @@ def process_lcm_files(folder_path, ordered_lcm_files):
             package_funcs[package_name].append(c_funcs)
             package_types[package_name].append(struct_name)
 
+        # Nested types must come before the types that use them, as they do for the serial structs
+        runs = flatten_fields(fields, parsed_types)
+        if runs is None:
+            print(f"skipping the LCM translators of {struct_name} from {package_name}, contains an unknown type")
+            continue
+        translator, lcm_max_size = generate_lcm_translators(package_name, struct_name, runs)
+        serial_size = sum(run[1] * run[2] if run[0] == 'values' else run[1] for run in runs)
+        package_translators[package_name].append(translator)
+        package_translated_types[package_name].append(struct_name)
+        package_max_serial_size[package_name] = max(package_max_serial_size[package_name], serial_size)
+        package_max_lcm_size[package_name] = max(package_max_lcm_size[package_name], lcm_max_size)
+
     for package_name in package_structs.keys():
         # Generate header file for each package
         header_file_name = f'{package_name}_serial.h'
@@ -181,6 +421,10 @@ def process_lcm_files(folder_path, ordered_lcm_files):
                 f.write("\n\n")
             f.write("#endif\n")
             f.close()
+
+        write_lcm_translator_header(package_name, package_translated_types[package_name],
+                                    package_translators[package_name], package_max_serial_size[package_name],
+                                    package_max_lcm_size[package_name])
         
         # # Generate .c file for each package
         # c_file_name = f'{package_name}_serial.c'
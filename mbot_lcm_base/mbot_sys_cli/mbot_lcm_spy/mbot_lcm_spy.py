@@ -12,6 +12,7 @@ parser = argparse.ArgumentParser(description="LCM Spy CLI")
 parser.add_argument("--channels", type=str, help="Comma-separated list of channel names to print decoded messages")
 parser.add_argument("--rate", type=float, default=1, help="Rate at which data is printed in Hz (default: 1 Hz)")
 parser.add_argument("--module", type=str, default="mbot_lcm_msgs", help="Module to use for decoding messages")
+parser.add_argument("--link-stats", type=str, default="MBOT_LINK_STATS", help="Channel of the serial link stats to show (default: MBOT_LINK_STATS)")
 args = parser.parse_args()
 
 # Parse channels from the --channels argument
@@ -34,9 +35,17 @@ message_times = defaultdict(list)
 channel_types = {}
 stop_event = Event()
 decoded_message_dict = defaultdict(list)
+link_stats = None
 
 def message_handler(channel, data):
-    global message_counts, message_times, channel_types, decoded_message_dict
+    global message_counts, message_times, channel_types, decoded_message_dict, link_stats
+
+    # The serial link stats get their own table, see print_link_stats()
+    if channel == args.link_stats and decode_module and hasattr(decode_module, 'link_stats_t'):
+        try:
+            link_stats = decode_module.link_stats_t.decode(data)
+        except Exception:
+            pass
 
     lcm_type = "Unknown"
     decoded_message = None
@@ -123,6 +132,30 @@ def print_decoded_message(msg, indent=0):
         for item in msg:
             print_decoded_message(item, indent)
 
+def format_ms(value_us, count):
+    return f"{value_us / 1000:.1f}" if count > 0 else "-"
+
+# Prints the health of the serial link to the control board, as published by lcm_serial_server
+def print_link_stats(stats):
+    period = stats.period_s if stats.period_s > 0 else 1.0
+    print(f"\nSerial link over {stats.period_s:.1f} s: "
+          f"rx {stats.rx_bytes / period / 1000:.1f} kB/s, tx {stats.tx_bytes / period / 1000:.1f} kB/s, "
+          f"tx queue {stats.tx_queue_mean_bytes:.0f} B mean, {stats.tx_queue_max_bytes} B max")
+    print(f"Errors: {stats.bad_headers} bad headers, {stats.bad_checksums} bad checksums, "
+          f"{stats.bad_bundles} bad bundles, {stats.resyncs} resyncs ({stats.skipped_bytes} bytes skipped), "
+          f"{stats.tx_errors} failed writes. Clock error {stats.clock_error_us / 1000:.2f} ms")
+    print(f"{'Topic':<24} {'Rx/s':>6} {'Tx/s':>6} {'Cksum':>6} {'Gap ms':>7} {'Jitter':>7} {'Max':>7} "
+          f"{'Latency ms':>11} {'Max':>7}")
+    print("="*90)
+    for topic in stats.topics:
+        print(f"{topic.channel:<24} {topic.rx_packets / period:>6.1f} {topic.tx_packets / period:>6.1f} "
+              f"{topic.bad_checksums:>6} "
+              f"{format_ms(topic.interval_mean_us, topic.rx_packets):>7} "
+              f"{format_ms(topic.interval_jitter_us, topic.rx_packets):>7} "
+              f"{format_ms(topic.interval_max_us, topic.rx_packets):>7} "
+              f"{format_ms(topic.latency_mean_us, topic.num_latencies):>11} "
+              f"{format_ms(topic.latency_max_us, topic.num_latencies):>7}")
+
 def print_status():
     while not stop_event.is_set():
         time.sleep(1 / args.rate)  # Update at the specified rate
@@ -139,6 +172,9 @@ def print_status():
             lcm_type = channel_types.get(channel, "Unknown")
             print(f"{channel:<20} {lcm_type:<22} {rate:<10.2f} {total_messages:<10}")
 
+        if link_stats is not None:
+            print_link_stats(link_stats)
+
         for channel in channels_to_print:
             if channel in decoded_message_dict:
                 print(f"\nDecoded message on channel {channel}:")
@@ -0,0 +1,89 @@
+#ifndef TIMESYNC_CLOCK_ESTIMATOR_H
+#define TIMESYNC_CLOCK_ESTIMATOR_H
+
+#include <stdint.h>
+
+/*
+ * A clock estimator tracks how a remote clock relates to the local clock using NTP-style round trips:
+ *
+ *   t0: local time the request is sent       t1: remote time the request arrives
+ *   t3: local time the reply arrives         t2: remote time the reply is sent
+ *
+ * Each round trip gives an offset, ((t0 - t1) + (t3 - t2)) / 2, that is off by at most half the round trip time,
+ * (t3 - t0) - (t2 - t1). Round trips that were held up in a queue somewhere are the least accurate, so the samples are
+ * grouped and only the one with the shortest round trip in each group is kept (a min filter). A line is fit to the
+ * kept points to find the offset and how fast it drifts, so times can be converted between clocks in between
+ * samples:
+ *
+ *   local = remote + offset + drift * (remote - ref_remote_utime)
+ *
+ * If the remote clock jumps, e.g. because the remote device restarted, the estimate starts over.
+ */
+
+#define CLOCK_ESTIMATOR_MAX_POINTS 64
+
+typedef struct clock_estimator_point clock_estimator_point_t;
+struct clock_estimator_point {
+    int64_t remote_utime;         // remote time halfway between receiving the request and sending the reply
+    int64_t offset;               // local minus remote time
+    int64_t rtt;                  // round trip time, less the time the remote side held the request
+};
+
+typedef struct clock_estimator clock_estimator_t;
+struct clock_estimator {
+    int samples_per_point;        // round trips in each group the shortest is picked from
+    int max_points;               // number of points the line is fit to
+
+    clock_estimator_point_t points[CLOCK_ESTIMATOR_MAX_POINTS]; // ring buffer of the points
+    int num_points;
+    int next_point;
+    clock_estimator_point_t best_sample; // shortest round trip in the group being collected
+    int samples_in_group;
+
+    int64_t ref_remote_utime;     // remote time the offset applies at
+    int64_t offset;               // local minus remote time at ref_remote_utime
+    double  drift;                // change in offset per microsecond of remote time
+    double  error;                // bound on the error of the offset (us)
+    int64_t min_rtt;              // shortest round trip among the fit points (us)
+
+    int32_t num_samples;          // round trips used since the last reset
+    int32_t num_resets;           // times the remote clock jumped
+    uint8_t is_valid;             // have we had any round trips?
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Create a new clock estimator.
+    @param samples_per_point  Number of round trips each fit point is picked from
+    @param max_points         Number of points the line is fit to. At most CLOCK_ESTIMATOR_MAX_POINTS
+**/
+clock_estimator_t *
+clock_estimator_create (int samples_per_point, int max_points);
+void
+clock_estimator_destroy (clock_estimator_t *est);
+
+/** Forget all round trips. **/
+void
+clock_estimator_reset (clock_estimator_t *est);
+
+/** Add a round trip and update the estimate. Returns 1 if the round trip was used, 0 if it was rejected because the
+    times were inconsistent. **/
+int
+clock_estimator_add_sample (clock_estimator_t *est, int64_t request_utime, int64_t receive_utime,
+                            int64_t transmit_utime, int64_t response_utime);
+
+/** Convert a time from the remote clock to the local clock. **/
+int64_t
+clock_estimator_to_local (const clock_estimator_t *est, int64_t remote_utime);
+
+/** Convert a time from the local clock to the remote clock. **/
+int64_t
+clock_estimator_to_remote (const clock_estimator_t *est, int64_t local_utime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TIMESYNC_CLOCK_ESTIMATOR_H
@@ -6,5 +6,7 @@
 #define MULTICAST_URL "udpm://239.255.76.67:7667?ttl=0"
 
 #define MBOT_TIMESYNC_CHANNEL "MBOT_TIMESYNC"
+#define MBOT_TIMESYNC_REQUEST_CHANNEL "MBOT_TIMESYNC_REQUEST"
+#define MBOT_TIMESYNC_RESPONSE_CHANNEL "MBOT_TIMESYNC_RESPONSE"
 
 #endif // TIMESYNC_LCM_CONFIG_H
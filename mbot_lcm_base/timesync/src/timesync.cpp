@@ -1,33 +1,87 @@
-#include <iostream>
+#include <cstdio>
 #include <unistd.h>
 
 #include <lcm/lcm-cpp.hpp>
 
+#include <timesync/clock_estimator.h>
 #include <timesync/lcm_config.h>
 #include <timesync/timestamp.h>
 
-#include <mbot_lcm_msgs/timestamp_t.hpp>
+#include <mbot_lcm_msgs/timesync_t.hpp>
 
 /**
-	A program that gets the current system time and publishes an lcm message of the current time
+	A program that estimates how the clock of this computer relates to the MBot's clock, which is the clock of the
+	computer running lcm_serial_server. It sends round trip requests to lcm_serial_server and prints the estimated
+	offset, drift, and error once per second.
 **/
+
+class TimesyncClient {
+public:
+	TimesyncClient(lcm::LCM* lcm) : lcm_(lcm), lastRequestUtime_(0) {
+		// 10 Hz requests, with the shortest round trip of each second fit over the last minute
+		estimator_ = clock_estimator_create(10, 60);
+		lcm_->subscribe(MBOT_TIMESYNC_RESPONSE_CHANNEL, &TimesyncClient::handleResponse, this);
+	}
+
+	~TimesyncClient() {
+		clock_estimator_destroy(estimator_);
+	}
+
+	void sendRequest() {
+		mbot_lcm_msgs::timesync_t request;
+		request.request_utime = utime_now();
+		request.receive_utime = 0;
+		request.transmit_utime = 0;
+		lastRequestUtime_ = request.request_utime;
+		lcm_->publish(MBOT_TIMESYNC_REQUEST_CHANNEL, &request);
+	}
+
+	void handleResponse(const lcm::ReceiveBuffer* buf, const std::string& channel, const mbot_lcm_msgs::timesync_t* response) {
+		// Every client sees every response, so only the reply to our latest request is used
+		if(response->request_utime != lastRequestUtime_) return;
+		clock_estimator_add_sample(estimator_, response->request_utime, response->receive_utime,
+		                           response->transmit_utime, buf->recv_utime);
+	}
+
+	void print() const {
+		if(!estimator_->is_valid) {
+			printf("Waiting for lcm_serial_server to respond...\n");
+			return;
+		}
+		// The estimator gives local = remote + offset, but the offset from this computer to the MBot is more useful
+		printf("offset: %+lld us  drift: %+.2f ppm  error: %.0f us  min rtt: %lld us  samples: %d\n",
+		       (long long)(-estimator_->offset), -estimator_->drift * 1e6, estimator_->error,
+		       (long long)estimator_->min_rtt, estimator_->num_samples);
+	}
+
+private:
+	lcm::LCM* lcm_;
+	clock_estimator_t* estimator_;
+	int64_t lastRequestUtime_;
+};
+
 int main(){
 
-	//sleep duration between time samplings
-	const int sleep_usec = 1000000;
+	//time between requests
+	const int request_period_usec = 100000;
+	const int requests_per_print = 10;
 
 	lcm::LCM lcmConnection(MULTICAST_URL);
 	if(!lcmConnection.good()) return 1;
 
-	mbot_lcm_msgs::timestamp_t now;
+	TimesyncClient client(&lcmConnection);
 
 	while(true){
-
-		now.utime = utime_now();
-
-		lcmConnection.publish(MBOT_TIMESYNC_CHANNEL, &now);
-
-		usleep(sleep_usec);
+		for(int n = 0; n < requests_per_print; ++n){
+			int64_t start = utime_now();
+			client.sendRequest();
+			int64_t remaining = request_period_usec - (utime_now() - start);
+			while(remaining > 0){
+				lcmConnection.handleTimeout(remaining / 1000 + 1);
+				remaining = request_period_usec - (utime_now() - start);
+			}
+		}
+		client.print();
 	}
 
 	return 0;
@@ -0,0 +1,53 @@
+#ifndef RPLIDAR_DRIVER_COMPACT_SCAN_HPP
+#define RPLIDAR_DRIVER_COMPACT_SCAN_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include <mbot_lcm_msgs/lidar_compact_t.hpp>
+
+#include <rplidar.h>
+
+/**
+ * How a revolution is cleaned up before it is published as a lidar_compact_t.
+ */
+struct CompactScanOptions
+{
+    float resolution = 0.5;     // Width of each ray's bin (degrees).
+    float min_range = 0;        // Returns closer than this are dropped (m). 0 keeps them all.
+    float max_range = 0;        // Returns farther than this are dropped (m). 0 keeps them all.
+    int median_window = 0;      // Rays in the median filter's window. 0 turns the filter off.
+    float outlier_dist = 0.2;   // Returns farther than this from the median of their window are dropped (m).
+};
+
+/**
+ * Bins the nodes of a revolution into rays a fixed angle apart and filters them. Each bin keeps its closest return,
+ * and bins with no return have a range of 0. The buffers are allocated up front, so building a scan doesn't allocate.
+ */
+class CompactScanBuilder
+{
+public:
+    explicit CompactScanBuilder(const CompactScanOptions& options);
+
+    /**
+     * Builds a scan from the nodes of one revolution, sorted by angle. The scan ran from scan_start to scan_end and
+     * the lidar swept its angles at a steady rate, so each ray's time is that of the middle of its bin.
+     */
+    const mbot_lcm_msgs::lidar_compact_t& build(const rplidar_response_measurement_node_hq_t* nodes, size_t count,
+                                                int64_t scan_start, int64_t scan_end);
+
+private:
+    CompactScanOptions options_;
+    int num_bins_;
+    int min_range_mm_;
+    int max_range_mm_;
+    int outlier_dist_mm_;
+
+    std::vector<int16_t> binned_;   // The closest return in each bin, before filtering.
+    std::vector<int16_t> window_;   // The returns around a ray, for its median.
+    mbot_lcm_msgs::lidar_compact_t scan_;
+
+    void medianFilter();
+};
+
+#endif // RPLIDAR_DRIVER_COMPACT_SCAN_HPP
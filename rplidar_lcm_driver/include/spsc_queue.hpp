@@ -0,0 +1,75 @@
+#ifndef RPLIDAR_DRIVER_SPSC_QUEUE_HPP
+#define RPLIDAR_DRIVER_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * A fixed size, lock-free queue between one producer thread and one consumer thread. The slots are allocated up front
+ * and filled in place, so neither side allocates or copies an element to pass it along.
+ *
+ * The producer fills writeSlot() and calls push(). The consumer reads readSlot() and calls pop() once it is done with
+ * it. Neither side ever waits: writeSlot() is null when the queue is full and readSlot() is null when it is empty.
+ */
+template <class T>
+class SpscQueue
+{
+public:
+    SpscQueue(size_t capacity, const T& init = T())
+    : slots_(capacity + 1, init)
+    , head_(0)
+    , tail_(0)
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer.
+    T* writeSlot()
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (next(tail) == head_.load(std::memory_order_acquire)) return nullptr;
+        return &slots_[tail];
+    }
+
+    void push()
+    {
+        tail_.store(next(tail_.load(std::memory_order_relaxed)), std::memory_order_release);
+    }
+
+    // Consumer.
+    T* readSlot()
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return nullptr;
+        return &slots_[head];
+    }
+
+    void pop()
+    {
+        head_.store(next(head_.load(std::memory_order_relaxed)), std::memory_order_release);
+    }
+
+    // Elements waiting. Exact only on the consumer's thread.
+    size_t size() const
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : tail + slots_.size() - head;
+    }
+
+    size_t capacity() const { return slots_.size() - 1; }
+
+private:
+    // One slot is always empty, so a full queue can be told from an empty one.
+    std::vector<T> slots_;
+    // On separate cache lines, so the two threads don't contend for them.
+    alignas(64) std::atomic<size_t> head_;  // Next slot to read. Written by the consumer.
+    alignas(64) std::atomic<size_t> tail_;  // Next slot to write. Written by the producer.
+
+    size_t next(size_t i) const { return i + 1 == slots_.size() ? 0 : i + 1; }
+};
+
+#endif // RPLIDAR_DRIVER_SPSC_QUEUE_HPP
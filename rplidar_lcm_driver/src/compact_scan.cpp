@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <compact_scan.hpp>
+
+#define PI 3.1415926535f
+
+CompactScanBuilder::CompactScanBuilder(const CompactScanOptions& options)
+: options_(options)
+{
+    num_bins_ = std::max(1, (int)std::lround(360.0f / options_.resolution));
+    min_range_mm_ = options_.min_range * 1000;
+    // The ranges are stored in signed 16 bit mm, so farther returns can't be sent.
+    max_range_mm_ = std::numeric_limits<int16_t>::max();
+    if (options_.max_range > 0) max_range_mm_ = std::min(max_range_mm_, (int)(options_.max_range * 1000));
+    outlier_dist_mm_ = options_.outlier_dist * 1000;
+    options_.median_window = std::min(options_.median_window, num_bins_);
+
+    binned_.resize(num_bins_);
+    window_.reserve(options_.median_window + 1);
+
+    // The lidar spins clockwise, so the angles decrease. Ray k is the middle of bin k.
+    float res_rad = 2 * PI / num_bins_;
+    scan_.start_theta = 2 * PI - 0.5f * res_rad;
+    scan_.theta_step = -res_rad;
+    scan_.num_ranges = num_bins_;
+    scan_.ranges.resize(num_bins_);
+    scan_.intensities.resize(num_bins_);
+}
+
+const mbot_lcm_msgs::lidar_compact_t& CompactScanBuilder::build(const rplidar_response_measurement_node_hq_t* nodes,
+                                                                size_t count, int64_t scan_start, int64_t scan_end)
+{
+    std::fill(binned_.begin(), binned_.end(), 0);
+    std::fill(scan_.intensities.begin(), scan_.intensities.end(), 0);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        int dist_mm = nodes[i].dist_mm_q2 / 4;
+        if (dist_mm == 0 || dist_mm < min_range_mm_ || dist_mm > max_range_mm_) continue;
+
+        // The angle is in 1/2^14 of 90 degrees.
+        int bin = (int64_t)nodes[i].angle_z_q14 * num_bins_ / (4 * 16384);
+        if (bin < 0 || bin >= num_bins_) continue;
+
+        if (binned_[bin] == 0 || dist_mm < binned_[bin])
+        {
+            binned_[bin] = dist_mm;
+            scan_.intensities[bin] = nodes[i].quality >> RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT;
+        }
+    }
+
+    if (options_.median_window > 1) medianFilter();
+    else std::copy(binned_.begin(), binned_.end(), scan_.ranges.begin());
+
+    scan_.utime = scan_end;
+    scan_.time_step = (float)(scan_end - scan_start) / num_bins_;
+    scan_.start_time = scan_start + (int64_t)(0.5f * scan_.time_step);
+    return scan_;
+}
+
+void CompactScanBuilder::medianFilter()
+{
+    int half = options_.median_window / 2;
+    for (int k = 0; k < num_bins_; ++k)
+    {
+        scan_.ranges[k] = binned_[k];
+        if (binned_[k] == 0) continue;
+
+        // The median of the returns around the ray. The scan is a full circle, so the window wraps around.
+        window_.clear();
+        for (int j = k - half; j <= k + half; ++j)
+        {
+            int16_t r = binned_[(j + num_bins_) % num_bins_];
+            if (r > 0) window_.push_back(r);
+        }
+        auto mid = window_.begin() + window_.size() / 2;
+        std::nth_element(window_.begin(), mid, window_.end());
+
+        if (std::abs(binned_[k] - *mid) > outlier_dist_mm_)
+        {
+            scan_.ranges[k] = 0;
+            scan_.intensities[k] = 0;
+        }
+    }
+}
@@ -1,7 +1,12 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <signal.h>
@@ -9,9 +14,14 @@
 
 #include <lcm/lcm-cpp.hpp>
 #include <mbot_lcm_msgs/lidar_t.hpp>
+#include <mbot_lcm_msgs/lidar_compact_t.hpp>
+#include <mbot_lcm_msgs/lidar_driver_stats_t.hpp>
 
 #include <rplidar.h>
 
+#include <compact_scan.hpp>
+#include <spsc_queue.hpp>
+
 #ifndef _countof
 #define _countof(_Array) (int)(sizeof(_Array) / sizeof(_Array[0]))
 #endif
@@ -19,6 +29,14 @@
 #define PI 3.1415926535f
 #define CONNECT_PERIOD 2000000
 #define MULTICAST_URL "udpm://239.255.76.67:7667?ttl=2"
+#define MAX_SCAN_NODES 8192     // The most nodes the SDK caches for one scan.
+#define SCAN_WAIT_THRESHOLD 2000  // If grabbing a scan takes longer than this (us), it waited for the scan to finish.
+#define STATS_PERIOD 1000000    // How often the driver's stats are published (us).
+#define PUBLISH_POLL_PERIOD 500 // How often the publish thread checks for a scan once the next one is due (us).
+#define PUBLISH_MAX_SLEEP 100000 // Longest the publish thread sleeps while waiting for a scan (us).
+#define SCAN_DUE_FRACTION 0.95  // The next scan is due this fraction of the last one's duration after it was grabbed.
+#define SECTOR_POLL_PERIOD 1000 // How often new nodes are collected when streaming sectors (us).
+#define SECTOR_TIMEOUT 2000000  // If no nodes arrive for this long (us) while streaming sectors, the lidar is reconnected.
 
 using namespace rp::standalone::rplidar;
 
@@ -54,7 +72,7 @@ bool checkRPLIDARHealth(RPlidarDriver * drv)
 
 // Catch SIGINT
 #include <signal.h>
-bool ctrl_c_pressed;
+std::atomic<bool> ctrl_c_pressed(false);
 void ctrlc(int)
 {
     ctrl_c_pressed = true;
@@ -103,20 +121,245 @@ bool validateStartupHealth(RPlidarDriver* drv) {
     return checkRPLIDARHealth(drv);
 }
 
+/**
+ * Estimates when a scan finished. The SDK hands over a scan when the sync node starting the next one arrives. If the
+ * grab waited for that, the scan finished as the grab returned. Otherwise the scan was already waiting, so it finished
+ * one revolution after the last one, or at the latest when the grab started.
+ */
+int64_t scanEndTime(int64_t grab_start, int64_t grab_end, int64_t prev_scan_end, int64_t scan_duration)
+{
+    if (grab_end - grab_start > SCAN_WAIT_THRESHOLD || prev_scan_end <= 0) return grab_end;
+    return std::min(prev_scan_end + scan_duration, grab_start);
+}
+
+void startScanning(RPlidarDriver* drv, uint16_t pwm, RplidarScanMode& scan_mode)
+{
+    drv->startMotor();
+    drv->setMotorPWM(pwm);
+    drv->startScan(0, 1, 0, &scan_mode);
+    fprintf(stderr, "Scan mode: %s, %.1f us per sample\n", scan_mode.scan_mode, scan_mode.us_per_sample);
+}
+
+/**
+ * Tries to reconnect after a failed grab. Returns false if the lidar reports that it is unhealthy, which is fatal.
+ */
+bool reconnect(RPlidarDriver* drv, const char* opt_com_path, _u32 opt_com_baudrate, uint16_t pwm,
+               RplidarScanMode& scan_mode)
+{
+    if (!connect(drv, opt_com_path, opt_com_baudrate)) return true;
+    if (!validateStartupHealth(drv)) return false;
+    startScanning(drv, pwm, scan_mode);
+    return true;
+}
+
+/**
+ * The nodes of a revolution, or of a sector of one, handed from the acquisition thread to the publish thread. The
+ * nodes were measured one sample apart, in the order they are in, and the last one a sample before scan_end.
+ */
+struct ScanNodes
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes;
+    size_t count = 0;
+    bool sector = false;        // Whether this is a sector of a revolution rather than a whole one.
+    int64_t grab_time = 0;      // When the last of the nodes were taken from the SDK.
+    int64_t scan_start = 0;
+    int64_t scan_end = 0;
+    float us_per_sample = 0;
+};
+
+/**
+ * Counts kept by the acquisition thread for the publish thread to report. Each is taken and reset once a period.
+ */
+struct AcquisitionStats
+{
+    std::atomic<int32_t> grabbed{0};
+    std::atomic<int32_t> dropped{0};
+    std::atomic<int32_t> grab_errors{0};
+};
+
+/**
+ * Hands scan to the publish thread, or drops it if the publish thread has fallen behind and the queue is full.
+ */
+void handOver(const ScanNodes& scan, SpscQueue<ScanNodes>& queue, AcquisitionStats& stats)
+{
+    ++stats.grabbed;
+    ScanNodes* slot = queue.writeSlot();
+    if (slot == nullptr) {
+        ++stats.dropped;
+        return;
+    }
+
+    std::copy(scan.nodes.begin(), scan.nodes.begin() + scan.count, slot->nodes.begin());
+    slot->count = scan.count;
+    slot->sector = scan.sector;
+    slot->grab_time = scan.grab_time;
+    slot->scan_start = scan.scan_start;
+    slot->scan_end = scan.scan_end;
+    slot->us_per_sample = scan.us_per_sample;
+    queue.push();
+}
+
+/**
+ * Grabs whole revolutions until the driver stops. The grabs go straight into the queue's slots. When the queue is full,
+ * revolutions are still grabbed, so the SDK's cache doesn't overflow, but they are dropped.
+ */
+void acquireRevolutions(RPlidarDriver* drv, const char* opt_com_path, _u32 opt_com_baudrate, uint16_t pwm,
+                        RplidarScanMode scan_mode, SpscQueue<ScanNodes>& queue, AcquisitionStats& stats,
+                        std::atomic<bool>& lidar_connected)
+{
+    std::vector<rplidar_response_measurement_node_hq_t> scratch(MAX_SCAN_NODES);
+    int64_t scan_end = 0;
+
+    while (lidar_connected && !ctrl_c_pressed) {
+        ScanNodes* slot = queue.writeSlot();
+        rplidar_response_measurement_node_hq_t* nodes = slot ? slot->nodes.data() : scratch.data();
+        size_t count = MAX_SCAN_NODES;
+
+        int64_t grab_start = utime_now();
+        u_result op_result = drv->grabScanDataHq(nodes, count);
+        int64_t grab_end = utime_now();
+
+        if (IS_FAIL(op_result)) {
+            ++stats.grab_errors;
+            // Attempt to reconnect to the driver.
+            if (!reconnect(drv, opt_com_path, opt_com_baudrate, pwm, scan_mode)) lidar_connected = false;
+            scan_end = 0;
+            continue;
+        }
+
+        ++stats.grabbed;
+        int64_t scan_duration = count * scan_mode.us_per_sample;
+        scan_end = scanEndTime(grab_start, grab_end, scan_end, scan_duration);
+        if (slot == nullptr) {
+            ++stats.dropped;
+            continue;
+        }
+
+        drv->ascendScanData(nodes, count);
+        slot->count = count;
+        slot->sector = false;
+        slot->grab_time = grab_end;
+        slot->scan_start = scan_end - scan_duration;
+        slot->scan_end = scan_end;
+        slot->us_per_sample = scan_mode.us_per_sample;
+        queue.push();
+    }
+}
+
+/**
+ * Collects nodes as they arrive and hands them over in sectors of a revolution, as soon as each sector is complete,
+ * as well as in whole revolutions. A sector ends when the angle passes into the next one, and a revolution at the
+ * lidar's sync node.
+ */
+void acquireSectors(RPlidarDriver* drv, const char* opt_com_path, _u32 opt_com_baudrate, uint16_t pwm,
+                    RplidarScanMode scan_mode, int num_sectors, SpscQueue<ScanNodes>& queue, AcquisitionStats& stats,
+                    std::atomic<bool>& lidar_connected)
+{
+    std::vector<rplidar_response_measurement_node_hq_t> polled(MAX_SCAN_NODES);
+    ScanNodes sector, revolution;
+    sector.nodes.resize(MAX_SCAN_NODES);
+    sector.sector = true;
+    revolution.nodes.resize(MAX_SCAN_NODES);
+    int current_sector = 0;
+    bool synced = false;    // Whether a revolution has started, so the one being collected is whole.
+    int64_t last_nodes = utime_now();
+
+    while (lidar_connected && !ctrl_c_pressed) {
+        usleep(SECTOR_POLL_PERIOD);
+
+        size_t count = polled.size();
+        u_result op_result = drv->getScanDataWithIntervalHq(polled.data(), count);
+        int64_t grab_time = utime_now();
+
+        if (IS_FAIL(op_result) || count == 0) {
+            if (grab_time - last_nodes < SECTOR_TIMEOUT) continue;
+
+            ++stats.grab_errors;
+            if (!reconnect(drv, opt_com_path, opt_com_baudrate, pwm, scan_mode)) lidar_connected = false;
+            sector.count = revolution.count = 0;
+            synced = false;
+            last_nodes = utime_now();
+            continue;
+        }
+        last_nodes = grab_time;
+
+        float us_per_sample = scan_mode.us_per_sample;
+        for (size_t i = 0; i < count; ++i) {
+            const rplidar_response_measurement_node_hq_t& node = polled[i];
+            bool new_revolution = node.flag & RPLIDAR_RESP_HQ_FLAG_SYNCBIT;
+            int node_sector = std::min((int)((int64_t)node.angle_z_q14 * num_sectors / (4 * 16384)), num_sectors - 1);
+
+            // Only move forward to the next sector, so a node whose angle is a little off doesn't split one.
+            if ((new_revolution || node_sector > current_sector) && sector.count > 0) {
+                sector.scan_start = sector.scan_end - (int64_t)(sector.count * us_per_sample);
+                handOver(sector, queue, stats);
+                sector.count = 0;
+            }
+            if (new_revolution) {
+                if (synced && revolution.count > 0) {
+                    revolution.scan_start = revolution.scan_end - (int64_t)(revolution.count * us_per_sample);
+                    drv->ascendScanData(revolution.nodes.data(), revolution.count);
+                    handOver(revolution, queue, stats);
+                }
+                revolution.count = 0;
+                synced = true;
+            }
+            if (new_revolution || node_sector > current_sector) current_sector = node_sector;
+
+            // The last node polled was measured a sample ago, and each one before it a sample earlier.
+            int64_t scan_end = grab_time - (int64_t)((count - 1 - i) * us_per_sample);
+            if (sector.count < sector.nodes.size()) sector.nodes[sector.count++] = node;
+            if (revolution.count < revolution.nodes.size()) revolution.nodes[revolution.count++] = node;
+            sector.scan_end = revolution.scan_end = scan_end;
+            sector.grab_time = revolution.grab_time = grab_time;
+            sector.us_per_sample = revolution.us_per_sample = us_per_sample;
+        }
+    }
+}
+
+/**
+ * Fills a lidar_t with every stride + 1th node. The rays are in the order they were measured, so the times increase.
+ * The lidar spins clockwise, so the angles decrease.
+ */
+void fillScan(const ScanNodes& raw, uint8_t stride, mbot_lcm_msgs::lidar_t& scan)
+{
+    int stride_ray_count = raw.count / (stride + 1);
+
+    scan.utime = raw.scan_end;
+    scan.num_ranges = stride_ray_count;
+    scan.ranges.resize(stride_ray_count);
+    scan.thetas.resize(stride_ray_count);
+    scan.intensities.resize(stride_ray_count);
+    scan.times.resize(stride_ray_count);
+
+    for (int pos = 0; pos < stride_ray_count ; ++pos) {
+        int scan_idx = pos * (stride + 1);
+        const rplidar_response_measurement_node_hq_t& node = raw.nodes[scan_idx];
+        scan.ranges[pos] = node.dist_mm_q2/4000.0f;
+        scan.thetas[pos] = 2*PI - node.angle_z_q14 * (PI / 32768.0); // use updated angle formula
+        scan.intensities[pos] = node.quality >> RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT;
+        scan.times[pos] = raw.scan_start + (int64_t)(scan_idx * raw.us_per_sample);
+    }
+}
+
 int main(int argc, char *argv[]) {
 
     // Default values
     const char * opt_com_path = "/dev/rplidar";
     _u32         opt_com_baudrate = 115200;
     uint16_t pwm = 700;
-    bool lidar_connected = false;
+    std::atomic<bool> lidar_connected(false);
 
     lcm::LCM lcmConnection(MULTICAST_URL);
 
     if(!lcmConnection.good()) { return 1; }
 
     uint8_t stride = 0;
-
+    CompactScanOptions compact_options;
+    bool publish_full = true;
+    bool publish_compact = true;
+    int num_sectors = 0;
+    int queue_size = 8;
     // command line arguments
     int c;
     static struct option long_options[] = {
@@ -125,9 +368,17 @@ int main(int argc, char *argv[]) {
         {"pwm", optional_argument, NULL, 'w'},
         {"help", no_argument, NULL, 'h'},
         {"stride", required_argument, NULL, 's'},
+        {"format", required_argument, NULL, 'f'},
+        {"resolution", required_argument, NULL, 'r'},
+        {"min-range", required_argument, NULL, 'n'},
+        {"max-range", required_argument, NULL, 'x'},
+        {"median", required_argument, NULL, 'm'},
+        {"outlier-dist", required_argument, NULL, 'o'},
+        {"sectors", required_argument, NULL, 'S'},
+        {"queue", required_argument, NULL, 'q'},
         {NULL, 0, NULL, 0}};
 
-    while ((c = getopt_long(argc, argv, "p:b:w:s:h", long_options, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "p:b:w:s:f:r:n:x:m:o:S:q:h", long_options, NULL)) != -1) {
         switch (c) {
         case 'p':
             if(optarg)
@@ -144,12 +395,50 @@ int main(int argc, char *argv[]) {
         case 's':
             stride = atoi(optarg);
             break;
+        case 'f':
+            publish_full = strcmp(optarg, "compact") != 0;
+            publish_compact = strcmp(optarg, "full") != 0;
+            if (!publish_full && !publish_compact) publish_full = publish_compact = true;
+            break;
+        case 'r':
+            compact_options.resolution = atof(optarg);
+            if (compact_options.resolution <= 0) {
+                fprintf(stderr, "ERROR: resolution must be positive.\n");
+                return 1;
+            }
+            break;
+        case 'n':
+            compact_options.min_range = atof(optarg);
+            break;
+        case 'x':
+            compact_options.max_range = atof(optarg);
+            break;
+        case 'm':
+            compact_options.median_window = atoi(optarg);
+            break;
+        case 'o':
+            compact_options.outlier_dist = atof(optarg);
+            break;
+        case 'S':
+            num_sectors = atoi(optarg);
+            break;
+        case 'q':
+            queue_size = std::max(atoi(optarg), 1);
+            break;
         case 'h':
             std::cout << "Usage: \n"
                       << "\t--dev or -d: Path of the device (default: " << opt_com_path << ") \n"
                       << "\t--baudrate or -b: Baudrate of the device (default: " << opt_com_baudrate << ") \n"
                       << "\t--pwm or -w: Pulse Width Modulation value (default: " << pwm << ") \n"
-                      << "\t--stride or -s: Stride value for lidar rays, 0 = include all (default: " << stride << ")\n"
+                      << "\t--stride or -s: Stride value for lidar rays on LIDAR, 0 = include all (default: " << stride << ")\n"
+                      << "\t--format or -f: Scans to publish: full (LIDAR), compact (LIDAR_COMPACT) or both (default: both)\n"
+                      << "\t--resolution or -r: Angle between compact rays in degrees (default: " << compact_options.resolution << ")\n"
+                      << "\t--min-range or -n: Drop compact returns closer than this in meters, 0 = off (default: " << compact_options.min_range << ")\n"
+                      << "\t--max-range or -x: Drop compact returns farther than this in meters, 0 = off (default: " << compact_options.max_range << ")\n"
+                      << "\t--median or -m: Rays in the compact median outlier filter, 0 = off (default: " << compact_options.median_window << ")\n"
+                      << "\t--outlier-dist or -o: Drop compact returns farther than this from the median in meters (default: " << compact_options.outlier_dist << ")\n"
+                      << "\t--sectors or -S: Also publish each revolution in this many sectors on LIDAR_SECTOR as they arrive, 0 = off (default: " << num_sectors << ")\n"
+                      << "\t--queue or -q: Scans that can wait to be published before new ones are dropped (default: " << queue_size << ")\n"
                       << "\t--help or -h: Display this help message \n";
             return 0;
         default:
@@ -166,8 +455,25 @@ int main(int argc, char *argv[]) {
         exit(-2);
     }
 
-    int64_t now = utime_now();
-    int64_t prev_time;
+    RplidarScanMode scan_mode = {};
+
+    // Everything is allocated up front, so nothing is allocated once scanning starts.
+    ScanNodes empty_nodes;
+    empty_nodes.nodes.resize(MAX_SCAN_NODES);
+    SpscQueue<ScanNodes> queue(queue_size, empty_nodes);
+    AcquisitionStats acquisition_stats;
+    std::thread acquisition_thread;
+
+    mbot_lcm_msgs::lidar_t scan;
+    scan.ranges.reserve(MAX_SCAN_NODES);
+    scan.thetas.reserve(MAX_SCAN_NODES);
+    scan.intensities.reserve(MAX_SCAN_NODES);
+    scan.times.reserve(MAX_SCAN_NODES);
+    CompactScanBuilder compact_builder(compact_options);
+
+    mbot_lcm_msgs::lidar_driver_stats_t stats = {};
+    int64_t stats_start = 0;
+    double latency_sum = 0;
 
     signal(SIGINT, ctrlc);
     signal(SIGTERM, ctrlc);
@@ -182,62 +488,81 @@ int main(int argc, char *argv[]) {
     if (!validateStartupHealth(drv)) goto on_finished;
     else lidar_connected = true;
 
-    drv->startMotor();
-    // start scan...
-    drv->setMotorPWM(pwm);
-    drv->startScan(0, 1);
-
-    u_result     op_result;
-
-    while (lidar_connected) {
-        rplidar_response_measurement_node_hq_t nodes[8192];
-        size_t   count = _countof(nodes);
-
-        op_result = drv->grabScanDataHq(nodes, count);
-        prev_time = now;
-        now = utime_now();  // get current timestamp in milliseconds
-        int64_t delta = (now - prev_time)/count;
-
-        if (IS_OK(op_result)) {
-
-            drv->ascendScanData(nodes, count);
+    startScanning(drv, pwm, scan_mode);
 
-            int stride_ray_count = count / (stride + 1);
-            mbot_lcm_msgs::lidar_t newLidar;
+    // Grabbing runs on a thread of its own, so a slow publish never holds up the next grab.
+    if (num_sectors > 0) {
+        acquisition_thread = std::thread(acquireSectors, drv, opt_com_path, opt_com_baudrate, pwm, scan_mode,
+                                         num_sectors, std::ref(queue), std::ref(acquisition_stats),
+                                         std::ref(lidar_connected));
+    }
+    else {
+        acquisition_thread = std::thread(acquireRevolutions, drv, opt_com_path, opt_com_baudrate, pwm, scan_mode,
+                                         std::ref(queue), std::ref(acquisition_stats), std::ref(lidar_connected));
+    }
 
-            newLidar.utime = now;
-            newLidar.num_ranges = stride_ray_count;
-            newLidar.ranges.resize(stride_ray_count);
-            newLidar.thetas.resize(stride_ray_count);
-            newLidar.intensities.resize(stride_ray_count);
-            newLidar.times.resize(stride_ray_count);
+    stats_start = utime_now();
+    stats.queue_capacity = queue.capacity();
+    int64_t next_scan_due = 0;  // When the acquisition thread is expected to hand over the next scan.
+
+    while (lidar_connected && !ctrl_c_pressed) {
+        int64_t now = utime_now();
+        if (now - stats_start >= STATS_PERIOD) {
+            stats.utime = now;
+            stats.period_s = (now - stats_start) / 1e6f;
+            stats.num_grabbed = acquisition_stats.grabbed.exchange(0);
+            stats.num_dropped = acquisition_stats.dropped.exchange(0);
+            stats.num_grab_errors = acquisition_stats.grab_errors.exchange(0);
+            stats.latency_mean_us = stats.num_published > 0 ? latency_sum / stats.num_published : 0;
+            lcmConnection.publish("LIDAR_STATS", &stats);
+
+            stats.num_published = 0;
+            stats.queue_max = 0;
+            stats.latency_max_us = 0;
+            latency_sum = 0;
+            stats_start = now;
+        }
 
-            for (int pos = 0; pos < stride_ray_count ; ++pos) {
-            	int scan_idx = (int)count - (pos * (stride+1)) - 1;
-                newLidar.ranges[pos] = nodes[scan_idx].dist_mm_q2/4000.0f;
-            	newLidar.thetas[pos] = 2*PI - nodes[scan_idx].angle_z_q14 * (PI / 32768.0); // use updated angle formula
-            	newLidar.intensities[pos] = nodes[scan_idx].quality >> RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT;
-            	newLidar.times[pos] = prev_time + pos*delta;
-            }
+        // Scans are handed over a scan's duration apart, so sleep through most of that and only check often once the
+        // next one is due. The hand-off itself stays lock-free.
+        ScanNodes* raw = queue.readSlot();
+        if (raw == nullptr) {
+            int64_t until_due = next_scan_due - utime_now();
+            usleep(std::min<int64_t>(std::max<int64_t>(until_due, PUBLISH_POLL_PERIOD), PUBLISH_MAX_SLEEP));
+            continue;
+        }
+        stats.queue_max = std::max(stats.queue_max, (int32_t)queue.size());
 
-            lcmConnection.publish("LIDAR", &newLidar);
+        if (raw->sector) {
+            fillScan(*raw, stride, scan);
+            lcmConnection.publish("LIDAR_SECTOR", &scan);
         }
         else {
-            // Attempt to reconnect to the driver.
-            if (connect(drv, opt_com_path, opt_com_baudrate)) {
-                if (!validateStartupHealth(drv)) goto on_finished;
-                drv->startMotor();
-                // start scan...
-                drv->setMotorPWM(pwm);
-                drv->startScan(0,1);
+            if (publish_compact) {
+                lcmConnection.publish("LIDAR_COMPACT",
+                                      &compact_builder.build(raw->nodes.data(), raw->count, raw->scan_start,
+                                                             raw->scan_end));
+            }
+            if (publish_full) {
+                fillScan(*raw, stride, scan);
+                lcmConnection.publish("LIDAR", &scan);
             }
         }
 
-        if (ctrl_c_pressed){
-            break;
+        float latency = utime_now() - raw->grab_time;
+        latency_sum += latency;
+        stats.latency_max_us = std::max(stats.latency_max_us, latency);
+        ++stats.num_published;
+        // With sectors, the next hand-over is the next sector, even right after a whole revolution.
+        if (raw->sector == (num_sectors > 0)) {
+            next_scan_due = raw->grab_time + (int64_t)(SCAN_DUE_FRACTION * raw->count * raw->us_per_sample);
         }
+        queue.pop();
     }
 
+    lidar_connected = false;
+    acquisition_thread.join();
+
     drv->stop();
     drv->stopMotor();
     // done!